@@ -1,13 +1,17 @@
 #include "RenderGraph/RenderPass.h"
 #include "SurfelGBuffer/SurfelGBuffer.h"
 #include "SurfelVBuffer/SurfelVBuffer.h"
+#include "SurfelSurfaceCache/SurfelSurfaceCache.h"
 #include "SurfelGIRenderPass/SurfelGIRenderPass.h"
 #include "SurfelGI/SurfelGI.h"
+#include "SurfelGICPU/SurfelGICPU.h"
 
 extern "C" FALCOR_API_EXPORT void registerPlugin(Falcor::PluginRegistry& registry)
 {
     registry.registerClass<RenderPass, SurfelGBuffer>();
     registry.registerClass<RenderPass, SurfelVBuffer>();
+    registry.registerClass<RenderPass, SurfelSurfaceCache>();
     registry.registerClass<RenderPass, SurfelGIRenderPass>();
     registry.registerClass<RenderPass, SurfelGI>();
+    registry.registerClass<RenderPass, SurfelGICPU>();
 }
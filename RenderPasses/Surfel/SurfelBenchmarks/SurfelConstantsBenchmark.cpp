@@ -0,0 +1,241 @@
+#include "Falcor.h"
+#include <benchmark/benchmark.h>
+#include <array>
+
+using namespace Falcor;
+
+// MSMEData is declared outside of Falcor namespace, so types must be visible before include.
+#include "SurfelGI/SurfelTypes.slang"
+
+// Host cost of constant upload and binding in SurfelGI, needs a device.
+// Per-member path looks up every constant by name from root var, as passes did before constants became structs.
+// Blob path resolves constants var once and uploads the whole struct. With dispatch, upload and binding are flushed
+// to the command list each iteration as in a frame; without, only the setters are measured.
+// Benchmarks take upload path (0 per member, 1 blob) and dispatch (0 or 1) as arguments.
+
+namespace
+{
+
+const char kShaderFile[] = "RenderPasses/Surfel/SurfelBenchmarks/SurfelConstantsBenchmark.cs.slang";
+const uint kBufferCount = 8;
+
+// Dispatches are submitted once per given iterations, so that command list does not grow without bound.
+const uint kSubmitInterval = 256;
+
+enum class UploadPath
+{
+    PerMember,
+    Blob,
+};
+
+ref<Device> getDevice()
+{
+    static ref<Device> pDevice = []() -> ref<Device>
+    {
+        try
+        {
+            return make_ref<Device>(Device::Desc());
+        }
+        catch (const std::exception&)
+        {
+            return nullptr;
+        }
+    }();
+    return pDevice;
+}
+
+ref<ComputePass> createPass(ref<Device> pDevice, const std::string& constantsType)
+{
+    DefineList defines;
+    defines.add("CONSTANTS_TYPE", constantsType);
+    return ComputePass::create(pDevice, kShaderFile, "csMain", defines);
+}
+
+std::array<ref<Buffer>, kBufferCount> createBuffers(ref<Device> pDevice)
+{
+    std::array<ref<Buffer>, kBufferCount> buffers;
+    for (auto& pBuffer : buffers)
+        pBuffer = pDevice->createStructuredBuffer(sizeof(uint), 1, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr, false);
+    return buffers;
+}
+
+void bindBuffers(const ShaderVar& rootVar, const std::array<ref<Buffer>, kBufferCount>& buffers)
+{
+    for (uint i = 0; i < kBufferCount; ++i)
+        rootVar["gBuffer" + std::to_string(i)] = buffers[i];
+}
+
+SurfelView createView(uint index)
+{
+    SurfelView view = {};
+    view.viewProj = float4x4::identity();
+    view.position = float3((float)index, 1.f, 0.f);
+    view.fovy = 1.f;
+    view.resolution = uint2(1920, 1080);
+    view.frameDim = view.resolution;
+    return view;
+}
+
+void setViewByName(const ShaderVar& var, const SurfelView& view)
+{
+    var["viewProj"] = view.viewProj;
+    var["position"] = view.position;
+    var["fovy"] = view.fovy;
+    var["resolution"] = view.resolution;
+    var["frameDim"] = view.frameDim;
+}
+
+void setConstantsByName(const ShaderVar& rootVar, const SurfelViewPassConstants& constants)
+{
+    setViewByName(rootVar["CB"]["gConstants"]["view"], constants.view);
+    rootVar["CB"]["gConstants"]["gridCenter"] = constants.gridCenter;
+    rootVar["CB"]["gConstants"]["frameIndex"] = constants.frameIndex;
+    rootVar["CB"]["gConstants"]["chanceMultiply"] = constants.chanceMultiply;
+    rootVar["CB"]["gConstants"]["chancePower"] = constants.chancePower;
+    rootVar["CB"]["gConstants"]["placementThreshold"] = constants.placementThreshold;
+    rootVar["CB"]["gConstants"]["removalThreshold"] = constants.removalThreshold;
+    rootVar["CB"]["gConstants"]["blendingDelay"] = constants.blendingDelay;
+    rootVar["CB"]["gConstants"]["overlayMode"] = constants.overlayMode;
+    rootVar["CB"]["gConstants"]["varianceSensitivity"] = constants.varianceSensitivity;
+    rootVar["CB"]["gConstants"]["useSurfaceCache"] = constants.useSurfaceCache;
+}
+
+void setConstantsByName(const ShaderVar& rootVar, const SurfelUpdateConstants& constants)
+{
+    for (uint i = 0; i < constants.viewCount; ++i)
+        setViewByName(rootVar["CB"]["gConstants"]["views"][i], constants.views[i]);
+    rootVar["CB"]["gConstants"]["gridCenter"] = constants.gridCenter;
+    rootVar["CB"]["gConstants"]["viewCount"] = constants.viewCount;
+    rootVar["CB"]["gConstants"]["lockSurfel"] = constants.lockSurfel;
+    rootVar["CB"]["gConstants"]["varianceSensitivity"] = constants.varianceSensitivity;
+    rootVar["CB"]["gConstants"]["minRayCount"] = constants.minRayCount;
+    rootVar["CB"]["gConstants"]["maxRayCount"] = constants.maxRayCount;
+    rootVar["CB"]["gConstants"]["useFullRayBudget"] = constants.useFullRayBudget;
+    rootVar["CB"]["gConstants"]["evictSurfel"] = constants.evictSurfel;
+    rootVar["CB"]["gConstants"]["restoreCount"] = constants.restoreCount;
+    rootVar["CB"]["gConstants"]["frameIndex"] = constants.frameIndex;
+    rootVar["CB"]["gConstants"]["updateInterval"] = constants.updateInterval;
+    rootVar["CB"]["gConstants"]["updateVarianceThreshold"] = constants.updateVarianceThreshold;
+}
+
+SurfelViewPassConstants createViewPassConstants()
+{
+    SurfelViewPassConstants constants = {};
+    constants.view = createView(0);
+    constants.chanceMultiply = 1.f;
+    constants.chancePower = 1;
+    constants.placementThreshold = 1.f;
+    constants.removalThreshold = 2.f;
+    constants.blendingDelay = 240;
+    constants.varianceSensitivity = 40.f;
+    return constants;
+}
+
+SurfelUpdateConstants createUpdateConstants()
+{
+    SurfelUpdateConstants constants = {};
+    constants.viewCount = kMaxViewCount;
+    for (uint i = 0; i < kMaxViewCount; ++i)
+        constants.views[i] = createView(i);
+    constants.varianceSensitivity = 40.f;
+    constants.minRayCount = 4;
+    constants.maxRayCount = 64;
+    return constants;
+}
+
+// Frame index changes every iteration, so that each upload has new data.
+template<typename Constants>
+void runConstantsBenchmark(benchmark::State& state, const std::string& constantsType, Constants constants)
+{
+    ref<Device> pDevice = getDevice();
+    if (!pDevice)
+    {
+        state.SkipWithError("No device");
+        return;
+    }
+
+    const UploadPath path = (UploadPath)state.range(0);
+    const bool dispatch = state.range(1) != 0;
+
+    ref<ComputePass> pPass = createPass(pDevice, constantsType);
+    bindBuffers(pPass->getRootVar(), createBuffers(pDevice));
+    const ShaderVar constantsVar = pPass->getRootVar()["CB"]["gConstants"];
+    RenderContext* pRenderContext = pDevice->getRenderContext();
+
+    uint iteration = 0;
+    for (auto _ : state)
+    {
+        constants.frameIndex = iteration;
+
+        if (path == UploadPath::PerMember)
+            setConstantsByName(pPass->getRootVar(), constants);
+        else
+            constantsVar.setBlob(constants);
+
+        if (dispatch)
+        {
+            pPass->execute(pRenderContext, uint3(1, 1, 1));
+            if (++iteration % kSubmitInterval == 0)
+                pRenderContext->submit(false);
+        }
+        else
+        {
+            iteration++;
+        }
+    }
+
+    pRenderContext->submit(true);
+    state.SetLabel(path == UploadPath::PerMember ? "per member" : "blob");
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Constants of evaluation, generation and overlay pass, uploaded once per view and pass.
+void BM_ViewPassConstants(benchmark::State& state)
+{
+    runConstantsBenchmark(state, "SurfelViewPassConstants", createViewPassConstants());
+}
+BENCHMARK(BM_ViewPassConstants)->ArgsProduct({{0, 1}, {0, 1}});
+
+// Constants of update kernels, with every view.
+void BM_UpdateConstants(benchmark::State& state)
+{
+    runConstantsBenchmark(state, "SurfelUpdateConstants", createUpdateConstants());
+}
+BENCHMARK(BM_UpdateConstants)->ArgsProduct({{0, 1}, {0, 1}});
+
+// Buffers bound by name on every dispatch, as passes did before bindings were kept across frames, or bound once.
+// Takes rebind (0 or 1) as argument.
+void BM_BindBuffers(benchmark::State& state)
+{
+    ref<Device> pDevice = getDevice();
+    if (!pDevice)
+    {
+        state.SkipWithError("No device");
+        return;
+    }
+
+    const bool rebind = state.range(0) != 0;
+
+    ref<ComputePass> pPass = createPass(pDevice, "SurfelViewPassConstants");
+    const auto buffers = createBuffers(pDevice);
+    bindBuffers(pPass->getRootVar(), buffers);
+    RenderContext* pRenderContext = pDevice->getRenderContext();
+
+    uint iteration = 0;
+    for (auto _ : state)
+    {
+        if (rebind)
+            bindBuffers(pPass->getRootVar(), buffers);
+
+        pPass->execute(pRenderContext, uint3(1, 1, 1));
+        if (++iteration % kSubmitInterval == 0)
+            pRenderContext->submit(false);
+    }
+
+    pRenderContext->submit(true);
+    state.SetLabel(rebind ? "rebind" : "bound once");
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BindBuffers)->Arg(0)->Arg(1);
+
+} // namespace
@@ -0,0 +1,173 @@
+#include "SurfelReference/SurfelReferenceEngine.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+// Host reference of surfel pipeline, for tuning algorithms without GPU.
+// Engine benchmarks take surfel count and thread count as arguments.
+
+namespace
+{
+
+SurfelReferenceEngine::Settings createSettings(uint surfelCount, uint threadCount)
+{
+    SurfelReferenceEngine::Settings settings;
+    settings.staticParams.cellUnit = 0.05f;
+    settings.staticParams.useIrradianceSharing = true;
+    settings.surfelLimit = surfelCount;
+    settings.threadCount = threadCount;
+    return settings;
+}
+
+SurfelView createView()
+{
+    SurfelView view = {};
+    view.position = float3(0.f, 1.f, 0.f);
+    view.fovy = 1.f;
+    view.resolution = uint2(1920, 1080);
+    view.frameDim = view.resolution;
+    return view;
+}
+
+std::vector<Surfel> createFloorSurfels(uint count, float extent = 4.f)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-extent, extent);
+
+    std::vector<Surfel> surfels(count);
+    for (Surfel& surfel : surfels)
+    {
+        surfel = {};
+        surfel.position = float3(dist(rng), 0.f, dist(rng));
+        surfel.normal = float3(0.f, 1.f, 0.f);
+        surfel.radius = 0.05f;
+        surfel.msmeData = SurfelReference::makeMSMEData();
+    }
+    return surfels;
+}
+
+std::vector<SurfelRayResult> createRayResults(const SurfelReferenceEngine& engine)
+{
+    std::vector<SurfelRayResult> rayResults(engine.getRequestedRayCount());
+    for (uint rayIndex = 0; rayIndex < rayResults.size(); ++rayIndex)
+    {
+        SurfelRayResult& rayResult = rayResults[rayIndex];
+        rayResult = {};
+        rayResult.dirWorld = float3(0.f, 1.f, 0.f);
+        rayResult.pdf = 1.f / (2.f * (float)M_PI);
+        rayResult.radiance = float3((float)(rayIndex % 7) * 0.25f);
+        rayResult.surfelIndex = engine.findRaySurfel(rayIndex);
+    }
+    return rayResults;
+}
+
+void BM_IsSurfelIntersectCell(benchmark::State& state)
+{
+    const float cellUnit = 0.05f;
+    const float3 surfelPos = float3(0.013f, 0.021f, -0.007f);
+
+    for (auto _ : state)
+    {
+        uint count = 0;
+        for (int x = -2; x <= 2; ++x)
+            for (int y = -2; y <= 2; ++y)
+                for (int z = -2; z <= 2; ++z)
+                    count += SurfelReference::isSurfelIntersectCell(surfelPos, 0.06f, int3(x, y, z), float3(0.f), cellUnit, 250);
+        benchmark::DoNotOptimize(count);
+    }
+
+    state.SetItemsProcessed(state.iterations() * 125);
+}
+BENCHMARK(BM_IsSurfelIntersectCell);
+
+void BM_OctEncodeDecode(benchmark::State& state)
+{
+    float3 dir = math::normalize(float3(0.3f, -0.2f, 0.9f));
+
+    for (auto _ : state)
+    {
+        dir = SurfelReference::octDecode(SurfelReference::octEncode(dir));
+        benchmark::DoNotOptimize(dir);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OctEncodeDecode);
+
+void BM_MSME(benchmark::State& state)
+{
+    MSMEData data = SurfelReference::makeMSMEData();
+    float3 y = float3(1.f);
+
+    for (auto _ : state)
+    {
+        y = SurfelReference::MSME(y * 1.0001f, data) + float3(0.1f);
+        benchmark::DoNotOptimize(y);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MSME);
+
+void BM_EngineUpdate(benchmark::State& state)
+{
+    const uint surfelCount = (uint)state.range(0);
+    SurfelReferenceEngine engine(createSettings(surfelCount, (uint)state.range(1)));
+    engine.spawn(createFloorSurfels(surfelCount));
+
+    const std::vector<SurfelView> views = {createView()};
+    for (auto _ : state)
+    {
+        for (uint surfelIndex : engine.getValidSurfelIndices())
+            engine.markSeen(surfelIndex);
+        engine.update(views);
+    }
+
+    state.SetItemsProcessed(state.iterations() * surfelCount);
+}
+BENCHMARK(BM_EngineUpdate)->ArgsProduct({{16384, 150000}, {1, 4, 0}})->Unit(benchmark::kMillisecond);
+
+void BM_EngineIntegrate(benchmark::State& state)
+{
+    const uint surfelCount = (uint)state.range(0);
+    SurfelReferenceEngine engine(createSettings(surfelCount, (uint)state.range(1)));
+    engine.spawn(createFloorSurfels(surfelCount));
+    engine.update({createView()});
+
+    const std::vector<SurfelRayResult> rayResults = createRayResults(engine);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(engine.integrate(rayResults));
+
+    state.SetItemsProcessed(state.iterations() * rayResults.size());
+}
+BENCHMARK(BM_EngineIntegrate)->ArgsProduct({{16384, 150000}, {1, 4, 0}})->Unit(benchmark::kMillisecond);
+
+// Update of dense cells, with neighbor lists of irradiance sharing built or not.
+// Floor is shrunk so that each cell holds given number of surfels. Cost of lists should not grow with density.
+void BM_NeighborListsDenseCells(benchmark::State& state)
+{
+    const uint surfelCount = 65536;
+    const uint surfelsPerCell = (uint)state.range(0);
+    const float cellUnit = 0.05f;
+    const float extent = 0.5f * cellUnit * std::sqrt((float)surfelCount / (float)surfelsPerCell);
+
+    auto settings = createSettings(surfelCount, 0);
+    settings.staticParams.useIrradianceSharing = state.range(1) != 0;
+    settings.runtimeParams.fixedGridCenter = true;
+
+    SurfelReferenceEngine engine(settings);
+    engine.spawn(createFloorSurfels(surfelCount, extent));
+
+    const std::vector<SurfelView> views = {createView()};
+    for (auto _ : state)
+    {
+        for (uint surfelIndex : engine.getValidSurfelIndices())
+            engine.markSeen(surfelIndex);
+        engine.update(views);
+    }
+
+    state.counters["surfelsPerCell"] = (double)surfelsPerCell;
+    state.SetItemsProcessed(state.iterations() * surfelCount);
+}
+BENCHMARK(BM_NeighborListsDenseCells)->ArgsProduct({{4, 64, 1024, 8192}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -1,4 +1,5 @@
 #include "SurfelGBuffer.h"
+#include "../SurfelGI/ResolutionScale.h"
 
 const ChannelList SurfelGBuffer::kChannels = {
     {"packedHitInfo", "gPackedHitInfo", "Packed Hit Info", true, ResourceFormat::RGBA32Uint},
@@ -52,6 +53,11 @@ void SurfelGBuffer::execute(RenderContext* pRenderContext, const RenderData& ren
         pRenderContext->clearFbo(mpFbo.get(), float4(0), 1.f, 0, FboAttachmentType::Color);
 
         mpState->setFbo(mpFbo);
+
+        // Viewport of sub-rectangle keeps projection of full frame, with fewer pixels.
+        const uint2 renderResolution =
+            getRenderResolution(uint2(pDepth->getWidth(), pDepth->getHeight()), getResolutionScale(renderData));
+        mpState->setViewport(0, GraphicsState::Viewport(0.f, 0.f, (float)renderResolution.x, (float)renderResolution.y, 0.f, 1.f));
         mpScene->rasterize(pRenderContext, mpState.get(), mpVars.get());
     }
 }
@@ -0,0 +1,126 @@
+#pragma once
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <optional>
+#include <string>
+
+// Build a new set of programs on worker thread, while caller keeps rendering with current one.
+//
+//   Idle --request--> Building --poll, done--> Idle (result returned once)
+//                        |  \--poll, failed--> Failed (current programs stay in use)
+//                        \--request--> Building, newer job queued. Result of older job is dropped.
+//
+// Only the latest request is ever swapped in. Job is free to throw, the message is kept for UI.
+// Launcher is replaceable, so that the state machine can be driven by stub jobs on host.
+template<typename T>
+class AsyncRecompiler
+{
+public:
+    enum class State
+    {
+        Idle,
+        Building,
+        Failed,
+    };
+
+    using Job = std::function<T()>;
+    using Launcher = std::function<std::future<T>(Job)>;
+
+    AsyncRecompiler()
+        : mLauncher([](Job job) { return std::async(std::launch::async, std::move(job)); })
+    {}
+
+    explicit AsyncRecompiler(Launcher launcher) : mLauncher(std::move(launcher)) {}
+
+    ~AsyncRecompiler() { cancel(); }
+
+    AsyncRecompiler(const AsyncRecompiler&) = delete;
+    AsyncRecompiler& operator=(const AsyncRecompiler&) = delete;
+
+    void request(Job job)
+    {
+        if (mState == State::Building)
+        {
+            mPendingJob = std::move(job);
+            return;
+        }
+
+        start(std::move(job));
+    }
+
+    // Returns result of latest request once it is built. Never blocks.
+    std::optional<T> poll()
+    {
+        if (mState != State::Building || mFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return std::nullopt;
+
+        std::optional<T> result;
+        try
+        {
+            result = mFuture.get();
+        }
+        catch (const std::exception& e)
+        {
+            mError = e.what();
+        }
+        catch (...)
+        {
+            mError = "Unknown error.";
+        }
+
+        // Newer request supersedes this one, whether it succeeded or not.
+        if (mPendingJob)
+        {
+            Job job = std::move(mPendingJob);
+            mPendingJob = nullptr;
+            start(std::move(job));
+            return std::nullopt;
+        }
+
+        mState = result ? State::Idle : State::Failed;
+        return result;
+    }
+
+    // Block until latest request is built. For callers which need result right away, e.g. scripting.
+    std::optional<T> wait()
+    {
+        while (mState == State::Building)
+        {
+            mFuture.wait();
+            if (auto result = poll())
+                return result;
+        }
+        return std::nullopt;
+    }
+
+    // Wait for job in flight and drop it, with any queued one.
+    void cancel()
+    {
+        mPendingJob = nullptr;
+        if (mFuture.valid())
+            mFuture.wait();
+        mFuture = {};
+        mState = State::Idle;
+    }
+
+    State getState() const { return mState; }
+    bool isBuilding() const { return mState == State::Building; }
+    bool hasPendingRequest() const { return (bool)mPendingJob; }
+    const std::string& getError() const { return mError; }
+
+private:
+    void start(Job job)
+    {
+        mError.clear();
+        mState = State::Building;
+        mFuture = mLauncher(std::move(job));
+    }
+
+    Launcher mLauncher;
+    State mState = State::Idle;
+    std::future<T> mFuture;
+    Job mPendingJob;
+    std::string mError;
+};
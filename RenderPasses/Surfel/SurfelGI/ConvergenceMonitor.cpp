@@ -0,0 +1,51 @@
+#include "ConvergenceMonitor.h"
+#include "SurfelTypes.slang"
+
+void ConvergenceMonitor::reset(const Criteria& criteria)
+{
+    mCriteria = criteria;
+    mCriteria.maxIterationCount = std::max(1u, mCriteria.maxIterationCount);
+    mCriteria.minIterationCount = std::min(mCriteria.minIterationCount, mCriteria.maxIterationCount);
+
+    mStatus = Status::Running;
+    mStableCount = 0;
+    mHistory.clear();
+}
+
+ConvergenceMonitor::Status ConvergenceMonitor::addSample(float meanVariance)
+{
+    mHistory.push_back(meanVariance);
+
+    if (mStatus != Status::Running)
+        return mStatus;
+
+    // NaN is never under threshold.
+    if (meanVariance <= mCriteria.varianceThreshold)
+        mStableCount++;
+    else
+        mStableCount = 0;
+
+    const uint iterationCount = getIterationCount();
+    if (iterationCount >= mCriteria.minIterationCount && mStableCount >= mCriteria.stableIterationCount)
+        mStatus = Status::Converged;
+    else if (iterationCount >= mCriteria.maxIterationCount)
+        mStatus = Status::IterationCap;
+
+    return mStatus;
+}
+
+ConvergenceMonitor::Status ConvergenceMonitor::addEmptySample()
+{
+    if (mStatus == Status::Running)
+        mStatus = Status::Empty;
+
+    return mStatus;
+}
+
+float ConvergenceMonitor::getMeanVariance(uint64_t varianceSum, uint surfelCount)
+{
+    if (surfelCount == 0)
+        return std::numeric_limits<float>::quiet_NaN();
+
+    return (float)(varianceSum / ((double)kConvergenceVarianceScale * surfelCount));
+}
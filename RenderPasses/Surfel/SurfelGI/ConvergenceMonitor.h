@@ -0,0 +1,48 @@
+#pragma once
+#include "Falcor.h"
+
+using namespace Falcor;
+
+// Decide when batch mode stops iterating.
+// Each sample is mean MSME variance of all surfels after one ray trace + integrate iteration.
+class ConvergenceMonitor
+{
+public:
+    enum class Status
+    {
+        Running,
+        Converged,
+        IterationCap,
+        Empty, ///< No surfel to estimate variance of, so iterating changes nothing.
+    };
+
+    struct Criteria
+    {
+        float varianceThreshold = 1e-3f;
+        uint minIterationCount = 4u;
+        uint maxIterationCount = 64u;
+        uint stableIterationCount = 2u; ///< Variance must stay under threshold for this many iterations in a row.
+    };
+
+    void reset(const Criteria& criteria);
+
+    // Add sample of next iteration, and return updated status.
+    // Samples added after stopping are only recorded at history.
+    Status addSample(float meanVariance);
+
+    // Stop without sample, when iteration had no surfel. Empty cache is never reported as converged.
+    Status addEmptySample();
+
+    // Mean variance from fixed-point sum accumulated by integrate pass. NaN if there is no surfel.
+    static float getMeanVariance(uint64_t varianceSum, uint surfelCount);
+
+    Status getStatus() const { return mStatus; }
+    uint getIterationCount() const { return (uint)mHistory.size(); }
+    const std::vector<float>& getHistory() const { return mHistory; }
+
+private:
+    Criteria mCriteria;
+    Status mStatus = Status::Running;
+    uint mStableCount = 0;
+    std::vector<float> mHistory;
+};
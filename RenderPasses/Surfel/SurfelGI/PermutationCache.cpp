@@ -0,0 +1,181 @@
+#include "PermutationCache.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+void PermutationKeyBuilder::addBytes(const void* pData, size_t size)
+{
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    for (size_t i = 0; i < size; ++i)
+    {
+        mHash ^= pBytes[i];
+        mHash *= 1099511628211ull;
+    }
+}
+
+PermutationKeyBuilder& PermutationKeyBuilder::add(std::string_view data)
+{
+    const uint64_t size = data.size();
+    addBytes(&size, sizeof(size));
+    addBytes(data.data(), data.size());
+    return *this;
+}
+
+PermutationKeyBuilder& PermutationKeyBuilder::add(uint64_t value)
+{
+    addBytes(&value, sizeof(value));
+    return *this;
+}
+
+PermutationKeyBuilder& PermutationKeyBuilder::addDefines(const DefineList& defines)
+{
+    // DefineList is ordered by name, so same defines always give same key.
+    add((uint64_t)defines.size());
+    for (const auto& [name, value] : defines)
+    {
+        add(name);
+        add(value);
+    }
+    return *this;
+}
+
+PermutationKeyBuilder& PermutationKeyBuilder::addTypeConformances(const TypeConformanceList& conformances)
+{
+    add((uint64_t)conformances.size());
+    for (const auto& [conformance, id] : conformances)
+    {
+        add(conformance.mTypeName);
+        add(conformance.mInterfaceName);
+        add((uint64_t)id);
+    }
+    return *this;
+}
+
+PermutationKeyBuilder& PermutationKeyBuilder::addSourceDirectory(const std::filesystem::path& directory)
+{
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+    {
+        if (entry.is_regular_file())
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& file : files)
+    {
+        std::ifstream stream(file, std::ios::binary);
+        std::stringstream contents;
+        contents << stream.rdbuf();
+
+        add(std::filesystem::relative(file, directory).generic_string());
+        add(contents.str());
+    }
+    return *this;
+}
+
+bool PermutationCache::contains(uint64_t key) const
+{
+    return std::any_of(mEntries.begin(), mEntries.end(), [key](const Entry& entry) { return entry.key == key; });
+}
+
+void PermutationCache::record(uint64_t key, const std::string& staticParams)
+{
+    auto it = std::find_if(mEntries.begin(), mEntries.end(), [key](const Entry& entry) { return entry.key == key; });
+    if (it == mEntries.end())
+        it = mEntries.insert(mEntries.end(), Entry{key});
+
+    it->lastUse = ++mUseCounter;
+    it->staticParams = staticParams;
+
+    prune();
+}
+
+void PermutationCache::setMaxEntryCount(size_t maxEntryCount)
+{
+    mMaxEntryCount = std::max<size_t>(1, maxEntryCount);
+    prune();
+}
+
+void PermutationCache::clear()
+{
+    mEntries.clear();
+    mUseCounter = 0;
+}
+
+void PermutationCache::prune()
+{
+    if (mEntries.size() <= mMaxEntryCount)
+        return;
+
+    std::sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b) { return a.lastUse > b.lastUse; });
+    mEntries.resize(mMaxEntryCount);
+}
+
+std::string PermutationCache::serialize() const
+{
+    std::string text;
+    for (const auto& entry : mEntries)
+        text += fmt::format("{:016x} {} {}\n", entry.key, entry.lastUse, entry.staticParams);
+    return text;
+}
+
+bool PermutationCache::deserialize(std::string_view text)
+{
+    clear();
+
+    bool valid = true;
+    while (!text.empty())
+    {
+        const size_t lineEnd = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, lineEnd);
+        text.remove_prefix(std::min(lineEnd + 1, text.size()));
+
+        if (line.empty())
+            continue;
+
+        // Key and last use, separated by single space. Rest of line is static params.
+        const size_t keyEnd = line.find(' ');
+        const size_t lastUseEnd = keyEnd == std::string_view::npos ? keyEnd : line.find(' ', keyEnd + 1);
+
+        Entry entry;
+        if (lastUseEnd == std::string_view::npos ||
+            std::from_chars(line.data(), line.data() + keyEnd, entry.key, 16).ec != std::errc() ||
+            std::from_chars(line.data() + keyEnd + 1, line.data() + lastUseEnd, entry.lastUse).ec != std::errc())
+        {
+            valid = false;
+            continue;
+        }
+
+        entry.staticParams = std::string(line.substr(lastUseEnd + 1));
+        mUseCounter = std::max(mUseCounter, entry.lastUse);
+        mEntries.push_back(std::move(entry));
+    }
+
+    prune();
+    return valid;
+}
+
+bool PermutationCache::load(const std::filesystem::path& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+        return false;
+
+    std::stringstream contents;
+    contents << stream.rdbuf();
+    return deserialize(contents.str());
+}
+
+bool PermutationCache::save(const std::filesystem::path& path) const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream)
+        return false;
+
+    stream << serialize();
+    return (bool)stream;
+}
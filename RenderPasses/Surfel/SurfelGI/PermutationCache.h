@@ -0,0 +1,65 @@
+#pragma once
+#include "Falcor.h"
+#include <filesystem>
+#include <string_view>
+
+using namespace Falcor;
+
+// FNV-1a 64 bit hash of everything a compiled program depends on.
+// Each value is hashed with its length, so that ("ab", "c") and ("a", "bc") give different keys.
+class PermutationKeyBuilder
+{
+public:
+    PermutationKeyBuilder& add(std::string_view data);
+    PermutationKeyBuilder& add(uint64_t value);
+    PermutationKeyBuilder& addDefines(const DefineList& defines);
+    PermutationKeyBuilder& addTypeConformances(const TypeConformanceList& conformances);
+
+    // Hash relative path and contents of every file under directory, in sorted path order.
+    PermutationKeyBuilder& addSourceDirectory(const std::filesystem::path& directory);
+
+    uint64_t getKey() const { return mHash; }
+
+private:
+    void addBytes(const void* pData, size_t size);
+
+    uint64_t mHash = 14695981039346656037ull;
+};
+
+// Record of permutations compiled before.
+// Compiled binaries are kept by persistent shader cache of device, which is looked up with the same sources and
+// defines. This record lets the pass know which permutations are warm, and lets tools pre-warm them.
+class PermutationCache
+{
+public:
+    struct Entry
+    {
+        uint64_t key = 0;
+        uint64_t lastUse = 0;   ///< Value of use counter at last record. Larger is more recent.
+        std::string staticParams; ///< Static params as JSON, for pre-warming.
+    };
+
+    bool contains(uint64_t key) const;
+
+    // Add or refresh entry, and drop least recently used entries above max count.
+    void record(uint64_t key, const std::string& staticParams);
+
+    void setMaxEntryCount(size_t maxEntryCount);
+    const std::vector<Entry>& getEntries() const { return mEntries; }
+    void clear();
+
+    // One entry per line: "<key in hex> <last use> <static params>".
+    std::string serialize() const;
+    // Malformed lines are skipped. Returns false if any line was skipped.
+    bool deserialize(std::string_view text);
+
+    bool load(const std::filesystem::path& path);
+    bool save(const std::filesystem::path& path) const;
+
+private:
+    void prune();
+
+    std::vector<Entry> mEntries;
+    uint64_t mUseCounter = 0;
+    size_t mMaxEntryCount = 64;
+};
@@ -0,0 +1,59 @@
+#include "RadianceFormat.h"
+#include <cmath>
+
+namespace
+{
+
+// Float of given mantissa and exponent bits, with IEEE bias and denormals.
+float quantizeFloat(float value, int mantissaBits, int exponentBits, bool isSigned)
+{
+    if (std::isnan(value))
+        return value;
+    if (!isSigned && !(value > 0.f))
+        return 0.f;
+
+    const int bias = (1 << (exponentBits - 1)) - 1;
+    const float maxValue = std::ldexp(2.f - std::ldexp(1.f, -mantissaBits), bias);
+    const float absValue = std::min(std::abs(value), maxValue);
+
+    // Spacing of values in binade of absValue, which stays at that of smallest normal binade for denormals.
+    int exponent = 0;
+    std::frexp(absValue, &exponent);
+    const float ulp = std::ldexp(1.f, std::max(exponent - 1, 1 - bias) - mantissaBits);
+
+    // Default rounding mode is to nearest even.
+    return std::copysign(std::min(std::nearbyint(absValue / ulp) * ulp, maxValue), value);
+}
+
+} // namespace
+
+ResourceFormat getResourceFormat(RadianceFormat format)
+{
+    switch (format)
+    {
+    case RadianceFormat::RGBA16Float:
+        return ResourceFormat::RGBA16Float;
+    case RadianceFormat::R11G11B10Float:
+        return ResourceFormat::R11G11B10Float;
+    default:
+        return ResourceFormat::RGBA32Float;
+    }
+}
+
+float3 quantizeRadiance(RadianceFormat format, const float3& radiance)
+{
+    switch (format)
+    {
+    case RadianceFormat::RGBA16Float:
+        return float3(
+            quantizeFloat(radiance.x, 10, 5, true), quantizeFloat(radiance.y, 10, 5, true), quantizeFloat(radiance.z, 10, 5, true)
+        );
+    case RadianceFormat::R11G11B10Float:
+        // Blue has one mantissa bit less.
+        return float3(
+            quantizeFloat(radiance.x, 6, 5, false), quantizeFloat(radiance.y, 6, 5, false), quantizeFloat(radiance.z, 5, 5, false)
+        );
+    default:
+        return radiance;
+    }
+}
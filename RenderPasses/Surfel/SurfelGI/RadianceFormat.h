@@ -0,0 +1,29 @@
+#pragma once
+#include "Falcor.h"
+
+using namespace Falcor;
+
+// Format of radiance render targets, which are written and read several times per frame.
+// - RGBA32Float: exact, 16 bytes per pixel.
+// - RGBA16Float: 8 bytes per pixel, 10 mantissa bits, up to 65504.
+// - R11G11B10Float: 4 bytes per pixel, 6 mantissa bits (blue 5), up to 65024. No alpha and no negative value.
+// Alpha of indirect lighting is only saturated gather weight, which no pass reads, so it is dropped with R11G11B10Float.
+enum class RadianceFormat : uint32_t
+{
+    RGBA32Float,
+    RGBA16Float,
+    R11G11B10Float,
+};
+
+FALCOR_ENUM_INFO(RadianceFormat, {
+    { RadianceFormat::RGBA32Float, "RGBA32Float" },
+    { RadianceFormat::RGBA16Float, "RGBA16Float" },
+    { RadianceFormat::R11G11B10Float, "R11G11B10Float" },
+});
+FALCOR_ENUM_REGISTER(RadianceFormat);
+
+ResourceFormat getResourceFormat(RadianceFormat format);
+
+// Radiance as stored in format, for error budgets on host. Rounds to nearest even, clamps to largest finite value,
+// and clamps negative value to 0 in unsigned format. Alpha is not modeled.
+float3 quantizeRadiance(RadianceFormat format, const float3& radiance);
@@ -0,0 +1,38 @@
+#include "ResolutionScale.h"
+
+float clampResolutionScale(float scale)
+{
+    if (!(scale >= kMinResolutionScale))
+        return std::isnan(scale) ? 1.f : kMinResolutionScale;
+
+    return std::min(scale, 1.f);
+}
+
+float getResolutionScale(const RenderData& renderData)
+{
+    const auto& dict = renderData.getDictionary();
+    if (!dict.keyExists(kResolutionScaleKey))
+        return 1.f;
+
+    return clampResolutionScale(dict.getValue<float>(kResolutionScaleKey));
+}
+
+uint2 getRenderResolution(uint2 frameDim, float scale)
+{
+    scale = clampResolutionScale(scale);
+
+    // Round up, so that scale 1 is always full frame.
+    const uint width = (uint)std::ceil(frameDim.x * scale);
+    const uint height = (uint)std::ceil(frameDim.y * scale);
+
+    return uint2(std::clamp(width, 1u, std::max(frameDim.x, 1u)), std::clamp(height, 1u, std::max(frameDim.y, 1u)));
+}
+
+float getSpawnChanceScale(uint2 frameDim, uint2 renderResolution)
+{
+    const float renderArea = (float)renderResolution.x * renderResolution.y;
+    if (renderArea <= 0.f)
+        return 1.f;
+
+    return (float)frameDim.x * frameDim.y / renderArea;
+}
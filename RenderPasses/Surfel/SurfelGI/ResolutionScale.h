@@ -0,0 +1,26 @@
+#pragma once
+#include "Falcor.h"
+#include "RenderGraph/RenderPass.h"
+
+using namespace Falcor;
+
+// Dynamic resolution scaling.
+// Frame-time controller writes resolution scale of each frame to render graph dictionary under kResolutionScaleKey.
+// Per-pixel passes render only top-left sub-rectangle of their textures, so that nothing is re-allocated.
+// Surfel radius and spawn density are measured in full frame, so that surfels stay same at any scale.
+
+const std::string kResolutionScaleKey = "surfelResolutionScale";
+const float kMinResolutionScale = 0.25f;
+
+// Clamp to [kMinResolutionScale, 1]. NaN is replaced by 1.
+float clampResolutionScale(float scale);
+
+// Scale of current frame, 1 if not given.
+float getResolutionScale(const RenderData& renderData);
+
+// Sub-rectangle rendered at scale. Never empty, never larger than frame.
+uint2 getRenderResolution(uint2 frameDim, float scale);
+
+// Surfels are spawned at most once per tile, and tile covers more of frame at lower scale.
+// Spawn chance is multiplied by this ratio, so that surfels per frame area stay same.
+float getSpawnChanceScale(uint2 frameDim, uint2 renderResolution);
@@ -1,6 +1,11 @@
 #include "SurfelGI.h"
 #include "Utils/Math/FalcorMath.h"
+#include "Rendering/Lights/EmissiveUniformSampler.h"
+#include "Rendering/Lights/EmissivePowerSampler.h"
 #include "SurfelTypes.slang"
+#include "SurfelReservoir.slang"
+#include "SurfelLightVisibility.slang"
+#include <chrono>
 
 namespace
 {
@@ -14,6 +19,8 @@ const std::string kPackedHitInfoTextureName = "packedHitInfo";
 const std::string kOutputTextureName = "output";
 const std::string kIrradianceMapTextureName = "irradiance map";
 const std::string kSurfelDepthTextureName = "surfel depth";
+const std::string kSurfacePosWTextureName = "surfacePosW";
+const std::string kSurfaceDataTextureName = "surfaceData";
 
 const std::string kSurfelBufferVarName = "gSurfelBuffer";
 const std::string kSurfelGeometryBufferVarName = "gSurfelGeometryBuffer";
@@ -23,10 +30,74 @@ const std::string kSurfelFreeIndexBufferVarName = "gSurfelFreeIndexBuffer";
 const std::string kCellInfoBufferVarName = "gCellInfoBuffer";
 const std::string kCellToSurfelBufferVarName = "gCellToSurfelBuffer";
 const std::string kSurfelRayResultBufferVarName = "gSurfelRayResultBuffer";
+const std::string kSurfelRayOffsetBufferVarName = "gSurfelRayOffsetBuffer";
+const std::string kSurfelNeighborBufferVarName = "gSurfelNeighborBuffer";
 const std::string kSurfelRecycleInfoBufferVarName = "gSurfelRecycleInfoBuffer";
+const std::string kSurfelReservoirBufferVarName = "gSurfelReservoirBuffer";
+const std::string kPrevSurfelReservoirBufferVarName = "gPrevSurfelReservoirBuffer";
 const std::string kSurfelReservationBufferVarName = "gSurfelReservationBuffer";
 const std::string kSurfelRefCounterVarName = "gSurfelRefCounter";
 const std::string kSurfelCounterVarName = "gSurfelCounter";
+const std::string kEmissiveSamplerVarName = "gEmissiveSampler";
+const std::string kSurfelFlagBufferVarName = "gSurfelFlagBuffer";
+const std::string kSurfelSnapshotBufferVarName = "gSurfelSnapshotBuffer";
+const std::string kSurfelSlotBlockBufferVarName = "gSurfelSlotBlockBuffer";
+const std::string kSurfelSpawnRequestBufferVarName = "gSurfelSpawnRequestBuffer";
+const std::string kSurfelEvictionBufferVarName = "gSurfelEvictionBuffer";
+const std::string kSurfelRestoreBufferVarName = "gSurfelRestoreBuffer";
+const std::string kSurfelHistogramBufferVarName = "gSurfelHistogramBuffer";
+const std::string kSurfelLightVisibilityBufferVarName = "gSurfelLightVisibilityBuffer";
+const std::string kSurfelDepthVarName = "gSurfelDepth";
+const std::string kSurfelDepthRWVarName = "gSurfelDepthRW";
+const std::string kSurfelDepthSamplerVarName = "gSurfelDepthSampler";
+const std::string kIrradianceMapVarName = "gIrradianceMap";
+
+// Every pass has its constants in one struct, so that they are uploaded at once.
+const std::string kConstantBufferName = "CB";
+const std::string kConstantsVarName = "gConstants";
+
+// Compiled pass sets kept in memory, including current one.
+const size_t kMaxCachedPassSetCount = 4;
+const std::string kPermutationCacheFileName = "SurfelGIPermutations.txt";
+
+// Eviction read back buffer holds count of evicted surfels, then records.
+const uint64_t kEvictionReadBackHeaderSize = 16;
+
+// Histograms are written to export path once per given frames.
+const uint kHistogramExportInterval = 60;
+
+// Weight of current frame in running average of host time, which then spans about 20 frames.
+const float kHostTimeSmoothing = 0.05f;
+
+double getElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Resources of view 0 have no suffix, e.g. "packedHitInfo", "packedHitInfo1", ...
+std::string getViewResourceName(const std::string& name, uint viewIndex)
+{
+    return viewIndex == 0 ? name : name + std::to_string(viewIndex);
+}
+
+// Compute pass around program compiled before, e.g. on worker thread.
+// Base constructor creates its own program, which is replaced before it is ever compiled.
+class PrecompiledComputePass : public ComputePass
+{
+public:
+    PrecompiledComputePass(ref<Device> pDevice, const ProgramDesc& desc, const DefineList& defines, const ref<Program>& pProgram)
+        : ComputePass(pDevice, desc, defines, false)
+    {
+        mpState->setProgram(pProgram);
+        mpVars = ProgramVars::create(mpDevice, pProgram.get());
+    }
+};
+
+// Light BVH sampler needs normal of previous vertex for evaluating pdf, which is not stored in payload.
+const Gui::DropdownList kEmissiveSamplerList = {
+    {(uint)EmissiveLightSamplerType::Uniform, "Uniform"},
+    {(uint)EmissiveLightSamplerType::Power, "Power"},
+};
 
 } // namespace
 
@@ -47,6 +118,36 @@ SurfelGI::SurfelGI(ref<Device> pDevice, const Properties& props) : RenderPass(pD
     samplerDesc.setFilterMode(TextureFilteringMode::Linear, TextureFilteringMode::Linear, TextureFilteringMode::Linear);
     samplerDesc.setAddressingMode(TextureAddressingMode::Clamp, TextureAddressingMode::Clamp, TextureAddressingMode::Clamp);
     mpSurfelDepthSampler = mpDevice->createSampler(samplerDesc);
+
+    parseSurfelGIProperties(props, mRuntimeParams, mStaticParams);
+    mTempStaticParams = mStaticParams;
+}
+
+void SurfelGI::setProperties(const Properties& props)
+{
+    SurfelGIStaticParams staticParams = mStaticParams;
+    const RadianceFormat prevOutputFormat = mRuntimeParams.outputFormat;
+    parseSurfelGIProperties(props, mRuntimeParams, staticParams);
+
+    // Output textures are allocated by render graph. Surfel radiance is kept in its own buffer, so cache stays valid.
+    if (mRuntimeParams.outputFormat != prevOutputFormat)
+        requestRecompile();
+
+    mTempStaticParams = staticParams;
+    const bool isStaticParamsChanged = mTempStaticParams != mStaticParams;
+    if (isStaticParamsChanged)
+    {
+        requestPassRebuild(mTempStaticParams);
+
+        // Scripts expect new params to take effect from next frame, so wait instead of swapping later.
+        if (auto programs = mRecompiler.wait())
+            swapPasses(createPasses(std::move(*programs)));
+    }
+}
+
+Properties SurfelGI::getProperties() const
+{
+    return getSurfelGIProperties(mRuntimeParams, mStaticParams);
 }
 
 RenderPassReflection SurfelGI::reflect(const CompileData& compileData)
@@ -70,13 +171,12 @@ void SurfelGI::execute(RenderContext* pRenderContext, const RenderData& renderDa
     if (!mpScene)
         return;
 
-    if (mRecompile)
-    {
-        createPasses();
-        createResolutionIndependentResources();
+    const auto hostStart = std::chrono::steady_clock::now();
 
-        mRecompile = false;
-    }
+    if (auto programs = mRecompiler.poll())
+        swapPasses(createPasses(std::move(*programs)));
+
+    prepareLighting(pRenderContext);
 
     if (mIsFrameDimChanged)
     {
@@ -84,14 +184,28 @@ void SurfelGI::execute(RenderContext* pRenderContext, const RenderData& renderDa
         mIsFrameDimChanged = false;
     }
 
+    prepareViews(renderData);
+    prepareUpdateConstants();
     bindResources(renderData);
+    bindSceneData(pRenderContext);
+
+    if (mRuntimeParams.regionStreaming && !mLockSurfel)
+        executeRegionStreaming(pRenderContext);
 
-    mFOVy = focalLengthToFovY(mpScene->getCamera()->getFocalLength(), mpScene->getCamera()->getFrameHeight());
-    mCamPos = mpScene->getCamera()->getPosition();
+    if (mStaticParams.useInstrumentation)
+        pRenderContext->clearUAV(mpSurfelHistogramBuffer->getUAV().get(), uint4(0));
 
-    // Request the light collection if emissive lights are enabled.
-    if (mpScene->getRenderSettings().useEmissiveLights)
-        mpScene->getLightCollection(pRenderContext);
+    // Cached visibility is stale once anything between surfels and lights has moved.
+    const auto lightVisibilityUpdateFlags = Scene::UpdateFlags::GeometryMoved | Scene::UpdateFlags::LightsMoved |
+                                            Scene::UpdateFlags::LightPropertiesChanged | Scene::UpdateFlags::LightCountChanged;
+    if (is_set(mpScene->getUpdates(), lightVisibilityUpdateFlags))
+        mClearLightVisibility = true;
+
+    if (mStaticParams.isLightVisibilityCacheEnabled() && mClearLightVisibility)
+    {
+        pRenderContext->clearUAV(mpSurfelLightVisibilityBuffer->getUAV().get(), uint4(0));
+        mClearLightVisibility = false;
+    }
 
     {
         FALCOR_PROFILE(pRenderContext, "Prepare Pass");
@@ -103,27 +217,32 @@ void SurfelGI::execute(RenderContext* pRenderContext, const RenderData& renderDa
     {
         FALCOR_PROFILE(pRenderContext, "Update Pass (Collect Cell Info Pass)");
 
-        auto var = mpCollectCellInfoPass->getRootVar();
+        mConstantVars.collectCellInfo.setBlob(mUpdateConstants);
+
+        mpCollectCellInfoPass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+    }
 
-        mpScene->setRaytracingShaderData(pRenderContext, var);
+    if (mStaticParams.deterministic)
+    {
+        FALCOR_PROFILE(pRenderContext, "Update Pass (Compact Surfel Slots Pass)");
 
-        var["CB"]["gCameraPos"] = mCamPos;
-        var["CB"]["gResolution"] = mFrameDim;
-        var["CB"]["gFOVy"] = mFOVy;
-        var["CB"]["gLockSurfel"] = mLockSurfel;
-        var["CB"]["gVarianceSensitivity"] = mRuntimeParams.varianceSensitivity;
-        var["CB"]["gMinRayCount"] = mRuntimeParams.minRayCount;
-        var["CB"]["gMaxRayCount"] = mRuntimeParams.maxRayCount;
+        mpCountSurfelSlotsPass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+        mpScanSurfelSlotBlocksPass->execute(pRenderContext, uint3(kScanGroupSize, 1, 1));
+        mpCompactSurfelSlotsPass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+    }
 
-        mpCollectCellInfoPass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+    // Locked surfels keep rays of last update, and are not traced.
+    if (!mLockSurfel)
+    {
+        FALCOR_PROFILE(pRenderContext, "Update Pass (Allocate Surfel Rays Pass)");
+
+        mpAllocateSurfelRaysPass->execute(pRenderContext, uint3(kScanGroupSize, 1, 1));
     }
 
     {
         FALCOR_PROFILE(pRenderContext, "Update Pass (Accumulate Cell Info Pass)");
 
-        auto var = mpAccumulateCellInfoPass->getRootVar();
-
-        var["CB"]["gCameraPos"] = mCamPos;
+        mConstantVars.accumulateCellInfo.setBlob(mUpdateConstants);
 
         mpAccumulateCellInfoPass->execute(pRenderContext, uint3(mStaticParams.cellCount, 1, 1));
     }
@@ -131,76 +250,77 @@ void SurfelGI::execute(RenderContext* pRenderContext, const RenderData& renderDa
     {
         FALCOR_PROFILE(pRenderContext, "Update Pass (Update Cell To Surfel buffer Pass)");
 
-        auto var = mpUpdateCellToSurfelBuffer->getRootVar();
-
-        var["CB"]["gCameraPos"] = mCamPos;
+        mConstantVars.updateCellToSurfelBuffer.setBlob(mUpdateConstants);
 
         mpUpdateCellToSurfelBuffer->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
     }
 
-    if (mLockSurfel)
+    if (mStaticParams.deterministic)
     {
-        FALCOR_PROFILE(pRenderContext, "Surfel Evaluation Pass");
+        FALCOR_PROFILE(pRenderContext, "Update Pass (Sort Cell To Surfel Buffer Pass)");
 
-        auto var = mpSurfelEvaluationPass->getRootVar();
+        mpSortCellToSurfelPass->execute(pRenderContext, uint3(mStaticParams.cellCount, 1, 1));
+    }
+
+    // Neighbors are only read by integrate pass, which locked surfels skip.
+    if (mStaticParams.useIrradianceSharing && !mLockSurfel)
+    {
+        FALCOR_PROFILE(pRenderContext, "Update Pass (Build Surfel Neighbors Pass)");
 
-        mpScene->setRaytracingShaderData(pRenderContext, var);
+        mConstantVars.buildSurfelNeighbors.setBlob(mUpdateConstants);
 
-        var["CB"]["gFrameIndex"] = mFrameIndex;
-        var["CB"]["gPlacementThreshold"] = mRuntimeParams.placementThreshold;
-        var["CB"]["gRemovalThreshold"] = mRuntimeParams.removalThreshold;
-        var["CB"]["gBlendingDelay"] = mRuntimeParams.blendingDelay;
-        var["CB"]["gOverlayMode"] = (uint)mRuntimeParams.overlayMode;
-        var["CB"]["gVarianceSensitivity"] = mRuntimeParams.varianceSensitivity;
+        mpBuildSurfelNeighborsPass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+    }
+
+    if (mLockSurfel)
+    {
+        FALCOR_PROFILE(pRenderContext, "Surfel Evaluation Pass");
 
-        pRenderContext->clearUAV(mpOutputTexture->getUAV().get(), float4(0));
-        mpSurfelEvaluationPass->execute(pRenderContext, uint3(mFrameDim, 1));
+        for (uint i = 0; i < kMaxViewCount; ++i)
+        {
+            if (mViewSet.getView(i).enabled)
+                executeEvaluationPass(pRenderContext, i);
+        }
     }
     else
     {
+        if (mRuntimeParams.batchMode)
         {
-            FALCOR_PROFILE(pRenderContext, "Surfel RayTrace Pass");
-
-            auto var = mRtPass.pVars->getRootVar();
-            var["CB"]["gFrameIndex"] = mFrameIndex;
-            var["CB"]["gRayStep"] = mRuntimeParams.rayStep;
-            var["CB"]["gMaxStep"] = mRuntimeParams.maxStep;
-
-            mpScene->raytrace(pRenderContext, mRtPass.pProgram.get(), mRtPass.pVars, uint3(kRayBudget, 1, 1));
+            executeBatch(pRenderContext);
         }
-
-        if (mFrameIndex <= mMaxFrameIndex)
+        else
         {
-            FALCOR_PROFILE(pRenderContext, "Surfel Integrate Pass");
+            executeRayTracePass(pRenderContext);
 
-            auto var = mpSurfelIntegratePass->getRootVar();
-            var["CB"]["gShortMeanWindow"] = mRuntimeParams.shortMeanWindow;
-            var["CB"]["gCameraPos"] = mCamPos;
-            var["CB"]["gVarianceSensitivity"] = mRuntimeParams.varianceSensitivity;
+            if (mFrameIndex <= mRuntimeParams.maxFrameIndex)
+                executeIntegratePass(pRenderContext, false);
 
-            mpSurfelIntegratePass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+            mSampleIndex++;
         }
 
         {
             FALCOR_PROFILE(pRenderContext, "Surfel Generation Pass");
 
-            auto var = mpSurfelGenerationPass->getRootVar();
-
-            mpScene->setRaytracingShaderData(pRenderContext, var);
+            // Views which are not scheduled for this frame only gather surfel radiance.
+            for (uint i = 0; i < kMaxViewCount; ++i)
+            {
+                if (mViewSet.isScheduled(i, mFrameIndex))
+                    executeGenerationPass(pRenderContext, i);
+                else if (mViewSet.getView(i).enabled)
+                    executeEvaluationPass(pRenderContext, i);
+            }
+        }
+    }
 
-            var["CB"]["gResolution"] = mFrameDim;
-            var["CB"]["gFOVy"] = mFOVy;
-            var["CB"]["gFrameIndex"] = mFrameIndex;
-            var["CB"]["gChanceMultiply"] = mRuntimeParams.chanceMultiply;
-            var["CB"]["gChancePower"] = mRuntimeParams.chancePower;
-            var["CB"]["gPlacementThreshold"] = mRuntimeParams.placementThreshold;
-            var["CB"]["gRemovalThreshold"] = mRuntimeParams.removalThreshold;
-            var["CB"]["gOverlayMode"] = (uint)mRuntimeParams.overlayMode;
-            var["CB"]["gBlendingDelay"] = mRuntimeParams.blendingDelay;
-            var["CB"]["gVarianceSensitivity"] = mRuntimeParams.varianceSensitivity;
+    // Debug overlays are drawn over output, so that per-pixel passes above do no debug work.
+    if (mRuntimeParams.overlayMode != OverlayMode::IndirectLighting)
+    {
+        FALCOR_PROFILE(pRenderContext, "Surfel Overlay Pass");
 
-            pRenderContext->clearUAV(mpOutputTexture->getUAV().get(), float4(0));
-            mpSurfelGenerationPass->execute(pRenderContext, uint3(mFrameDim, 1));
+        for (uint i = 0; i < kMaxViewCount; ++i)
+        {
+            if (mViewSet.getView(i).enabled)
+                executeOverlayPass(pRenderContext, i);
         }
     }
 
@@ -209,24 +329,83 @@ void SurfelGI::execute(RenderContext* pRenderContext, const RenderData& renderDa
 
         pRenderContext->copyResource(mpReadBackBuffer.get(), mpSurfelCounter.get());
 
+        // Surfels evicted at reset frame belong to cache being cleared.
+        const bool readEviction = mRuntimeParams.regionStreaming && !mLockSurfel && !mResetSurfelBuffer;
+        if (readEviction)
+        {
+            // Slot is reused after ring goes around, so read what is left in it first.
+            if (mEvictionFenceValues[mEvictionSlot] != 0)
+                readEvictedSurfels(mEvictionSlot);
+
+            const auto& pReadBackBuffer = mpEvictionReadBackBuffers[mEvictionSlot];
+            pRenderContext->copyBufferRegion(
+                pReadBackBuffer.get(), 0, mpSurfelCounter.get(), (uint64_t)SurfelCounterOffset::EvictedSurfel, sizeof(uint)
+            );
+            pRenderContext->copyBufferRegion(
+                pReadBackBuffer.get(),
+                kEvictionReadBackHeaderSize,
+                mpSurfelEvictionBuffer.get(),
+                0,
+                mpSurfelEvictionBuffer->getSize()
+            );
+        }
+
+        // Histograms of reset frame are kept, as they describe cache before reset.
+        if (mStaticParams.useInstrumentation)
+        {
+            if (mHistogramFenceValues[mHistogramSlot] != 0)
+                readHistograms(mHistogramSlot);
+
+            pRenderContext->copyResource(mpHistogramReadBackBuffers[mHistogramSlot].get(), mpSurfelHistogramBuffer.get());
+        }
+
         if (mResetSurfelBuffer)
         {
             pRenderContext->copyResource(mpSurfelBuffer.get(), mpEmptySurfelBuffer.get());
+            clearRegionStreaming();
 
             pRenderContext->clearUAV(mpIrradianceMapTexture->getUAV().get(), float4(0));
             pRenderContext->clearUAV(mpSurfelDepthTexture->getUAV().get(), float4(0));
+            pRenderContext->clearUAV(mpSurfelFlagBuffer->getUAV().get(), uint4(0));
 
             mResetSurfelBuffer = false;
+            mClearLightVisibility = true;
             mFrameIndex = 0;
+            mSampleIndex = 0;
         }
 
         pRenderContext->submit(false);
-        pRenderContext->signal(mpFence.get());
+        const uint64_t fenceValue = pRenderContext->signal(mpFence.get());
+
+        if (readEviction)
+        {
+            mEvictionFenceValues[mEvictionSlot] = fenceValue;
+            mEvictionSlot = (mEvictionSlot + 1) % (uint)mEvictionFenceValues.size();
+        }
+
+        if (mStaticParams.useInstrumentation)
+        {
+            mHistogramFenceValues[mHistogramSlot] = fenceValue;
+            mHistogramSlot = (mHistogramSlot + 1) % (uint)mHistogramFenceValues.size();
+
+            // Slots of earlier frames which GPU has finished are read without waiting.
+            const uint64_t completedValue = mpFence->getCurrentValue();
+            for (uint slot = 0; slot < (uint)mHistogramFenceValues.size(); ++slot)
+            {
+                if (mHistogramFenceValues[slot] != 0 && mHistogramFenceValues[slot] <= completedValue)
+                    readHistograms(slot);
+            }
+
+            if (!mRuntimeParams.histogramExportPath.empty() && mFrameIndex % kHistogramExportInterval == 0)
+                exportHistograms(mRuntimeParams.histogramExportPath);
+        }
 
         mReadBackValid = true;
     }
 
     mFrameIndex++;
+
+    mHostTimeMs += ((float)getElapsedMs(hostStart) - mHostTimeMs) * kHostTimeSmoothing;
 }
 
 void SurfelGI::renderUI(Gui::Widgets& widget)
@@ -268,6 +447,37 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
         widget.text(std::to_string(mpReadBackBuffer->getElement<uint>(5)), true);
         widget.tooltip("The number of rays that failed to find surfel and move on to the next step.");
 
+        if (mStaticParams.isLightVisibilityCacheEnabled())
+        {
+            const uint shadowRayCount = mpReadBackBuffer->getElement<uint>(8);
+            const uint cachedShadowRayCount = mpReadBackBuffer->getElement<uint>(9);
+
+            widget.text("Shadow ray skip rate");
+            widget.text(std::to_string(shadowRayCount > 0 ? cachedShadowRayCount * 100.0f / shadowRayCount : 0.f) + " %", true);
+            widget.tooltip("Shadow rays at first hit which used cached light visibility instead of tracing.");
+        }
+
+        if (mRuntimeParams.updateInterval > 1)
+        {
+            widget.text("Deferred surfel");
+            widget.text(std::to_string(mpReadBackBuffer->getElement<uint>(10)), true);
+            widget.tooltip("Surfels which kept their last update at this frame, and traced no ray.");
+        }
+
+        widget.text("Resolution scale");
+        widget.text(std::to_string(mResolutionScale), true);
+        widget.tooltip(
+            "Given per frame by render graph dictionary key '" + kResolutionScaleKey +
+            "'. Per-pixel passes render top-left part of view, surfel radius and spawn density do not change."
+        );
+
+        widget.text("Host time");
+        widget.text(std::to_string(mHostTimeMs) + " ms", true);
+        widget.tooltip(
+            "CPU time spent in execute per frame, averaged over recent frames. Includes waiting for GPU in batch mode, "
+            "and when read back of earlier frames is not ready."
+        );
+
         widget.text("Visible distance");
         widget.text(std::to_string(mStaticParams.cellDim * mStaticParams.cellUnit), true);
         widget.tooltip(
@@ -320,7 +530,7 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
                 mpScene->setCameraSpeed(mRenderScale);
 
             mTempStaticParams.cellUnit = 0.05f * mRenderScale;
-            resetAndRecompile();
+            requestPassRebuild(mTempStaticParams);
         }
     }
 
@@ -335,7 +545,29 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
     widget.tooltip("Clears all spawned surfels in the scene.");
 
     widget.dropdown("Overlay mode", mRuntimeParams.overlayMode);
-    widget.tooltip("Decide what to render.");
+    widget.tooltip("Decide what to render. Debug overlays are drawn by separate pass, over indirect lighting.");
+
+    if (widget.dropdown("Output format", mRuntimeParams.outputFormat))
+        requestRecompile();
+    widget.tooltip(
+        "Format of output textures. RGBA16Float halves bandwidth and keeps 10 mantissa bits. "
+        "R11G11B10Float quarters it, keeps 6 mantissa bits (blue 5) and drops gather weight in alpha."
+    );
+
+    if (auto group = widget.group("Views"))
+    {
+        group.checkbox("Fixed grid center", mRuntimeParams.fixedGridCenter);
+        group.tooltip("Center cell grid on given position instead of camera of view 0.");
+
+        if (mRuntimeParams.fixedGridCenter)
+        {
+            group.var("Grid center", mRuntimeParams.gridCenter);
+            if (group.button("Move to camera"))
+                mRuntimeParams.gridCenter = mViews[0].position;
+        }
+
+        mViewSet.renderUI(group, mpScene ? (uint)mpScene->getCameras().size() : 0);
+    }
 
     widget.dummy("#spacer0", {1, 10});
 
@@ -344,7 +576,27 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
         widget.tooltip("Following parameters needs re-compile. Please press below button after adjusting values.");
 
         if (widget.button("Recompile"))
-            resetAndRecompile();
+            requestPassRebuild(mTempStaticParams);
+
+        if (mRecompiler.isBuilding())
+        {
+            widget.text("Compiling in background...");
+        }
+        else if (mRecompiler.getState() == AsyncRecompiler<ProgramSet>::State::Failed)
+        {
+            widget.text("Compile failed, previous shaders are kept in use.");
+            widget.tooltip(mRecompiler.getError());
+        }
+
+        widget.text("Cached permutations");
+        widget.text(
+            std::to_string(mCachedPassSets.size()) + " in memory, " +
+                std::to_string(mPermutationCache.getEntries().size()) + " recorded",
+            true
+        );
+        widget.tooltip(
+            "Switching to permutation in memory needs no compile. Binaries of recorded ones are in shader cache."
+        );
 
         if (auto g = group.group("Surfel Generation", true))
         {
@@ -367,6 +619,24 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
                 g.slider("Max surfel for step", mTempStaticParams.maxSurfelForStep, 1u, 100u);
 
             g.checkbox("Use ray guiding", mTempStaticParams.useRayGuiding);
+            g.checkbox("Use light reservoir", mTempStaticParams.useLightReservoir);
+            g.tooltip("Resample direct light of first hit using per-surfel light reservoir (temporal and spatial reuse).");
+
+            g.checkbox("Use light visibility cache", mTempStaticParams.useLightVisibilityCache);
+            g.tooltip(
+                "Skip shadow rays of first hit close to surfel, if visibility of the light is cached in surfel and stable. "
+                "Disabled in deterministic mode."
+            );
+
+            g.checkbox("Use emissive sampling", mTempStaticParams.useEmissiveSampling);
+            g.tooltip("Sample emissive triangles at each path vertex, combined with BSDF sampling by MIS.");
+
+            if (mTempStaticParams.useEmissiveSampling)
+            {
+                uint emissiveSampler = (uint)mTempStaticParams.emissiveSampler;
+                if (g.dropdown("Emissive sampler", kEmissiveSamplerList, emissiveSampler))
+                    mTempStaticParams.emissiveSampler = (EmissiveLightSamplerType)emissiveSampler;
+            }
         }
 
         if (auto g = group.group("Integrate", true))
@@ -374,6 +644,18 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
             g.checkbox("Use surfel depth", mTempStaticParams.useSurfelDepth);
             g.checkbox("Use irradiance sharing", mTempStaticParams.useIrradianceSharing);
         }
+
+        if (auto g = group.group("Validation", true))
+        {
+            g.checkbox("Deterministic", mTempStaticParams.deterministic);
+            g.tooltip(
+                "Produce same result at every run, for comparing with reference images. Surfel allocation is done in "
+                "fixed order, and spawning sleeping surfel at ray hit is disabled. Slower than default."
+            );
+
+            g.checkbox("Use instrumentation", mTempStaticParams.useInstrumentation);
+            g.tooltip("Record histograms of surfel passes, such as surfels per cell and steps per ray.");
+        }
     }
 
     if (auto group = widget.group("Runtime Params"))
@@ -402,16 +684,146 @@ void SurfelGI::renderUI(Gui::Widgets& widget)
             g.slider("Max step", mRuntimeParams.maxStep, mRuntimeParams.rayStep, 100u);
         }
 
+        if (mStaticParams.useLightReservoir)
+        {
+            if (auto g = group.group("Light Reservoir", true))
+            {
+                g.slider("Candidate count", mRuntimeParams.reservoirCandidateCount, 1u, 32u);
+                g.slider("Spatial count", mRuntimeParams.reservoirSpatialCount, 0u, 8u);
+                g.slider("Max temporal M", mRuntimeParams.reservoirMaxTemporalM, 1.f, 100.f);
+                g.tooltip("History length limit of reused reservoirs, also when surfel reservoir is reused at ray hit.");
+            }
+        }
+
+        if (mStaticParams.isLightVisibilityCacheEnabled())
+        {
+            if (auto g = group.group("Light Visibility Cache", true))
+            {
+                g.slider("Refresh probability", mRuntimeParams.lightVisibilityRefresh, 0.01f, 1.f);
+                g.tooltip("Probability that stable cached visibility is traced again.");
+            }
+        }
+
+        if (auto g = group.group("Update Schedule", true))
+        {
+            g.slider("Update interval", mRuntimeParams.updateInterval, 1u, 64u);
+            g.tooltip(
+                "Converged, off-screen or sleeping surfels are updated once per this many frames, round-robin. New, "
+                "visible and inconsistent surfels are updated every frame. Batch mode always updates every surfel."
+            );
+            g.slider("Variance threshold", mRuntimeParams.updateVarianceThreshold, 0.f, 1.f);
+            g.tooltip("Surfels whose variance, scaled by variance sensitivity, is above this are updated every frame.");
+        }
+
         if (auto g = group.group("Integrate", true))
         {
             g.slider("Short mean window", mRuntimeParams.shortMeanWindow, 0.01f, 0.5f);
+            g.var("Max frame index", mRuntimeParams.maxFrameIndex, 0u, UINT_MAX);
+            g.tooltip("Surfel radiance is not integrated after this frame.");
+        }
+
+        if (auto g = group.group("Batch Mode", true))
+        {
+            g.checkbox("Enable batch mode", mRuntimeParams.batchMode);
+            g.tooltip(
+                "Run ray trace and integrate repeatedly at each frame until surfel radiance is converged. Whole ray "
+                "budget is used, and output is written only once per frame."
+            );
+
+            auto& criteria = mRuntimeParams.batchCriteria;
+            g.var("Variance threshold", criteria.varianceThreshold, 0.f, 1.f, 1e-4f);
+            g.slider("Min iteration", criteria.minIterationCount, 1u, criteria.maxIterationCount);
+            g.slider("Max iteration", criteria.maxIterationCount, criteria.minIterationCount, kMaxBatchIterationCount);
+            g.slider("Stable iteration", criteria.stableIterationCount, 1u, 16u);
+            g.slider("Check interval", mRuntimeParams.batchCheckInterval, 1u, 16u);
+            g.tooltip("Variance is read back once per given iterations, which needs to wait GPU.");
+
+            const auto& history = mConvergenceMonitor.getHistory();
+            if (mRuntimeParams.batchMode && !history.empty())
+            {
+                g.graph("", plotFunc, (void*)history.data(), history.size(), 0, 0, FLT_MAX, 0, 50u);
+
+                g.text("Iterations");
+                g.text(std::to_string(history.size()), true);
+                g.text("Mean variance");
+                g.text(std::to_string(history.back()), true);
+            }
+        }
+
+        if (auto g = group.group("Region Streaming", true))
+        {
+            g.checkbox("Enable region streaming", mRuntimeParams.regionStreaming);
+            g.tooltip(
+                "Keep surfels which leave cell window on host per world region, and restore them when the region comes "
+                "back to window."
+            );
+
+            g.var("Region size", mRuntimeParams.regionSize, 0.1f, 10000.f);
+            g.var("Cache size (MB)", mRuntimeParams.regionCacheSize, 1u, 65536u);
+            g.tooltip("Least recently used regions beyond cache size are written to spill file, or dropped without one.");
+
+            const auto& stats = mRegionStore.getStats();
+            g.text("Regions");
+            g.text(
+                std::to_string(stats.residentRegionCount) + " resident, " + std::to_string(stats.spilledRegionCount) +
+                    " spilled",
+                true
+            );
+            g.text("Pending restores");
+            g.text(std::to_string(mPendingRestores.size()), true);
+            g.text("Dropped surfels");
+            g.text(std::to_string(stats.droppedRecordCount), true);
+        }
+
+        if (mStaticParams.useInstrumentation)
+        {
+            if (auto g = group.group("Instrumentation", true))
+            {
+                g.text("Frames");
+                g.text(std::to_string(mHistograms.getFrameCount()), true);
+
+                // Share of each bin over all frames so far.
+                for (uint i = 0; i < (uint)SurfelHistogramType::Count; ++i)
+                {
+                    const SurfelHistogramType type = (SurfelHistogramType)i;
+                    const uint binCount = mHistograms.getUsedBinCount(type);
+                    const uint64_t total = mHistograms.getTotal(type);
+
+                    std::vector<float> shares(std::max(binCount, 1u), 0.f);
+                    for (uint bin = 0; bin < binCount; ++bin)
+                        shares[bin] = (float)mHistograms.getCount(type, bin) / total;
+
+                    g.text(SurfelHistograms::getName(type));
+                    g.graph("", plotFunc, shares.data(), shares.size(), 0, 0, 1, 0, 50u);
+                    if (binCount > 0)
+                        g.tooltip(
+                            "Bins " + SurfelHistograms::getBinLabel(type, 0) + " to " +
+                            SurfelHistograms::getBinLabel(type, binCount - 1)
+                        );
+                }
+
+                if (g.button("Clear histograms"))
+                    clearHistograms();
+                if (g.button("Export histograms", true))
+                {
+                    std::filesystem::path path;
+                    if (saveFileDialog({{"csv", "CSV Files"}}, path))
+                        exportHistograms(path);
+                }
+                g.tooltip("Set 'histogramExportPath' property to write them periodically instead.");
+            }
         }
     }
 }
 
 void SurfelGI::setScene(RenderContext* pRenderContext, const ref<Scene>& pScene)
 {
+    // Programs in flight or cached are built for previous scene.
+    mRecompiler.cancel();
+    mCachedPassSets.clear();
+
     mpScene = pScene;
+    mpEmissiveSampler = nullptr;
     if (!mpScene)
         return;
 
@@ -424,21 +836,54 @@ void SurfelGI::setScene(RenderContext* pRenderContext, const ref<Scene>& pScene)
     }
 
     mFrameIndex = 0;
-    mMaxFrameIndex = 1000000;
+    mSampleIndex = 0;
     mFrameDim = uint2(0, 0);
     mRenderScale = 1.f;
     mIsFrameDimChanged = true;
     mReadBackValid = false;
     mLockSurfel = false;
     mResetSurfelBuffer = false;
-    mRecompile = false;
     mSurfelCount = std::vector<float>(1000, 0.f);
+    clearRegionStreaming();
+    clearHistograms();
     mRayBudget = std::vector<float>(1000, 0.f);
 
-    createPasses();
+    loadPermutationCache();
+
+    // Sampler is created first, so that first pass set is built with its defines.
+    updateEmissiveSampler(pRenderContext);
+    const DefineList emissiveDefines = getEmissiveDefines();
+
+    ProgramSet programs = getProgramSet(mStaticParams, emissiveDefines);
+    programs.key = getPermutationKey(mStaticParams, emissiveDefines);
+    compileProgramSet(mpDevice, programs);
+
+    PassSet passes = createPasses(std::move(programs));
+    cachePassSet(passes);
+    applyPasses(std::move(passes));
+
     createResolutionIndependentResources();
 }
 
+void SurfelGI::loadPermutationCache()
+{
+    // Binaries are kept by shader cache of device. Without it, recording permutations is meaningless.
+    const std::filesystem::path shaderCachePath = mpDevice->getDesc().shaderCachePath;
+    mPermutationCachePath =
+        shaderCachePath.empty() ? std::filesystem::path() : shaderCachePath / kPermutationCacheFileName;
+
+    mSourceKey = 0;
+    std::filesystem::path sourcePath;
+    if (findFileInShaderDirectories("RenderPasses/Surfel/SurfelGI/SurfelTypes.slang", sourcePath))
+        mSourceKey = PermutationKeyBuilder().addSourceDirectory(sourcePath.parent_path().parent_path()).getKey();
+    else
+        logWarning("SurfelGI: shader sources not found, permutation keys do not track source changes.");
+
+    if (!mPermutationCachePath.empty() && std::filesystem::exists(mPermutationCachePath) &&
+        !mPermutationCache.load(mPermutationCachePath))
+        logWarning("SurfelGI: permutation cache '{}' has malformed entries, skipped.", mPermutationCachePath.string());
+}
+
 bool SurfelGI::onKeyEvent(const KeyboardEvent& keyEvent)
 {
     if (keyEvent.key == Input::Key::L)
@@ -455,14 +900,47 @@ void SurfelGI::reflectInput(RenderPassReflection& reflector, uint2 resolution)
     reflector.addInput(kPackedHitInfoTextureName, "packed hit info texture")
         .format(ResourceFormat::RGBA32Uint)
         .bindFlags(ResourceBindFlags::ShaderResource);
+
+    // Auxiliary views are enabled when both packed hit info and output are connected.
+    for (uint i = 1; i < kMaxViewCount; ++i)
+    {
+        reflector.addInput(getViewResourceName(kPackedHitInfoTextureName, i), "packed hit info texture of auxiliary view")
+            .format(ResourceFormat::RGBA32Uint)
+            .bindFlags(ResourceBindFlags::ShaderResource)
+            .flags(RenderPassReflection::Field::Flags::Optional);
+    }
+
+    // Surface cache replaces decoding packed hit info per pass, when both of its textures are connected.
+    for (uint i = 0; i < kMaxViewCount; ++i)
+    {
+        reflector.addInput(getViewResourceName(kSurfacePosWTextureName, i), "surface cache position and linear depth")
+            .format(ResourceFormat::RGBA32Float)
+            .bindFlags(ResourceBindFlags::ShaderResource)
+            .flags(RenderPassReflection::Field::Flags::Optional);
+
+        reflector.addInput(getViewResourceName(kSurfaceDataTextureName, i), "surface cache normal and albedo")
+            .format(ResourceFormat::RG32Uint)
+            .bindFlags(ResourceBindFlags::ShaderResource)
+            .flags(RenderPassReflection::Field::Flags::Optional);
+    }
 }
 
 void SurfelGI::reflectOutput(RenderPassReflection& reflector, uint2 resolution)
 {
+    const ResourceFormat outputFormat = getResourceFormat(mRuntimeParams.outputFormat);
+
     reflector.addOutput(kOutputTextureName, "output texture")
-        .format(ResourceFormat::RGBA32Float)
+        .format(outputFormat)
         .bindFlags(ResourceBindFlags::UnorderedAccess);
 
+    for (uint i = 1; i < kMaxViewCount; ++i)
+    {
+        reflector.addOutput(getViewResourceName(kOutputTextureName, i), "output texture of auxiliary view")
+            .format(outputFormat)
+            .bindFlags(ResourceBindFlags::UnorderedAccess)
+            .flags(RenderPassReflection::Field::Flags::Optional);
+    }
+
     reflector.addOutput(kIrradianceMapTextureName, "irradiance map texture")
         .format(ResourceFormat::R32Float)
         .bindFlags(ResourceBindFlags::UnorderedAccess)
@@ -474,116 +952,277 @@ void SurfelGI::reflectOutput(RenderPassReflection& reflector, uint2 resolution)
         .texture2D(kSurfelDepthTextureRes.x, kSurfelDepthTextureRes.y);
 }
 
-void SurfelGI::resetAndRecompile()
-{
-    mStaticParams = mTempStaticParams;
-
-    // Reset render passes.
-    mpSurfelEvaluationPass = nullptr;
-    mpPreparePass = nullptr;
-    mpCollectCellInfoPass = nullptr;
-    mpAccumulateCellInfoPass = nullptr;
-    mpUpdateCellToSurfelBuffer = nullptr;
-    mpSurfelGenerationPass = nullptr;
-    mpSurfelIntegratePass = nullptr;
-    mRtPass.pProgram = nullptr;
-    mRtPass.pBindingTable = nullptr;
-    mRtPass.pVars = nullptr;
-
-    // Reset resources.
-    mpSurfelBuffer = nullptr;
-    mpSurfelGeometryBuffer = nullptr;
-    mpSurfelValidIndexBuffer = nullptr;
-    mpSurfelDirtyIndexBuffer = nullptr;
-    mpSurfelFreeIndexBuffer = nullptr;
-    mpCellInfoBuffer = nullptr;
-    mpCellToSurfelBuffer = nullptr;
-    mpSurfelRayResultBuffer = nullptr;
-    mpSurfelRecycleInfoBuffer = nullptr;
-    mpSurfelReservationBuffer = nullptr;
-    mpSurfelRefCounter = nullptr;
-    mpSurfelCounter = nullptr;
-    mpEmptySurfelBuffer = nullptr;
-    mpReadBackBuffer = nullptr;
-
-    // #TODO Should reset texture reousrces also?
-
-    // Reset variables.
-    mFrameIndex = 0;
-    mIsFrameDimChanged = true;
-    mReadBackValid = false;
-    mLockSurfel = false;
+void SurfelGI::requestPassRebuild(const SurfelGIStaticParams& staticParams)
+{
+    // Without scene, passes are created at setScene.
+    if (!mpScene)
+    {
+        mStaticParams = staticParams;
+        return;
+    }
+
+    const DefineList emissiveDefines = getEmissiveDefines();
+    const uint64_t key = getPermutationKey(staticParams, emissiveDefines);
+
+    auto it = std::find_if(
+        mCachedPassSets.begin(), mCachedPassSets.end(), [key](const PassSet& passes) { return passes.key == key; }
+    );
+    if (it != mCachedPassSets.end())
+    {
+        mRecompiler.cancel();
+
+        PassSet passes = *it;
+        passes.staticParams = staticParams;
+        swapPasses(std::move(passes));
+        return;
+    }
+
+    if (mPermutationCache.contains(key))
+        logInfo("SurfelGI: permutation {:016x} was compiled before, expecting shader cache hit.", key);
+
+    ProgramSet programs = getProgramSet(staticParams, emissiveDefines);
+    programs.key = key;
+
+    mRecompiler.request(
+        [pDevice = mpDevice, programs = std::move(programs)]() mutable
+        {
+            compileProgramSet(pDevice, programs);
+            return std::move(programs);
+        }
+    );
+}
+
+uint64_t SurfelGI::getPermutationKey(const SurfelGIStaticParams& staticParams, const DefineList& emissiveDefines) const
+{
+    return PermutationKeyBuilder()
+        .add(mSourceKey)
+        .addDefines(staticParams.getDefines())
+        .addDefines(mpScene->getSceneDefines())
+        .addDefines(mpSampleGenerator->getDefines())
+        .addDefines(emissiveDefines)
+        .addTypeConformances(mpScene->getTypeConformances())
+        .getKey();
+}
+
+void SurfelGI::cachePassSet(const PassSet& passes)
+{
+    mCachedPassSets.erase(
+        std::remove_if(
+            mCachedPassSets.begin(), mCachedPassSets.end(), [&](const PassSet& cached) { return cached.key == passes.key; }
+        ),
+        mCachedPassSets.end()
+    );
+    mCachedPassSets.push_back(passes);
 
-    mRecompile = true;
+    if (mCachedPassSets.size() > kMaxCachedPassSetCount)
+        mCachedPassSets.erase(mCachedPassSets.begin());
+
+    if (!mPermutationCachePath.empty())
+    {
+        mPermutationCache.record(passes.key, getSurfelGIStaticProperties(passes.staticParams).toJson().dump());
+        if (!mPermutationCache.save(mPermutationCachePath))
+            logWarning("SurfelGI: failed to write permutation cache '{}'.", mPermutationCachePath.string());
+    }
 }
 
-void SurfelGI::createPasses()
+SurfelGI::ProgramSet SurfelGI::getProgramSet(const SurfelGIStaticParams& staticParams, const DefineList& emissiveDefines) const
 {
-    auto defines = mStaticParams.getDefines(*this);
+    ProgramSet programs;
+    programs.staticParams = staticParams;
+    programs.emissiveDefines = emissiveDefines;
+
+    auto defines = staticParams.getDefines();
     defines.add(mpScene->getSceneDefines());
 
+    const auto addComputeProgram =
+        [&](ref<ComputePass> PassSet::*pPass, const std::string& path, const std::string& entry, const DefineList& passDefines)
+    {
+        ProgramBuild build;
+        build.desc.addShaderLibrary(path).csEntry(entry);
+        build.defines = passDefines;
+        programs.computePrograms.emplace_back(pPass, std::move(build));
+    };
+
     // Evalulation Pass
-    mpSurfelEvaluationPass =
-        ComputePass::create(mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelEvaluationPass.cs.slang", "csMain", defines);
+    addComputeProgram(
+        &PassSet::pSurfelEvaluationPass, "RenderPasses/Surfel/SurfelGI/SurfelEvaluationPass.cs.slang", "csMain", defines
+    );
+
+    // Overlay Pass
+    addComputeProgram(&PassSet::pSurfelOverlayPass, "RenderPasses/Surfel/SurfelGI/SurfelOverlayPass.cs.slang", "csMain", defines);
 
     // Prepare Pass
-    mpPreparePass =
-        ComputePass::create(mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelPreparePass.cs.slang", "csMain", defines);
+    addComputeProgram(&PassSet::pPreparePass, "RenderPasses/Surfel/SurfelGI/SurfelPreparePass.cs.slang", "csMain", defines);
 
-    // Update Pass (Collect Cell Info Pass)
-    mpCollectCellInfoPass = ComputePass::create(
-        mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelUpdatePass.cs.slang", "collectCellInfo", defines
-    );
+    // Update Passes
+    {
+        const std::string path = "RenderPasses/Surfel/SurfelGI/SurfelUpdatePass.cs.slang";
 
-    // Update Pass (Accumulate Cell Info Pass)
-    mpAccumulateCellInfoPass = ComputePass::create(
-        mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelUpdatePass.cs.slang", "accumulateCellInfo", defines
-    );
+        addComputeProgram(&PassSet::pCollectCellInfoPass, path, "collectCellInfo", defines);
+        addComputeProgram(&PassSet::pAccumulateCellInfoPass, path, "accumulateCellInfo", defines);
+        addComputeProgram(&PassSet::pUpdateCellToSurfelBuffer, path, "updateCellToSurfelBuffer", defines);
+        addComputeProgram(&PassSet::pAllocateSurfelRaysPass, path, "allocateSurfelRays", defines);
+        addComputeProgram(&PassSet::pBuildSurfelNeighborsPass, path, "buildSurfelNeighbors", defines);
 
-    // Update Pass (Update Cell To Surfel buffer Pass)
-    mpUpdateCellToSurfelBuffer = ComputePass::create(
-        mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelUpdatePass.cs.slang", "updateCellToSurfelBuffer", defines
-    );
+        // Region Streaming Pass
+        addComputeProgram(&PassSet::pRestoreSurfelsPass, path, "restoreSurfels", defines);
+    }
 
     // Surfel RayTrace Pass
     {
-        ProgramDesc desc;
+        ProgramDesc& desc = programs.rtProgram.desc;
         desc.addShaderModules(mpScene->getShaderModules());
         desc.addShaderLibrary("RenderPasses/Surfel/SurfelGI/SurfelRayTrace.rt.slang");
-        desc.setMaxPayloadSize(72u);
+        desc.setMaxPayloadSize(80u);
         desc.setMaxAttributeSize(mpScene->getRaytracingMaxAttributeSize());
         desc.setMaxTraceRecursionDepth(2u);
+        desc.addTypeConformances(mpScene->getTypeConformances());
 
-        mRtPass.pBindingTable = RtBindingTable::create(2, 2, mpScene->getGeometryCount());
-        mRtPass.pBindingTable->setRayGen(desc.addRayGen("rayGen"));
-        mRtPass.pBindingTable->setMiss(0, desc.addMiss("scatterMiss"));
-        mRtPass.pBindingTable->setMiss(1, desc.addMiss("shadowMiss"));
+        programs.pRtBindingTable = RtBindingTable::create(2, 2, mpScene->getGeometryCount());
+        programs.pRtBindingTable->setRayGen(desc.addRayGen("rayGen"));
+        programs.pRtBindingTable->setMiss(0, desc.addMiss("scatterMiss"));
+        programs.pRtBindingTable->setMiss(1, desc.addMiss("shadowMiss"));
 
-        mRtPass.pBindingTable->setHitGroup(
+        programs.pRtBindingTable->setHitGroup(
             0,
             mpScene->getGeometryIDs(Scene::GeometryType::TriangleMesh),
             desc.addHitGroup("scatterCloseHit", "scatterAnyHit")
         );
 
-        mRtPass.pBindingTable->setHitGroup(
+        programs.pRtBindingTable->setHitGroup(
             1, mpScene->getGeometryIDs(Scene::GeometryType::TriangleMesh), desc.addHitGroup("", "shadowAnyhit")
         );
 
-        mRtPass.pProgram = Program::create(mpDevice, desc, defines);
-        mRtPass.pProgram->addDefines(mpSampleGenerator->getDefines());
-        mRtPass.pProgram->setTypeConformances(mpScene->getTypeConformances());
-
-        mRtPass.pVars = RtProgramVars::create(mpDevice, mRtPass.pProgram, mRtPass.pBindingTable);
-        mpSampleGenerator->bindShaderData(mRtPass.pVars->getRootVar());
+        programs.rtProgram.defines = defines;
+        programs.rtProgram.defines.add(mpSampleGenerator->getDefines());
+        programs.rtProgram.defines.add(emissiveDefines);
     }
 
     // Surfel Generation Pass
-    mpSurfelGenerationPass =
-        ComputePass::create(mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelGenerationPass.cs.slang", "csMain", defines);
+    addComputeProgram(
+        &PassSet::pSurfelGenerationPass, "RenderPasses/Surfel/SurfelGI/SurfelGenerationPass.cs.slang", "csMain", defines
+    );
 
     // Surfel Integrate Pass
-    mpSurfelIntegratePass =
-        ComputePass::create(mpDevice, "RenderPasses/Surfel/SurfelGI/SurfelIntegratePass.cs.slang", "csMain", defines);
+    addComputeProgram(
+        &PassSet::pSurfelIntegratePass, "RenderPasses/Surfel/SurfelGI/SurfelIntegratePass.cs.slang", "csMain", defines
+    );
+
+    // Surfel Light Resampling Pass
+    {
+        auto resamplingDefines = defines;
+        resamplingDefines.add(mpSampleGenerator->getDefines());
+
+        addComputeProgram(
+            &PassSet::pSurfelLightResamplingPass,
+            "RenderPasses/Surfel/SurfelGI/SurfelLightResamplingPass.cs.slang",
+            "csMain",
+            resamplingDefines
+        );
+    }
+
+    // Deterministic Passes
+    if (staticParams.deterministic)
+    {
+        const std::string path = "RenderPasses/Surfel/SurfelGI/SurfelDeterministicPass.cs.slang";
+
+        addComputeProgram(&PassSet::pCountSurfelSlotsPass, path, "countSurfelSlots", defines);
+        addComputeProgram(&PassSet::pScanSurfelSlotBlocksPass, path, "scanSurfelSlotBlocks", defines);
+        addComputeProgram(&PassSet::pCompactSurfelSlotsPass, path, "compactSurfelSlots", defines);
+        addComputeProgram(&PassSet::pSortCellToSurfelPass, path, "sortCellToSurfelBuffer", defines);
+        addComputeProgram(&PassSet::pAllocateSpawnRequestsPass, path, "allocateSpawnRequests", defines);
+    }
+
+    return programs;
+}
+
+void SurfelGI::compileProgramSet(const ref<Device>& pDevice, ProgramSet& programs)
+{
+    // Compile every program now, instead of at first dispatch on render thread.
+    // Kernels are compiled without vars, as no pass has specialization parameters.
+    const auto compile = [&](ProgramBuild& build)
+    {
+        build.pProgram = Program::create(pDevice, build.desc, build.defines);
+        build.pProgram->getActiveVersion()->getKernels(pDevice.get(), nullptr);
+    };
+
+    for (auto& [pPass, build] : programs.computePrograms)
+        compile(build);
+
+    compile(programs.rtProgram);
+}
+
+SurfelGI::PassSet SurfelGI::createPasses(ProgramSet&& programs) const
+{
+    PassSet passes;
+    passes.staticParams = programs.staticParams;
+    passes.emissiveDefines = std::move(programs.emissiveDefines);
+    passes.key = programs.key;
+
+    for (auto& [pPass, build] : programs.computePrograms)
+        passes.*pPass = make_ref<PrecompiledComputePass>(mpDevice, build.desc, build.defines, build.pProgram);
+
+    passes.rtPass.pProgram = std::move(programs.rtProgram.pProgram);
+    passes.rtPass.pBindingTable = std::move(programs.pRtBindingTable);
+    passes.rtPass.pVars = RtProgramVars::create(mpDevice, passes.rtPass.pProgram, passes.rtPass.pBindingTable);
+    mpSampleGenerator->bindShaderData(passes.rtPass.pVars->getRootVar());
+
+    return passes;
+}
+
+void SurfelGI::applyPasses(PassSet&& passes)
+{
+    mpSurfelEvaluationPass = std::move(passes.pSurfelEvaluationPass);
+    mpSurfelOverlayPass = std::move(passes.pSurfelOverlayPass);
+    mpPreparePass = std::move(passes.pPreparePass);
+    mpCollectCellInfoPass = std::move(passes.pCollectCellInfoPass);
+    mpAccumulateCellInfoPass = std::move(passes.pAccumulateCellInfoPass);
+    mpUpdateCellToSurfelBuffer = std::move(passes.pUpdateCellToSurfelBuffer);
+    mpAllocateSurfelRaysPass = std::move(passes.pAllocateSurfelRaysPass);
+    mpBuildSurfelNeighborsPass = std::move(passes.pBuildSurfelNeighborsPass);
+    mpSurfelGenerationPass = std::move(passes.pSurfelGenerationPass);
+    mpSurfelIntegratePass = std::move(passes.pSurfelIntegratePass);
+    mpSurfelLightResamplingPass = std::move(passes.pSurfelLightResamplingPass);
+    mpCountSurfelSlotsPass = std::move(passes.pCountSurfelSlotsPass);
+    mpScanSurfelSlotBlocksPass = std::move(passes.pScanSurfelSlotBlocksPass);
+    mpCompactSurfelSlotsPass = std::move(passes.pCompactSurfelSlotsPass);
+    mpSortCellToSurfelPass = std::move(passes.pSortCellToSurfelPass);
+    mpAllocateSpawnRequestsPass = std::move(passes.pAllocateSpawnRequestsPass);
+    mpRestoreSurfelsPass = std::move(passes.pRestoreSurfelsPass);
+    mRtPass = std::move(passes.rtPass);
+    mEmissiveDefines = std::move(passes.emissiveDefines);
+
+    resolveConstantVars();
+    mBindingsDirty = true;
+}
+
+void SurfelGI::swapPasses(PassSet&& passes)
+{
+    cachePassSet(passes);
+
+    const SurfelGIStaticParams prevStaticParams = mStaticParams;
+    mStaticParams = passes.staticParams;
+    applyPasses(std::move(passes));
+
+    // Surfels are placed in world space, so they stay valid with most static params.
+    // Only resources sized by static params are re-created.
+    if (mStaticParams.cellCount != prevStaticParams.cellCount || mStaticParams.deterministic != prevStaticParams.deterministic)
+        createStaticParamDependentResources();
+
+    if (mStaticParams.useInstrumentation != prevStaticParams.useInstrumentation)
+        clearHistograms();
+
+    // Buffer is not updated while cache is disabled.
+    if (mStaticParams.isLightVisibilityCacheEnabled() != prevStaticParams.isLightVisibilityCacheEnabled())
+        mClearLightVisibility = true;
+
+    if (mStaticParams.isSurfelResetRequired(prevStaticParams))
+        mResetSurfelBuffer = true;
+
+    // Sampler is re-created at prepareLighting, which then swaps in pass set built for its defines.
+    if (mStaticParams.useEmissiveSampling != prevStaticParams.useEmissiveSampling ||
+        mStaticParams.emissiveSampler != prevStaticParams.emissiveSampler)
+        mpEmissiveSampler = nullptr;
 }
 
 void SurfelGI::createResolutionIndependentResources()
@@ -620,26 +1259,35 @@ void SurfelGI::createResolutionIndependentResources()
         delete[] freeIndexBuffer;
     }
 
-    mpCellInfoBuffer = mpDevice->createStructuredBuffer(
-        sizeof(CellInfo),
-        mStaticParams.cellCount,
+    mpCellToSurfelBuffer = mpDevice->createStructuredBuffer(
+        sizeof(uint),
+        kTotalSurfelLimit * 125,
         ResourceBindFlags::UnorderedAccess,
         MemoryType::DeviceLocal,
         nullptr,
         false
     );
 
-    mpCellToSurfelBuffer = mpDevice->createStructuredBuffer(
+    mpSurfelRayResultBuffer = mpDevice->createStructuredBuffer(
+        sizeof(SurfelRayResult), kRayBudget, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr, false
+    );
+
+    mpSurfelRayOffsetBuffer = mpDevice->createStructuredBuffer(
         sizeof(uint),
-        kTotalSurfelLimit * 125,
-        ResourceBindFlags::UnorderedAccess,
+        kTotalSurfelLimit,
+        ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess,
         MemoryType::DeviceLocal,
         nullptr,
         false
     );
 
-    mpSurfelRayResultBuffer = mpDevice->createStructuredBuffer(
-        sizeof(SurfelRayResult), kRayBudget, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr, false
+    mpSurfelNeighborBuffer = mpDevice->createStructuredBuffer(
+        sizeof(uint),
+        kTotalSurfelLimit * kMaxSurfelNeighborCount,
+        ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
     );
 
     mpSurfelRecycleInfoBuffer = mpDevice->createStructuredBuffer(
@@ -651,11 +1299,39 @@ void SurfelGI::createResolutionIndependentResources()
         false
     );
 
-    mpSurfelReservationBuffer = mpDevice->createBuffer(
-        sizeof(uint) * mStaticParams.cellCount, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr
-    );
-
-    mpSurfelRefCounter = mpDevice->createBuffer(
+    mpSurfelReservoirBuffer = mpDevice->createStructuredBuffer(
+        sizeof(SurfelReservoir),
+        kTotalSurfelLimit,
+        ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
+    );
+
+    mpPrevSurfelReservoirBuffer = mpDevice->createStructuredBuffer(
+        sizeof(SurfelReservoir),
+        kTotalSurfelLimit,
+        ResourceBindFlags::ShaderResource,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
+    );
+
+    mpSurfelLightVisibilityBuffer = mpDevice->createStructuredBuffer(
+        sizeof(uint),
+        kTotalSurfelLimit * kLightVisibilityWordCount,
+        ResourceBindFlags::UnorderedAccess,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
+    );
+    mClearLightVisibility = true;
+
+    mpSurfelFlagBuffer = mpDevice->createBuffer(
+        sizeof(uint) * kTotalSurfelLimit, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr
+    );
+
+    mpSurfelRefCounter = mpDevice->createBuffer(
         sizeof(uint) * kTotalSurfelLimit, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr
     );
 
@@ -673,16 +1349,123 @@ void SurfelGI::createResolutionIndependentResources()
     mpEmptySurfelBuffer = mpDevice->createStructuredBuffer(
         sizeof(Surfel), kTotalSurfelLimit, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr, false
     );
+
+    // Low and high word of variance sum, and surfel count. Padded to uint4.
+    mpConvergenceCounter =
+        mpDevice->createBuffer(sizeof(uint4), ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr);
+
+    // One slot per batch iteration.
+    mpConvergenceReadBackBuffer = mpDevice->createBuffer(
+        sizeof(uint4) * kMaxBatchIterationCount, ResourceBindFlags::None, MemoryType::ReadBack, nullptr
+    );
+
+    mpSurfelEvictionBuffer = mpDevice->createStructuredBuffer(
+        sizeof(SurfelRegionRecord), kMaxEvictionCount, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr, false
+    );
+
+    mpSurfelRestoreBuffer = mpDevice->createStructuredBuffer(
+        sizeof(SurfelRegionRecord), kMaxRestoreCount, ResourceBindFlags::ShaderResource, MemoryType::DeviceLocal, nullptr, false
+    );
+
+    for (auto& pReadBackBuffer : mpEvictionReadBackBuffers)
+    {
+        pReadBackBuffer = mpDevice->createBuffer(
+            kEvictionReadBackHeaderSize + sizeof(SurfelRegionRecord) * kMaxEvictionCount,
+            ResourceBindFlags::None,
+            MemoryType::ReadBack,
+            nullptr
+        );
+    }
+
+    mpSurfelHistogramBuffer = mpDevice->createBuffer(
+        sizeof(uint) * kHistogramBufferCount, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr
+    );
+
+    for (auto& pReadBackBuffer : mpHistogramReadBackBuffers)
+    {
+        pReadBackBuffer = mpDevice->createBuffer(
+            sizeof(uint) * kHistogramBufferCount, ResourceBindFlags::None, MemoryType::ReadBack, nullptr
+        );
+    }
+
+    createStaticParamDependentResources();
+}
+
+void SurfelGI::createStaticParamDependentResources()
+{
+    mBindingsDirty = true;
+
+    mpCellInfoBuffer = mpDevice->createStructuredBuffer(
+        sizeof(CellInfo),
+        mStaticParams.cellCount,
+        ResourceBindFlags::UnorderedAccess,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
+    );
+
+    mpSurfelReservationBuffer = mpDevice->createBuffer(
+        sizeof(uint) * mStaticParams.cellCount, ResourceBindFlags::UnorderedAccess, MemoryType::DeviceLocal, nullptr
+    );
+
+    mpSurfelSnapshotBuffer = nullptr;
+    mpSurfelSlotBlockBuffer = nullptr;
+    if (mStaticParams.deterministic)
+    {
+        mpSurfelSnapshotBuffer = mpDevice->createStructuredBuffer(
+            sizeof(Surfel), kTotalSurfelLimit, ResourceBindFlags::ShaderResource, MemoryType::DeviceLocal, nullptr, false
+        );
+        mpSurfelSlotBlockBuffer = mpDevice->createStructuredBuffer(
+            sizeof(uint),
+            kSurfelSlotBlockCount,
+            ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess,
+            MemoryType::DeviceLocal,
+            nullptr,
+            false
+        );
+    }
 }
 
 void SurfelGI::createResolutionDependentResources() {}
 
+void SurfelGI::resolveConstantVars()
+{
+    auto getConstantsVar = [](const ShaderVar& rootVar) { return rootVar[kConstantBufferName][kConstantsVarName]; };
+
+    mConstantVars.evaluation = getConstantsVar(mpSurfelEvaluationPass->getRootVar());
+    mConstantVars.generation = getConstantsVar(mpSurfelGenerationPass->getRootVar());
+    mConstantVars.overlay = getConstantsVar(mpSurfelOverlayPass->getRootVar());
+    mConstantVars.collectCellInfo = getConstantsVar(mpCollectCellInfoPass->getRootVar());
+    mConstantVars.accumulateCellInfo = getConstantsVar(mpAccumulateCellInfoPass->getRootVar());
+    mConstantVars.updateCellToSurfelBuffer = getConstantsVar(mpUpdateCellToSurfelBuffer->getRootVar());
+    mConstantVars.buildSurfelNeighbors = getConstantsVar(mpBuildSurfelNeighborsPass->getRootVar());
+    mConstantVars.restoreSurfels = getConstantsVar(mpRestoreSurfelsPass->getRootVar());
+    mConstantVars.rayTrace = getConstantsVar(mRtPass.pVars->getRootVar());
+    mConstantVars.integrate = getConstantsVar(mpSurfelIntegratePass->getRootVar());
+    mConstantVars.lightResampling = getConstantsVar(mpSurfelLightResamplingPass->getRootVar());
+
+    if (mpAllocateSpawnRequestsPass)
+        mConstantVars.spawnRequestCount = mpAllocateSpawnRequestsPass->getRootVar()[kConstantBufferName]["gSpawnRequestCount"];
+}
+
 void SurfelGI::bindResources(const RenderData& renderData)
 {
-    const auto& pPackedHitInfoTexture = renderData.getTexture(kPackedHitInfoTextureName);
-    mpOutputTexture = renderData.getTexture(kOutputTextureName);
-    mpIrradianceMapTexture = renderData.getTexture(kIrradianceMapTextureName);
-    mpSurfelDepthTexture = renderData.getTexture(kSurfelDepthTextureName);
+    // Textures of render graph are re-allocated when graph is re-compiled, e.g. when output format is changed.
+    // Their bindings are then set again with the rest, instead of at every frame.
+    const ref<Texture> pIrradianceMapTexture = renderData.getTexture(kIrradianceMapTextureName);
+    const ref<Texture> pSurfelDepthTexture = renderData.getTexture(kSurfelDepthTextureName);
+    if (pIrradianceMapTexture != mpIrradianceMapTexture || pSurfelDepthTexture != mpSurfelDepthTexture)
+    {
+        mpIrradianceMapTexture = pIrradianceMapTexture;
+        mpSurfelDepthTexture = pSurfelDepthTexture;
+        mBindingsDirty = true;
+    }
+
+    // Bindings stay in program vars, so they are set again only when passes or resources are re-created.
+    if (!mBindingsDirty)
+        return;
+
+    mBindingsDirty = false;
 
     // Evaluation Pass
     {
@@ -693,13 +1476,25 @@ void SurfelGI::bindResources(const RenderData& renderData)
         var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
         var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
 
+        var[kSurfelDepthVarName] = mpSurfelDepthTexture;
+
+        var[kSurfelDepthSamplerVarName] = mpSurfelDepthSampler;
+    }
+
+    // Overlay Pass
+    {
+        auto var = mpSurfelOverlayPass->getRootVar();
+
+        var[kSurfelBufferVarName] = mpSurfelBuffer;
+        var[kCellInfoBufferVarName] = mpCellInfoBuffer;
+        var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
+        var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+
         var[kSurfelRefCounterVarName] = mpSurfelRefCounter;
 
-        var["gPackedHitInfo"] = pPackedHitInfoTexture;
-        var["gSurfelDepth"] = mpSurfelDepthTexture;
-        var["gOutput"] = mpOutputTexture;
+        var[kSurfelDepthVarName] = mpSurfelDepthTexture;
 
-        var["gSurfelDepthSampler"] = mpSurfelDepthSampler;
+        var[kSurfelDepthSamplerVarName] = mpSurfelDepthSampler;
     }
 
     // Prepare Pass
@@ -718,9 +1513,31 @@ void SurfelGI::bindResources(const RenderData& renderData)
         var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
         var[kSurfelFreeIndexBufferVarName] = mpSurfelFreeIndexBuffer;
         var[kCellInfoBufferVarName] = mpCellInfoBuffer;
-        var[kSurfelRayResultBufferVarName] = mpSurfelRayResultBuffer;
         var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+        var[kSurfelEvictionBufferVarName] = mpSurfelEvictionBuffer;
 
+        var[kSurfelFlagBufferVarName] = mpSurfelFlagBuffer;
+        var[kSurfelRefCounterVarName] = mpSurfelRefCounter;
+        var[kSurfelCounterVarName] = mpSurfelCounter;
+
+        if (mStaticParams.useInstrumentation)
+            var[kSurfelHistogramBufferVarName] = mpSurfelHistogramBuffer;
+        if (mStaticParams.isLightVisibilityCacheEnabled())
+            var[kSurfelLightVisibilityBufferVarName] = mpSurfelLightVisibilityBuffer;
+    }
+
+    // Region Streaming Pass
+    {
+        auto var = mpRestoreSurfelsPass->getRootVar();
+
+        var[kSurfelBufferVarName] = mpSurfelBuffer;
+        var[kSurfelGeometryBufferVarName] = mpSurfelGeometryBuffer;
+        var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
+        var[kSurfelFreeIndexBufferVarName] = mpSurfelFreeIndexBuffer;
+        var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+        var[kSurfelRestoreBufferVarName] = mpSurfelRestoreBuffer;
+
+        var[kSurfelFlagBufferVarName] = mpSurfelFlagBuffer;
         var[kSurfelRefCounterVarName] = mpSurfelRefCounter;
         var[kSurfelCounterVarName] = mpSurfelCounter;
     }
@@ -733,6 +1550,9 @@ void SurfelGI::bindResources(const RenderData& renderData)
         var[kSurfelCounterVarName] = mpSurfelCounter;
 
         var[kSurfelReservationBufferVarName] = mpSurfelReservationBuffer;
+
+        if (mStaticParams.useInstrumentation)
+            var[kSurfelHistogramBufferVarName] = mpSurfelHistogramBuffer;
     }
 
     // Update Pass (Update Cell To Surfel buffer Pass)
@@ -747,6 +1567,30 @@ void SurfelGI::bindResources(const RenderData& renderData)
         var[kSurfelCounterVarName] = mpSurfelCounter;
     }
 
+    // Update Pass (Allocate Surfel Rays Pass)
+    {
+        auto var = mpAllocateSurfelRaysPass->getRootVar();
+
+        var[kSurfelBufferVarName] = mpSurfelBuffer;
+        var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
+        var[kSurfelRayOffsetBufferVarName] = mpSurfelRayOffsetBuffer;
+
+        var[kSurfelCounterVarName] = mpSurfelCounter;
+    }
+
+    // Update Pass (Build Surfel Neighbors Pass)
+    {
+        auto var = mpBuildSurfelNeighborsPass->getRootVar();
+
+        var[kSurfelBufferVarName] = mpSurfelBuffer;
+        var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
+        var[kCellInfoBufferVarName] = mpCellInfoBuffer;
+        var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
+        var[kSurfelNeighborBufferVarName] = mpSurfelNeighborBuffer;
+
+        var[kSurfelCounterVarName] = mpSurfelCounter;
+    }
+
     // Surfel RayTrace Pass
     {
         auto var = mRtPass.pVars->getRootVar();
@@ -758,16 +1602,24 @@ void SurfelGI::bindResources(const RenderData& renderData)
         var[kCellInfoBufferVarName] = mpCellInfoBuffer;
         var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
         var[kSurfelRayResultBufferVarName] = mpSurfelRayResultBuffer;
+        var[kSurfelRayOffsetBufferVarName] = mpSurfelRayOffsetBuffer;
         var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+        var[kSurfelReservoirBufferVarName] = mpSurfelReservoirBuffer;
 
         var[kSurfelReservationBufferVarName] = mpSurfelReservationBuffer;
+        var[kSurfelFlagBufferVarName] = mpSurfelFlagBuffer;
         var[kSurfelRefCounterVarName] = mpSurfelRefCounter;
         var[kSurfelCounterVarName] = mpSurfelCounter;
 
-        var["gSurfelDepth"] = mpSurfelDepthTexture;
-        var["gIrradianceMap"] = mpIrradianceMapTexture;
+        var[kSurfelDepthVarName] = mpSurfelDepthTexture;
+        var[kIrradianceMapVarName] = mpIrradianceMapTexture;
+
+        var[kSurfelDepthSamplerVarName] = mpSurfelDepthSampler;
 
-        var["gSurfelDepthSampler"] = mpSurfelDepthSampler;
+        if (mStaticParams.useInstrumentation)
+            var[kSurfelHistogramBufferVarName] = mpSurfelHistogramBuffer;
+        if (mStaticParams.isLightVisibilityCacheEnabled())
+            var[kSurfelLightVisibilityBufferVarName] = mpSurfelLightVisibilityBuffer;
     }
 
     // Surfel Generation Pass
@@ -781,63 +1633,554 @@ void SurfelGI::bindResources(const RenderData& renderData)
         var[kCellInfoBufferVarName] = mpCellInfoBuffer;
         var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
         var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+        var[kSurfelSpawnRequestBufferVarName] = mpSurfelSpawnRequestBuffer;
 
+        var[kSurfelFlagBufferVarName] = mpSurfelFlagBuffer;
         var[kSurfelRefCounterVarName] = mpSurfelRefCounter;
         var[kSurfelCounterVarName] = mpSurfelCounter;
 
-        var["gPackedHitInfo"] = pPackedHitInfoTexture;
-        var["gSurfelDepth"] = mpSurfelDepthTexture;
-        var["gOutput"] = mpOutputTexture;
+        var[kSurfelDepthVarName] = mpSurfelDepthTexture;
 
-        var["gSurfelDepthSampler"] = mpSurfelDepthSampler;
+        var[kSurfelDepthSamplerVarName] = mpSurfelDepthSampler;
     }
 
     // Surfel Integrate Pass
     {
         auto var = mpSurfelIntegratePass->getRootVar();
 
+        var[kSurfelBufferVarName] = mpSurfelBuffer;
+        var[kSurfelSnapshotBufferVarName] = mpSurfelSnapshotBuffer;
+        var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
+        var[kSurfelNeighborBufferVarName] = mpSurfelNeighborBuffer;
+        var[kSurfelRayResultBufferVarName] = mpSurfelRayResultBuffer;
+
+        var[kSurfelCounterVarName] = mpSurfelCounter;
+        var["gConvergenceCounter"] = mpConvergenceCounter;
+
+        var[kSurfelDepthVarName] = mpSurfelDepthTexture;
+        var[kSurfelDepthRWVarName] = mpSurfelDepthTexture;
+        var[kIrradianceMapVarName] = mpIrradianceMapTexture;
+
+        var[kSurfelDepthSamplerVarName] = mpSurfelDepthSampler;
+    }
+
+    // Surfel Light Resampling Pass
+    {
+        auto var = mpSurfelLightResamplingPass->getRootVar();
+
         var[kSurfelBufferVarName] = mpSurfelBuffer;
         var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
         var[kCellInfoBufferVarName] = mpCellInfoBuffer;
         var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
-        var[kSurfelRayResultBufferVarName] = mpSurfelRayResultBuffer;
+        var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+        var[kSurfelReservoirBufferVarName] = mpSurfelReservoirBuffer;
+        var[kPrevSurfelReservoirBufferVarName] = mpPrevSurfelReservoirBuffer;
 
         var[kSurfelCounterVarName] = mpSurfelCounter;
+    }
+
+    // Deterministic Passes
+    if (mStaticParams.deterministic)
+    {
+        for (const auto& pPass :
+             {mpCountSurfelSlotsPass,
+              mpScanSurfelSlotBlocksPass,
+              mpCompactSurfelSlotsPass,
+              mpSortCellToSurfelPass,
+              mpAllocateSpawnRequestsPass})
+        {
+            auto var = pPass->getRootVar();
+
+            var[kSurfelBufferVarName] = mpSurfelBuffer;
+            var[kSurfelGeometryBufferVarName] = mpSurfelGeometryBuffer;
+            var[kSurfelValidIndexBufferVarName] = mpSurfelValidIndexBuffer;
+            var[kSurfelFreeIndexBufferVarName] = mpSurfelFreeIndexBuffer;
+            var[kCellInfoBufferVarName] = mpCellInfoBuffer;
+            var[kCellToSurfelBufferVarName] = mpCellToSurfelBuffer;
+            var[kSurfelRecycleInfoBufferVarName] = mpSurfelRecycleInfoBuffer;
+            var[kSurfelSpawnRequestBufferVarName] = mpSurfelSpawnRequestBuffer;
+            var[kSurfelSlotBlockBufferVarName] = mpSurfelSlotBlockBuffer;
+
+            var[kSurfelFlagBufferVarName] = mpSurfelFlagBuffer;
+            var[kSurfelRefCounterVarName] = mpSurfelRefCounter;
+            var[kSurfelCounterVarName] = mpSurfelCounter;
+        }
+    }
+}
+
+void SurfelGI::bindSceneData(RenderContext* pRenderContext)
+{
+    // Once per frame, as every view and batch iteration sees same scene.
+    mpScene->setRaytracingShaderData(pRenderContext, mpCollectCellInfoPass->getRootVar());
+    mpScene->setRaytracingShaderData(pRenderContext, mpSurfelEvaluationPass->getRootVar());
+    mpScene->setRaytracingShaderData(pRenderContext, mpSurfelGenerationPass->getRootVar());
+    mpScene->setRaytracingShaderData(pRenderContext, mpSurfelOverlayPass->getRootVar());
+
+    if (mStaticParams.useLightReservoir)
+        mpScene->setRaytracingShaderData(pRenderContext, mpSurfelLightResamplingPass->getRootVar());
+}
+
+void SurfelGI::updateEmissiveSampler(RenderContext* pRenderContext)
+{
+    // Request the light collection if emissive lights are enabled, also without emissive sampling,
+    // so that scene keeps it updated.
+    const bool hasEmissiveLights = mpScene->getRenderSettings().useEmissiveLights &&
+                                   mpScene->getLightCollection(pRenderContext)->getActiveLightCount(pRenderContext) > 0;
+    const bool useEmissiveSampling = mStaticParams.useEmissiveSampling && hasEmissiveLights;
+
+    if (useEmissiveSampling && !mpEmissiveSampler)
+    {
+        switch (mStaticParams.emissiveSampler)
+        {
+        case EmissiveLightSamplerType::Uniform:
+            mpEmissiveSampler = std::make_unique<EmissiveUniformSampler>(pRenderContext, mpScene);
+            break;
+        case EmissiveLightSamplerType::Power:
+            mpEmissiveSampler = std::make_unique<EmissivePowerSampler>(pRenderContext, mpScene);
+            break;
+        default:
+            FALCOR_THROW("Unsupported emissive light sampler type.");
+        }
+    }
+    else if (!useEmissiveSampling && mpEmissiveSampler)
+    {
+        mpEmissiveSampler = nullptr;
+    }
+}
+
+DefineList SurfelGI::getEmissiveDefines() const
+{
+    DefineList emissiveDefines;
+    if (mpEmissiveSampler)
+    {
+        emissiveDefines = mpEmissiveSampler->getDefines();
+        emissiveDefines.add("USE_EMISSIVE_SAMPLING");
+    }
+    return emissiveDefines;
+}
+
+void SurfelGI::prepareLighting(RenderContext* pRenderContext)
+{
+    updateEmissiveSampler(pRenderContext);
+
+    // Sampler can be created or destroyed after pass set is built. Pass sets are cached by key of their defines,
+    // so pass set for new defines is swapped in instead of changing defines of active program.
+    if (getEmissiveDefines() != mEmissiveDefines)
+    {
+        // Build in flight may already match, or may change static params of sampler.
+        if (auto programs = mRecompiler.wait())
+        {
+            swapPasses(createPasses(std::move(*programs)));
+            updateEmissiveSampler(pRenderContext);
+        }
+
+        // Failed build is not retried every frame. It is retried at next rebuild requested by user.
+        if (getEmissiveDefines() != mEmissiveDefines && mRecompiler.getState() != AsyncRecompiler<ProgramSet>::State::Failed)
+        {
+            requestPassRebuild(mStaticParams);
+            if (auto programs = mRecompiler.wait())
+                swapPasses(createPasses(std::move(*programs)));
+        }
+    }
+
+    if (mpEmissiveSampler)
+        mpEmissiveSampler->update(pRenderContext);
+}
+
+void SurfelGI::prepareViews(const RenderData& renderData)
+{
+    const auto& cameras = mpScene->getCameras();
+    mResolutionScale = getResolutionScale(renderData);
+
+    for (uint i = 0; i < kMaxViewCount; ++i)
+    {
+        mpPackedHitInfoTextures[i] = renderData.getTexture(getViewResourceName(kPackedHitInfoTextureName, i));
+        mpOutputTextures[i] = renderData.getTexture(getViewResourceName(kOutputTextureName, i));
+
+        const bool connected = mpPackedHitInfoTextures[i] && mpOutputTextures[i];
+        mViewSet.setEnabled(i, connected);
+        if (!connected)
+            continue;
+
+        // View 0 follows active camera, auxiliary views use camera of given index.
+        const auto& pCamera = i == 0 || cameras.empty()
+                                  ? mpScene->getCamera()
+                                  : cameras[std::min<size_t>(mViewSet.getView(i).cameraIndex, cameras.size() - 1)];
+
+        SurfelView& view = mViews[i];
+        view.viewProj = pCamera->getViewProjMatrixNoJitter();
+        view.position = pCamera->getPosition();
+        view.fovy = focalLengthToFovY(pCamera->getFocalLength(), pCamera->getFrameHeight());
+        view.frameDim = math::min(
+            uint2(mpPackedHitInfoTextures[i]->getWidth(), mpPackedHitInfoTextures[i]->getHeight()),
+            uint2(mpOutputTextures[i]->getWidth(), mpOutputTextures[i]->getHeight())
+        );
+        view.resolution = getRenderResolution(view.frameDim, mResolutionScale);
+
+        mpSurfacePosWTextures[i] = renderData.getTexture(getViewResourceName(kSurfacePosWTextureName, i));
+        mpSurfaceDataTextures[i] = renderData.getTexture(getViewResourceName(kSurfaceDataTextureName, i));
+
+        // Cache smaller than view would leave pixels without surface, so packed hit info is used instead.
+        mUseSurfaceCache[i] = mpSurfacePosWTextures[i] && mpSurfaceDataTextures[i] &&
+                              mpSurfacePosWTextures[i]->getWidth() >= view.resolution.x &&
+                              mpSurfacePosWTextures[i]->getHeight() >= view.resolution.y &&
+                              mpSurfaceDataTextures[i]->getWidth() >= view.resolution.x &&
+                              mpSurfaceDataTextures[i]->getHeight() >= view.resolution.y;
+    }
+
+    mGridCenter = mRuntimeParams.fixedGridCenter ? mRuntimeParams.gridCenter : mViews[0].position;
+
+    // Deterministic mode needs one spawn request slot per tile.
+    if (mStaticParams.deterministic)
+    {
+        uint requestCount = 0;
+        for (uint i = 0; i < kMaxViewCount; ++i)
+        {
+            if (mViewSet.getView(i).enabled)
+            {
+                const uint2 tileCount = (mViews[i].resolution + kTileSize - 1u) / kTileSize;
+                requestCount = std::max(requestCount, tileCount.x * tileCount.y);
+            }
+        }
+
+        if (!mpSurfelSpawnRequestBuffer || mpSurfelSpawnRequestBuffer->getElementCount() < requestCount)
+        {
+            mpSurfelSpawnRequestBuffer = mpDevice->createStructuredBuffer(
+                sizeof(SurfelSpawnRequest),
+                requestCount,
+                ResourceBindFlags::UnorderedAccess,
+                MemoryType::DeviceLocal,
+                nullptr,
+                false
+            );
+            mBindingsDirty = true;
+        }
+    }
+}
+
+void SurfelGI::prepareUpdateConstants()
+{
+    SurfelUpdateConstants& constants = mUpdateConstants;
+    constants = {};
+
+    // Pass every enabled view, so that surfel radius is decided by the closest one.
+    for (uint i = 0; i < kMaxViewCount; ++i)
+    {
+        if (mViewSet.getView(i).enabled)
+            constants.views[constants.viewCount++] = mViews[i];
+    }
+
+    constants.gridCenter = mGridCenter;
+    constants.lockSurfel = mLockSurfel;
+    constants.varianceSensitivity = mRuntimeParams.varianceSensitivity;
+    constants.minRayCount = mRuntimeParams.minRayCount;
+    constants.maxRayCount = mRuntimeParams.maxRayCount;
+    constants.useFullRayBudget = mRuntimeParams.batchMode;
+    constants.evictSurfel = mRuntimeParams.regionStreaming;
+    constants.frameIndex = mFrameIndex;
+
+    // Moved geometry invalidates kept surfel positions, and batch mode spreads whole ray budget over every surfel.
+    const bool updateAll = mRuntimeParams.batchMode || is_set(mpScene->getUpdates(), Scene::UpdateFlags::GeometryMoved);
+    constants.updateInterval = updateAll ? 1u : mRuntimeParams.updateInterval;
+    constants.updateVarianceThreshold = mRuntimeParams.updateVarianceThreshold;
+}
+
+SurfelViewPassConstants SurfelGI::getViewPassConstants(uint viewIndex) const
+{
+    const SurfelView& view = mViews[viewIndex];
+
+    SurfelViewPassConstants constants = {};
+    constants.view = view;
+    constants.gridCenter = mGridCenter;
+    constants.frameIndex = mFrameIndex;
+    constants.chanceMultiply = mRuntimeParams.chanceMultiply * getSpawnChanceScale(view.frameDim, view.resolution);
+    constants.chancePower = mRuntimeParams.chancePower;
+    constants.placementThreshold = mRuntimeParams.placementThreshold;
+    constants.removalThreshold = mRuntimeParams.removalThreshold;
+    constants.blendingDelay = mRuntimeParams.blendingDelay;
+    constants.overlayMode = (uint)mRuntimeParams.overlayMode;
+    constants.varianceSensitivity = mRuntimeParams.varianceSensitivity;
+    constants.useSurfaceCache = mUseSurfaceCache[viewIndex];
+
+    return constants;
+}
+
+void SurfelGI::executeEvaluationPass(RenderContext* pRenderContext, uint viewIndex)
+{
+    mConstantVars.evaluation.setBlob(getViewPassConstants(viewIndex));
+
+    auto var = mpSurfelEvaluationPass->getRootVar();
+
+    var["gPackedHitInfo"] = mpPackedHitInfoTextures[viewIndex];
+    var["gSurfacePosW"] = mpSurfacePosWTextures[viewIndex];
+    var["gSurfaceData"] = mpSurfaceDataTextures[viewIndex];
+    var["gOutput"] = mpOutputTextures[viewIndex];
+
+    mpSurfelEvaluationPass->execute(pRenderContext, uint3(mViews[viewIndex].resolution, 1));
+}
+
+void SurfelGI::executeGenerationPass(RenderContext* pRenderContext, uint viewIndex)
+{
+    mConstantVars.generation.setBlob(getViewPassConstants(viewIndex));
+
+    auto var = mpSurfelGenerationPass->getRootVar();
+
+    var["gPackedHitInfo"] = mpPackedHitInfoTextures[viewIndex];
+    var["gSurfacePosW"] = mpSurfacePosWTextures[viewIndex];
+    var["gSurfaceData"] = mpSurfaceDataTextures[viewIndex];
+    var["gOutput"] = mpOutputTextures[viewIndex];
+
+    mpSurfelGenerationPass->execute(pRenderContext, uint3(mViews[viewIndex].resolution, 1));
+
+    if (mStaticParams.deterministic)
+        executeSpawnAllocation(pRenderContext, viewIndex);
+}
+
+void SurfelGI::executeOverlayPass(RenderContext* pRenderContext, uint viewIndex)
+{
+    mConstantVars.overlay.setBlob(getViewPassConstants(viewIndex));
+
+    auto var = mpSurfelOverlayPass->getRootVar();
+
+    var["gPackedHitInfo"] = mpPackedHitInfoTextures[viewIndex];
+    var["gSurfacePosW"] = mpSurfacePosWTextures[viewIndex];
+    var["gSurfaceData"] = mpSurfaceDataTextures[viewIndex];
+    var["gOutput"] = mpOutputTextures[viewIndex];
+
+    mpSurfelOverlayPass->execute(pRenderContext, uint3(mViews[viewIndex].resolution, 1));
+}
+
+void SurfelGI::executeSpawnAllocation(RenderContext* pRenderContext, uint viewIndex)
+{
+    FALCOR_PROFILE(pRenderContext, "Surfel Spawn Allocation Pass");
+
+    const uint2 tileCount = (mViews[viewIndex].resolution + kTileSize - 1u) / kTileSize;
+
+    mConstantVars.spawnRequestCount = tileCount.x * tileCount.y;
+
+    mpAllocateSpawnRequestsPass->execute(pRenderContext, uint3(kScanGroupSize, 1, 1));
+}
 
-        var["gSurfelDepth"] = mpSurfelDepthTexture;
-        var["gSurfelDepthRW"] = mpSurfelDepthTexture;
-        var["gIrradianceMap"] = mpIrradianceMapTexture;
+void SurfelGI::executeRegionStreaming(RenderContext* pRenderContext)
+{
+    FALCOR_PROFILE(pRenderContext, "Region Streaming Pass");
 
-        var["gSurfelDepthSampler"] = mpSurfelDepthSampler;
+    mRegionStore.configure(
+        mRuntimeParams.regionSize, (uint64_t)mRuntimeParams.regionCacheSize << 20, mRuntimeParams.regionSpillPath
+    );
+
+    // Store what GPU has finished evicting.
+    const uint64_t completedValue = mpFence->getCurrentValue();
+    for (uint slot = 0; slot < (uint)mEvictionFenceValues.size(); ++slot)
+    {
+        if (mEvictionFenceValues[slot] != 0 && mEvictionFenceValues[slot] <= completedValue)
+            readEvictedSurfels(slot);
     }
+
+    // Take regions overlapping cell window. Surfels outside window would only be evicted again, so they are put back.
+    const float3 halfExtent = float3((float)(mStaticParams.cellDim / 2 - 1) * mStaticParams.cellUnit);
+    const float3 windowMin = mGridCenter - halfExtent;
+    const float3 windowMax = mGridCenter + halfExtent;
+
+    std::vector<SurfelRegionRecord> records;
+    if (mRegionStore.take(windowMin, windowMax, records) > 0)
+    {
+        std::vector<SurfelRegionRecord> outside;
+        for (const auto& record : records)
+        {
+            const float3& posW = record.surfel.position;
+            if (math::all(posW >= windowMin) && math::all(posW <= windowMax))
+                mPendingRestores.push_back(record);
+            else
+                outside.push_back(record);
+        }
+        mRegionStore.store(outside.data(), outside.size());
+    }
+
+    // Upload bounded chunk per frame.
+    const uint restoreCount = std::min((uint)mPendingRestores.size(), kMaxRestoreCount);
+    if (restoreCount == 0)
+        return;
+
+    mpSurfelRestoreBuffer->setBlob(mPendingRestores.data(), 0, sizeof(SurfelRegionRecord) * restoreCount);
+    mPendingRestores.erase(mPendingRestores.begin(), mPendingRestores.begin() + restoreCount);
+
+    SurfelUpdateConstants constants = mUpdateConstants;
+    constants.restoreCount = restoreCount;
+    mConstantVars.restoreSurfels.setBlob(constants);
+
+    mpRestoreSurfelsPass->execute(pRenderContext, uint3(kScanGroupSize, 1, 1));
 }
 
-Falcor::DefineList SurfelGI::StaticParams::getDefines(const SurfelGI& owner) const
+void SurfelGI::readEvictedSurfels(uint slot)
 {
-    DefineList defines;
+    mpFence->wait(mEvictionFenceValues[slot]);
+    mEvictionFenceValues[slot] = 0;
 
-    defines.add("SURFEL_TARGET_AREA", std::to_string(surfelTargetArea));
-    defines.add("CELL_UNIT", std::to_string(cellUnit));
-    defines.add("CELL_DIM", std::to_string(cellDim));
-    defines.add("CELL_COUNT", std::to_string(cellCount));
-    defines.add("PER_CELL_SURFEL_LIMIT", std::to_string(perCellSurfelLimit));
+    const auto& pReadBackBuffer = mpEvictionReadBackBuffers[slot];
+    const uint count = std::min(pReadBackBuffer->getElement<uint>(0), kMaxEvictionCount);
+    if (count == 0)
+        return;
 
-    if (useSurfelRadinace)
-        defines.add("USE_SURFEL_RADIANCE");
+    std::vector<SurfelRegionRecord> records(count);
+    pReadBackBuffer->getBlob(records.data(), kEvictionReadBackHeaderSize, sizeof(SurfelRegionRecord) * count);
 
-    if (limitSurfelSearch)
-        defines.add("LIMIT_SURFEL_SEARCH");
+    // Eviction order depends on thread scheduling. Sort, so that restore order does not.
+    if (mStaticParams.deterministic)
+    {
+        std::sort(
+            records.begin(),
+            records.end(),
+            [](const SurfelRegionRecord& a, const SurfelRegionRecord& b)
+            { return std::memcmp(&a.hitInfo, &b.hitInfo, sizeof(uint4)) < 0; }
+        );
+    }
+
+    mRegionStore.store(records.data(), records.size());
+}
+
+void SurfelGI::clearRegionStreaming()
+{
+    mRegionStore.clear();
+    mPendingRestores.clear();
+    mEvictionFenceValues = {};
+}
+
+void SurfelGI::readHistograms(uint slot)
+{
+    mpFence->wait(mHistogramFenceValues[slot]);
+    mHistogramFenceValues[slot] = 0;
+
+    std::vector<uint> bins(kHistogramBufferCount);
+    mpHistogramReadBackBuffers[slot]->getBlob(bins.data(), 0, sizeof(uint) * kHistogramBufferCount);
+    mHistograms.accumulate(bins.data());
+}
 
-    defines.add("MAX_SURFEL_FOR_STEP", std::to_string(maxSurfelForStep));
+void SurfelGI::exportHistograms(const std::filesystem::path& path)
+{
+    if (!mHistograms.save(path))
+        logWarning("SurfelGI: Failed to write histograms to '{}'.", path.string());
+}
 
-    if (useRayGuiding)
-        defines.add("USE_RAY_GUIDING");
+void SurfelGI::clearHistograms()
+{
+    mHistograms.clear();
+    mHistogramFenceValues = {};
+}
 
-    if (useSurfelDepth)
-        defines.add("USE_SURFEL_DEPTH");
+void SurfelGI::executeRayTracePass(RenderContext* pRenderContext)
+{
+    if (mStaticParams.useLightReservoir)
+    {
+        FALCOR_PROFILE(pRenderContext, "Surfel Light Resampling Pass");
 
-    if (useIrradianceSharing)
-        defines.add("USE_IRRADIANCE_SHARING");
+        // Keep reservoirs of previous frame for temporal and spatial reuse.
+        pRenderContext->copyResource(mpPrevSurfelReservoirBuffer.get(), mpSurfelReservoirBuffer.get());
 
-    return defines;
+        SurfelLightResamplingConstants constants = {};
+        constants.gridCenter = mGridCenter;
+        constants.frameIndex = mSampleIndex;
+        constants.candidateCount = mRuntimeParams.reservoirCandidateCount;
+        constants.spatialCount = mRuntimeParams.reservoirSpatialCount;
+        constants.maxTemporalM = mRuntimeParams.reservoirMaxTemporalM;
+        mConstantVars.lightResampling.setBlob(constants);
+
+        mpSurfelLightResamplingPass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+    }
+
+    {
+        FALCOR_PROFILE(pRenderContext, "Surfel RayTrace Pass");
+
+        SurfelRayTraceConstants constants = {};
+        constants.gridCenter = mGridCenter;
+        constants.frameIndex = mSampleIndex;
+        constants.rayStep = mRuntimeParams.rayStep;
+        constants.maxStep = mRuntimeParams.maxStep;
+        constants.lightVisibilityRefresh = mRuntimeParams.lightVisibilityRefresh;
+        constants.reservoirMaxM = mRuntimeParams.reservoirMaxTemporalM;
+        mConstantVars.rayTrace.setBlob(constants);
+
+        if (mpEmissiveSampler)
+            mpEmissiveSampler->bindShaderData(mRtPass.pVars->getRootVar()[kEmissiveSamplerVarName]);
+
+        mpScene->raytrace(pRenderContext, mRtPass.pProgram.get(), mRtPass.pVars, uint3(kRayBudget, 1, 1));
+    }
+}
+
+void SurfelGI::executeIntegratePass(RenderContext* pRenderContext, bool trackConvergence)
+{
+    FALCOR_PROFILE(pRenderContext, "Surfel Integrate Pass");
+
+    // Irradiance sharing reads neighbors before they are integrated.
+    if (mStaticParams.deterministic)
+        pRenderContext->copyResource(mpSurfelSnapshotBuffer.get(), mpSurfelBuffer.get());
+
+    SurfelIntegrateConstants constants = {};
+    constants.gridCenter = mGridCenter;
+    constants.shortMeanWindow = mRuntimeParams.shortMeanWindow;
+    constants.varianceSensitivity = mRuntimeParams.varianceSensitivity;
+    constants.trackConvergence = trackConvergence;
+    mConstantVars.integrate.setBlob(constants);
+
+    mpSurfelIntegratePass->execute(pRenderContext, uint3(kTotalSurfelLimit, 1, 1));
+}
+
+void SurfelGI::executeBatch(RenderContext* pRenderContext)
+{
+    FALCOR_PROFILE(pRenderContext, "Batch Iterations");
+
+    ConvergenceMonitor::Criteria criteria = mRuntimeParams.batchCriteria;
+    criteria.maxIterationCount = std::min(criteria.maxIterationCount, kMaxBatchIterationCount);
+    mConvergenceMonitor.reset(criteria);
+
+    // Reading back variance needs to wait GPU, so check only once per interval.
+    const uint checkInterval = std::max(1u, mRuntimeParams.batchCheckInterval);
+    uint iterationCount = 0;
+
+    while (mConvergenceMonitor.getStatus() == ConvergenceMonitor::Status::Running)
+    {
+        uint pendingCount = 0;
+        while (pendingCount < checkInterval && iterationCount < criteria.maxIterationCount)
+        {
+            pRenderContext->clearUAV(mpConvergenceCounter->getUAV().get(), uint4(0));
+
+            executeRayTracePass(pRenderContext);
+            executeIntegratePass(pRenderContext, true);
+
+            pRenderContext->copyBufferRegion(
+                mpConvergenceReadBackBuffer.get(), sizeof(uint4) * iterationCount, mpConvergenceCounter.get(), 0, sizeof(uint4)
+            );
+
+            mSampleIndex++;
+            iterationCount++;
+            pendingCount++;
+        }
+
+        pRenderContext->submit(true);
+
+        for (uint i = iterationCount - pendingCount; i < iterationCount; ++i)
+        {
+            const uint4 counter = mpConvergenceReadBackBuffer->getElement<uint4>(i);
+            const uint64_t varianceSum = ((uint64_t)counter.y << 32) | counter.x;
+
+            if (counter.z == 0)
+                mConvergenceMonitor.addEmptySample();
+            else
+                mConvergenceMonitor.addSample(ConvergenceMonitor::getMeanVariance(varianceSum, counter.z));
+        }
+    }
+
+    if (mConvergenceMonitor.getStatus() == ConvergenceMonitor::Status::Empty)
+    {
+        logDebug("SurfelGI batch: frame {} has no surfel to converge.", mFrameIndex);
+        return;
+    }
+
+    logDebug(
+        "SurfelGI batch: frame {} {} after {} iterations, mean variance {}.",
+        mFrameIndex,
+        mConvergenceMonitor.getStatus() == ConvergenceMonitor::Status::Converged ? "converged" : "hit iteration cap",
+        mConvergenceMonitor.getIterationCount(),
+        mConvergenceMonitor.getHistory().back()
+    );
 }
@@ -2,7 +2,14 @@
 #include "Falcor.h"
 #include "RenderGraph/RenderPass.h"
 #include "RenderGraph/RenderPassHelpers.h"
-#include "OverlayMode.slang"
+#include "Rendering/Lights/EmissiveLightSampler.h"
+#include "SurfelViewSet.h"
+#include "SurfelGIParams.h"
+#include "AsyncRecompiler.h"
+#include "PermutationCache.h"
+#include "SurfelRegionStore.h"
+#include "SurfelHistograms.h"
+#include "ResolutionScale.h"
 
 using namespace Falcor;
 
@@ -18,8 +25,8 @@ public:
 
     SurfelGI(ref<Device> pDevice, const Properties& props);
 
-    virtual void setProperties(const Properties& props) override {}
-    virtual Properties getProperties() const override { return {}; }
+    virtual void setProperties(const Properties& props) override;
+    virtual Properties getProperties() const override;
     virtual RenderPassReflection reflect(const CompileData& compileData) override;
     virtual void compile(RenderContext* pRenderContext, const CompileData& compileData) override {}
     virtual void execute(RenderContext* pRenderContext, const RenderData& renderData) override;
@@ -29,95 +36,202 @@ public:
     virtual bool onKeyEvent(const KeyboardEvent& keyEvent) override;
 
 private:
-    void reflectInput(RenderPassReflection& reflector, uint2 resolution);
-    void reflectOutput(RenderPassReflection& reflector, uint2 resolution);
-    void resetAndRecompile();
-    void createPasses();
-    void createResolutionIndependentResources();
-    void createResolutionDependentResources();
-    void bindResources(const RenderData& renderData);
+    struct RtPass
+    {
+        ref<Program> pProgram;
+        ref<RtBindingTable> pBindingTable;
+        ref<RtProgramVars> pVars;
+    };
 
-    struct RuntimeParams
+    // Every pass built from static params. Created on render thread from compiled programs, then swapped in at once.
+    struct PassSet
     {
-        // Surfel generation.
-        float chanceMultiply = 0.3f;
-        uint chancePower = 1;
-        float placementThreshold = 2.f;
-        float removalThreshold = 4.f;
-        float thresholdGap = 2.f;
-        uint blendingDelay = 240;
-        Falcor::OverlayMode overlayMode = Falcor::OverlayMode::IndirectLighting;
-
-        // Ray tracing.
-        float varianceSensitivity = 40.f;
-        uint minRayCount = 4u;
-        uint maxRayCount = 64u;
-        uint rayStep = 3;
-        uint maxStep = 6;
-
-        // Integrate.
-        float shortMeanWindow = 0.03f;
+        SurfelGIStaticParams staticParams;
+        DefineList emissiveDefines;
+        uint64_t key = 0;
+
+        ref<ComputePass> pSurfelEvaluationPass;
+        ref<ComputePass> pSurfelOverlayPass;
+        ref<ComputePass> pPreparePass;
+        ref<ComputePass> pCollectCellInfoPass;
+        ref<ComputePass> pAccumulateCellInfoPass;
+        ref<ComputePass> pUpdateCellToSurfelBuffer;
+        ref<ComputePass> pAllocateSurfelRaysPass;
+        ref<ComputePass> pBuildSurfelNeighborsPass;
+        ref<ComputePass> pSurfelGenerationPass;
+        ref<ComputePass> pSurfelIntegratePass;
+        ref<ComputePass> pSurfelLightResamplingPass;
+        ref<ComputePass> pCountSurfelSlotsPass;
+        ref<ComputePass> pScanSurfelSlotBlocksPass;
+        ref<ComputePass> pCompactSurfelSlotsPass;
+        ref<ComputePass> pSortCellToSurfelPass;
+        ref<ComputePass> pAllocateSpawnRequestsPass;
+        ref<ComputePass> pRestoreSurfelsPass;
+        RtPass rtPass;
     };
 
-    struct StaticParams
+    // Program of one pass. Desc and defines are made on render thread, and program is compiled from them on worker thread.
+    struct ProgramBuild
     {
-        uint surfelTargetArea = 40000;
-        float cellUnit = 0.05f;
-        uint cellDim = 250u;
-        uint cellCount = cellDim * cellDim * cellDim;
-        uint perCellSurfelLimit = 1024u;
-
-        bool useSurfelRadinace = true;
-        bool limitSurfelSearch = false;
-        uint maxSurfelForStep = 10;
-        bool useRayGuiding = false;
-        bool useSurfelDepth = true;
-        bool useIrradianceSharing = true;
-
-        DefineList getDefines(const SurfelGI& owner) const;
+        ProgramDesc desc;
+        DefineList defines;
+        ref<Program> pProgram;
+    };
+
+    // Programs of pass set. Everything read from scene or device is captured by value on render thread,
+    // so that worker thread only compiles programs. Passes and vars are created from them on render thread.
+    struct ProgramSet
+    {
+        SurfelGIStaticParams staticParams;
+        DefineList emissiveDefines;
+        uint64_t key = 0;
+
+        std::vector<std::pair<ref<ComputePass> PassSet::*, ProgramBuild>> computePrograms;
+        ProgramBuild rtProgram;
+        ref<RtBindingTable> pRtBindingTable;
     };
 
-    RuntimeParams mRuntimeParams;
-    StaticParams mStaticParams;
-    StaticParams mTempStaticParams;
+    // Constants of each pass, resolved once per program vars instead of by name at every dispatch.
+    // Vars point into program vars, so they are resolved again whenever those are re-created.
+    struct ConstantVars
+    {
+        ShaderVar evaluation;
+        ShaderVar generation;
+        ShaderVar overlay;
+        ShaderVar collectCellInfo;
+        ShaderVar accumulateCellInfo;
+        ShaderVar updateCellToSurfelBuffer;
+        ShaderVar buildSurfelNeighbors;
+        ShaderVar restoreSurfels;
+        ShaderVar rayTrace;
+        ShaderVar integrate;
+        ShaderVar lightResampling;
+        ShaderVar spawnRequestCount; ///< Only in deterministic mode.
+    };
+
+    void reflectInput(RenderPassReflection& reflector, uint2 resolution);
+    void reflectOutput(RenderPassReflection& reflector, uint2 resolution);
+    void requestPassRebuild(const SurfelGIStaticParams& staticParams);
+    uint64_t getPermutationKey(const SurfelGIStaticParams& staticParams, const DefineList& emissiveDefines) const;
+    void cachePassSet(const PassSet& passes);
+    void loadPermutationCache();
+    ProgramSet getProgramSet(const SurfelGIStaticParams& staticParams, const DefineList& emissiveDefines) const;
+    static void compileProgramSet(const ref<Device>& pDevice, ProgramSet& programs);
+    PassSet createPasses(ProgramSet&& programs) const;
+    void applyPasses(PassSet&& passes);
+    void swapPasses(PassSet&& passes);
+    void createResolutionIndependentResources();
+    void createStaticParamDependentResources();
+    void createResolutionDependentResources();
+    void resolveConstantVars();
+    void bindResources(const RenderData& renderData);
+    void bindSceneData(RenderContext* pRenderContext);
+    void updateEmissiveSampler(RenderContext* pRenderContext);
+    DefineList getEmissiveDefines() const;
+    void prepareLighting(RenderContext* pRenderContext);
+    void prepareViews(const RenderData& renderData);
+    void prepareUpdateConstants();
+    SurfelViewPassConstants getViewPassConstants(uint viewIndex) const;
+    void executeEvaluationPass(RenderContext* pRenderContext, uint viewIndex);
+    void executeGenerationPass(RenderContext* pRenderContext, uint viewIndex);
+    void executeOverlayPass(RenderContext* pRenderContext, uint viewIndex);
+    void executeRayTracePass(RenderContext* pRenderContext);
+    void executeIntegratePass(RenderContext* pRenderContext, bool trackConvergence);
+    void executeBatch(RenderContext* pRenderContext);
+    void executeSpawnAllocation(RenderContext* pRenderContext, uint viewIndex);
+    void executeRegionStreaming(RenderContext* pRenderContext);
+    void readEvictedSurfels(uint slot);
+    void clearRegionStreaming();
+    void readHistograms(uint slot);
+    void exportHistograms(const std::filesystem::path& path);
+    void clearHistograms();
+
+    SurfelGIRuntimeParams mRuntimeParams;
+    SurfelGIStaticParams mStaticParams;
+    SurfelGIStaticParams mTempStaticParams;
 
     uint mFrameIndex;
-    uint mMaxFrameIndex;
+    uint mSampleIndex;
     uint2 mFrameDim;
-    float mFOVy;
-    float3 mCamPos;
+    float3 mGridCenter;
     float mRenderScale;
+    float mResolutionScale = 1.f;   ///< Resolution scale of current frame, given by render graph dictionary.
+
+    SurfelViewSet mViewSet;
+    std::array<SurfelView, kMaxViewCount> mViews;
 
     bool mIsFrameDimChanged;
     bool mReadBackValid;
     bool mLockSurfel;
     bool mResetSurfelBuffer;
-    bool mRecompile;
+    bool mClearLightVisibility = true;
+    bool mBindingsDirty = true;     ///< Buffers are bound only when passes or buffers are re-created.
+
+    float mHostTimeMs = 0.f;        ///< CPU time of execute, averaged over recent frames.
 
     std::vector<float> mSurfelCount;
     std::vector<float> mRayBudget;
 
+    ConvergenceMonitor mConvergenceMonitor;
+
+    // Pass sets built before are kept, so that switching back to them needs no compile.
+    // Most recently used is at the back.
+    std::vector<PassSet> mCachedPassSets;
+    PermutationCache mPermutationCache;
+    std::filesystem::path mPermutationCachePath;
+    uint64_t mSourceKey = 0;
+
+    // Region streaming.
+    // Evicted surfels are read back through a ring of buffers, so that host reads them frames later without waiting.
+    SurfelRegionStore mRegionStore;
+    std::vector<SurfelRegionRecord> mPendingRestores;
+    std::array<uint64_t, 2> mEvictionFenceValues = {}; ///< Zero if slot has nothing to read.
+    uint mEvictionSlot = 0;
+
+    // Instrumentation.
+    // Histograms of each frame are read back through a ring of buffers like evicted surfels, and summed on host.
+    SurfelHistograms mHistograms;
+    std::array<uint64_t, 2> mHistogramFenceValues = {}; ///< Zero if slot has nothing to read.
+    uint mHistogramSlot = 0;
+
     ref<Scene> mpScene;
     ref<Fence> mpFence;
     ref<SampleGenerator> mpSampleGenerator;
+    std::unique_ptr<EmissiveLightSampler> mpEmissiveSampler;
 
     ref<ComputePass> mpSurfelEvaluationPass;
+    ref<ComputePass> mpSurfelOverlayPass;
 
     ref<ComputePass> mpPreparePass;
     ref<ComputePass> mpCollectCellInfoPass;
     ref<ComputePass> mpAccumulateCellInfoPass;
     ref<ComputePass> mpUpdateCellToSurfelBuffer;
+    ref<ComputePass> mpAllocateSurfelRaysPass;
+    ref<ComputePass> mpBuildSurfelNeighborsPass;
     ref<ComputePass> mpSurfelGenerationPass;
     ref<ComputePass> mpSurfelIntegratePass;
+    ref<ComputePass> mpSurfelLightResamplingPass;
 
-    struct
-    {
-        ref<Program> pProgram;
-        ref<RtBindingTable> pBindingTable;
-        ref<RtProgramVars> pVars;
-    } mRtPass;
+    // Deterministic mode.
+    ref<ComputePass> mpCountSurfelSlotsPass;
+    ref<ComputePass> mpScanSurfelSlotBlocksPass;
+    ref<ComputePass> mpCompactSurfelSlotsPass;
+    ref<ComputePass> mpSortCellToSurfelPass;
+    ref<ComputePass> mpAllocateSpawnRequestsPass;
+
+    ref<ComputePass> mpRestoreSurfelsPass;
+
+    RtPass mRtPass;
+    DefineList mEmissiveDefines; ///< Emissive defines which active pass set is built with.
 
-    ref<Texture> mpOutputTexture;
+    ConstantVars mConstantVars;
+    SurfelUpdateConstants mUpdateConstants = {};
+
+    std::array<ref<Texture>, kMaxViewCount> mpPackedHitInfoTextures;
+    std::array<ref<Texture>, kMaxViewCount> mpOutputTextures;
+    std::array<ref<Texture>, kMaxViewCount> mpSurfacePosWTextures;
+    std::array<ref<Texture>, kMaxViewCount> mpSurfaceDataTextures;
+    std::array<bool, kMaxViewCount> mUseSurfaceCache = {};
     ref<Texture> mpIrradianceMapTexture;
     ref<Texture> mpSurfelDepthTexture;
 
@@ -129,7 +243,18 @@ private:
     ref<Buffer> mpCellInfoBuffer;
     ref<Buffer> mpCellToSurfelBuffer;
     ref<Buffer> mpSurfelRayResultBuffer;
+    ref<Buffer> mpSurfelRayOffsetBuffer;
+    ref<Buffer> mpSurfelNeighborBuffer;
     ref<Buffer> mpSurfelRecycleInfoBuffer;
+    ref<Buffer> mpSurfelReservoirBuffer;
+    ref<Buffer> mpPrevSurfelReservoirBuffer;
+    ref<Buffer> mpSurfelLightVisibilityBuffer;
+    ref<Buffer> mpSurfelFlagBuffer;
+    ref<Buffer> mpSurfelSnapshotBuffer;
+    ref<Buffer> mpSurfelSlotBlockBuffer;
+    ref<Buffer> mpSurfelSpawnRequestBuffer;
+    ref<Buffer> mpSurfelEvictionBuffer;
+    ref<Buffer> mpSurfelRestoreBuffer;
 
     ref<Buffer> mpSurfelReservationBuffer;
     ref<Buffer> mpSurfelRefCounter;
@@ -138,5 +263,16 @@ private:
     ref<Buffer> mpEmptySurfelBuffer;
     ref<Buffer> mpReadBackBuffer;
 
+    ref<Buffer> mpConvergenceCounter;
+    ref<Buffer> mpConvergenceReadBackBuffer;
+
+    std::array<ref<Buffer>, 2> mpEvictionReadBackBuffers;
+
+    ref<Buffer> mpSurfelHistogramBuffer;
+    std::array<ref<Buffer>, 2> mpHistogramReadBackBuffers;
+
     ref<Sampler> mpSurfelDepthSampler;
+
+    // Declared last, so that job in flight is finished before anything it uses is destroyed.
+    AsyncRecompiler<ProgramSet> mRecompiler;
 };
@@ -0,0 +1,351 @@
+#include "SurfelGIParams.h"
+#include "SurfelTypes.slang"
+
+namespace
+{
+
+// Runtime params.
+const std::string kChanceMultiply = "chanceMultiply";
+const std::string kChancePower = "chancePower";
+const std::string kPlacementThreshold = "placementThreshold";
+const std::string kRemovalThreshold = "removalThreshold";
+const std::string kBlendingDelay = "blendingDelay";
+const std::string kOverlayMode = "overlayMode";
+const std::string kOutputFormat = "outputFormat";
+const std::string kVarianceSensitivity = "varianceSensitivity";
+const std::string kMinRayCount = "minRayCount";
+const std::string kMaxRayCount = "maxRayCount";
+const std::string kRayStep = "rayStep";
+const std::string kMaxStep = "maxStep";
+const std::string kReservoirCandidateCount = "reservoirCandidateCount";
+const std::string kReservoirSpatialCount = "reservoirSpatialCount";
+const std::string kReservoirMaxTemporalM = "reservoirMaxTemporalM";
+const std::string kLightVisibilityRefresh = "lightVisibilityRefresh";
+const std::string kUpdateInterval = "updateInterval";
+const std::string kUpdateVarianceThreshold = "updateVarianceThreshold";
+const std::string kShortMeanWindow = "shortMeanWindow";
+const std::string kFixedGridCenter = "fixedGridCenter";
+const std::string kGridCenter = "gridCenter";
+const std::string kMaxFrameIndex = "maxFrameIndex";
+const std::string kBatchMode = "batchMode";
+const std::string kBatchCheckInterval = "batchCheckInterval";
+const std::string kBatchVarianceThreshold = "batchVarianceThreshold";
+const std::string kBatchMinIterationCount = "batchMinIterationCount";
+const std::string kBatchMaxIterationCount = "batchMaxIterationCount";
+const std::string kBatchStableIterationCount = "batchStableIterationCount";
+const std::string kRegionStreaming = "regionStreaming";
+const std::string kRegionSize = "regionSize";
+const std::string kRegionCacheSize = "regionCacheSize";
+const std::string kRegionSpillPath = "regionSpillPath";
+const std::string kHistogramExportPath = "histogramExportPath";
+
+// Static params.
+const std::string kSurfelTargetArea = "surfelTargetArea";
+const std::string kCellUnit = "cellUnit";
+const std::string kCellDim = "cellDim";
+const std::string kPerCellSurfelLimit = "perCellSurfelLimit";
+const std::string kUseSurfelRadiance = "useSurfelRadiance";
+const std::string kLimitSurfelSearch = "limitSurfelSearch";
+const std::string kMaxSurfelForStep = "maxSurfelForStep";
+const std::string kUseRayGuiding = "useRayGuiding";
+const std::string kUseLightReservoir = "useLightReservoir";
+const std::string kUseEmissiveSampling = "useEmissiveSampling";
+const std::string kEmissiveSampler = "emissiveSampler";
+const std::string kUseSurfelDepth = "useSurfelDepth";
+const std::string kUseIrradianceSharing = "useIrradianceSharing";
+const std::string kDeterministic = "deterministic";
+const std::string kUseInstrumentation = "useInstrumentation";
+const std::string kUseLightVisibilityCache = "useLightVisibilityCache";
+
+template<typename T>
+bool clampParam(const std::string& name, T& value, T minValue, T maxValue)
+{
+    // Negated comparison so that NaN is also replaced.
+    if (!(value >= minValue))
+    {
+        logWarning("SurfelGI: '{}' is below minimum {}, clamped.", name, minValue);
+        value = minValue;
+        return false;
+    }
+    if (!(value <= maxValue))
+    {
+        logWarning("SurfelGI: '{}' is above maximum {}, clamped.", name, maxValue);
+        value = maxValue;
+        return false;
+    }
+    return true;
+}
+
+void writeStaticParams(Properties& props, const SurfelGIStaticParams& s)
+{
+    props[kSurfelTargetArea] = s.surfelTargetArea;
+    props[kCellUnit] = s.cellUnit;
+    props[kCellDim] = s.cellDim;
+    props[kPerCellSurfelLimit] = s.perCellSurfelLimit;
+    props[kUseSurfelRadiance] = s.useSurfelRadinace;
+    props[kLimitSurfelSearch] = s.limitSurfelSearch;
+    props[kMaxSurfelForStep] = s.maxSurfelForStep;
+    props[kUseRayGuiding] = s.useRayGuiding;
+    props[kUseLightReservoir] = s.useLightReservoir;
+    props[kUseEmissiveSampling] = s.useEmissiveSampling;
+    props[kEmissiveSampler] = s.emissiveSampler;
+    props[kUseSurfelDepth] = s.useSurfelDepth;
+    props[kUseIrradianceSharing] = s.useIrradianceSharing;
+    props[kDeterministic] = s.deterministic;
+    props[kUseInstrumentation] = s.useInstrumentation;
+    props[kUseLightVisibilityCache] = s.useLightVisibilityCache;
+}
+
+} // namespace
+
+bool SurfelGIRuntimeParams::validate()
+{
+    bool valid = true;
+
+    valid &= clampParam(kChanceMultiply, chanceMultiply, 0.f, 1.f);
+    valid &= clampParam(kChancePower, chancePower, 0u, 8u);
+    valid &= clampParam(kPlacementThreshold, placementThreshold, 0.f, 10.f);
+    valid &= clampParam(kRemovalThreshold, removalThreshold, placementThreshold, 20.f);
+    thresholdGap = removalThreshold - placementThreshold;
+    valid &= clampParam(kBlendingDelay, blendingDelay, 0u, 2048u);
+
+    valid &= clampParam(kVarianceSensitivity, varianceSensitivity, 0.1f, 100.f);
+    valid &= clampParam(kMaxRayCount, maxRayCount, 1u, 256u);
+    valid &= clampParam(kMinRayCount, minRayCount, 0u, maxRayCount);
+    valid &= clampParam(kMaxStep, maxStep, 1u, 100u);
+    valid &= clampParam(kRayStep, rayStep, 0u, maxStep);
+
+    valid &= clampParam(kReservoirCandidateCount, reservoirCandidateCount, 1u, 32u);
+    valid &= clampParam(kReservoirSpatialCount, reservoirSpatialCount, 0u, 8u);
+    valid &= clampParam(kReservoirMaxTemporalM, reservoirMaxTemporalM, 1.f, 100.f);
+
+    valid &= clampParam(kLightVisibilityRefresh, lightVisibilityRefresh, 0.01f, 1.f);
+
+    valid &= clampParam(kUpdateInterval, updateInterval, 1u, 64u);
+    valid &= clampParam(kUpdateVarianceThreshold, updateVarianceThreshold, 0.f, 1.f);
+
+    valid &= clampParam(kShortMeanWindow, shortMeanWindow, 0.01f, 0.5f);
+
+    valid &= clampParam(kBatchCheckInterval, batchCheckInterval, 1u, 16u);
+    valid &= clampParam(kBatchVarianceThreshold, batchCriteria.varianceThreshold, 0.f, 1.f);
+    valid &= clampParam(kBatchMaxIterationCount, batchCriteria.maxIterationCount, 1u, kMaxBatchIterationCount);
+    valid &= clampParam(kBatchMinIterationCount, batchCriteria.minIterationCount, 1u, batchCriteria.maxIterationCount);
+    valid &= clampParam(kBatchStableIterationCount, batchCriteria.stableIterationCount, 1u, 16u);
+
+    valid &= clampParam(kRegionSize, regionSize, 0.1f, 10000.f);
+    valid &= clampParam(kRegionCacheSize, regionCacheSize, 1u, 65536u);
+
+    return valid;
+}
+
+bool SurfelGIStaticParams::validate()
+{
+    bool valid = true;
+
+    valid &= clampParam(kSurfelTargetArea, surfelTargetArea, 200u, 80000u);
+    valid &= clampParam(kCellUnit, cellUnit, 0.005f, 100.f);
+    valid &= clampParam(kCellDim, cellDim, 25u, 1000u);
+    cellCount = cellDim * cellDim * cellDim;
+    valid &= clampParam(kPerCellSurfelLimit, perCellSurfelLimit, 2u, 1024u);
+    valid &= clampParam(kMaxSurfelForStep, maxSurfelForStep, 1u, 100u);
+
+    // Same choices as UI dropdown.
+    if (emissiveSampler != EmissiveLightSamplerType::Uniform && emissiveSampler != EmissiveLightSamplerType::Power)
+    {
+        logWarning("SurfelGI: '{}' supports only Uniform and Power, using Power.", kEmissiveSampler);
+        emissiveSampler = EmissiveLightSamplerType::Power;
+        valid = false;
+    }
+
+    return valid;
+}
+
+Falcor::DefineList SurfelGIStaticParams::getDefines() const
+{
+    DefineList defines;
+
+    defines.add("SURFEL_TARGET_AREA", std::to_string(surfelTargetArea));
+    defines.add("CELL_UNIT", std::to_string(cellUnit));
+    defines.add("CELL_DIM", std::to_string(cellDim));
+    defines.add("CELL_COUNT", std::to_string(cellCount));
+    defines.add("PER_CELL_SURFEL_LIMIT", std::to_string(perCellSurfelLimit));
+
+    if (useSurfelRadinace)
+        defines.add("USE_SURFEL_RADIANCE");
+
+    if (limitSurfelSearch)
+        defines.add("LIMIT_SURFEL_SEARCH");
+
+    defines.add("MAX_SURFEL_FOR_STEP", std::to_string(maxSurfelForStep));
+
+    if (useRayGuiding)
+        defines.add("USE_RAY_GUIDING");
+
+    if (useLightReservoir)
+        defines.add("USE_LIGHT_RESERVOIR");
+
+    if (useSurfelDepth)
+        defines.add("USE_SURFEL_DEPTH");
+
+    if (useIrradianceSharing)
+        defines.add("USE_IRRADIANCE_SHARING");
+
+    if (deterministic)
+        defines.add("DETERMINISTIC");
+
+    if (useInstrumentation)
+        defines.add("USE_INSTRUMENTATION");
+
+    if (isLightVisibilityCacheEnabled())
+        defines.add("USE_LIGHT_VISIBILITY_CACHE");
+
+    return defines;
+}
+
+bool SurfelGIStaticParams::operator==(const SurfelGIStaticParams& other) const
+{
+    return surfelTargetArea == other.surfelTargetArea && cellUnit == other.cellUnit && cellDim == other.cellDim &&
+           perCellSurfelLimit == other.perCellSurfelLimit && useSurfelRadinace == other.useSurfelRadinace &&
+           limitSurfelSearch == other.limitSurfelSearch && maxSurfelForStep == other.maxSurfelForStep &&
+           useRayGuiding == other.useRayGuiding && useLightReservoir == other.useLightReservoir &&
+           useEmissiveSampling == other.useEmissiveSampling && emissiveSampler == other.emissiveSampler &&
+           useSurfelDepth == other.useSurfelDepth && useIrradianceSharing == other.useIrradianceSharing &&
+           deterministic == other.deterministic && useInstrumentation == other.useInstrumentation &&
+           useLightVisibilityCache == other.useLightVisibilityCache;
+}
+
+bool SurfelGIStaticParams::isSurfelResetRequired(const SurfelGIStaticParams& prev) const
+{
+    return useLightReservoir != prev.useLightReservoir ||
+           isLightVisibilityCacheEnabled() != prev.isLightVisibilityCacheEnabled() || deterministic != prev.deterministic;
+}
+
+bool parseSurfelGIProperties(const Properties& props, SurfelGIRuntimeParams& runtimeParams, SurfelGIStaticParams& staticParams)
+{
+    auto& r = runtimeParams;
+    auto& s = staticParams;
+    bool valid = true;
+
+    for (const auto& [key, value] : props)
+    {
+        // Runtime params.
+        if (key == kChanceMultiply) r.chanceMultiply = value;
+        else if (key == kChancePower) r.chancePower = value;
+        else if (key == kPlacementThreshold) r.placementThreshold = value;
+        else if (key == kRemovalThreshold) r.removalThreshold = value;
+        else if (key == kBlendingDelay) r.blendingDelay = value;
+        else if (key == kOverlayMode) r.overlayMode = value;
+        else if (key == kOutputFormat) r.outputFormat = value;
+        else if (key == kVarianceSensitivity) r.varianceSensitivity = value;
+        else if (key == kMinRayCount) r.minRayCount = value;
+        else if (key == kMaxRayCount) r.maxRayCount = value;
+        else if (key == kRayStep) r.rayStep = value;
+        else if (key == kMaxStep) r.maxStep = value;
+        else if (key == kReservoirCandidateCount) r.reservoirCandidateCount = value;
+        else if (key == kReservoirSpatialCount) r.reservoirSpatialCount = value;
+        else if (key == kReservoirMaxTemporalM) r.reservoirMaxTemporalM = value;
+        else if (key == kLightVisibilityRefresh) r.lightVisibilityRefresh = value;
+        else if (key == kUpdateInterval) r.updateInterval = value;
+        else if (key == kUpdateVarianceThreshold) r.updateVarianceThreshold = value;
+        else if (key == kShortMeanWindow) r.shortMeanWindow = value;
+        else if (key == kFixedGridCenter) r.fixedGridCenter = value;
+        else if (key == kGridCenter) r.gridCenter = value;
+        else if (key == kMaxFrameIndex) r.maxFrameIndex = value;
+        else if (key == kBatchMode) r.batchMode = value;
+        else if (key == kBatchCheckInterval) r.batchCheckInterval = value;
+        else if (key == kBatchVarianceThreshold) r.batchCriteria.varianceThreshold = value;
+        else if (key == kBatchMinIterationCount) r.batchCriteria.minIterationCount = value;
+        else if (key == kBatchMaxIterationCount) r.batchCriteria.maxIterationCount = value;
+        else if (key == kBatchStableIterationCount) r.batchCriteria.stableIterationCount = value;
+        else if (key == kRegionStreaming) r.regionStreaming = value;
+        else if (key == kRegionSize) r.regionSize = value;
+        else if (key == kRegionCacheSize) r.regionCacheSize = value;
+        else if (key == kRegionSpillPath) r.regionSpillPath = value.operator std::string();
+        else if (key == kHistogramExportPath) r.histogramExportPath = value.operator std::string();
+        // Static params.
+        else if (key == kSurfelTargetArea) s.surfelTargetArea = value;
+        else if (key == kCellUnit) s.cellUnit = value;
+        else if (key == kCellDim) s.cellDim = value;
+        else if (key == kPerCellSurfelLimit) s.perCellSurfelLimit = value;
+        else if (key == kUseSurfelRadiance) s.useSurfelRadinace = value;
+        else if (key == kLimitSurfelSearch) s.limitSurfelSearch = value;
+        else if (key == kMaxSurfelForStep) s.maxSurfelForStep = value;
+        else if (key == kUseRayGuiding) s.useRayGuiding = value;
+        else if (key == kUseLightReservoir) s.useLightReservoir = value;
+        else if (key == kUseEmissiveSampling) s.useEmissiveSampling = value;
+        else if (key == kEmissiveSampler) s.emissiveSampler = value;
+        else if (key == kUseSurfelDepth) s.useSurfelDepth = value;
+        else if (key == kUseIrradianceSharing) s.useIrradianceSharing = value;
+        else if (key == kDeterministic) s.deterministic = value;
+        else if (key == kUseInstrumentation) s.useInstrumentation = value;
+        else if (key == kUseLightVisibilityCache) s.useLightVisibilityCache = value;
+        else
+        {
+            logWarning("Unknown property '{}' in SurfelGI properties.", key);
+            valid = false;
+        }
+    }
+
+    // Removal threshold follows placement threshold if only the latter is given, as UI does.
+    if (props.has(kPlacementThreshold) && !props.has(kRemovalThreshold))
+        r.removalThreshold = r.placementThreshold + r.thresholdGap;
+
+    valid &= r.validate();
+    valid &= s.validate();
+
+    return valid;
+}
+
+Properties getSurfelGIProperties(const SurfelGIRuntimeParams& runtimeParams, const SurfelGIStaticParams& staticParams)
+{
+    const auto& r = runtimeParams;
+    Properties props;
+
+    props[kChanceMultiply] = r.chanceMultiply;
+    props[kChancePower] = r.chancePower;
+    props[kPlacementThreshold] = r.placementThreshold;
+    props[kRemovalThreshold] = r.removalThreshold;
+    props[kBlendingDelay] = r.blendingDelay;
+    props[kOverlayMode] = r.overlayMode;
+    props[kOutputFormat] = r.outputFormat;
+    props[kVarianceSensitivity] = r.varianceSensitivity;
+    props[kMinRayCount] = r.minRayCount;
+    props[kMaxRayCount] = r.maxRayCount;
+    props[kRayStep] = r.rayStep;
+    props[kMaxStep] = r.maxStep;
+    props[kReservoirCandidateCount] = r.reservoirCandidateCount;
+    props[kReservoirSpatialCount] = r.reservoirSpatialCount;
+    props[kReservoirMaxTemporalM] = r.reservoirMaxTemporalM;
+    props[kLightVisibilityRefresh] = r.lightVisibilityRefresh;
+    props[kUpdateInterval] = r.updateInterval;
+    props[kUpdateVarianceThreshold] = r.updateVarianceThreshold;
+    props[kShortMeanWindow] = r.shortMeanWindow;
+    props[kFixedGridCenter] = r.fixedGridCenter;
+    if (r.fixedGridCenter)
+        props[kGridCenter] = r.gridCenter;
+    props[kMaxFrameIndex] = r.maxFrameIndex;
+    props[kBatchMode] = r.batchMode;
+    props[kBatchCheckInterval] = r.batchCheckInterval;
+    props[kBatchVarianceThreshold] = r.batchCriteria.varianceThreshold;
+    props[kBatchMinIterationCount] = r.batchCriteria.minIterationCount;
+    props[kBatchMaxIterationCount] = r.batchCriteria.maxIterationCount;
+    props[kBatchStableIterationCount] = r.batchCriteria.stableIterationCount;
+    props[kRegionStreaming] = r.regionStreaming;
+    props[kRegionSize] = r.regionSize;
+    props[kRegionCacheSize] = r.regionCacheSize;
+    if (!r.regionSpillPath.empty())
+        props[kRegionSpillPath] = r.regionSpillPath;
+    if (!r.histogramExportPath.empty())
+        props[kHistogramExportPath] = r.histogramExportPath;
+
+    writeStaticParams(props, staticParams);
+
+    return props;
+}
+
+Properties getSurfelGIStaticProperties(const SurfelGIStaticParams& staticParams)
+{
+    Properties props;
+    writeStaticParams(props, staticParams);
+    return props;
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "Falcor.h"
+#include "Rendering/Lights/EmissiveLightSamplerType.slangh"
+#include "OverlayMode.slang"
+#include "ConvergenceMonitor.h"
+#include "RadianceFormat.h"
+
+using namespace Falcor;
+
+// Parameters of SurfelGI, and their conversion from / to render pass properties.
+// Nothing here needs device or scene, so parsing and validation can be checked on host.
+
+struct SurfelGIRuntimeParams
+{
+    // Surfel generation.
+    float chanceMultiply = 0.3f;
+    uint chancePower = 1;
+    float placementThreshold = 2.f;
+    float removalThreshold = 4.f;
+    float thresholdGap = 2.f;
+    uint blendingDelay = 240;
+    Falcor::OverlayMode overlayMode = Falcor::OverlayMode::IndirectLighting;
+
+    // Output.
+    RadianceFormat outputFormat = RadianceFormat::RGBA32Float;  ///< Changing it re-compiles render graph.
+
+    // Ray tracing.
+    float varianceSensitivity = 40.f;
+    uint minRayCount = 4u;
+    uint maxRayCount = 64u;
+    uint rayStep = 3;
+    uint maxStep = 6;
+
+    // Light reservoir.
+    uint reservoirCandidateCount = 4u;
+    uint reservoirSpatialCount = 2u;
+    float reservoirMaxTemporalM = 20.f;
+
+    // Light visibility cache.
+    float lightVisibilityRefresh = 0.125f;  ///< Probability that stable cached visibility is traced again.
+
+    // Update schedule.
+    // Converged, off-screen or sleeping surfels are updated once per interval frames. 1 updates every surfel every frame.
+    uint updateInterval = 1u;
+    float updateVarianceThreshold = 0.1f;   ///< Scaled by variance sensitivity, as ray allocation is.
+
+    // Integrate.
+    float shortMeanWindow = 0.03f;
+
+    // Cell grid.
+    bool fixedGridCenter = false;
+    float3 gridCenter = float3(0.f);
+
+    // Surfel radiance is not integrated after this frame.
+    uint maxFrameIndex = 1000000;
+
+    // Batch mode.
+    // Run ray trace + integrate iterations until converged, and write output once per execute.
+    bool batchMode = false;
+    uint batchCheckInterval = 4u;
+    ConvergenceMonitor::Criteria batchCriteria;
+
+    // Region streaming.
+    // Surfels left outside cell window are kept on host per world region, and restored when the window comes back.
+    bool regionStreaming = false;
+    float regionSize = 16.f;
+    uint regionCacheSize = 256u;    ///< MB of host memory. Least recently used regions beyond it are spilled.
+    std::string regionSpillPath;    ///< File which spilled regions are written to. Dropped if empty.
+
+    // Histograms of instrumentation, written periodically as CSV if path is given.
+    std::string histogramExportPath;
+
+    // Clamp values to the ranges UI allows. Returns false if any value was changed.
+    bool validate();
+};
+
+struct SurfelGIStaticParams
+{
+    uint surfelTargetArea = 40000;
+    float cellUnit = 0.05f;
+    uint cellDim = 250u;
+    uint cellCount = cellDim * cellDim * cellDim;
+    uint perCellSurfelLimit = 1024u;
+
+    bool useSurfelRadinace = true;
+    bool limitSurfelSearch = false;
+    uint maxSurfelForStep = 10;
+    bool useRayGuiding = false;
+    bool useLightReservoir = false;
+    bool useEmissiveSampling = false;
+    EmissiveLightSamplerType emissiveSampler = EmissiveLightSamplerType::Power;
+    bool useSurfelDepth = true;
+    bool useIrradianceSharing = true;
+    bool deterministic = false;
+    bool useInstrumentation = false;
+    bool useLightVisibilityCache = false;
+
+    // Clamp values to the ranges UI allows, and update derived values. Returns false if any value was changed.
+    bool validate();
+
+    // Cached visibility is written by racing rays of same surfel, so it is off in deterministic mode.
+    bool isLightVisibilityCacheEnabled() const { return useLightVisibilityCache && !deterministic; }
+
+    // Surfels are placed in world space and stay valid with most params. Returns true if switching from previous params
+    // changes what is cached per surfel, or deterministic mode, which must start from empty cache to be reproducible.
+    bool isSurfelResetRequired(const SurfelGIStaticParams& prev) const;
+
+    DefineList getDefines() const;
+
+    bool operator==(const SurfelGIStaticParams& other) const;
+    bool operator!=(const SurfelGIStaticParams& other) const { return !(*this == other); }
+};
+
+// Parse properties into params, then validate them.
+// Keys not given keep current value. Returns false if there was unknown key or value out of range.
+bool parseSurfelGIProperties(const Properties& props, SurfelGIRuntimeParams& runtimeParams, SurfelGIStaticParams& staticParams);
+
+Properties getSurfelGIProperties(const SurfelGIRuntimeParams& runtimeParams, const SurfelGIStaticParams& staticParams);
+
+// Static params only. Identifies a shader permutation, e.g. for pre-warming.
+Properties getSurfelGIStaticProperties(const SurfelGIStaticParams& staticParams);
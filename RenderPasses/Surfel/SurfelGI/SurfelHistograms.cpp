@@ -0,0 +1,138 @@
+#include "SurfelHistograms.h"
+#include <climits>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+const char* kFinalizeOutcomeNames[] = {"Hit", "Miss", "SkippedDense", "SkippedRandom", "SleepingSpawn", "InvalidCell"};
+
+} // namespace
+
+const char* SurfelHistograms::getName(SurfelHistogramType type)
+{
+    switch (type)
+    {
+    case SurfelHistogramType::CellOccupancy:
+        return "CellOccupancy";
+    case SurfelHistogramType::RayStep:
+        return "RayStep";
+    case SurfelHistogramType::FinalizeOutcome:
+        return "FinalizeOutcome";
+    case SurfelHistogramType::SurfelRayCount:
+        return "SurfelRayCount";
+    case SurfelHistogramType::SurfelAge:
+        return "SurfelAge";
+    default:
+        return "Unknown";
+    }
+}
+
+bool SurfelHistograms::isLog2(SurfelHistogramType type)
+{
+    return type == SurfelHistogramType::CellOccupancy || type == SurfelHistogramType::SurfelRayCount ||
+           type == SurfelHistogramType::SurfelAge;
+}
+
+uint SurfelHistograms::getBin(SurfelHistogramType type, uint value)
+{
+    if (!isLog2(type))
+        return std::min(value, kHistogramBinCount - 1);
+
+    uint bin = 0;
+    while (value > 0)
+    {
+        value >>= 1;
+        bin++;
+    }
+    return std::min(bin, kHistogramBinCount - 1);
+}
+
+uint2 SurfelHistograms::getBinRange(SurfelHistogramType type, uint bin)
+{
+    const bool last = bin == kHistogramBinCount - 1;
+
+    if (!isLog2(type))
+        return uint2(bin, last ? UINT_MAX : bin);
+
+    if (bin == 0)
+        return uint2(0, 0);
+
+    return uint2(1u << (bin - 1), last ? UINT_MAX : (1u << bin) - 1);
+}
+
+std::string SurfelHistograms::getBinLabel(SurfelHistogramType type, uint bin)
+{
+    if (type == SurfelHistogramType::FinalizeOutcome)
+        return bin < (uint)FinalizeOutcome::Count ? kFinalizeOutcomeNames[bin] : "Unknown";
+
+    const uint2 range = getBinRange(type, bin);
+    if (range.y == UINT_MAX)
+        return std::to_string(range.x) + "+";
+    if (range.x == range.y)
+        return std::to_string(range.x);
+    return std::to_string(range.x) + "-" + std::to_string(range.y);
+}
+
+void SurfelHistograms::clear()
+{
+    mCounts.fill(0);
+    mFrameCount = 0;
+}
+
+void SurfelHistograms::accumulate(const uint* pBins)
+{
+    for (uint i = 0; i < kHistogramBufferCount; ++i)
+        mCounts[i] += pBins[i];
+
+    mFrameCount++;
+}
+
+uint64_t SurfelHistograms::getTotal(SurfelHistogramType type) const
+{
+    uint64_t total = 0;
+    for (uint bin = 0; bin < kHistogramBinCount; ++bin)
+        total += getCount(type, bin);
+    return total;
+}
+
+uint SurfelHistograms::getUsedBinCount(SurfelHistogramType type) const
+{
+    uint count = 0;
+    for (uint bin = 0; bin < kHistogramBinCount; ++bin)
+    {
+        if (getCount(type, bin) > 0)
+            count = bin + 1;
+    }
+    return count;
+}
+
+std::string SurfelHistograms::toCsv() const
+{
+    std::ostringstream csv;
+    csv << "histogram,bin,label,count\n";
+
+    for (uint i = 0; i < (uint)SurfelHistogramType::Count; ++i)
+    {
+        const SurfelHistogramType type = (SurfelHistogramType)i;
+        for (uint bin = 0; bin < kHistogramBinCount; ++bin)
+        {
+            const uint64_t count = getCount(type, bin);
+            if (count > 0)
+                csv << getName(type) << "," << bin << "," << getBinLabel(type, bin) << "," << count << "\n";
+        }
+    }
+
+    return csv.str();
+}
+
+bool SurfelHistograms::save(const std::filesystem::path& path) const
+{
+    std::ofstream stream(path);
+    if (!stream)
+        return false;
+
+    stream << "# frames," << mFrameCount << "\n" << toCsv();
+    return (bool)stream;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Falcor.h"
+#include "SurfelHistogram.slang"
+#include <array>
+#include <filesystem>
+
+using namespace Falcor;
+
+// Histograms of instrumentation buffer, accumulated over frames on host.
+// Binning is same as SurfelInstrumentation.slang, so that bins can be labeled without device.
+class SurfelHistograms
+{
+public:
+    static const char* getName(SurfelHistogramType type);
+    static bool isLog2(SurfelHistogramType type);
+    static uint getBin(SurfelHistogramType type, uint value);
+
+    // Value range [lower, upper] of bin. Last bin has no upper bound.
+    static uint2 getBinRange(SurfelHistogramType type, uint bin);
+    // Outcome name for finalize outcomes, value range otherwise, e.g. "4-7" or "32+".
+    static std::string getBinLabel(SurfelHistogramType type, uint bin);
+
+    void clear();
+
+    // Add one frame of instrumentation buffer, kHistogramBufferCount bins.
+    void accumulate(const uint* pBins);
+
+    uint64_t getCount(SurfelHistogramType type, uint bin) const { return mCounts[(uint)type * kHistogramBinCount + bin]; }
+    uint64_t getTotal(SurfelHistogramType type) const;
+    uint getFrameCount() const { return mFrameCount; }
+
+    // Index of last non-empty bin plus one, for plotting.
+    uint getUsedBinCount(SurfelHistogramType type) const;
+
+    // One row per non-empty bin: "histogram,bin,label,count". Counts are summed over frames.
+    std::string toCsv() const;
+    bool save(const std::filesystem::path& path) const;
+
+private:
+    std::array<uint64_t, kHistogramBufferCount> mCounts = {};
+    uint mFrameCount = 0;
+};
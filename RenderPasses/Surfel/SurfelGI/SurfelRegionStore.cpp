@@ -0,0 +1,271 @@
+#include "SurfelRegionStore.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+struct RegionHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t recordCount;
+};
+
+const uint32_t kRegionMagic = 0x47524653; // "SFRG"
+const uint32_t kRegionVersion = 1;
+
+} // namespace
+
+void SurfelRegionStore::configure(float regionSize, uint64_t memoryBudget, const std::filesystem::path& spillPath)
+{
+    // Regions of different size or spill file of different path cannot be looked up anymore.
+    if (regionSize != mRegionSize || spillPath != mSpillPath)
+    {
+        mRegionSize = regionSize;
+        mSpillPath = spillPath;
+        clear();
+    }
+
+    mMemoryBudget = memoryBudget;
+    evict();
+}
+
+void SurfelRegionStore::clear()
+{
+    mRegions.clear();
+    mLru.clear();
+    mStats = {};
+    mSpillFailed = false;
+
+    if (mSpillFile.is_open())
+    {
+        mSpillFile.close();
+
+        std::error_code ec;
+        std::filesystem::remove(mSpillPath, ec);
+    }
+}
+
+void SurfelRegionStore::store(const SurfelRegionRecord* pRecords, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const int3 regionPos = getRegion(pRecords[i].surfel.position);
+        const uint64_t key = getRegionKey(regionPos);
+
+        auto [it, inserted] = mRegions.try_emplace(key);
+        Region& region = it->second;
+
+        if (inserted)
+        {
+            region.region = regionPos;
+            mLru.push_front(key);
+            region.lruIt = mLru.begin();
+        }
+        else if (region.spilled)
+        {
+            // Read back to append, so that region stays in one piece.
+            unspill(region);
+        }
+        else
+        {
+            touch(region);
+        }
+
+        region.records.push_back(pRecords[i]);
+        mStats.residentSize += sizeof(SurfelRegionRecord);
+    }
+
+    evict();
+}
+
+uint SurfelRegionStore::take(const float3& boxMin, const float3& boxMax, std::vector<SurfelRegionRecord>& records)
+{
+    const int3 minRegion = getRegion(boxMin);
+    const int3 maxRegion = getRegion(boxMax);
+
+    std::vector<Region*> taken;
+    for (auto& [key, region] : mRegions)
+    {
+        const int3& r = region.region;
+        if (r.x >= minRegion.x && r.y >= minRegion.y && r.z >= minRegion.z && r.x <= maxRegion.x && r.y <= maxRegion.y &&
+            r.z <= maxRegion.z)
+            taken.push_back(&region);
+    }
+
+    // Hash map order is not stable. Sorted, so that restored surfels get same slots at every run.
+    std::sort(
+        taken.begin(),
+        taken.end(),
+        [](const Region* a, const Region* b)
+        {
+            if (a->region.x != b->region.x)
+                return a->region.x < b->region.x;
+            if (a->region.y != b->region.y)
+                return a->region.y < b->region.y;
+            return a->region.z < b->region.z;
+        }
+    );
+
+    for (Region* pRegion : taken)
+    {
+        if (pRegion->spilled)
+            unspill(*pRegion);
+
+        records.insert(records.end(), pRegion->records.begin(), pRegion->records.end());
+
+        mStats.residentSize -= pRegion->records.size() * sizeof(SurfelRegionRecord);
+        mLru.erase(pRegion->lruIt);
+        mRegions.erase(getRegionKey(pRegion->region));
+    }
+
+    mStats.residentRegionCount = (uint)mLru.size();
+    return (uint)taken.size();
+}
+
+int3 SurfelRegionStore::getRegion(const float3& posW) const
+{
+    return int3(
+        (int)std::floor(posW.x / mRegionSize), (int)std::floor(posW.y / mRegionSize), (int)std::floor(posW.z / mRegionSize)
+    );
+}
+
+std::vector<uint8_t> SurfelRegionStore::serialize(const std::vector<SurfelRegionRecord>& records)
+{
+    const RegionHeader header = {kRegionMagic, kRegionVersion, (uint32_t)sizeof(SurfelRegionRecord), (uint32_t)records.size()};
+    const size_t recordBytes = records.size() * sizeof(SurfelRegionRecord);
+
+    std::vector<uint8_t> data(sizeof(RegionHeader) + recordBytes);
+    std::memcpy(data.data(), &header, sizeof(RegionHeader));
+    if (recordBytes > 0)
+        std::memcpy(data.data() + sizeof(RegionHeader), records.data(), recordBytes);
+
+    return data;
+}
+
+bool SurfelRegionStore::deserialize(const uint8_t* pData, size_t size, std::vector<SurfelRegionRecord>& records)
+{
+    if (size < sizeof(RegionHeader))
+        return false;
+
+    RegionHeader header;
+    std::memcpy(&header, pData, sizeof(RegionHeader));
+
+    if (header.magic != kRegionMagic || header.version != kRegionVersion || header.recordSize != sizeof(SurfelRegionRecord))
+        return false;
+
+    const size_t recordBytes = (size_t)header.recordCount * sizeof(SurfelRegionRecord);
+    if (size - sizeof(RegionHeader) < recordBytes)
+        return false;
+
+    const size_t offset = records.size();
+    records.resize(offset + header.recordCount);
+    if (recordBytes > 0)
+        std::memcpy(records.data() + offset, pData + sizeof(RegionHeader), recordBytes);
+
+    return true;
+}
+
+uint64_t SurfelRegionStore::getRegionKey(const int3& region)
+{
+    // 21 bits per axis.
+    const uint64_t mask = (1u << 21) - 1;
+    return ((uint64_t)(region.x & mask) << 42) | ((uint64_t)(region.y & mask) << 21) | (uint64_t)(region.z & mask);
+}
+
+void SurfelRegionStore::touch(Region& region)
+{
+    mLru.splice(mLru.begin(), mLru, region.lruIt);
+    region.lruIt = mLru.begin();
+}
+
+void SurfelRegionStore::evict()
+{
+    while (mStats.residentSize > mMemoryBudget && !mLru.empty())
+    {
+        const uint64_t key = mLru.back();
+        mLru.pop_back();
+
+        Region& region = mRegions.at(key);
+        mStats.residentSize -= region.records.size() * sizeof(SurfelRegionRecord);
+
+        if (!spill(region))
+        {
+            mStats.droppedRecordCount += region.records.size();
+            mRegions.erase(key);
+        }
+    }
+
+    mStats.residentRegionCount = (uint)mLru.size();
+}
+
+bool SurfelRegionStore::spill(Region& region)
+{
+    if (mSpillPath.empty() || mSpillFailed)
+        return false;
+
+    if (!mSpillFile.is_open())
+    {
+        mSpillFile.open(mSpillPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!mSpillFile.is_open())
+        {
+            logWarning("SurfelGI: Failed to open region spill file '{}', regions over budget are dropped.", mSpillPath.string());
+            mSpillFailed = true;
+            return false;
+        }
+    }
+
+    // Spill file is only appended to. Space of regions taken back is reclaimed at clear.
+    const std::vector<uint8_t> data = serialize(region.records);
+
+    mSpillFile.seekp((std::streamoff)mStats.spillFileSize);
+    mSpillFile.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    if (!mSpillFile)
+    {
+        mSpillFile.clear();
+        return false;
+    }
+
+    region.spilled = true;
+    region.fileOffset = mStats.spillFileSize;
+    region.fileSize = data.size();
+    region.records.clear();
+    region.records.shrink_to_fit();
+
+    mStats.spillFileSize += data.size();
+    mStats.spilledRegionCount++;
+
+    return true;
+}
+
+bool SurfelRegionStore::unspill(Region& region)
+{
+    std::vector<uint8_t> data(region.fileSize);
+
+    mSpillFile.seekg((std::streamoff)region.fileOffset);
+    mSpillFile.read(reinterpret_cast<char*>(data.data()), (std::streamsize)data.size());
+
+    bool valid = (bool)mSpillFile;
+    mSpillFile.clear();
+
+    region.records.clear();
+    valid = valid && deserialize(data.data(), data.size(), region.records);
+    if (!valid)
+        logWarning(
+            "SurfelGI: Failed to read region ({}, {}, {}) from spill file, its surfels are lost.",
+            region.region.x,
+            region.region.y,
+            region.region.z
+        );
+
+    region.spilled = false;
+    mStats.spilledRegionCount--;
+    mStats.residentSize += region.records.size() * sizeof(SurfelRegionRecord);
+
+    mLru.push_front(getRegionKey(region.region));
+    region.lruIt = mLru.begin();
+
+    return valid;
+}
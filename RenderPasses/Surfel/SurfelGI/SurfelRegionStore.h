@@ -0,0 +1,75 @@
+#pragma once
+#include "Falcor.h"
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <unordered_map>
+
+using namespace Falcor;
+
+// MSMEData is declared outside of Falcor namespace, so types must be visible before include.
+#include "SurfelTypes.slang"
+
+// Surfels which left cell window, kept per world region so that their radiance survives until the region comes back.
+// Regions are kept in host memory up to budget. Least recently used regions beyond it are written to spill file,
+// or dropped if there is none.
+class SurfelRegionStore
+{
+public:
+    struct Stats
+    {
+        uint residentRegionCount = 0;
+        uint spilledRegionCount = 0;
+        uint64_t residentSize = 0;      ///< Bytes of records in memory.
+        uint64_t spillFileSize = 0;     ///< Bytes written to spill file, including regions taken back since.
+        uint64_t droppedRecordCount = 0;
+    };
+
+    // Records stored before are kept only if region size is unchanged.
+    void configure(float regionSize, uint64_t memoryBudget, const std::filesystem::path& spillPath);
+    void clear();
+
+    // Append records to their regions, and evict least recently used regions over budget.
+    void store(const SurfelRegionRecord* pRecords, size_t count);
+
+    // Remove every region overlapping box, and append their records in region order.
+    // Returns number of regions taken.
+    uint take(const float3& boxMin, const float3& boxMax, std::vector<SurfelRegionRecord>& records);
+
+    int3 getRegion(const float3& posW) const;
+    float getRegionSize() const { return mRegionSize; }
+    const Stats& getStats() const { return mStats; }
+
+    // Header, then records as they are in GPU buffer.
+    static std::vector<uint8_t> serialize(const std::vector<SurfelRegionRecord>& records);
+    // Returns false if data is truncated, or written with different record layout.
+    static bool deserialize(const uint8_t* pData, size_t size, std::vector<SurfelRegionRecord>& records);
+
+private:
+    struct Region
+    {
+        int3 region;
+        std::vector<SurfelRegionRecord> records;
+        bool spilled = false;
+        uint64_t fileOffset = 0;
+        uint64_t fileSize = 0;
+        std::list<uint64_t>::iterator lruIt; ///< Valid while resident.
+    };
+
+    static uint64_t getRegionKey(const int3& region);
+
+    void touch(Region& region);
+    void evict();
+    bool spill(Region& region);
+    bool unspill(Region& region);
+
+    float mRegionSize = 16.f;
+    uint64_t mMemoryBudget = 256ull << 20;
+    std::filesystem::path mSpillPath;
+    std::fstream mSpillFile;
+    bool mSpillFailed = false;
+
+    std::unordered_map<uint64_t, Region> mRegions;
+    std::list<uint64_t> mLru; ///< Resident regions, most recently used at front.
+    Stats mStats;
+};
@@ -0,0 +1,119 @@
+#include "SurfelViewSet.h"
+
+SurfelViewSet::SurfelViewSet()
+{
+    for (uint i = 0; i < kMaxViewCount; ++i)
+        mViews[i].cameraIndex = i;
+
+    // Primary view is always enabled.
+    mViews[0].enabled = true;
+}
+
+void SurfelViewSet::setEnabled(uint viewIndex, bool enabled)
+{
+    FALCOR_ASSERT(viewIndex < kMaxViewCount);
+
+    if (viewIndex == 0 || mViews[viewIndex].enabled == enabled)
+        return;
+
+    mViews[viewIndex].enabled = enabled;
+    rebalance();
+}
+
+void SurfelViewSet::setCameraIndex(uint viewIndex, uint cameraIndex)
+{
+    FALCOR_ASSERT(viewIndex < kMaxViewCount);
+    mViews[viewIndex].cameraIndex = cameraIndex;
+}
+
+void SurfelViewSet::setUpdatePeriod(uint viewIndex, uint updatePeriod)
+{
+    FALCOR_ASSERT(viewIndex < kMaxViewCount);
+
+    // Primary view always spawns surfels.
+    if (viewIndex == 0)
+        return;
+
+    mViews[viewIndex].updatePeriod = std::max(1u, updatePeriod);
+    rebalance();
+}
+
+uint SurfelViewSet::getEnabledViewCount() const
+{
+    uint count = 0;
+    for (const auto& view : mViews)
+        count += view.enabled ? 1 : 0;
+
+    return count;
+}
+
+bool SurfelViewSet::isScheduled(uint viewIndex, uint frameIndex) const
+{
+    const View& view = mViews[viewIndex];
+    if (!view.enabled)
+        return false;
+
+    return (frameIndex + view.phase) % view.updatePeriod == 0;
+}
+
+std::vector<uint> SurfelViewSet::getScheduledViews(uint frameIndex) const
+{
+    std::vector<uint> scheduledViews;
+    for (uint i = 0; i < kMaxViewCount; ++i)
+    {
+        if (isScheduled(i, frameIndex))
+            scheduledViews.push_back(i);
+    }
+
+    return scheduledViews;
+}
+
+void SurfelViewSet::rebalance()
+{
+    // Count auxiliary views per update period, and give each one next phase.
+    std::map<uint, uint> periodUsage;
+    for (uint i = 1; i < kMaxViewCount; ++i)
+    {
+        View& view = mViews[i];
+        if (!view.enabled)
+            continue;
+
+        uint& usage = periodUsage[view.updatePeriod];
+        view.phase = usage % view.updatePeriod;
+        usage++;
+    }
+}
+
+bool SurfelViewSet::renderUI(Gui::Widgets& widget, uint cameraCount)
+{
+    bool changed = false;
+
+    for (uint i = 0; i < kMaxViewCount; ++i)
+    {
+        View& view = mViews[i];
+        if (!view.enabled)
+            continue;
+
+        const std::string label = "View " + std::to_string(i);
+        if (auto g = widget.group(label, true))
+        {
+            if (i == 0)
+            {
+                g.text("Follows active camera.");
+                continue;
+            }
+
+            if (cameraCount > 1)
+                changed |= g.slider("Camera index", view.cameraIndex, 0u, cameraCount - 1);
+
+            if (g.slider("Update period", view.updatePeriod, 1u, 16u))
+            {
+                rebalance();
+                changed = true;
+            }
+            g.tooltip("Spawn surfels once per given frames. Surfel radiance is gathered every frame.");
+        }
+    }
+
+    return changed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Falcor.h"
+
+using namespace Falcor;
+
+// MSMEData is declared outside of Falcor namespace, so types must be visible before include.
+#include "SurfelTypes.slang"
+
+// Set of views sharing one surfel cache.
+// View 0 is the primary view, which spawns surfels every frame.
+// Auxiliary views spawn surfels once per update period, and only gather surfel radiance for other frames.
+class SurfelViewSet
+{
+public:
+    struct View
+    {
+        bool enabled = false;
+        uint cameraIndex = 0;
+        uint updatePeriod = 1;
+        uint phase = 0;
+    };
+
+    SurfelViewSet();
+
+    void setEnabled(uint viewIndex, bool enabled);
+    void setCameraIndex(uint viewIndex, uint cameraIndex);
+    void setUpdatePeriod(uint viewIndex, uint updatePeriod);
+
+    const View& getView(uint viewIndex) const { return mViews[viewIndex]; }
+    uint getEnabledViewCount() const;
+
+    // Return true if view spawns surfels at given frame.
+    bool isScheduled(uint viewIndex, uint frameIndex) const;
+
+    // Return indices of views spawning surfels at given frame.
+    std::vector<uint> getScheduledViews(uint frameIndex) const;
+
+    // Spread phase of auxiliary views sharing same update period,
+    // so that spawning cost is distributed over frames.
+    void rebalance();
+
+    bool renderUI(Gui::Widgets& widget, uint cameraCount);
+
+private:
+    std::array<View, kMaxViewCount> mViews;
+};
@@ -0,0 +1,275 @@
+#include "CpuBvh.h"
+
+namespace
+{
+const uint kBinCount = 12;
+const uint kMaxLeafSize = 4;
+const uint kMaxStackSize = 64;
+
+struct Bounds
+{
+    float3 min = float3(FLT_MAX);
+    float3 max = float3(-FLT_MAX);
+
+    void grow(const float3& p)
+    {
+        min = math::min(min, p);
+        max = math::max(max, p);
+    }
+
+    void grow(const Bounds& b)
+    {
+        min = math::min(min, b.min);
+        max = math::max(max, b.max);
+    }
+
+    float area() const
+    {
+        const float3 e = max - min;
+        return (e.x < 0.f) ? 0.f : 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+// Entry and exit distance of ray with box. Returns FLT_MAX if missed.
+float intersectBounds(const float3& boundsMin, const float3& boundsMax, const float3& origin, const float3& invDir, float tMax)
+{
+    const float3 t0 = (boundsMin - origin) * invDir;
+    const float3 t1 = (boundsMax - origin) * invDir;
+    const float3 tNear = math::min(t0, t1);
+    const float3 tFar = math::max(t0, t1);
+
+    const float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+} // namespace
+
+void CpuBvh::build(const std::vector<float3>& vertices)
+{
+    const uint triangleCount = (uint)(vertices.size() / 3);
+
+    mNodes.clear();
+    mTriangles.clear();
+    mTriangleIndices.resize(triangleCount);
+    if (triangleCount == 0)
+        return;
+
+    std::vector<Bounds> triangleBounds(triangleCount);
+    std::vector<float3> centroids(triangleCount);
+    for (uint i = 0; i < triangleCount; ++i)
+    {
+        for (uint j = 0; j < 3; ++j)
+            triangleBounds[i].grow(vertices[i * 3 + j]);
+        centroids[i] = (vertices[i * 3] + vertices[i * 3 + 1] + vertices[i * 3 + 2]) / 3.f;
+        mTriangleIndices[i] = i;
+    }
+
+    // Upper bound of node count, so that references to nodes are not invalidated during build.
+    mNodes.reserve(triangleCount * 2);
+    mNodes.push_back({float3(0.f), 0, float3(0.f), triangleCount});
+
+    std::vector<uint> stack = {0};
+    while (!stack.empty())
+    {
+        const uint nodeIndex = stack.back();
+        stack.pop_back();
+
+        Node& node = mNodes[nodeIndex];
+        const uint first = node.leftOrFirst;
+        const uint count = node.count;
+
+        Bounds bounds, centroidBounds;
+        for (uint i = first; i < first + count; ++i)
+        {
+            bounds.grow(triangleBounds[mTriangleIndices[i]]);
+            centroidBounds.grow(centroids[mTriangleIndices[i]]);
+        }
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+
+        if (count <= kMaxLeafSize)
+            continue;
+
+        // Find split with lowest SAH cost over bins of centroid bounds.
+        float bestCost = FLT_MAX;
+        uint bestAxis = 0;
+        uint bestSplit = 0;
+
+        for (uint axis = 0; axis < 3; ++axis)
+        {
+            const float extentMin = centroidBounds.min[axis];
+            const float extent = centroidBounds.max[axis] - extentMin;
+            if (extent <= 0.f)
+                continue;
+
+            Bounds binBounds[kBinCount];
+            uint binCounts[kBinCount] = {};
+            const float scale = kBinCount / extent;
+
+            for (uint i = first; i < first + count; ++i)
+            {
+                const uint triangleIndex = mTriangleIndices[i];
+                const uint bin = std::min(kBinCount - 1, (uint)((centroids[triangleIndex][axis] - extentMin) * scale));
+                binBounds[bin].grow(triangleBounds[triangleIndex]);
+                binCounts[bin]++;
+            }
+
+            // Sweep from right to get area of right side of each split, then from left.
+            float rightAreas[kBinCount];
+            uint rightCounts[kBinCount];
+            Bounds right;
+            uint rightCount = 0;
+            for (uint bin = kBinCount - 1; bin > 0; --bin)
+            {
+                right.grow(binBounds[bin]);
+                rightCount += binCounts[bin];
+                rightAreas[bin] = right.area();
+                rightCounts[bin] = rightCount;
+            }
+
+            Bounds left;
+            uint leftCount = 0;
+            for (uint split = 1; split < kBinCount; ++split)
+            {
+                left.grow(binBounds[split - 1]);
+                leftCount += binCounts[split - 1];
+
+                const float cost = leftCount * left.area() + rightCounts[split] * rightAreas[split];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // Keep as leaf if no split is cheaper than intersecting every triangle.
+        if (bestCost >= count * bounds.area())
+            continue;
+
+        const float extentMin = centroidBounds.min[bestAxis];
+        const float scale = kBinCount / (centroidBounds.max[bestAxis] - extentMin);
+        auto middle = std::partition(
+            mTriangleIndices.begin() + first,
+            mTriangleIndices.begin() + first + count,
+            [&](uint triangleIndex)
+            { return std::min(kBinCount - 1, (uint)((centroids[triangleIndex][bestAxis] - extentMin) * scale)) < bestSplit; }
+        );
+
+        const uint leftCount = (uint)(middle - mTriangleIndices.begin()) - first;
+        if (leftCount == 0 || leftCount == count)
+            continue;
+
+        const uint leftIndex = (uint)mNodes.size();
+        mNodes.push_back({float3(0.f), first, float3(0.f), leftCount});
+        mNodes.push_back({float3(0.f), first + leftCount, float3(0.f), count - leftCount});
+
+        // Node reference is still valid, capacity is reserved.
+        node.leftOrFirst = leftIndex;
+        node.count = 0;
+
+        stack.push_back(leftIndex + 1);
+        stack.push_back(leftIndex);
+    }
+
+    // Store triangles in leaf order, so that leaf reads contiguous memory.
+    mTriangles.resize(triangleCount);
+    for (uint i = 0; i < triangleCount; ++i)
+    {
+        const uint triangleIndex = mTriangleIndices[i];
+        const float3 v0 = vertices[triangleIndex * 3];
+        mTriangles[i] = {v0, vertices[triangleIndex * 3 + 1] - v0, vertices[triangleIndex * 3 + 2] - v0};
+    }
+}
+
+bool CpuBvh::intersect(const float3& origin, const float3& dir, float tMax, Hit& hit) const
+{
+    return traverse<false>(origin, dir, tMax, hit);
+}
+
+bool CpuBvh::isOccluded(const float3& origin, const float3& dir, float tMax) const
+{
+    Hit hit;
+    return traverse<true>(origin, dir, tMax, hit);
+}
+
+template<bool kAnyHit>
+bool CpuBvh::traverse(const float3& origin, const float3& dir, float tMax, Hit& hit) const
+{
+    if (mNodes.empty())
+        return false;
+
+    const float3 invDir = float3(1.f) / dir;
+    bool found = false;
+    hit.t = tMax;
+
+    uint stack[kMaxStackSize];
+    uint stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = mNodes[stack[--stackSize]];
+        if (intersectBounds(node.boundsMin, node.boundsMax, origin, invDir, hit.t) == FLT_MAX)
+            continue;
+
+        if (node.count > 0)
+        {
+            // Moller-Trumbore.
+            for (uint i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+            {
+                const Triangle& triangle = mTriangles[i];
+
+                const float3 pvec = math::cross(dir, triangle.e2);
+                const float det = math::dot(triangle.e1, pvec);
+                if (std::abs(det) < 1e-12f)
+                    continue;
+
+                const float invDet = 1.f / det;
+                const float3 tvec = origin - triangle.v0;
+                const float u = math::dot(tvec, pvec) * invDet;
+                if (u < 0.f || u > 1.f)
+                    continue;
+
+                const float3 qvec = math::cross(tvec, triangle.e1);
+                const float v = math::dot(dir, qvec) * invDet;
+                if (v < 0.f || u + v > 1.f)
+                    continue;
+
+                const float t = math::dot(triangle.e2, qvec) * invDet;
+                if (t <= 0.f || t >= hit.t)
+                    continue;
+
+                hit.t = t;
+                hit.triangleIndex = mTriangleIndices[i];
+                hit.u = u;
+                hit.v = v;
+                found = true;
+
+                if (kAnyHit)
+                    return true;
+            }
+            continue;
+        }
+
+        // Visit nearer child first.
+        const Node& left = mNodes[node.leftOrFirst];
+        const Node& right = mNodes[node.leftOrFirst + 1];
+        const float tLeft = intersectBounds(left.boundsMin, left.boundsMax, origin, invDir, hit.t);
+        const float tRight = intersectBounds(right.boundsMin, right.boundsMax, origin, invDir, hit.t);
+
+        const bool leftFirst = tLeft <= tRight;
+        const uint nearIndex = leftFirst ? node.leftOrFirst : node.leftOrFirst + 1;
+        const uint farIndex = leftFirst ? node.leftOrFirst + 1 : node.leftOrFirst;
+        const float tNear = leftFirst ? tLeft : tRight;
+        const float tFar = leftFirst ? tRight : tLeft;
+
+        if (tFar != FLT_MAX && stackSize < kMaxStackSize)
+            stack[stackSize++] = farIndex;
+        if (tNear != FLT_MAX && stackSize < kMaxStackSize)
+            stack[stackSize++] = nearIndex;
+    }
+
+    return found;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "Falcor.h"
+
+using namespace Falcor;
+
+// Bounding volume hierarchy over world space triangles, built with binned SAH.
+// Used by CPU backend in place of ray tracing acceleration structure.
+class CpuBvh
+{
+public:
+    struct Hit
+    {
+        float t = FLT_MAX;
+        uint triangleIndex = 0; ///< Index in triangles given at build.
+        float u = 0.f;          ///< Barycentrics of second and third vertex.
+        float v = 0.f;
+    };
+
+    // Three vertices per triangle.
+    void build(const std::vector<float3>& vertices);
+
+    // Closest hit in (0, tMax). Direction needs not be normalized, t is in its unit.
+    bool intersect(const float3& origin, const float3& dir, float tMax, Hit& hit) const;
+
+    // Any hit in (0, tMax), for shadow rays.
+    bool isOccluded(const float3& origin, const float3& dir, float tMax) const;
+
+    uint getTriangleCount() const { return (uint)mTriangleIndices.size(); }
+    uint getNodeCount() const { return (uint)mNodes.size(); }
+
+private:
+    // 32 bytes, two nodes per cache line.
+    struct Node
+    {
+        float3 boundsMin;
+        uint leftOrFirst; ///< Left child if count is 0, first triangle otherwise. Right child is left + 1.
+        float3 boundsMax;
+        uint count;
+    };
+
+    // Vertices are stored as v0, v1 - v0, v2 - v0 in traversal order.
+    struct Triangle
+    {
+        float3 v0;
+        float3 e1;
+        float3 e2;
+    };
+
+    template<bool kAnyHit>
+    bool traverse(const float3& origin, const float3& dir, float tMax, Hit& hit) const;
+
+    std::vector<Node> mNodes;
+    std::vector<Triangle> mTriangles;
+    std::vector<uint> mTriangleIndices; ///< Original index of triangle at each slot.
+};
@@ -0,0 +1,822 @@
+#include "SurfelGICPU.h"
+#include "Utils/Math/FalcorMath.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+const std::string kOutputTextureName = "output";
+const std::string kThreadCount = "threadCount";
+const std::string kUseSurfelLod = "useSurfelLod";
+
+// Pixels per range of scheduler. Rows of tiles are balanced by stealing.
+const uint kPixelGrainSize = 256;
+const uint kRayGrainSize = 64;
+
+// Same as kTileSize, as compile time constant for arrays of tile.
+constexpr uint kTileWidth = 16;
+constexpr uint kTilePixelCount = kTileWidth * kTileWidth;
+
+// Same offset scale as computeRayOrigin, relative to distance from origin.
+const float kRayOffset = 1e-4f;
+
+// f32tof16 of HLSL, so that coverage of pixels is compared with same precision as generation pass.
+uint f32tof16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent <= 0)
+        return sign;
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    // Round to nearest even.
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return half;
+}
+
+float f16tof32(uint value)
+{
+    const uint32_t sign = (value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0)
+        bits = sign; // Denormals are flushed, same as f32tof16 above.
+    else if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Cosine weighted, so that diffuse throughput is albedo.
+float3 sampleCosineHemisphere(float u, float v)
+{
+    const float phi = v * 2 * (float)M_PI;
+    const float sinTheta = std::sqrt(u);
+    return float3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, std::sqrt(1 - u));
+}
+
+double getElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+float3 offsetRayOrigin(const float3& posW, const float3& normalW)
+{
+    const float scale = std::max(1.f, std::max(std::abs(posW.x), std::max(std::abs(posW.y), std::abs(posW.z))));
+    return posW + normalW * (kRayOffset * scale);
+}
+} // namespace
+
+SurfelGICPU::SurfelGICPU(ref<Device> pDevice, const Properties& props) : RenderPass(pDevice)
+{
+    // No device feature is needed, output is uploaded from host.
+    parseProperties(props);
+}
+
+void SurfelGICPU::parseProperties(const Properties& props)
+{
+    // Thread count and surfel hierarchy are only known to this pass, the rest is shared with SurfelGI.
+    auto json = props.toJson();
+    if (json.contains(kThreadCount))
+    {
+        mThreadCount = json[kThreadCount].get<uint>();
+        json.erase(kThreadCount);
+    }
+    if (json.contains(kUseSurfelLod))
+    {
+        mUseSurfelLod = json[kUseSurfelLod].get<bool>();
+        json.erase(kUseSurfelLod);
+    }
+
+    parseSurfelGIProperties(Properties(json), mRuntimeParams, mStaticParams);
+
+    if (mStaticParams.useRayGuiding || mStaticParams.useLightReservoir || mStaticParams.useEmissiveSampling || mStaticParams.useSurfelDepth)
+        logInfo("SurfelGICPU: ray guiding, light reservoir, emissive sampling and surfel depth are ignored on CPU.");
+
+    createEngine();
+}
+
+void SurfelGICPU::setProperties(const Properties& props)
+{
+    parseProperties(props);
+}
+
+Properties SurfelGICPU::getProperties() const
+{
+    Properties props = getSurfelGIProperties(mRuntimeParams, mStaticParams);
+    props[kThreadCount] = mThreadCount;
+    props[kUseSurfelLod] = mUseSurfelLod;
+    return props;
+}
+
+void SurfelGICPU::createEngine()
+{
+    // Engine holds scheduler, so release engine first.
+    mpEngine = nullptr;
+    mpScheduler = std::make_unique<TaskScheduler>(mThreadCount);
+
+    SurfelReferenceEngine::Settings settings;
+    settings.staticParams = mStaticParams;
+    settings.runtimeParams = mRuntimeParams;
+    settings.pScheduler = mpScheduler.get();
+    settings.useLod = mUseSurfelLod;
+    mpEngine = std::make_unique<SurfelReferenceEngine>(settings);
+
+    mFrameIndex = 0;
+}
+
+RenderPassReflection SurfelGICPU::reflect(const CompileData& compileData)
+{
+    RenderPassReflection reflector;
+
+    // Written with updateTextureData, so no shader access is needed.
+    reflector.addOutput(kOutputTextureName, "output texture")
+        .format(ResourceFormat::RGBA32Float)
+        .bindFlags(ResourceBindFlags::ShaderResource);
+
+    return reflector;
+}
+
+void SurfelGICPU::setScene(RenderContext* pRenderContext, const ref<Scene>& pScene)
+{
+    mpScene = pScene;
+    mLocalTriangles.clear();
+    mMaterials.clear();
+    mLights.clear();
+
+    if (!mpScene)
+        return;
+
+    loadSceneGeometry();
+    buildBvh();
+
+    mpEngine->reset();
+    mFrameIndex = 0;
+}
+
+void SurfelGICPU::loadSceneGeometry()
+{
+    // Base color and emission of basic materials. Others are grey.
+    for (const auto& pMaterial : mpScene->getMaterials())
+    {
+        SceneMaterial material = {float3(0.5f), float3(0.f)};
+        if (auto pBasicMaterial = pMaterial->toBasicMaterial())
+        {
+            material.albedo = pBasicMaterial->getBaseColor().xyz();
+            material.emission = pBasicMaterial->getEmissiveColor() * pBasicMaterial->getEmissiveFactor();
+        }
+        mMaterials.push_back(material);
+    }
+
+    bool hasUnsupportedLight = mpScene->getEnvMap() != nullptr;
+    for (const auto& pLight : mpScene->getActiveLights())
+    {
+        const LightData& data = pLight->getData();
+        const LightType type = (LightType)data.type;
+
+        if (type == LightType::Point)
+            mLights.push_back({data.posW, data.dirW, data.intensity, false});
+        else if (type == LightType::Directional || type == LightType::Distant)
+            mLights.push_back({data.posW, data.dirW, data.intensity, true});
+        else
+            hasUnsupportedLight = true;
+    }
+
+    if (hasUnsupportedLight)
+        logWarning("SurfelGICPU: environment map and area lights are not sampled on CPU.");
+
+    // Read back vertices and indices of every mesh once. They are transformed when geometry moves.
+    const auto& pVao = mpScene->getMeshVao();
+    const auto vertexData = pVao->getVertexBuffer(0)->getElements<PackedStaticVertexData>();
+    const auto indexData = pVao->getIndexBuffer() ? pVao->getIndexBuffer()->getElements<uint32_t>() : std::vector<uint32_t>();
+
+    for (uint instanceID = 0; instanceID < mpScene->getGeometryInstanceCount(); ++instanceID)
+    {
+        const GeometryInstanceData& instance = mpScene->getGeometryInstance(instanceID);
+        if (instance.getType() != GeometryType::TriangleMesh)
+            continue;
+
+        const MeshDesc& mesh = mpScene->getMesh(MeshID(instance.geometryID));
+
+        LocalTriangles triangles;
+        triangles.globalMatrixID = instance.globalMatrixID;
+        triangles.materialIndex = instance.materialID;
+        triangles.vertices.reserve(mesh.getTriangleCount() * 3);
+
+        for (uint i = 0; i < mesh.getTriangleCount() * 3; ++i)
+        {
+            uint index = i;
+            if (mesh.indexCount > 0)
+            {
+                // 16 bit indices are packed two per word.
+                if (mesh.use16BitIndices())
+                    index = (indexData[mesh.ibOffset + i / 2] >> ((i % 2) * 16)) & 0xffff;
+                else
+                    index = indexData[mesh.ibOffset + i];
+            }
+            triangles.vertices.push_back(vertexData[mesh.vbOffset + index].position);
+        }
+
+        mLocalTriangles.push_back(std::move(triangles));
+    }
+}
+
+void SurfelGICPU::buildBvh()
+{
+    const auto& globalMatrices = mpScene->getAnimationController()->getGlobalMatrices();
+
+    std::vector<float3> vertices;
+    mTriangleMaterials.clear();
+    mTriangleNormals.clear();
+
+    for (const auto& triangles : mLocalTriangles)
+    {
+        const float4x4& transform = globalMatrices[triangles.globalMatrixID];
+        for (size_t i = 0; i < triangles.vertices.size(); i += 3)
+        {
+            const float3 v0 = transformPoint(transform, triangles.vertices[i]);
+            const float3 v1 = transformPoint(transform, triangles.vertices[i + 1]);
+            const float3 v2 = transformPoint(transform, triangles.vertices[i + 2]);
+
+            vertices.push_back(v0);
+            vertices.push_back(v1);
+            vertices.push_back(v2);
+
+            const float3 n = math::cross(v1 - v0, v2 - v0);
+            const float len = math::length(n);
+            mTriangleNormals.push_back(len > 0.f ? n / len : float3(0.f, 1.f, 0.f));
+            mTriangleMaterials.push_back(triangles.materialIndex);
+        }
+    }
+
+    mBvh.build(vertices);
+}
+
+void SurfelGICPU::prepareView(uint2 resolution)
+{
+    const auto& pCamera = mpScene->getCamera();
+    mView.viewProj = pCamera->getViewProjMatrixNoJitter();
+    mView.position = pCamera->getPosition();
+    mView.fovy = focalLengthToFovY(pCamera->getFocalLength(), pCamera->getFrameHeight());
+    mView.resolution = resolution;
+    mView.frameDim = resolution;
+}
+
+void SurfelGICPU::execute(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    const auto& pOutput = renderData.getTexture(kOutputTextureName);
+    if (!mpScene || !pOutput)
+        return;
+
+    if (is_set(mpScene->getUpdates(), Scene::UpdateFlags::GeometryMoved))
+        buildBvh();
+
+    const uint2 resolution = uint2(pOutput->getWidth(), pOutput->getHeight());
+    if (math::any(mFrameDim != resolution))
+    {
+        mFrameDim = resolution;
+        mPixelHits.resize(resolution.x * resolution.y);
+        mOutput.resize(resolution.x * resolution.y);
+    }
+
+    if (mResetSurfelBuffer)
+    {
+        mpEngine->reset();
+        mResetSurfelBuffer = false;
+    }
+
+    prepareView(resolution);
+
+    auto start = std::chrono::steady_clock::now();
+    mpEngine->update({mView});
+    mFrameTimes.update = getElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    traceSurfelRays();
+    mFrameTimes.rayTrace = getElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    if (mFrameIndex <= mRuntimeParams.maxFrameIndex)
+        mpEngine->integrate(mRayResults);
+    mFrameTimes.integrate = getElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    traceGBuffer();
+    generateSurfels();
+    mFrameTimes.generation = getElapsedMs(start);
+
+    pRenderContext->updateTextureData(pOutput.get(), mOutput.data());
+
+    mFrameIndex++;
+}
+
+void SurfelGICPU::traceGBuffer()
+{
+    const CameraData& camera = mpScene->getCamera()->getData();
+    const uint2 resolution = mView.resolution;
+
+    mpScheduler->parallelFor(
+        resolution.x * resolution.y,
+        kPixelGrainSize,
+        [&](uint, uint begin, uint end)
+        {
+            for (uint pixelIndex = begin; pixelIndex < end; ++pixelIndex)
+            {
+                const uint2 pixel = uint2(pixelIndex % resolution.x, pixelIndex / resolution.x);
+
+                // Pinhole camera ray, same as Camera::computeRayPinhole.
+                const float2 p = (float2(pixel) + float2(0.5f)) / float2(resolution);
+                const float2 ndc = float2(2.f, -2.f) * p + float2(-1.f, 1.f);
+                const float3 dir = ndc.x * camera.cameraU + ndc.y * camera.cameraV + camera.cameraW;
+
+                PixelHit& pixelHit = mPixelHits[pixelIndex];
+                CpuBvh::Hit hit;
+                pixelHit.valid = mBvh.intersect(camera.posW, dir, FLT_MAX, hit);
+                if (!pixelHit.valid)
+                    continue;
+
+                pixelHit.posW = camera.posW + dir * hit.t;
+                pixelHit.normalW = mTriangleNormals[hit.triangleIndex];
+                if (math::dot(pixelHit.normalW, dir) > 0.f)
+                    pixelHit.normalW = -pixelHit.normalW;
+
+                const float4 posH = math::mul(mView.viewProj, float4(pixelHit.posW, 1.f));
+                pixelHit.depth = posH.z / posH.w;
+            }
+        }
+    );
+}
+
+float3 SurfelGICPU::evalAnalyticLight(const float3& posW, const float3& normalW, const float3& albedo, SurfelReference::RNG& rng) const
+{
+    const uint lightCount = (uint)mLights.size();
+    if (lightCount == 0)
+        return float3(0.f);
+
+    // Sample one light, probability is all same.
+    const SceneLight& light = mLights[std::min(rng.nextUint(lightCount), lightCount - 1)];
+
+    float3 dir;
+    float distance;
+    float3 Li;
+    if (light.directional)
+    {
+        dir = -math::normalize(light.dirW);
+        distance = FLT_MAX;
+        Li = light.intensity;
+    }
+    else
+    {
+        const float3 toLight = light.posW - posW;
+        const float dist2 = math::dot(toLight, toLight);
+        if (dist2 <= 0.f)
+            return float3(0.f);
+        distance = std::sqrt(dist2);
+        dir = toLight / distance;
+        Li = light.intensity / dist2;
+    }
+
+    const float NdotL = math::dot(normalW, dir);
+    if (NdotL <= 0.f)
+        return float3(0.f);
+
+    const float3 origin = offsetRayOrigin(posW, normalW);
+    if (mBvh.isOccluded(origin, dir, distance))
+        return float3(0.f);
+
+    return albedo * (float)M_1_PI * NdotL * Li * (float)lightCount;
+}
+
+bool SurfelGICPU::finalizePath(const float3& posW, const float3& normalW, SurfelReference::RNG& rng, float3& Lr)
+{
+    if (!mStaticParams.useSurfelRadinace)
+    {
+        Lr = float3(0.f);
+        return true;
+    }
+
+    const int3 cellPos = SurfelReference::getCellPos(posW, mpEngine->getGridCenter(), mStaticParams.cellUnit);
+    if (!SurfelReference::isCellValid(cellPos, mStaticParams.cellDim))
+        return false;
+
+    const CellInfo cellInfo = mpEngine->getCellInfo(SurfelReference::getFlattenCellIndex(cellPos, mStaticParams.cellDim));
+    if (cellInfo.surfelCount > 64 || rng.nextFloat() < 0.2f)
+        return false;
+
+    const auto& surfels = mpEngine->getSurfels();
+    const auto& recycleInfos = mpEngine->getRecycleInfos();
+    const auto& cellToSurfel = mpEngine->getCellToSurfelBuffer();
+
+    float4 weightedLr = float4(0.f);
+    float sleepingCoverage = 0.f;
+    float maxContribution = 0.f;
+    int maxContributionSleepingSurfelIndex = -1;
+
+    for (uint i = 0; i < cellInfo.surfelCount; ++i)
+    {
+        const uint surfelIndex = cellToSurfel[cellInfo.cellToSurfelBufferOffset + i];
+        const Surfel& surfel = surfels[surfelIndex];
+
+        const float3 bias = posW - surfel.position;
+        const float dist2 = math::dot(bias, bias);
+        if (dist2 >= surfel.radius * surfel.radius)
+            continue;
+
+        const float dotN = math::dot(normalW, math::normalize(surfel.normal));
+        if (dotN <= 0)
+            continue;
+
+        const float contribution = SurfelReference::calcContribution(dotN, std::sqrt(dist2), surfel.radius);
+        weightedLr += float4(surfel.radiance, 1.f) * contribution;
+
+        if (recycleInfos[surfelIndex].status & 0x0001)
+        {
+            sleepingCoverage += contribution;
+            if (maxContribution < contribution)
+            {
+                maxContribution = contribution;
+                maxContributionSleepingSurfelIndex = (int)surfelIndex;
+            }
+        }
+
+        mpEngine->addRef(surfelIndex);
+    }
+
+    if (weightedLr.w <= 0.f)
+        return false;
+
+    if (sleepingCoverage >= 4.0f && maxContributionSleepingSurfelIndex != -1)
+        mpEngine->markDestroy((uint)maxContributionSleepingSurfelIndex);
+
+    Lr = weightedLr.xyz() / weightedLr.w;
+    return true;
+}
+
+void SurfelGICPU::traceSurfelRays()
+{
+    const auto& surfels = mpEngine->getSurfels();
+    const auto& recycleInfos = mpEngine->getRecycleInfos();
+
+    // Every field is written by its ray, so no initialization is needed.
+    mRayResults.resize(mpEngine->getRequestedRayCount());
+
+    mpScheduler->parallelFor(
+        (uint)mRayResults.size(),
+        kRayGrainSize,
+        [&](uint, uint begin, uint end)
+        {
+            for (uint rayIndex = begin; rayIndex < end; ++rayIndex)
+            {
+                const uint surfelIndex = mpEngine->findRaySurfel(rayIndex);
+
+                SurfelRayResult& rayResult = mRayResults[rayIndex];
+                rayResult.surfelIndex = surfelIndex;
+                const Surfel& surfel = surfels[surfelIndex];
+                const bool isSleeping = recycleInfos[surfelIndex].status & 0x0001;
+
+                // Seed by owner surfel, as deterministic mode does.
+                const uint2 seed = uint2(surfelIndex, rayIndex - surfel.rayOffset);
+                SurfelReference::RNG rng;
+                rng.init(seed, mFrameIndex);
+
+                const float3 dirLocal = math::normalize(SurfelReference::hemispherePointUniform(rng.nextFloat(), rng.nextFloat()));
+                const float3 dirWorld = math::normalize(SurfelReference::getTangentSpace(surfel.normal).toWorld(dirLocal));
+
+                rayResult.dirLocal = dirLocal;
+                rayResult.dirWorld = dirWorld;
+                rayResult.pdf = 1.f / (16 * (float)M_PI);
+                rayResult.firstRayLength = 0.f;
+
+                // Sleeping surfels have double steps, because sleeping surfel focus on exploration.
+                const uint rayStep = isSleeping ? mRuntimeParams.rayStep * 2u : mRuntimeParams.rayStep;
+                const uint maxStep = isSleeping ? mRuntimeParams.maxStep * 2u : mRuntimeParams.maxStep;
+
+                float3 radiance = float3(0.f);
+                float3 thp = float3(1.f);
+                float3 origin = surfel.position;
+                float3 direction = dirWorld;
+
+                for (uint currStep = 1; currStep <= maxStep;)
+                {
+                    CpuBvh::Hit hit;
+                    if (!mBvh.intersect(origin, direction, FLT_MAX, hit))
+                        break;
+
+                    const float3 posW = origin + direction * hit.t;
+                    float3 normalW = mTriangleNormals[hit.triangleIndex];
+                    if (math::dot(normalW, direction) > 0.f)
+                        normalW = -normalW;
+
+                    if (currStep == 1u)
+                        rayResult.firstRayLength = hit.t;
+
+                    const SceneMaterial& material = mMaterials[mTriangleMaterials[hit.triangleIndex]];
+                    radiance += thp * material.emission;
+                    radiance += thp * evalAnalyticLight(posW, normalW, material.albedo, rng);
+
+                    // Diffuse BSDF sampling, weight is albedo.
+                    const float3 sampleLocal = sampleCosineHemisphere(rng.nextFloat(), rng.nextFloat());
+                    origin = offsetRayOrigin(posW, normalW);
+                    direction = math::normalize(SurfelReference::getTangentSpace(normalW).toWorld(sampleLocal));
+                    thp *= material.albedo;
+
+                    if (currStep < rayStep)
+                    {
+                        // Russian roulette.
+                        const float prob = std::max(0.f, 1.f - SurfelReference::luminance(thp));
+                        if (rng.nextFloat() >= prob)
+                        {
+                            thp /= std::max(1e-12f, 1.f - prob);
+                            if (!(thp.x > 0.f || thp.y > 0.f || thp.z > 0.f))
+                                break;
+
+                            currStep++;
+                            continue;
+                        }
+                    }
+
+                    float3 Lr;
+                    if (finalizePath(posW, normalW, rng, Lr))
+                    {
+                        radiance += thp * Lr;
+                        break;
+                    }
+                    currStep++;
+                }
+
+                rayResult.radiance = radiance;
+            }
+        }
+    );
+}
+
+void SurfelGICPU::generateSurfels()
+{
+    const uint2 resolution = mView.resolution;
+    const uint2 tileCount = (resolution + kTileSize - 1u) / kTileSize;
+    const float3 gridCenter = mpEngine->getGridCenter();
+
+    const auto& surfels = mpEngine->getSurfels();
+    const auto& recycleInfos = mpEngine->getRecycleInfos();
+    const auto& cellToSurfel = mpEngine->getCellToSurfelBuffer();
+
+    // One request slot per tile, allocated in tile order after all tiles are done.
+    std::vector<Surfel> spawnRequests(tileCount.x * tileCount.y);
+    std::vector<uint8_t> spawnRequestValid(tileCount.x * tileCount.y, 0);
+    std::vector<CellCacheStats> tileCacheStats(tileCount.x * tileCount.y);
+
+    mpScheduler->parallelFor(
+        tileCount.x * tileCount.y,
+        1,
+        [&](uint, uint begin, uint end)
+        {
+            for (uint tileIndex = begin; tileIndex < end; ++tileIndex)
+            {
+                const uint2 tilePos = uint2(tileIndex % tileCount.x, tileIndex / tileCount.x);
+
+                uint minCoverageData = ~0u;
+                uint maxContributionData = 0;
+
+                // Model of cell cache of GPU gather, cells are inserted in pixel order.
+                CellCacheStats& cacheStats = tileCacheStats[tileIndex];
+                uint cachedCells[kCellCacheSize];
+                uint cachedCellCount = 0;
+                SurfelReference::RNG tileRngs[kTilePixelCount];
+                float3 tileIndirectLighting[kTilePixelCount];
+
+                for (uint localIndex = 0; localIndex < kTilePixelCount; ++localIndex)
+                {
+                    const uint2 groupThreadID = uint2(localIndex % kTileWidth, localIndex / kTileWidth);
+                    const uint2 pixel = tilePos * kTileSize + groupThreadID;
+                    if (pixel.x >= resolution.x || pixel.y >= resolution.y)
+                        continue;
+
+                    const uint pixelIndex = pixel.y * resolution.x + pixel.x;
+                    mOutput[pixelIndex] = float4(0.f);
+
+                    SurfelReference::RNG& randomState = tileRngs[localIndex];
+                    randomState.init(pixel, mFrameIndex);
+
+                    const PixelHit& pixelHit = mPixelHits[pixelIndex];
+                    if (!pixelHit.valid)
+                        continue;
+
+                    const int3 cellPos = SurfelReference::getCellPos(pixelHit.posW, gridCenter, mStaticParams.cellUnit);
+                    if (!SurfelReference::isCellValid(cellPos, mStaticParams.cellDim))
+                        continue;
+
+                    const uint flattenIndex = SurfelReference::getFlattenCellIndex(cellPos, mStaticParams.cellDim);
+                    const CellInfo cellInfo = mpEngine->getCellInfo(flattenIndex);
+
+                    cacheStats.pixelLoadCount += cellInfo.surfelCount;
+                    const uint* cachedCell = std::find(cachedCells, cachedCells + cachedCellCount, flattenIndex);
+                    if (cachedCell == cachedCells + cachedCellCount)
+                    {
+                        // Loaded once per tile if inserted, once per pixel if cache is full.
+                        cacheStats.cachedLoadCount += cellInfo.surfelCount;
+                        if (cachedCellCount < kCellCacheSize)
+                            cachedCells[cachedCellCount++] = flattenIndex;
+                        else
+                            cacheStats.fallbackPixelCount++;
+                    }
+
+                    float4 indirectLighting = float4(0.f);
+                    float coverage = 0.f;
+                    float maxContribution = 0.f;
+                    uint maxContributionSurfelIndex = randomState.nextUint(cellInfo.surfelCount);
+
+                    for (uint i = 0; i < cellInfo.surfelCount; ++i)
+                    {
+                        const uint surfelIndex = cellToSurfel[cellInfo.cellToSurfelBufferOffset + i];
+                        const Surfel& surfel = surfels[surfelIndex];
+
+                        const float3 bias = pixelHit.posW - surfel.position;
+                        const float dist2 = math::dot(bias, bias);
+                        if (dist2 >= surfel.radius * surfel.radius)
+                            continue;
+
+                        const float dotN = math::dot(pixelHit.normalW, math::normalize(surfel.normal));
+                        if (dotN <= 0)
+                            continue;
+
+                        const SurfelRecycleInfo& recycleInfo = recycleInfos[surfelIndex];
+                        if (!(recycleInfo.status & 0x0001))
+                        {
+                            const float contribution = SurfelReference::calcContribution(dotN, std::sqrt(dist2), surfel.radius);
+                            coverage += contribution;
+
+                            // Delay blending if not sufficient sample is accumulated.
+                            indirectLighting += float4(surfel.radiance, 1.f) * contribution *
+                                                SurfelReference::smoothstep(0, (float)mRuntimeParams.blendingDelay, recycleInfo.frame);
+
+                            if (maxContribution < contribution)
+                            {
+                                maxContribution = contribution;
+                                maxContributionSurfelIndex = i;
+                            }
+                        }
+
+                        mpEngine->markSeen(surfelIndex);
+                    }
+
+                    if (indirectLighting.w > 0)
+                    {
+                        const float3 color = indirectLighting.xyz() / indirectLighting.w;
+                        mOutput[pixelIndex] = float4(color, SurfelReference::saturate(indirectLighting.w));
+                        indirectLighting = float4(color, indirectLighting.w);
+                    }
+                    tileIndirectLighting[localIndex] = indirectLighting.xyz();
+
+                    uint coverageData = 0;
+                    coverageData |= ((f32tof16(coverage) & 0x0000FFFF) << 16);
+                    coverageData |= ((randomState.nextUint(255) & 0x000000FF) << 8);
+                    coverageData |= ((groupThreadID.x & 0x0000000F) << 4);
+                    coverageData |= ((groupThreadID.y & 0x0000000F) << 0);
+                    minCoverageData = std::min(minCoverageData, coverageData);
+
+                    uint contributionData = 0;
+                    contributionData |= ((f32tof16(maxContribution) & 0x0000FFFF) << 16);
+                    contributionData |= ((maxContributionSurfelIndex & 0x0000FFFF) << 0);
+                    maxContributionData = std::max(maxContributionData, contributionData);
+                }
+
+                cacheStats.tileCount = 1;
+                cacheStats.cellCount = cachedCellCount;
+
+                if (minCoverageData == ~0u)
+                    continue;
+
+                // Pixel of min coverage decides spawn or removal of tile.
+                const uint2 groupThreadID = uint2((minCoverageData & 0x000000F0) >> 4, (minCoverageData & 0x0000000F) >> 0);
+                const uint localIndex = groupThreadID.y * kTileWidth + groupThreadID.x;
+                const uint2 pixel = tilePos * kTileSize + groupThreadID;
+                const PixelHit& pixelHit = mPixelHits[pixel.y * resolution.x + pixel.x];
+                SurfelReference::RNG& randomState = tileRngs[localIndex];
+
+                const float coverage = f16tof32(minCoverageData >> 16);
+                const int3 cellPos = SurfelReference::getCellPos(pixelHit.posW, gridCenter, mStaticParams.cellUnit);
+                const CellInfo cellInfo = mpEngine->getCellInfo(SurfelReference::getFlattenCellIndex(cellPos, mStaticParams.cellDim));
+                const float chance = std::pow(pixelHit.depth, (float)mRuntimeParams.chancePower);
+
+                if (cellInfo.surfelCount < mStaticParams.perCellSurfelLimit && coverage <= mRuntimeParams.placementThreshold)
+                {
+                    if (randomState.nextFloat() < chance * mRuntimeParams.chanceMultiply)
+                    {
+                        const float3 indirectLighting = tileIndirectLighting[localIndex];
+
+                        Surfel surfel = {};
+                        surfel.position = pixelHit.posW;
+                        surfel.normal = pixelHit.normalW;
+                        surfel.radius = SurfelReference::calcSurfelRadius(
+                            math::length(mView.position - pixelHit.posW),
+                            mView.fovy,
+                            mView.frameDim,
+                            (float)mStaticParams.surfelTargetArea,
+                            mStaticParams.cellUnit
+                        );
+                        surfel.radiance = indirectLighting;
+                        surfel.msmeData = SurfelReference::makeMSMEData();
+                        surfel.msmeData.mean = indirectLighting;
+                        surfel.msmeData.shortMean = indirectLighting;
+
+                        spawnRequests[tileIndex] = surfel;
+                        spawnRequestValid[tileIndex] = 1;
+                    }
+                }
+
+                if (cellInfo.surfelCount > 0 && coverage > mRuntimeParams.removalThreshold)
+                {
+                    if (randomState.nextFloat() < chance * mRuntimeParams.chanceMultiply)
+                    {
+                        // Other tiles may still read this surfel, so destroy at next update.
+                        const uint maxContributionSurfelIndex = maxContributionData & 0x0000FFFF;
+                        mpEngine->markDestroy(cellToSurfel[cellInfo.cellToSurfelBufferOffset + maxContributionSurfelIndex]);
+                    }
+                }
+            }
+        }
+    );
+
+    std::vector<Surfel> requests;
+    for (size_t i = 0; i < spawnRequests.size(); ++i)
+    {
+        if (spawnRequestValid[i])
+            requests.push_back(spawnRequests[i]);
+    }
+    mpEngine->spawn(requests);
+
+    mCellCacheStats = {};
+    for (const CellCacheStats& stats : tileCacheStats)
+    {
+        mCellCacheStats.tileCount += stats.tileCount;
+        mCellCacheStats.cellCount += stats.cellCount;
+        mCellCacheStats.fallbackPixelCount += stats.fallbackPixelCount;
+        mCellCacheStats.pixelLoadCount += stats.pixelLoadCount;
+        mCellCacheStats.cachedLoadCount += stats.cachedLoadCount;
+    }
+}
+
+void SurfelGICPU::renderUI(Gui::Widgets& widget)
+{
+    widget.text("Worker threads: " + std::to_string(mpScheduler->getWorkerCount()));
+    widget.text("Triangles: " + std::to_string(mBvh.getTriangleCount()) + ", BVH nodes: " + std::to_string(mBvh.getNodeCount()));
+    widget.text("Valid surfels: " + std::to_string(mpEngine->getValidSurfelIndices().size()));
+    widget.text("Rays: " + std::to_string(mpEngine->getRequestedRayCount()));
+
+    widget.text(fmt::format(
+        "Update {:.2f} ms, ray trace {:.2f} ms, integrate {:.2f} ms, generation {:.2f} ms",
+        mFrameTimes.update,
+        mFrameTimes.rayTrace,
+        mFrameTimes.integrate,
+        mFrameTimes.generation
+    ));
+
+    // Surfel loads of gather with cell cache of GPU passes, compared to load per pixel.
+    const CellCacheStats& cacheStats = mCellCacheStats;
+    if (cacheStats.tileCount > 0 && cacheStats.pixelLoadCount > 0)
+    {
+        widget.text(fmt::format(
+            "Cell cache: {:.2f} cells per tile, hit rate {:.1f}%, fallback pixels {}",
+            (double)cacheStats.cellCount / cacheStats.tileCount,
+            100.0 * (1.0 - (double)cacheStats.cachedLoadCount / cacheStats.pixelLoadCount),
+            cacheStats.fallbackPixelCount
+        ));
+    }
+
+    // Toggling recreates engine, which clears surfels.
+    if (widget.checkbox("Surfel LOD", mUseSurfelLod))
+        createEngine();
+    widget.tooltip("Merges surfels of far field into parent surfels, and splits them as view approaches.");
+
+    if (mUseSurfelLod)
+    {
+        const SurfelReferenceEngine::LodStats& lodStats = mpEngine->getLodStats();
+        widget.text(fmt::format(
+            "LOD: {} parents hold {} surfels, {} merged and {} split at last update",
+            lodStats.parentCount,
+            lodStats.mergedSurfelCount,
+            lodStats.mergeCount,
+            lodStats.splitCount
+        ));
+    }
+
+    if (widget.button("Reset Surfel"))
+        mResetSurfelBuffer = true;
+    widget.tooltip("Clears all spawned surfels in the scene.");
+}
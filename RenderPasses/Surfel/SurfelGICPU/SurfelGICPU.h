@@ -0,0 +1,127 @@
+#pragma once
+#include "Falcor.h"
+#include "RenderGraph/RenderPass.h"
+#include "CpuBvh.h"
+#include "../SurfelReference/SurfelReferenceEngine.h"
+#include "../SurfelReference/TaskScheduler.h"
+
+using namespace Falcor;
+
+// SurfelGI on CPU, for devices without Shader Model 6.5 or ray tracing (e.g. software rasterizer of render farm).
+// Same frame loop as deterministic mode of SurfelGI, and same properties, so that graph only swaps pass name.
+// Output is indirect lighting, same as output of SurfelGI.
+//
+// Differences from GPU:
+//   - Materials are diffuse with constant base color and emission, textures are not sampled.
+//   - Lights are point and directional lights. Environment map and area lights are not sampled.
+//   - Ray guiding, light reservoir, emissive sampling and surfel depth are not supported.
+class SurfelGICPU : public RenderPass
+{
+public:
+    FALCOR_PLUGIN_CLASS(SurfelGICPU, "SurfelGICPU", "Surfel GI Pass on CPU");
+
+    static ref<SurfelGICPU> create(ref<Device> pDevice, const Properties& props)
+    {
+        return make_ref<SurfelGICPU>(pDevice, props);
+    }
+
+    SurfelGICPU(ref<Device> pDevice, const Properties& props);
+
+    virtual void setProperties(const Properties& props) override;
+    virtual Properties getProperties() const override;
+    virtual RenderPassReflection reflect(const CompileData& compileData) override;
+    virtual void compile(RenderContext* pRenderContext, const CompileData& compileData) override {}
+    virtual void execute(RenderContext* pRenderContext, const RenderData& renderData) override;
+    virtual void renderUI(Gui::Widgets& widget) override;
+    virtual void setScene(RenderContext* pRenderContext, const ref<Scene>& pScene) override;
+    virtual bool onMouseEvent(const MouseEvent& mouseEvent) override { return false; }
+    virtual bool onKeyEvent(const KeyboardEvent& keyEvent) override { return false; }
+
+private:
+    struct SceneMaterial
+    {
+        float3 albedo;
+        float3 emission;
+    };
+
+    struct SceneLight
+    {
+        float3 posW;
+        float3 dirW;        ///< Direction light travels, for directional light.
+        float3 intensity;
+        bool directional;
+    };
+
+    // Mesh triangle in local space, transformed when geometry moves.
+    struct LocalTriangles
+    {
+        uint globalMatrixID;
+        uint materialIndex;
+        std::vector<float3> vertices;
+    };
+
+    struct PixelHit
+    {
+        float3 posW;
+        float3 normalW;
+        float depth;
+        bool valid;
+    };
+
+    struct FrameTimes
+    {
+        double update = 0.0;
+        double rayTrace = 0.0;
+        double integrate = 0.0;
+        double generation = 0.0;
+    };
+
+    // Counts of cell cache model over tiles. Cached load count includes loads of fallback pixels.
+    struct CellCacheStats
+    {
+        uint tileCount = 0;
+        uint cellCount = 0;
+        uint fallbackPixelCount = 0;
+        uint64_t pixelLoadCount = 0;
+        uint64_t cachedLoadCount = 0;
+    };
+
+    void parseProperties(const Properties& props);
+    void createEngine();
+    void loadSceneGeometry();
+    void buildBvh();
+    void prepareView(uint2 resolution);
+    void traceGBuffer();
+    void traceSurfelRays();
+    void generateSurfels();
+
+    float3 evalAnalyticLight(const float3& posW, const float3& normalW, const float3& albedo, SurfelReference::RNG& rng) const;
+    bool finalizePath(const float3& posW, const float3& normalW, SurfelReference::RNG& rng, float3& Lr);
+
+    SurfelGIRuntimeParams mRuntimeParams;
+    SurfelGIStaticParams mStaticParams;
+    uint mThreadCount = 0;
+    bool mUseSurfelLod = false;
+
+    std::unique_ptr<TaskScheduler> mpScheduler;
+    std::unique_ptr<SurfelReferenceEngine> mpEngine;
+
+    ref<Scene> mpScene;
+    std::vector<LocalTriangles> mLocalTriangles;
+    std::vector<SceneMaterial> mMaterials;
+    std::vector<SceneLight> mLights;
+    std::vector<uint> mTriangleMaterials;
+    std::vector<float3> mTriangleNormals;
+    CpuBvh mBvh;
+
+    SurfelView mView;
+    uint mFrameIndex = 0;
+    uint2 mFrameDim = uint2(0, 0);
+    bool mResetSurfelBuffer = false;
+
+    std::vector<PixelHit> mPixelHits;
+    std::vector<float4> mOutput;
+    std::vector<SurfelRayResult> mRayResults;
+    FrameTimes mFrameTimes;
+    CellCacheStats mCellCacheStats;
+};
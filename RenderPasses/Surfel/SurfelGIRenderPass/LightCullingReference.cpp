@@ -0,0 +1,67 @@
+#include "LightCullingReference.h"
+
+namespace LightCullingReference
+{
+
+uint2 getTileCount(const uint2 resolution)
+{
+    return uint2((resolution.x + kLightTileSize - 1) / kLightTileSize, (resolution.y + kLightTileSize - 1) / kLightTileSize);
+}
+
+std::vector<TileLights> cullLights(
+    const uint2 resolution,
+    const std::vector<float3>& posW,
+    const std::vector<bool>& isValid,
+    const std::vector<Light>& lights,
+    float influenceCutoff
+)
+{
+    const uint2 tileCount = getTileCount(resolution);
+    std::vector<TileLights> tiles(tileCount.x * tileCount.y);
+
+    for (uint tileY = 0; tileY < tileCount.y; ++tileY)
+    {
+        for (uint tileX = 0; tileX < tileCount.x; ++tileX)
+        {
+            // World space bound of visible surface in tile.
+            float3 boxMin = float3(FLT_MAX);
+            float3 boxMax = float3(-FLT_MAX);
+            bool hasSurface = false;
+
+            const uint endY = std::min((tileY + 1) * kLightTileSize, resolution.y);
+            const uint endX = std::min((tileX + 1) * kLightTileSize, resolution.x);
+            for (uint y = tileY * kLightTileSize; y < endY; ++y)
+            {
+                for (uint x = tileX * kLightTileSize; x < endX; ++x)
+                {
+                    const uint pixelIndex = y * resolution.x + x;
+                    if (!isValid[pixelIndex])
+                        continue;
+
+                    boxMin = math::min(boxMin, posW[pixelIndex]);
+                    boxMax = math::max(boxMax, posW[pixelIndex]);
+                    hasSurface = true;
+                }
+            }
+
+            if (!hasSurface)
+                continue;
+
+            TileLights& tile = tiles[tileY * tileCount.x + tileX];
+            for (uint lightIndex = 0; lightIndex < (uint)lights.size(); ++lightIndex)
+            {
+                const Light& light = lights[lightIndex];
+                if (!LightCulling::isLightAffectingBox(light.isPointLight, light.posW, light.intensity, influenceCutoff, boxMin, boxMax))
+                    continue;
+
+                if (tile.count < kMaxLightsPerTile)
+                    tile.lightIndices.push_back(lightIndex);
+                tile.count++;
+            }
+        }
+    }
+
+    return tiles;
+}
+
+} // namespace LightCullingReference
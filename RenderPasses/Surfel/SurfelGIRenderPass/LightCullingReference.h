@@ -0,0 +1,41 @@
+#pragma once
+#include "Falcor.h"
+#include <vector>
+
+using namespace Falcor;
+
+#include "LightCulling.slang"
+
+// CPU reference of LightCullingPass, for tests and tuning of influence cutoff.
+// GPU list order depends on atomics, so lists here are in light order. They hold same lights unless overflowed.
+namespace LightCullingReference
+{
+
+struct Light
+{
+    float3 posW;
+    float intensity;    ///< Luminance of light intensity.
+    bool isPointLight;
+};
+
+struct TileLights
+{
+    uint count = 0;                 ///< Number of lights affecting tile, can be larger than kMaxLightsPerTile.
+    std::vector<uint> lightIndices; ///< First kMaxLightsPerTile of lights affecting tile.
+
+    // Consumer uses all lights if list is overflowed.
+    bool isOverflowed() const { return count > kMaxLightsPerTile; }
+};
+
+uint2 getTileCount(const uint2 resolution);
+
+// Positions of visible surface, row major. Pixels without surface have isValid false.
+std::vector<TileLights> cullLights(
+    const uint2 resolution,
+    const std::vector<float3>& posW,
+    const std::vector<bool>& isValid,
+    const std::vector<Light>& lights,
+    float influenceCutoff
+);
+
+} // namespace LightCullingReference
@@ -1,4 +1,17 @@
 #include "SurfelGIRenderPass.h"
+#include "../SurfelGI/ResolutionScale.h"
+#include "LightCulling.slang"
+
+namespace
+{
+const std::string kRenderDirectLighting = "renderDirectLighting";
+const std::string kRenderIndirectLighting = "renderIndirectLighting";
+const std::string kDirectLightingMode = "directLightingMode";
+const std::string kStochasticLightCount = "stochasticLightCount";
+const std::string kInfluenceCutoff = "influenceCutoff";
+const std::string kTemporalAlpha = "temporalAlpha";
+const std::string kOutputFormat = "outputFormat";
+} // namespace
 
 SurfelGIRenderPass::SurfelGIRenderPass(ref<Device> pDevice, const Properties& props) : RenderPass(pDevice)
 {
@@ -13,6 +26,53 @@ SurfelGIRenderPass::SurfelGIRenderPass(ref<Device> pDevice, const Properties& pr
     FALCOR_ASSERT(mpSampleGenerator);
 
     mFrameIndex = 0;
+    mFrameDim = uint2(0, 0);
+    mTileCount = uint2(0, 0);
+
+    parseProperties(props);
+}
+
+void SurfelGIRenderPass::parseProperties(const Properties& props)
+{
+    for (const auto& [key, value] : props)
+    {
+        if (key == kRenderDirectLighting) mRenderDirectLighting = value;
+        else if (key == kRenderIndirectLighting) mRenderIndirectLighting = value;
+        else if (key == kDirectLightingMode) mDirectLightingMode = value;
+        else if (key == kStochasticLightCount) mStochasticLightCount = value;
+        else if (key == kInfluenceCutoff) mInfluenceCutoff = value;
+        else if (key == kTemporalAlpha) mTemporalAlpha = value;
+        else if (key == kOutputFormat) mOutputFormat = value;
+        else logWarning("Unknown property '{}' in SurfelGIRenderPass properties.", key);
+    }
+
+    // Same ranges as UI.
+    mStochasticLightCount = std::clamp(mStochasticLightCount, 1u, 32u);
+    mInfluenceCutoff = std::clamp(mInfluenceCutoff, 1e-6f, 1.f);
+    mTemporalAlpha = std::clamp(mTemporalAlpha, 0.01f, 1.f);
+}
+
+void SurfelGIRenderPass::setProperties(const Properties& props)
+{
+    const RadianceFormat prevOutputFormat = mOutputFormat;
+    parseProperties(props);
+
+    // Output texture is allocated by render graph.
+    if (mOutputFormat != prevOutputFormat)
+        requestRecompile();
+}
+
+Properties SurfelGIRenderPass::getProperties() const
+{
+    Properties props;
+    props[kRenderDirectLighting] = mRenderDirectLighting;
+    props[kRenderIndirectLighting] = mRenderIndirectLighting;
+    props[kDirectLightingMode] = mDirectLightingMode;
+    props[kStochasticLightCount] = mStochasticLightCount;
+    props[kInfluenceCutoff] = mInfluenceCutoff;
+    props[kTemporalAlpha] = mTemporalAlpha;
+    props[kOutputFormat] = mOutputFormat;
+    return props;
 }
 
 RenderPassReflection SurfelGIRenderPass::reflect(const CompileData& compileData)
@@ -24,13 +84,24 @@ RenderPassReflection SurfelGIRenderPass::reflect(const CompileData& compileData)
         .format(ResourceFormat::RGBA32Uint)
         .bindFlags(ResourceBindFlags::ShaderResource);
 
-    reflector.addInput("indirectLighting", "indirect lighting texture")
+    // Any float format, as given by output format of SurfelGI.
+    reflector.addInput("indirectLighting", "indirect lighting texture").bindFlags(ResourceBindFlags::ShaderResource);
+
+    // Surface cache is read by light culling instead of packed hit info, if connected.
+    // Final gather still needs shading data of material for direct lighting.
+    reflector.addInput("surfacePosW", "surface cache position and linear depth")
         .format(ResourceFormat::RGBA32Float)
-        .bindFlags(ResourceBindFlags::ShaderResource);
+        .bindFlags(ResourceBindFlags::ShaderResource)
+        .flags(RenderPassReflection::Field::Flags::Optional);
+
+    reflector.addInput("surfaceData", "surface cache normal and albedo")
+        .format(ResourceFormat::RG32Uint)
+        .bindFlags(ResourceBindFlags::ShaderResource)
+        .flags(RenderPassReflection::Field::Flags::Optional);
 
     // Output
     reflector.addOutput("output", "output texture")
-        .format(ResourceFormat::RGBA32Float)
+        .format(getResourceFormat(mOutputFormat))
         .bindFlags(ResourceBindFlags::UnorderedAccess);
 
     return reflector;
@@ -44,24 +115,85 @@ void SurfelGIRenderPass::execute(RenderContext* pRenderContext, const RenderData
 
     FALCOR_ASSERT(pPackedHitInfo && pIndirectLighting && pOutput);
 
+    const auto& pSurfacePosW = renderData.getTexture("surfacePosW");
+    const auto& pSurfaceData = renderData.getTexture("surfaceData");
+    const bool useSurfaceCache = pSurfacePosW && pSurfaceData;
+
+    const uint2 resolution = renderData.getDefaultTextureDims();
+    if (math::any(mFrameDim != resolution))
+    {
+        createResolutionDependentResources(resolution);
+
+        // Invalidate history.
+        for (uint i = 0; i < 2; ++i)
+        {
+            pRenderContext->clearUAV(mpDirectLightingTexture[i]->getUAV().get(), float4(0));
+            pRenderContext->clearUAV(mpPosWTexture[i]->getUAV().get(), float4(0));
+        }
+    }
+
+    // Resources are sized by full frame, and only sub-rectangle of resolution scale is rendered.
+    // Tile list keeps tile count of full frame, so that tile index is same at any scale.
+    const uint2 renderResolution = getRenderResolution(resolution, getResolutionScale(renderData));
+
+    const bool useTileLightList = mDirectLightingMode != DirectLightingMode::Exhaustive;
+    if (mpLightCullingPass && useTileLightList)
+    {
+        FALCOR_PROFILE(pRenderContext, "Light Culling Pass");
+
+        auto var = mpLightCullingPass->getRootVar();
+        mpScene->setRaytracingShaderData(pRenderContext, var);
+
+        var["CB"]["gResolution"] = renderResolution;
+        var["CB"]["gTileCount"] = mTileCount;
+        var["CB"]["gInfluenceCutoff"] = mInfluenceCutoff;
+        var["CB"]["gUseSurfaceCache"] = useSurfaceCache;
+
+        var["gPackedHitInfo"] = pPackedHitInfo;
+        var["gSurfacePosW"] = pSurfacePosW;
+        var["gSurfaceData"] = pSurfaceData;
+        var["gTileLightIndexBuffer"] = mpTileLightIndexBuffer;
+        var["gTileLightCountBuffer"] = mpTileLightCountBuffer;
+
+        const uint2 renderTileCount = div_round_up(renderResolution, uint2(kLightTileSize));
+        mpLightCullingPass->execute(pRenderContext, uint3(renderTileCount * kLightTileSize, 1));
+    }
+
     if (mpProgram)
     {
+        FALCOR_PROFILE(pRenderContext, "Final Gather");
+
         auto var = mpVars->getRootVar();
         mpScene->setRaytracingShaderData(pRenderContext, var);
 
-        var["CB"]["gResolution"] = renderData.getDefaultTextureDims();
+        var["CB"]["gResolution"] = renderResolution;
         var["CB"]["gFrameIndex"] = mFrameIndex;
         var["CB"]["gRenderDirectLighting"] = mRenderDirectLighting;
         var["CB"]["gRenderIndirectLighting"] = mRenderIndirectLighting;
+        var["CB"]["gDirectLightingMode"] = (uint)mDirectLightingMode;
+        var["CB"]["gTileCount"] = mTileCount;
+        var["CB"]["gStochasticLightCount"] = mStochasticLightCount;
+        var["CB"]["gInfluenceCutoff"] = mInfluenceCutoff;
+        var["CB"]["gTemporalAlpha"] = mTemporalAlpha;
 
         var["gPackedHitInfo"] = pPackedHitInfo;
         var["gIndirectLighting"] = pIndirectLighting;
         var["gOutput"] = pOutput;
 
-        pRenderContext->clearUAV(pOutput->getUAV().get(), float4(0));
+        var["gTileLightIndexBuffer"] = mpTileLightIndexBuffer;
+        var["gTileLightCountBuffer"] = mpTileLightCountBuffer;
+
+        // History of stochastic direct lighting is ping-ponged.
+        const uint curr = mFrameIndex & 1u;
+        const uint prev = curr ^ 1u;
+        var["gPrevDirectLighting"] = mpDirectLightingTexture[prev];
+        var["gPrevPosW"] = mpPosWTexture[prev];
+        var["gDirectLighting"] = mpDirectLightingTexture[curr];
+        var["gPosW"] = mpPosWTexture[curr];
 
+        // Every pixel of render resolution is written, so output is not cleared.
         uint3 threadGroupSize = mpProgram->getReflector()->getThreadGroupSize();
-        uint3 groups = div_round_up(uint3(renderData.getDefaultTextureDims(), 1), threadGroupSize);
+        uint3 groups = div_round_up(uint3(renderResolution, 1), threadGroupSize);
         pRenderContext->dispatch(mpState.get(), mpVars.get(), groups);
     }
 
@@ -72,13 +204,34 @@ void SurfelGIRenderPass::renderUI(Gui::Widgets& widget)
 {
     widget.checkbox("Direct Lighting", mRenderDirectLighting);
     widget.checkbox("Indirect Lighting", mRenderIndirectLighting);
+
+    widget.dropdown("Direct lighting mode", mDirectLightingMode);
+    widget.tooltip(
+        "Exhaustive: evaluate all lights per pixel.\n"
+        "Tiled: evaluate lights whose influence radius overlaps the screen tile.\n"
+        "Stochastic: evaluate K importance sampled lights of the tile, with temporal accumulation."
+    );
+
+    if (mDirectLightingMode != DirectLightingMode::Exhaustive)
+    {
+        widget.var("Influence cutoff", mInfluenceCutoff, 1e-6f, 1.f, 1e-4f);
+        widget.tooltip("Point light is culled where its intensity falls below this value.");
+    }
+
+    if (mDirectLightingMode == DirectLightingMode::Stochastic)
+    {
+        widget.slider("Light samples", mStochasticLightCount, 1u, 32u);
+        widget.slider("Temporal alpha", mTemporalAlpha, 0.01f, 1.f);
+    }
+
+    if (widget.dropdown("Output format", mOutputFormat))
+        requestRecompile();
+    widget.tooltip("Format of output texture. Alpha is always 1, so R11G11B10Float loses nothing but precision.");
 }
 
 void SurfelGIRenderPass::setScene(RenderContext* pRenderContext, const ref<Scene>& pScene)
 {
     mpScene = pScene;
-    mRenderDirectLighting = true;
-    mRenderIndirectLighting = true;
 
     if (mpScene)
     {
@@ -95,5 +248,58 @@ void SurfelGIRenderPass::setScene(RenderContext* pRenderContext, const ref<Scene
 
         mpVars = ProgramVars::create(mpDevice, mpProgram.get());
         mpSampleGenerator->bindShaderData(mpVars->getRootVar());
+
+        mpLightCullingPass = ComputePass::create(
+            mpDevice, "RenderPasses/Surfel/SurfelGIRenderPass/LightCullingPass.cs.slang", "csMain", mpScene->getSceneDefines()
+        );
+    }
+}
+
+void SurfelGIRenderPass::createResolutionDependentResources(uint2 resolution)
+{
+    mFrameDim = resolution;
+    mTileCount = div_round_up(resolution, uint2(kLightTileSize));
+
+    const uint tileCount = mTileCount.x * mTileCount.y;
+
+    mpTileLightIndexBuffer = mpDevice->createStructuredBuffer(
+        sizeof(uint),
+        tileCount * kMaxLightsPerTile,
+        ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
+    );
+
+    mpTileLightCountBuffer = mpDevice->createStructuredBuffer(
+        sizeof(uint),
+        tileCount,
+        ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource,
+        MemoryType::DeviceLocal,
+        nullptr,
+        false
+    );
+
+    for (uint i = 0; i < 2; ++i)
+    {
+        mpDirectLightingTexture[i] = mpDevice->createTexture2D(
+            resolution.x,
+            resolution.y,
+            ResourceFormat::RGBA32Float,
+            1,
+            1,
+            nullptr,
+            ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource
+        );
+
+        mpPosWTexture[i] = mpDevice->createTexture2D(
+            resolution.x,
+            resolution.y,
+            ResourceFormat::RGBA32Float,
+            1,
+            1,
+            nullptr,
+            ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource
+        );
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "Falcor.h"
 #include "RenderGraph/RenderPass.h"
+#include "DirectLightingMode.slang"
+#include "../SurfelGI/RadianceFormat.h"
 
 using namespace Falcor;
 
@@ -16,7 +18,8 @@ public:
 
     SurfelGIRenderPass(ref<Device> pDevice, const Properties& props);
 
-    virtual Properties getProperties() const override { return {}; }
+    virtual void setProperties(const Properties& props) override;
+    virtual Properties getProperties() const override;
     virtual RenderPassReflection reflect(const CompileData& compileData) override;
     virtual void compile(RenderContext* pRenderContext, const CompileData& compileData) override {}
     virtual void execute(RenderContext* pRenderContext, const RenderData& renderData) override;
@@ -26,6 +29,9 @@ public:
     virtual bool onKeyEvent(const KeyboardEvent& keyEvent) override { return false; }
 
 private:
+    void parseProperties(const Properties& props);
+    void createResolutionDependentResources(uint2 resolution);
+
     ref<Scene>              mpScene;
     ref<ComputeState>       mpState;
     ref<Program>            mpProgram;
@@ -33,7 +39,22 @@ private:
 
     ref<SampleGenerator>    mpSampleGenerator;
 
+    ref<ComputePass>        mpLightCullingPass;
+
+    ref<Buffer>             mpTileLightIndexBuffer;
+    ref<Buffer>             mpTileLightCountBuffer;
+    ref<Texture>            mpDirectLightingTexture[2];
+    ref<Texture>            mpPosWTexture[2];
+
     uint                    mFrameIndex;
-    bool                    mRenderDirectLighting;
-    bool                    mRenderIndirectLighting;
+    uint2                   mFrameDim;
+    uint2                   mTileCount;
+    bool                    mRenderDirectLighting = true;
+    bool                    mRenderIndirectLighting = true;
+
+    DirectLightingMode      mDirectLightingMode = DirectLightingMode::Exhaustive;
+    uint                    mStochasticLightCount = 4u;
+    float                   mInfluenceCutoff = 1e-3f;
+    float                   mTemporalAlpha = 0.1f;
+    RadianceFormat          mOutputFormat = RadianceFormat::RGBA32Float;
 };
@@ -0,0 +1,92 @@
+#include "SurfelLod.h"
+
+namespace SurfelReference
+{
+
+uint getAdequateLodLevel(const SurfelLodParams& params, float distance, float varianceLuminance, float cellUnit)
+{
+    // Level 1 starts at merge distance, and each level after doubles it.
+    const float mergeDistance = params.mergeDistance * cellUnit;
+    uint level = 0;
+    while (level < params.maxLevel && distance >= mergeDistance * (float)(1u << level))
+        level++;
+
+    // Converged surfel has nothing more to learn from its own rays.
+    if (level > 0 && varianceLuminance < params.varianceThreshold)
+        level = std::min(level + 1, params.maxLevel);
+
+    return level;
+}
+
+uint64_t getLodClusterKey(const float3& posW, const float3& normalW, const float3& gridCenter, float cellUnit, uint level)
+{
+    const float3 posC = (posW - gridCenter) / (cellUnit * (float)(1u << level));
+    const int3 coarsePos = int3((int)std::floor(posC.x), (int)std::floor(posC.y), (int)std::floor(posC.z));
+
+    // Dominant axis of normal with sign, so that opposite sides of thin wall are not merged.
+    const float3 absNormal = math::abs(normalW);
+    uint axis = absNormal.x >= absNormal.y ? (absNormal.x >= absNormal.z ? 0 : 2) : (absNormal.y >= absNormal.z ? 1 : 2);
+    const uint direction = axis * 2 + (normalW[axis] < 0.f ? 1 : 0);
+
+    // 20 bits per axis of coarse cell, 3 bits of direction.
+    const uint64_t mask = (1u << 20) - 1;
+    return ((uint64_t)(coarsePos.x & mask) << 43) | ((uint64_t)(coarsePos.y & mask) << 23) | ((uint64_t)(coarsePos.z & mask) << 3) |
+           direction;
+}
+
+Surfel mergeSurfels(const std::vector<const Surfel*>& children)
+{
+    Surfel parent = {};
+    parent.msmeData = makeMSMEData();
+    if (children.empty())
+        return parent;
+
+    float weightSum = 0.f;
+    float3 positionSum = float3(0.f);
+    float3 normalSum = float3(0.f);
+    for (const Surfel* pChild : children)
+    {
+        const float weight = pChild->radius * pChild->radius;
+        weightSum += weight;
+        positionSum += pChild->position * weight;
+        normalSum += pChild->normal * weight;
+    }
+
+    parent.position = positionSum / weightSum;
+    parent.normal = math::length(normalSum) > 0.f ? math::normalize(normalSum) : children[0]->normal;
+
+    MSMEData& msme = parent.msmeData;
+    msme.inconsistency = 0.f;
+
+    float3 weightedVariance = float3(0.f);
+    for (const Surfel* pChild : children)
+    {
+        const float weight = pChild->radius * pChild->radius / weightSum;
+        const MSMEData& childMsme = pChild->msmeData;
+
+        parent.radius = std::max(parent.radius, math::length(pChild->position - parent.position) + pChild->radius);
+        parent.radiance += pChild->radiance * weight;
+        parent.sumLuminance += pChild->sumLuminance * weight;
+        parent.hasHole |= pChild->hasHole;
+
+        msme.mean += childMsme.mean * weight;
+        msme.shortMean += childMsme.shortMean * weight;
+        msme.vbbr += childMsme.vbbr * weight;
+        msme.inconsistency += childMsme.inconsistency * weight;
+        weightedVariance += childMsme.variance * (weight * weight);
+    }
+    msme.variance = weightedVariance;
+
+    return parent;
+}
+
+void applyParentUpdate(const Surfel& parent, const float3& mergedMean, Surfel& child)
+{
+    const float3 delta = parent.msmeData.mean - mergedMean;
+
+    child.msmeData.mean = math::max(float3(0.f), child.msmeData.mean + delta);
+    child.msmeData.shortMean = math::max(float3(0.f), child.msmeData.shortMean + delta);
+    child.radiance = child.msmeData.mean;
+}
+
+} // namespace SurfelReference
@@ -0,0 +1,39 @@
+#pragma once
+#include "SurfelReferenceMath.h"
+
+// Surfel hierarchy for far field.
+// Clusters of distant or converged surfels are merged into parent surfel of next level, which takes over their rays,
+// update and cell list entries. Children are kept as they are while merged, so that split restores their detail.
+// Host only, used by SurfelReferenceEngine and SurfelGICPU. GPU passes do not build the hierarchy yet:
+// cell lists of update pass reach 125 neighbor cells, which caps radius at 2 * cellUnit, so parents need wider
+// cell insertion there, and merge / split passes are still to be written.
+namespace SurfelReference
+{
+
+struct SurfelLodParams
+{
+    uint maxLevel = 2;               ///< Parent of level L clusters surfels within 2^L cells per axis.
+    float mergeDistance = 64.f;      ///< In cell units. Level L is adequate beyond mergeDistance * 2^(L - 1).
+    float splitRatio = 0.75f;        ///< Parent splits closer than this ratio of its merge distance, so that level does not flicker.
+    float varianceThreshold = 0.01f; ///< Surfels with lower variance luminance are adequate one level coarser.
+    float minNormalDot = 0.8f;       ///< Children face within this cosine of parent normal.
+    uint minClusterSize = 4;
+};
+
+// Coarsest adequate level of surfel at distance from closest view.
+// Split test passes distance divided by split ratio, so that parent is kept until view comes closer than where it merged.
+uint getAdequateLodLevel(const SurfelLodParams& params, float distance, float varianceLuminance, float cellUnit);
+
+// Cluster of surfel at level, among surfels of same coarse cell and facing same axis.
+uint64_t getLodClusterKey(const float3& posW, const float3& normalW, const float3& gridCenter, float cellUnit, uint level);
+
+// Parent of children, weighted by surfel area. Disc of parent covers discs of children.
+// Radiance estimates of children are independent, so parent variance is variance of their weighted mean.
+// Ray offset and count are left for update to allocate.
+Surfel mergeSurfels(const std::vector<const Surfel*>& children);
+
+// Restore child of split parent. Change of parent mean since merge is added to child,
+// so that child keeps its own detail and what parent has learned while merged.
+void applyParentUpdate(const Surfel& parent, const float3& mergedMean, Surfel& child);
+
+} // namespace SurfelReference
@@ -0,0 +1,776 @@
+#include "SurfelReferenceEngine.h"
+#include <algorithm>
+#include <map>
+#include <thread>
+
+namespace
+{
+// Same order as neighborOffset in SurfelUtils.slang, split into components for vectorized loops.
+struct NeighborOffsets
+{
+    int x[125], y[125], z[125];
+
+    NeighborOffsets()
+    {
+        uint i = 0;
+        for (int ox = -2; ox <= 2; ++ox)
+            for (int oy = -2; oy <= 2; ++oy)
+                for (int oz = -2; oz <= 2; ++oz, ++i)
+                {
+                    x[i] = ox;
+                    y[i] = oy;
+                    z[i] = oz;
+                }
+    }
+};
+
+const NeighborOffsets kNeighborOffsets;
+
+// Keep chunks large enough that scheduling is not dominant.
+const uint kChunkSize = 1024;
+
+uint getChunkCount(uint count)
+{
+    return (count + kChunkSize - 1) / kChunkSize;
+}
+
+// Same as insertNeighbor in SurfelUpdatePass.cs.slang.
+struct NeighborList
+{
+    uint indices[kMaxSurfelNeighborCount];
+    float dist2s[kMaxSurfelNeighborCount];
+    uint count = 0;
+
+    void insert(uint surfelIndex, float dist2)
+    {
+        if (count == kMaxSurfelNeighborCount)
+        {
+            const float lastDist2 = dist2s[kMaxSurfelNeighborCount - 1];
+            if (dist2 > lastDist2 || (dist2 == lastDist2 && surfelIndex >= indices[kMaxSurfelNeighborCount - 1]))
+                return;
+        }
+
+        for (uint i = 0; i < count; ++i)
+        {
+            if (indices[i] == surfelIndex)
+                return;
+        }
+
+        uint slot = std::min(count, kMaxSurfelNeighborCount - 1);
+        count = std::min(count + 1, kMaxSurfelNeighborCount);
+
+        while (slot > 0 && (dist2s[slot - 1] > dist2 || (dist2s[slot - 1] == dist2 && indices[slot - 1] > surfelIndex)))
+        {
+            indices[slot] = indices[slot - 1];
+            dist2s[slot] = dist2s[slot - 1];
+            --slot;
+        }
+
+        indices[slot] = surfelIndex;
+        dist2s[slot] = dist2;
+    }
+};
+} // namespace
+
+void SurfelReferenceEngine::SurfelBatch::resize(size_t count)
+{
+    posX.resize(count);
+    posY.resize(count);
+    posZ.resize(count);
+    radius.resize(count);
+    sleeping.resize(count);
+    alive.resize(count);
+}
+
+template<typename Func>
+void SurfelReferenceEngine::parallelFor(uint count, const Func& func) const
+{
+    const uint chunkCount = getChunkCount(count);
+    auto runChunks = [&](uint begin, uint end)
+    {
+        for (uint chunk = begin; chunk < end; ++chunk)
+            func(chunk, chunk * kChunkSize, std::min(count, (chunk + 1) * kChunkSize));
+    };
+
+    if (mSettings.pScheduler)
+    {
+        mSettings.pScheduler->parallelFor(chunkCount, 1, [&](uint, uint begin, uint end) { runChunks(begin, end); });
+        return;
+    }
+
+    const uint threadCount = std::min(chunkCount, mThreadCount);
+    if (threadCount <= 1)
+    {
+        runChunks(0, chunkCount);
+        return;
+    }
+
+    std::atomic<uint> nextChunk = 0;
+    auto worker = [&]()
+    {
+        for (uint chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+            runChunks(chunk, chunk + 1);
+    };
+
+    std::vector<std::thread> threads;
+    for (uint i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+SurfelReferenceEngine::SurfelReferenceEngine(const Settings& settings) : mSettings(settings)
+{
+    mSettings.staticParams.validate();
+    mSettings.runtimeParams.validate();
+
+    if (mSettings.pScheduler)
+        mThreadCount = mSettings.pScheduler->getWorkerCount();
+    else
+        mThreadCount = mSettings.threadCount > 0 ? mSettings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+    reset();
+}
+
+void SurfelReferenceEngine::reset()
+{
+    const uint surfelLimit = mSettings.surfelLimit;
+
+    mSurfels.assign(surfelLimit, Surfel{});
+    mRecycleInfos.assign(surfelLimit, SurfelRecycleInfo{});
+    mFlags = std::make_unique<std::atomic<uint>[]>(surfelLimit);
+    mRefCounts = std::make_unique<std::atomic<uint>[]>(surfelLimit);
+    for (uint i = 0; i < surfelLimit; ++i)
+    {
+        mFlags[i] = 0;
+        mRefCounts[i] = 0;
+    }
+
+    // Same as kInitialStatus. Every slot is free.
+    mValidIndices.clear();
+    mFreeIndices.resize(surfelLimit);
+    for (uint i = 0; i < surfelLimit; ++i)
+        mFreeIndices[i] = i;
+    mRequestedRayCount = 0;
+
+    mCellKeys.clear();
+    mCellInfos.clear();
+    mCellToSurfel.clear();
+    mNeighbors.assign((size_t)surfelLimit * kMaxSurfelNeighborCount, kInvalidSurfelIndex);
+
+    mLodNodes.assign(surfelLimit, LodNode{});
+    mLodStats = {};
+}
+
+uint SurfelReferenceEngine::spawn(const std::vector<Surfel>& surfels)
+{
+    const uint freeSurfelCount = (uint)mFreeIndices.size();
+    const uint validSurfelCount = (uint)mValidIndices.size();
+    const uint allocatableCount = std::min(freeSurfelCount, mSettings.surfelLimit - std::min(validSurfelCount, mSettings.surfelLimit));
+    const uint allocatedCount = std::min((uint)surfels.size(), allocatableCount);
+
+    for (uint i = 0; i < allocatedCount; ++i)
+    {
+        const uint newIndex = mFreeIndices[freeSurfelCount - 1 - i];
+
+        mValidIndices.push_back(newIndex);
+        mSurfels[newIndex] = surfels[i];
+        mRecycleInfos[newIndex] = {(uint16_t)kMaxLife, 0, 0};
+        mRefCounts[newIndex] = 0;
+        mFlags[newIndex] = kSurfelFlagAlive;
+    }
+
+    mFreeIndices.resize(freeSurfelCount - allocatedCount);
+    return allocatedCount;
+}
+
+void SurfelReferenceEngine::update(const std::vector<SurfelView>& views)
+{
+    // Same as SurfelGI, grid follows first view unless fixed.
+    if (mSettings.runtimeParams.fixedGridCenter)
+        mGridCenter = mSettings.runtimeParams.gridCenter;
+    else if (!views.empty())
+        mGridCenter = views[0].position;
+
+    recycleSurfels(views);
+
+    if (mSettings.useLod && !views.empty())
+        updateLod(views);
+
+    compactSurfelSlots();
+    allocateSurfelRays();
+    buildCellLists();
+
+    if (mSettings.staticParams.useIrradianceSharing)
+        buildNeighborLists();
+}
+
+void SurfelReferenceEngine::recycleSurfels(const std::vector<SurfelView>& views)
+{
+    const SurfelGIStaticParams& staticParams = mSettings.staticParams;
+    const SurfelGIRuntimeParams& runtimeParams = mSettings.runtimeParams;
+
+    // Valid surfels of last frame and spawned surfels, same as dirty index buffer.
+    const std::vector<uint>& dirtyIndices = mValidIndices;
+    const uint dirtySurfelCount = (uint)dirtyIndices.size();
+    mBatch.resize(dirtySurfelCount);
+
+    // Radius only depends on distance at each view, so factor of calcRadiusApprox is computed once per view.
+    std::vector<float> awakeFactors, sleepingFactors;
+    for (const auto& view : views)
+    {
+        awakeFactors.push_back(SurfelReference::calcRadiusApprox((float)staticParams.surfelTargetArea, 1.f, view.fovy, view.frameDim));
+        sleepingFactors.push_back(
+            SurfelReference::calcRadiusApprox((float)staticParams.surfelTargetArea * 16.f, 1.f, view.fovy, view.frameDim)
+        );
+    }
+
+    parallelFor(
+        dirtySurfelCount,
+        [&](uint chunkIndex, uint begin, uint end)
+        {
+            // Update life and status.
+            for (uint i = begin; i < end; ++i)
+            {
+                const uint surfelIndex = dirtyIndices[i];
+                SurfelRecycleInfo& recycleInfo = mRecycleInfos[surfelIndex];
+                const Surfel& surfel = mSurfels[surfelIndex];
+
+                bool isSleeping = recycleInfo.status & 0x0001;
+                bool lastSeen = (recycleInfo.status & 0x0002) || (mFlags[surfelIndex] & kSurfelFlagSeen);
+                const float surfelRadius = (mFlags[surfelIndex] & kSurfelFlagDestroy) ? 0.f : surfel.radius;
+
+                // Dead surfels do not write back recycle info, so work on copy.
+                SurfelRecycleInfo info = recycleInfo;
+                info.life = (uint16_t)std::max((int)info.life - 1, 0);
+                info.frame = (uint16_t)std::clamp((int)info.frame + 1, 0, 65535);
+
+                if (lastSeen)
+                {
+                    info.life = kMaxLife;
+                    isSleeping = false;
+                }
+
+                if (isSleeping && mRefCounts[surfelIndex] > kRefCountThreshold)
+                    info.life = kSleepingMaxLife;
+
+                const bool alive = surfelRadius > 0 && info.life > 0;
+                if (alive)
+                {
+                    info.status = isSleeping ? 0x0001 : 0x0000;
+                    recycleInfo = info;
+                }
+
+                mBatch.posX[i] = surfel.position.x;
+                mBatch.posY[i] = surfel.position.y;
+                mBatch.posZ[i] = surfel.position.z;
+                mBatch.radius[i] = FLT_MAX;
+                mBatch.sleeping[i] = isSleeping;
+                mBatch.alive[i] = alive;
+            }
+
+            // Radius by closest view. Plain loop over arrays, so that compiler can vectorize it.
+            for (size_t viewIndex = 0; viewIndex < views.size(); ++viewIndex)
+            {
+                const float3 viewPos = views[viewIndex].position;
+                const float awakeFactor = awakeFactors[viewIndex];
+                const float sleepingFactor = sleepingFactors[viewIndex];
+                const float maxRadius = staticParams.cellUnit * 2;
+
+                float* pRadius = mBatch.radius.data();
+                const float* pX = mBatch.posX.data();
+                const float* pY = mBatch.posY.data();
+                const float* pZ = mBatch.posZ.data();
+                const uint8_t* pSleeping = mBatch.sleeping.data();
+
+                for (uint i = begin; i < end; ++i)
+                {
+                    const float dx = pX[i] - viewPos.x;
+                    const float dy = pY[i] - viewPos.y;
+                    const float dz = pZ[i] - viewPos.z;
+                    const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    const float radius = std::min(distance * (pSleeping[i] ? sleepingFactor : awakeFactor), maxRadius);
+                    pRadius[i] = std::min(pRadius[i], radius);
+                }
+            }
+
+            // Write back radius and requested ray count.
+            for (uint i = begin; i < end; ++i)
+            {
+                const uint surfelIndex = dirtyIndices[i];
+                if (!mBatch.alive[i])
+                {
+                    mFlags[surfelIndex] = 0;
+                    continue;
+                }
+
+                Surfel& surfel = mSurfels[surfelIndex];
+                const bool isSleeping = mBatch.sleeping[i];
+
+                surfel.radius = mBatch.radius[i];
+                if (isSleeping)
+                    surfel.radius = std::max(surfel.radius, staticParams.cellUnit * 0.5f);
+
+                // Parent keeps covering its children.
+                surfel.radius = std::max(surfel.radius, mLodNodes[surfelIndex].radius);
+
+                // Computed in float then truncated, as uint lerp is on GPU.
+                const uint lower = isSleeping ? (runtimeParams.minRayCount / 4u) : (runtimeParams.maxRayCount / 4u);
+                const uint upper = isSleeping ? runtimeParams.minRayCount : runtimeParams.maxRayCount;
+                const float t = math::length(surfel.msmeData.variance) * runtimeParams.varianceSensitivity;
+                uint rayRequestCount = (uint)std::clamp((float)lower + ((float)upper - (float)lower) * t, (float)lower, (float)upper);
+
+                if (runtimeParams.batchMode)
+                    rayRequestCount = std::clamp(mSettings.rayBudget / std::max(1u, dirtySurfelCount), 1u, kMaxBatchRayCount);
+
+                surfel.rayCount = rayRequestCount;
+                mRefCounts[surfelIndex] = 0;
+                mFlags[surfelIndex] = kSurfelFlagAlive;
+            }
+        }
+    );
+}
+
+void SurfelReferenceEngine::updateLod(const std::vector<SurfelView>& views)
+{
+    const SurfelGIStaticParams& staticParams = mSettings.staticParams;
+    const SurfelReference::SurfelLodParams& lodParams = mSettings.lodParams;
+
+    auto getViewDistance = [&](const float3& posW)
+    {
+        float distance = FLT_MAX;
+        for (const auto& view : views)
+            distance = std::min(distance, math::length(posW - view.position));
+        return distance;
+    };
+
+    mLodStats.mergeCount = 0;
+    mLodStats.splitCount = 0;
+
+    // Recycled parents take their children with them. Children of split parents join valid list at compaction.
+    std::vector<uint> candidates;
+    for (size_t i = 0; i < mValidIndices.size(); ++i)
+    {
+        const uint surfelIndex = mValidIndices[i];
+        LodNode& node = mLodNodes[surfelIndex];
+
+        if (!(mFlags[surfelIndex] & kSurfelFlagAlive))
+        {
+            releaseChildren(surfelIndex);
+            continue;
+        }
+
+        if (node.level > 0)
+        {
+            const Surfel& surfel = mSurfels[surfelIndex];
+            const float distance = getViewDistance(surfel.position) / lodParams.splitRatio;
+            const float variance = SurfelReference::luminance(surfel.msmeData.variance);
+
+            if (SurfelReference::getAdequateLodLevel(lodParams, distance, variance, staticParams.cellUnit) < node.level)
+            {
+                splitSurfel(surfelIndex);
+                continue;
+            }
+        }
+
+        candidates.push_back(surfelIndex);
+    }
+
+    // Merge level by level, so that parents made at one level may merge again at next one.
+    for (uint level = 1; level <= lodParams.maxLevel; ++level)
+    {
+        // Ordered by key, so that parent slots are allocated in same order on any run.
+        std::map<uint64_t, std::vector<uint>> clusters;
+        for (uint surfelIndex : candidates)
+        {
+            if (mLodNodes[surfelIndex].merged || mLodNodes[surfelIndex].level != level - 1)
+                continue;
+
+            const Surfel& surfel = mSurfels[surfelIndex];
+            const float distance = getViewDistance(surfel.position);
+            const float variance = SurfelReference::luminance(surfel.msmeData.variance);
+            if (SurfelReference::getAdequateLodLevel(lodParams, distance, variance, staticParams.cellUnit) < level)
+                continue;
+
+            const uint64_t key =
+                SurfelReference::getLodClusterKey(surfel.position, surfel.normal, mGridCenter, staticParams.cellUnit, level);
+            clusters[key].push_back(surfelIndex);
+        }
+
+        for (auto& [key, cluster] : clusters)
+        {
+            if (cluster.size() < lodParams.minClusterSize || mFreeIndices.empty())
+                continue;
+
+            // Drop children facing away from the first estimate of parent, then merge the rest.
+            std::vector<const Surfel*> children;
+            for (uint surfelIndex : cluster)
+                children.push_back(&mSurfels[surfelIndex]);
+
+            const float3 clusterNormal = SurfelReference::mergeSurfels(children).normal;
+            children.clear();
+            cluster.erase(
+                std::remove_if(
+                    cluster.begin(),
+                    cluster.end(),
+                    [&](uint surfelIndex) { return math::dot(mSurfels[surfelIndex].normal, clusterNormal) < lodParams.minNormalDot; }
+                ),
+                cluster.end()
+            );
+            if (cluster.size() < lodParams.minClusterSize)
+                continue;
+
+            SurfelRecycleInfo recycleInfo = {0, 0, 0x0001};
+            uint rayCount = 0;
+            for (uint surfelIndex : cluster)
+            {
+                children.push_back(&mSurfels[surfelIndex]);
+                recycleInfo.life = std::max(recycleInfo.life, mRecycleInfos[surfelIndex].life);
+                recycleInfo.status &= mRecycleInfos[surfelIndex].status;
+                rayCount = std::max(rayCount, mSurfels[surfelIndex].rayCount);
+            }
+
+            // Slot is popped from the end, same as spawn().
+            const uint parentIndex = mFreeIndices.back();
+            mFreeIndices.pop_back();
+
+            Surfel& parent = mSurfels[parentIndex];
+            parent = SurfelReference::mergeSurfels(children);
+            parent.rayCount = rayCount;
+
+            LodNode& parentNode = mLodNodes[parentIndex];
+            parentNode = {level, false, parent.radius, parent.msmeData.mean, cluster};
+
+            mRecycleInfos[parentIndex] = recycleInfo;
+            mRefCounts[parentIndex] = 0;
+            mFlags[parentIndex] = kSurfelFlagAlive;
+
+            for (uint surfelIndex : cluster)
+            {
+                mLodNodes[surfelIndex].merged = true;
+                mFlags[surfelIndex] = 0;
+            }
+
+            candidates.push_back(parentIndex);
+            mLodStats.mergeCount++;
+        }
+    }
+
+    mLodStats.parentCount = 0;
+    mLodStats.mergedSurfelCount = 0;
+    for (const LodNode& node : mLodNodes)
+    {
+        mLodStats.parentCount += (node.level > 0 && !node.merged) ? 1 : 0;
+        mLodStats.mergedSurfelCount += node.merged ? 1 : 0;
+    }
+}
+
+void SurfelReferenceEngine::splitSurfel(uint surfelIndex)
+{
+    LodNode& node = mLodNodes[surfelIndex];
+    const Surfel& parent = mSurfels[surfelIndex];
+
+    // Children come back with life and status of parent, as they were seen through it.
+    for (uint childIndex : node.children)
+    {
+        SurfelReference::applyParentUpdate(parent, node.mergedMean, mSurfels[childIndex]);
+        mSurfels[childIndex].rayCount = parent.rayCount;
+
+        mLodNodes[childIndex].merged = false;
+        mRecycleInfos[childIndex] = mRecycleInfos[surfelIndex];
+        mRefCounts[childIndex] = 0;
+        mFlags[childIndex] = kSurfelFlagAlive;
+    }
+
+    // Parent slot is freed at compaction.
+    node = LodNode{};
+    mFlags[surfelIndex] = 0;
+    mLodStats.splitCount++;
+}
+
+void SurfelReferenceEngine::releaseChildren(uint surfelIndex)
+{
+    LodNode& node = mLodNodes[surfelIndex];
+    for (uint childIndex : node.children)
+    {
+        releaseChildren(childIndex);
+        mFlags[childIndex] = 0;
+    }
+    node = LodNode{};
+}
+
+void SurfelReferenceEngine::compactSurfelSlots()
+{
+    // Serial scan in surfel index order, same result as compactSurfelSlots pass.
+    mValidIndices.clear();
+    mFreeIndices.clear();
+
+    for (uint surfelIndex = 0; surfelIndex < mSettings.surfelLimit; ++surfelIndex)
+    {
+        if (mFlags[surfelIndex] & kSurfelFlagAlive)
+            mValidIndices.push_back(surfelIndex);
+        else if (!mLodNodes[surfelIndex].merged)
+            mFreeIndices.push_back(surfelIndex);
+    }
+}
+
+void SurfelReferenceEngine::allocateSurfelRays()
+{
+    // Serial scan in valid index order, same result as allocateSurfelRays pass.
+    std::vector<uint> requestedRayCounts(mValidIndices.size());
+    for (size_t i = 0; i < mValidIndices.size(); ++i)
+        requestedRayCounts[i] = mSurfels[mValidIndices[i]].rayCount;
+
+    std::vector<uint> rayCounts;
+    mRequestedRayCount = SurfelReference::allocateRays(requestedRayCounts, mSettings.rayBudget, mRayOffsets, rayCounts);
+
+    for (size_t i = 0; i < mValidIndices.size(); ++i)
+    {
+        Surfel& surfel = mSurfels[mValidIndices[i]];
+        surfel.rayOffset = mRayOffsets[i];
+        surfel.rayCount = rayCounts[i];
+    }
+}
+
+uint SurfelReferenceEngine::findRaySurfel(uint rayIndex) const
+{
+    return mValidIndices[SurfelReference::findRayOwner(mRayOffsets, rayIndex)];
+}
+
+void SurfelReferenceEngine::buildCellLists()
+{
+    const SurfelGIStaticParams& staticParams = mSettings.staticParams;
+    const float3 gridCenter = mGridCenter;
+    const uint validSurfelCount = (uint)mValidIndices.size();
+
+    // Each chunk collects (cell, surfel) pairs. Sorting them gives cells in order, and surfels of cell in order.
+    std::vector<std::vector<uint64_t>> chunkPairs(getChunkCount(validSurfelCount));
+
+    parallelFor(
+        validSurfelCount,
+        [&](uint chunkIndex, uint begin, uint end)
+        {
+            std::vector<uint64_t>& pairs = chunkPairs[chunkIndex];
+            bool intersects[125];
+
+            for (uint i = begin; i < end; ++i)
+            {
+                const uint surfelIndex = mValidIndices[i];
+                const Surfel& surfel = mSurfels[surfelIndex];
+                const int3 cellPos = SurfelReference::getCellPos(surfel.position, gridCenter, staticParams.cellUnit);
+
+                // Parent of surfel hierarchy may reach beyond 125 neighbors.
+                if (surfel.radius > staticParams.cellUnit * 2)
+                {
+                    const int range = (int)std::ceil(surfel.radius / staticParams.cellUnit + 0.5f);
+                    for (int x = -range; x <= range; ++x)
+                        for (int y = -range; y <= range; ++y)
+                            for (int z = -range; z <= range; ++z)
+                            {
+                                const int3 neighborPos = int3(cellPos.x + x, cellPos.y + y, cellPos.z + z);
+                                if (!SurfelReference::isSurfelIntersectCell(
+                                        surfel.position, surfel.radius, neighborPos, gridCenter, staticParams.cellUnit, staticParams.cellDim
+                                    ))
+                                    continue;
+
+                                const uint flattenIndex = SurfelReference::getFlattenCellIndex(neighborPos, staticParams.cellDim);
+                                pairs.push_back(((uint64_t)flattenIndex << 32) | surfelIndex);
+                            }
+                    continue;
+                }
+
+                // Test all neighbors first, so that the loop has no branch to emit.
+                for (uint n = 0; n < 125; ++n)
+                {
+                    const int3 neighborPos = int3(cellPos.x + kNeighborOffsets.x[n], cellPos.y + kNeighborOffsets.y[n], cellPos.z + kNeighborOffsets.z[n]);
+                    intersects[n] = SurfelReference::isSurfelIntersectCell(
+                        surfel.position, surfel.radius, neighborPos, gridCenter, staticParams.cellUnit, staticParams.cellDim
+                    );
+                }
+
+                for (uint n = 0; n < 125; ++n)
+                {
+                    if (!intersects[n])
+                        continue;
+
+                    const int3 neighborPos = int3(cellPos.x + kNeighborOffsets.x[n], cellPos.y + kNeighborOffsets.y[n], cellPos.z + kNeighborOffsets.z[n]);
+                    const uint flattenIndex = SurfelReference::getFlattenCellIndex(neighborPos, staticParams.cellDim);
+                    pairs.push_back(((uint64_t)flattenIndex << 32) | surfelIndex);
+                }
+            }
+        }
+    );
+
+    std::vector<uint64_t> pairs;
+    for (const auto& chunkPair : chunkPairs)
+        pairs.insert(pairs.end(), chunkPair.begin(), chunkPair.end());
+    std::sort(pairs.begin(), pairs.end());
+
+    // Per cell limit is not applied, same as update pass.
+    mCellKeys.clear();
+    mCellInfos.clear();
+    mCellToSurfel.resize(pairs.size());
+
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        const uint flattenIndex = (uint)(pairs[i] >> 32);
+        if (mCellKeys.empty() || mCellKeys.back() != flattenIndex)
+        {
+            mCellKeys.push_back(flattenIndex);
+            mCellInfos.push_back({0, (uint)i});
+        }
+
+        mCellInfos.back().surfelCount++;
+        mCellToSurfel[i] = (uint)pairs[i];
+    }
+}
+
+void SurfelReferenceEngine::buildNeighborLists()
+{
+    const SurfelGIStaticParams& staticParams = mSettings.staticParams;
+    const float affectRadius = staticParams.cellUnit * std::sqrt(2.f);
+    const uint validSurfelCount = (uint)mValidIndices.size();
+
+    parallelFor(
+        validSurfelCount,
+        [&](uint chunkIndex, uint begin, uint end)
+        {
+            for (uint i = begin; i < end; ++i)
+            {
+                const uint surfelIndex = mValidIndices[i];
+                const Surfel& surfel = mSurfels[surfelIndex];
+                NeighborList list;
+
+                const int3 cellPos = SurfelReference::getCellPos(surfel.position, mGridCenter, staticParams.cellUnit);
+                if (SurfelReference::isCellValid(cellPos, staticParams.cellDim))
+                {
+                    for (uint n = 0; n < 27; ++n)
+                    {
+                        const int3 neighborPos = int3(cellPos.x + (int)(n % 3) - 1, cellPos.y + (int)(n / 3 % 3) - 1, cellPos.z + (int)(n / 9) - 1);
+                        if (!SurfelReference::isCellValid(neighborPos, staticParams.cellDim))
+                            continue;
+
+                        const CellInfo cellInfo = getCellInfo(SurfelReference::getFlattenCellIndex(neighborPos, staticParams.cellDim));
+                        const uint candidateCount = std::min(cellInfo.surfelCount, kMaxNeighborCandidateCount);
+
+                        for (uint j = 0; j < candidateCount; ++j)
+                        {
+                            const uint listIndex = j * cellInfo.surfelCount / candidateCount;
+                            const uint neiSurfelIndex = mCellToSurfel[cellInfo.cellToSurfelBufferOffset + listIndex];
+                            const Surfel& neiSurfel = mSurfels[neiSurfelIndex];
+
+                            const float3 bias = surfel.position - neiSurfel.position;
+                            const float dist2 = math::dot(bias, bias);
+                            if (dist2 >= affectRadius * affectRadius)
+                                continue;
+
+                            if (math::dot(neiSurfel.normal, surfel.normal) <= 0)
+                                continue;
+
+                            list.insert(neiSurfelIndex, dist2);
+                        }
+                    }
+                }
+
+                uint* pNeighbors = &mNeighbors[(size_t)surfelIndex * kMaxSurfelNeighborCount];
+                for (uint n = 0; n < kMaxSurfelNeighborCount; ++n)
+                    pNeighbors[n] = n < list.count ? list.indices[n] : kInvalidSurfelIndex;
+            }
+        }
+    );
+}
+
+CellInfo SurfelReferenceEngine::getCellInfo(uint flattenIndex) const
+{
+    auto it = std::lower_bound(mCellKeys.begin(), mCellKeys.end(), flattenIndex);
+    if (it == mCellKeys.end() || *it != flattenIndex)
+        return {0, 0};
+    return mCellInfos[it - mCellKeys.begin()];
+}
+
+float SurfelReferenceEngine::integrate(const std::vector<SurfelRayResult>& rayResults)
+{
+    const SurfelGIStaticParams& staticParams = mSettings.staticParams;
+    const SurfelGIRuntimeParams& runtimeParams = mSettings.runtimeParams;
+    const uint validSurfelCount = (uint)mValidIndices.size();
+
+    // Neighbor may be already integrated, so read copy of it.
+    std::vector<Surfel> snapshot;
+    if (staticParams.useIrradianceSharing)
+        snapshot = mSurfels;
+
+    const uint chunkCount = getChunkCount(validSurfelCount);
+    std::vector<double> chunkVariances(chunkCount, 0.0);
+    std::vector<uint> chunkCounts(chunkCount, 0);
+
+    parallelFor(
+        validSurfelCount,
+        [&](uint chunkIndex, uint begin, uint end)
+        {
+            for (uint i = begin; i < end; ++i)
+            {
+                const uint surfelIndex = mValidIndices[i];
+                Surfel& surfel = mSurfels[surfelIndex];
+
+                if (surfel.rayCount == 0 || surfel.rayOffset + surfel.rayCount > rayResults.size())
+                    continue;
+
+                float3 surfelRadiance = float3(0.f);
+                for (uint rayIndex = 0; rayIndex < surfel.rayCount; ++rayIndex)
+                {
+                    const SurfelRayResult& rayResult = rayResults[surfel.rayOffset + rayIndex];
+                    surfelRadiance += rayResult.radiance * math::dot(rayResult.dirWorld, surfel.normal) *
+                                      ((1.f / (16 * (float)M_PI)) / std::max(1e-12f, rayResult.pdf));
+                }
+                surfelRadiance /= (float)surfel.rayCount;
+
+                if (staticParams.useIrradianceSharing)
+                {
+                    const float affectRadius = staticParams.cellUnit * std::sqrt(2.f);
+                    const uint* pNeighbors = &mNeighbors[(size_t)surfelIndex * kMaxSurfelNeighborCount];
+
+                    float3 sharedRadiance = float3(0.f);
+                    float sharedWeight = 0.f;
+
+                    for (uint n = 0; n < kMaxSurfelNeighborCount && pNeighbors[n] != kInvalidSurfelIndex; ++n)
+                    {
+                        const Surfel& neiSurfel = snapshot[pNeighbors[n]];
+
+                        const float dist = math::length(surfel.position - neiSurfel.position);
+                        const float dotN = math::dot(neiSurfel.normal, surfel.normal);
+
+                        const float contribution = SurfelReference::calcContribution(dotN, dist, affectRadius);
+                        sharedRadiance += neiSurfel.radiance * contribution;
+                        sharedWeight += contribution;
+                    }
+
+                    if (sharedWeight > 0)
+                    {
+                        surfelRadiance = SurfelReference::lerp(
+                            surfelRadiance,
+                            sharedRadiance / sharedWeight,
+                            SurfelReference::saturate(math::length(surfel.msmeData.variance) * runtimeParams.varianceSensitivity)
+                        );
+                    }
+                }
+
+                surfel.radiance = SurfelReference::MSME(surfelRadiance, surfel.msmeData, runtimeParams.shortMeanWindow);
+
+                chunkVariances[chunkIndex] +=
+                    std::clamp(SurfelReference::luminance(surfel.msmeData.variance), 0.f, kConvergenceVarianceClamp);
+                chunkCounts[chunkIndex]++;
+            }
+        }
+    );
+
+    double varianceSum = 0.0;
+    uint count = 0;
+    for (uint i = 0; i < chunkCount; ++i)
+    {
+        varianceSum += chunkVariances[i];
+        count += chunkCounts[i];
+    }
+
+    return count > 0 ? (float)(varianceSum / count) : 0.f;
+}
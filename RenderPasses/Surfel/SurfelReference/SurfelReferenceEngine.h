@@ -0,0 +1,137 @@
+#pragma once
+#include "SurfelReferenceMath.h"
+#include "SurfelLod.h"
+#include "TaskScheduler.h"
+#include "../SurfelGI/SurfelGIParams.h"
+
+// CPU version of surfel update and integrate passes, used as reference for GPU results.
+// Matches deterministic mode: lists are built in surfel index order, and integrate reads snapshot of surfels.
+// Surfel hierarchy of useLod has no GPU counterpart yet, so results with it only compare with SurfelGICPU.
+// Not covered, as they need scene or ray tracing:
+//   - Surfel position and normal are kept, as with static geometry. Caller may move them with getSurfels().
+//   - Ray results are given by caller, in the layout allocated by update().
+//   - Surfel depth is not tracked, so irradiance sharing has no depth test (same as useSurfelDepth off).
+class SurfelReferenceEngine
+{
+public:
+    struct Settings
+    {
+        SurfelGIStaticParams staticParams;
+        SurfelGIRuntimeParams runtimeParams;
+        uint surfelLimit = kTotalSurfelLimit;
+        uint rayBudget = kRayBudget;
+        uint threadCount = 0;                 ///< 0 uses hardware concurrency. Ignored if scheduler is given.
+        TaskScheduler* pScheduler = nullptr;  ///< Shared with other CPU work if given. Must outlive engine.
+        bool useLod = false;                  ///< Merge far field surfels into parents. Not in SurfelGI.
+        SurfelReference::SurfelLodParams lodParams;
+    };
+
+    struct LodStats
+    {
+        uint parentCount = 0;
+        uint mergedSurfelCount = 0; ///< Surfels held by parents, at any level.
+        uint mergeCount = 0;        ///< Parents created at last update().
+        uint splitCount = 0;        ///< Parents split at last update().
+    };
+
+    SurfelReferenceEngine(const Settings& settings);
+
+    void reset();
+
+    // Allocate surfels in given order. Free slots are popped from the end, as allocateSpawnRequests does.
+    // Surfels are stored as given, so MSME data should be initialized as generation pass does.
+    // Returns number of allocated surfels.
+    uint spawn(const std::vector<Surfel>& surfels);
+
+    // Same as flags written during frame on GPU, consumed at next update().
+    // Atomic, so that they can be called from parallel work between update() calls.
+    void markSeen(uint surfelIndex) { mFlags[surfelIndex] |= kSurfelFlagSeen; }
+    void markDestroy(uint surfelIndex) { mFlags[surfelIndex] |= kSurfelFlagDestroy; }
+    void addRef(uint surfelIndex, uint count = 1) { mRefCounts[surfelIndex] += count; }
+
+    // Recycle surfels, merge and split surfel hierarchy, update radius and ray count, allocate rays and build cell lists.
+    void update(const std::vector<SurfelView>& views);
+
+    // Integrate radiance from rays allocated by last update(). Returns mean variance luminance of surfels with rays.
+    float integrate(const std::vector<SurfelRayResult>& rayResults);
+
+    std::vector<Surfel>& getSurfels() { return mSurfels; }
+    const std::vector<Surfel>& getSurfels() const { return mSurfels; }
+    const std::vector<SurfelRecycleInfo>& getRecycleInfos() const { return mRecycleInfos; }
+    const std::vector<uint>& getValidSurfelIndices() const { return mValidIndices; }
+    uint getRequestedRayCount() const { return mRequestedRayCount; }
+
+    // Owner surfel of ray allocated by last update(), found by binary search over ray offsets as ray gen does.
+    uint findRaySurfel(uint rayIndex) const;
+    float3 getGridCenter() const { return mGridCenter; }
+
+    // Cells without surfel are not stored. Surfel indices of cell are in ascending order.
+    CellInfo getCellInfo(uint flattenIndex) const;
+    const std::vector<uint>& getCellToSurfelBuffer() const { return mCellToSurfel; }
+
+    // Neighbors for irradiance sharing, built by last update() if enabled. kMaxSurfelNeighborCount per surfel index,
+    // nearest first and terminated with kInvalidSurfelIndex.
+    const std::vector<uint>& getNeighborBuffer() const { return mNeighbors; }
+
+    // Level 0 is surfel without children.
+    uint getLodLevel(uint surfelIndex) const { return mLodNodes[surfelIndex].level; }
+    const LodStats& getLodStats() const { return mLodStats; }
+
+private:
+    struct LodNode
+    {
+        uint level = 0;
+        bool merged = false;             ///< Held by parent, so neither valid nor free.
+        float radius = 0.f;              ///< Radius covering children, kept over radius by view.
+        float3 mergedMean = float3(0.f); ///< Mean of parent when merged, for split.
+        std::vector<uint> children;
+    };
+
+    struct SurfelBatch
+    {
+        std::vector<float> posX, posY, posZ;
+        std::vector<float> radius;
+        std::vector<uint8_t> sleeping;
+        std::vector<uint8_t> alive;
+
+        void resize(size_t count);
+    };
+
+    void recycleSurfels(const std::vector<SurfelView>& views);
+    void updateLod(const std::vector<SurfelView>& views);
+    void splitSurfel(uint surfelIndex);
+    void releaseChildren(uint surfelIndex);
+    void compactSurfelSlots();
+    void allocateSurfelRays();
+    void buildCellLists();
+    void buildNeighborLists();
+
+    // Func is called with (chunk index, begin, end). Chunks do not depend on thread count,
+    // so that per chunk results are reduced in same order on any machine.
+    template<typename Func>
+    void parallelFor(uint count, const Func& func) const;
+
+    Settings mSettings;
+    uint mThreadCount = 1;
+
+    std::vector<Surfel> mSurfels;
+    std::vector<SurfelRecycleInfo> mRecycleInfos;
+    std::unique_ptr<std::atomic<uint>[]> mFlags;
+    std::unique_ptr<std::atomic<uint>[]> mRefCounts;
+
+    std::vector<uint> mValidIndices;
+    std::vector<uint> mFreeIndices;
+    std::vector<uint> mRayOffsets; ///< Ray offset of each valid index, ascending.
+    uint mRequestedRayCount = 0;
+    float3 mGridCenter = float3(0.f);
+
+    SurfelBatch mBatch;
+
+    std::vector<uint> mCellKeys; ///< Flatten index of non-empty cells, ascending.
+    std::vector<CellInfo> mCellInfos;
+    std::vector<uint> mCellToSurfel;
+    std::vector<uint> mNeighbors;
+
+    std::vector<LodNode> mLodNodes;
+    LodStats mLodStats;
+};
@@ -0,0 +1,55 @@
+#include "SurfelReferenceMath.h"
+
+namespace SurfelReference
+{
+
+float3 MSME(float3 y, MSMEData& data, float shortWindowBlend)
+{
+    const float3 kLuminanceWeight = float3(0.299f, 0.587f, 0.114f);
+
+    float3 mean = data.mean;
+    float3 shortMean = data.shortMean;
+    float vbbr = data.vbbr;
+    float3 variance = data.variance;
+    float inconsistency = data.inconsistency;
+
+    // Suppress fireflies.
+    {
+        const float3 dev = math::sqrt(math::max(float3(1e-5f), variance));
+        const float3 highThreshold = float3(0.1f) + shortMean + dev * 8.f;
+        const float3 overflow = math::max(float3(0.f), y - highThreshold);
+        y -= overflow;
+    }
+
+    const float3 delta = y - shortMean;
+    shortMean = lerp(shortMean, y, shortWindowBlend);
+    const float3 delta2 = y - shortMean;
+
+    const float varianceBlend = shortWindowBlend * 0.5f;
+    variance = lerp(variance, delta * delta2, varianceBlend);
+    const float3 dev = math::sqrt(math::max(float3(1e-5f), variance));
+
+    const float3 shortDiff = mean - shortMean;
+
+    const float relativeDiff = math::dot(kLuminanceWeight, math::abs(shortDiff) / math::max(float3(1e-5f), dev));
+    inconsistency = inconsistency + (relativeDiff - inconsistency) * 0.08f;
+
+    const float varianceBasedBlendReduction =
+        std::clamp(math::dot(kLuminanceWeight, 0.5f * shortMean / math::max(float3(1e-5f), dev)), 1.f / 32, 1.f);
+
+    float catchUpBlend = std::clamp(smoothstep(0, 1, relativeDiff * std::max(0.02f, inconsistency - 0.2f)), 1.f / 256, 1.f);
+    catchUpBlend *= vbbr;
+
+    vbbr = vbbr + (varianceBasedBlendReduction - vbbr) * 0.1f;
+    mean = lerp(mean, y, saturate(catchUpBlend));
+
+    data.mean = mean;
+    data.shortMean = shortMean;
+    data.vbbr = vbbr;
+    data.variance = variance;
+    data.inconsistency = inconsistency;
+
+    return mean;
+}
+
+} // namespace SurfelReference
@@ -0,0 +1,302 @@
+#pragma once
+#include "Falcor.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace Falcor;
+
+// MSMEData is declared outside of Falcor namespace, so types must be visible before include.
+#include "../SurfelGI/SurfelTypes.slang"
+
+// Host versions of surfel math in SurfelUtils.slang, MultiscaleMeanEstimator.slang and SurfaceCache.slang.
+// They follow GPU semantics rather than usual C++ ones where the two differ, noted at each function.
+// Static params which are compile time constants on GPU are passed as arguments.
+namespace SurfelReference
+{
+
+inline float saturate(float x)
+{
+    return std::clamp(x, 0.f, 1.f);
+}
+
+inline float smoothstep(float edge0, float edge1, float x)
+{
+    const float t = saturate((x - edge0) / (edge1 - edge0));
+    return t * t * (3.f - 2.f * t);
+}
+
+inline float3 lerp(const float3& a, const float3& b, float t)
+{
+    return a + (b - a) * t;
+}
+
+inline float luminance(const float3& rgb)
+{
+    return math::dot(rgb, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// HLSL round() rounds halfway cases to even, as nearbyint does with default rounding mode.
+// std::round would move surfels at cell boundaries to other cell.
+inline int3 getCellPos(const float3& posW, const float3& gridCenter, float cellUnit)
+{
+    const float3 posC = (posW - gridCenter) / cellUnit;
+    return int3((int)std::nearbyint(posC.x), (int)std::nearbyint(posC.y), (int)std::nearbyint(posC.z));
+}
+
+// Same unsigned wrap around as GPU. Only meaningful for valid cell.
+inline uint getFlattenCellIndex(const int3& cellPos, uint cellDim)
+{
+    const uint x = (uint)cellPos.x + cellDim / 2;
+    const uint y = (uint)cellPos.y + cellDim / 2;
+    const uint z = (uint)cellPos.z + cellDim / 2;
+    return (z * cellDim * cellDim) + (y * cellDim) + x;
+}
+
+// Compared as signed, since kCellDimension / 2 is promoted to int with abs() on GPU.
+inline bool isCellValid(const int3& cellPos, uint cellDim)
+{
+    const int halfDim = (int)(cellDim / 2);
+    return std::abs(cellPos.x) < halfDim && std::abs(cellPos.y) < halfDim && std::abs(cellPos.z) < halfDim;
+}
+
+inline bool isSurfelIntersectCell(
+    const float3& surfelPos,
+    float surfelRadius,
+    const int3& cellPos,
+    const float3& gridCenter,
+    float cellUnit,
+    uint cellDim
+)
+{
+    if (!isCellValid(cellPos, cellDim))
+        return false;
+
+    const float3 cellCenter = float3(cellPos) * cellUnit + gridCenter;
+    const float3 minPosW = cellCenter - float3(cellUnit / 2.f);
+    const float3 maxPosW = cellCenter + float3(cellUnit / 2.f);
+    const float3 closePoint = math::min(math::max(surfelPos, minPosW), maxPosW);
+
+    return math::length(closePoint - surfelPos) < surfelRadius;
+}
+
+inline float calcRadiusApprox(float area, float distance, float fovy, uint2 resolution)
+{
+    return distance * std::tan(std::sqrt(area / (float)M_PI) * fovy / (float)std::max(resolution.x, resolution.y));
+}
+
+inline float calcSurfelRadius(float distance, float fovy, uint2 resolution, float area, float cellUnit)
+{
+    return std::min(calcRadiusApprox(area, distance, fovy, resolution), cellUnit * 2);
+}
+
+// Octahedral encoding, modified for hemisphere projection. Input needs not be normalized.
+inline float2 octEncode(const float3& v)
+{
+    const float l1norm = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    const float2 result = float2(v.x, v.y) * (1.f / l1norm);
+    return float2(result.x - result.y, result.x + result.y);
+}
+
+inline float3 octDecode(const float2& uv)
+{
+    const float2 result = float2((uv.x + uv.y) / 2.f, (uv.y - uv.x) / 2.f);
+    return math::normalize(float3(result.x, result.y, 1.f - std::abs(result.x) - std::abs(result.y)));
+}
+
+// Same as ndir_to_oct_snorm and oct_to_ndir_snorm of MathHelpers.slang, full sphere to [-1, 1]^2.
+inline float2 octWrap(const float2& v)
+{
+    return float2((1.f - std::abs(v.y)) * (v.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(v.x)) * (v.y >= 0.f ? 1.f : -1.f));
+}
+
+inline float2 ndirToOctSnorm(const float3& n)
+{
+    const float2 p = float2(n.x, n.y) * (1.f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z)));
+    return n.z < 0.f ? octWrap(p) : p;
+}
+
+inline float3 octToNdirSnorm(const float2& p)
+{
+    const float z = 1.f - std::abs(p.x) - std::abs(p.y);
+    const float2 xy = z < 0.f ? octWrap(p) : p;
+    return math::normalize(float3(xy.x, xy.y, z));
+}
+
+// Surface cache packing. GPU round is to nearest even, which std::nearbyint does in default rounding mode.
+inline uint packSurfaceNormal(const float3& normal)
+{
+    const float2 oct = ndirToOctSnorm(normal);
+    const int sx = (int)std::nearbyint(std::clamp(oct.x, -1.f, 1.f) * 32767.f);
+    const int sy = (int)std::nearbyint(std::clamp(oct.y, -1.f, 1.f) * 32767.f);
+    return ((uint)sx & 0xFFFF) | ((uint)sy << 16);
+}
+
+inline float3 unpackSurfaceNormal(uint packed)
+{
+    // Sign extended by arithmetic shift.
+    const int sx = (int)(packed << 16) >> 16;
+    const int sy = (int)packed >> 16;
+    return octToNdirSnorm(float2(std::max((float)sx / 32767.f, -1.f), std::max((float)sy / 32767.f, -1.f)));
+}
+
+inline uint packSurfaceAlbedo(const float3& albedo)
+{
+    const uint x = (uint)std::nearbyint(saturate(albedo.x) * 255.f);
+    const uint y = (uint)std::nearbyint(saturate(albedo.y) * 255.f);
+    const uint z = (uint)std::nearbyint(saturate(albedo.z) * 255.f);
+    return x | (y << 8) | (z << 16);
+}
+
+inline float3 unpackSurfaceAlbedo(uint packed)
+{
+    return float3((float)(packed & 0xFF), (float)((packed >> 8) & 0xFF), (float)((packed >> 16) & 0xFF)) / 255.f;
+}
+
+// Same as get_tangentspace, returned as rows of the matrix.
+struct TangentSpace
+{
+    float3 tangent;
+    float3 binormal;
+    float3 normal;
+
+    // mul(dirLocal, get_tangentspace(normal)) on GPU.
+    float3 toWorld(const float3& dirLocal) const { return tangent * dirLocal.x + binormal * dirLocal.y + normal * dirLocal.z; }
+};
+
+inline TangentSpace getTangentSpace(const float3& normal)
+{
+    const float3 helper = std::abs(normal.x) > 0.99f ? float3(0, 0, 1) : float3(1, 0, 0);
+
+    TangentSpace space;
+    space.tangent = math::normalize(math::cross(normal, helper));
+    space.binormal = math::normalize(math::cross(normal, space.tangent));
+    space.normal = normal;
+    return space;
+}
+
+inline float3 hemispherePointUniform(float u, float v)
+{
+    const float phi = v * 2 * (float)M_PI;
+    const float cosTheta = 1 - u;
+    const float sinTheta = std::sqrt(1 - cosTheta * cosTheta);
+    return float3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+}
+
+// Same sequence as RNG in Random.slang.
+struct RNG
+{
+    uint32_t s[2];
+
+    static uint32_t rotl(uint32_t x, uint32_t k) { return (x << k) | (x >> (32 - k)); }
+
+    static uint32_t hash(uint32_t seed)
+    {
+        seed = (seed ^ 61) ^ (seed >> 16);
+        seed *= 9;
+        seed = seed ^ (seed >> 4);
+        seed *= 0x27d4eb2d;
+        seed = seed ^ (seed >> 15);
+        return seed;
+    }
+
+    void init(uint2 id, uint frameIndex)
+    {
+        id.x += frameIndex;
+        id.y += frameIndex;
+        s[0] = hash((id.x << 16) | id.y);
+        s[1] = hash(frameIndex);
+        next();
+    }
+
+    uint32_t next()
+    {
+        const uint32_t result = s[0] * 0x9e3779bb;
+
+        s[1] ^= s[0];
+        s[0] = rotl(s[0], 26) ^ s[1] ^ (s[1] << 9);
+        s[1] = rotl(s[1], 13);
+
+        return result;
+    }
+
+    float nextFloat()
+    {
+        const uint32_t u = 0x3f800000 | (next() >> 9);
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f - 1.f;
+    }
+
+    uint nextUint(uint nmax) { return (uint)std::floor(nextFloat() * nmax); }
+};
+
+// Weight of surfel at shading point, shared by evaluation and irradiance sharing.
+// dotN is dot of surfel normal and shading normal, and should be positive.
+inline float calcContribution(float dotN, float dist, float radius)
+{
+    float contribution = 1.f;
+    contribution *= saturate(dotN);
+    contribution *= saturate(1 - dist / radius);
+    return smoothstep(0, 1, contribution);
+}
+
+// Same as allocateSurfelRays pass. Rays are packed in list order, and once budget is exceeded, rest of surfels get no ray.
+// Offsets keep growing past budget, so that search below stays valid. Returns number of rays to trace,
+// which ends at last surfel with rays.
+inline uint allocateRays(
+    const std::vector<uint>& requestedRayCounts,
+    uint rayBudget,
+    std::vector<uint>& rayOffsets,
+    std::vector<uint>& rayCounts
+)
+{
+    rayOffsets.resize(requestedRayCounts.size());
+    rayCounts.resize(requestedRayCounts.size());
+
+    uint rayBase = 0;
+    uint allocatedRayCount = 0;
+    for (size_t i = 0; i < requestedRayCounts.size(); ++i)
+    {
+        rayOffsets[i] = rayBase;
+        rayCounts[i] = (rayBase + requestedRayCounts[i] <= rayBudget) ? requestedRayCounts[i] : 0;
+        rayBase += requestedRayCounts[i];
+        allocatedRayCount += rayCounts[i];
+    }
+
+    return allocatedRayCount;
+}
+
+// Same search as ray gen. Index of last offset which is not greater than ray index.
+inline uint findRayOwner(const std::vector<uint>& rayOffsets, uint rayIndex)
+{
+    uint lower = 0;
+    uint upper = (uint)rayOffsets.size();
+
+    while (upper - lower > 1)
+    {
+        const uint middle = (lower + upper) / 2;
+        if (rayOffsets[middle] <= rayIndex)
+            lower = middle;
+        else
+            upper = middle;
+    }
+
+    return lower;
+}
+
+// Same as MSMEData initializer on GPU.
+inline MSMEData makeMSMEData()
+{
+    MSMEData data;
+    data.mean = float3(0.f);
+    data.shortMean = float3(0.f);
+    data.vbbr = 0.f;
+    data.variance = float3(0.f);
+    data.inconsistency = 1.f;
+    return data;
+}
+
+float3 MSME(float3 y, MSMEData& data, float shortWindowBlend = 0.08f);
+
+} // namespace SurfelReference
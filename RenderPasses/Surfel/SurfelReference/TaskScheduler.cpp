@@ -0,0 +1,141 @@
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(uint threadCount)
+{
+    const uint workerCount = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint i = 0; i < workerCount; ++i)
+        mQueues.push_back(std::make_unique<Queue>());
+
+    for (uint i = 1; i < workerCount; ++i)
+        mThreads.emplace_back([this, i]() { workerLoop(i); });
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mStop = true;
+    }
+    mWakeCondition.notify_all();
+
+    for (auto& thread : mThreads)
+        thread.join();
+}
+
+void TaskScheduler::parallelFor(uint count, uint grainSize, const RangeFunc& func)
+{
+    if (count == 0)
+        return;
+
+    grainSize = std::max(1u, grainSize);
+    const uint rangeCount = (count + grainSize - 1) / grainSize;
+
+    Job job;
+    job.pFunc = &func;
+    job.remainingRangeCount = rangeCount;
+
+    // Contiguous block of ranges per worker, so that neighbor ranges stay on same worker unless stolen.
+    const uint workerCount = getWorkerCount();
+    for (uint i = 0; i < rangeCount; ++i)
+    {
+        const uint workerIndex = (uint)((uint64_t)i * workerCount / rangeCount);
+        const Range range = {&job, i * grainSize, std::min(count, (i + 1) * grainSize)};
+
+        std::lock_guard<std::mutex> lock(mQueues[workerIndex]->mutex);
+        mQueues[workerIndex]->ranges.push_back(range);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mGeneration++;
+    }
+    mWakeCondition.notify_all();
+
+    runRanges(0);
+
+    // Ranges taken by other workers may still be running.
+    {
+        std::unique_lock<std::mutex> lock(mDoneMutex);
+        mDoneCondition.wait(lock, [&job]() { return job.remainingRangeCount.load() == 0; });
+    }
+
+    if (job.pError)
+        std::rethrow_exception(job.pError);
+}
+
+void TaskScheduler::workerLoop(uint workerIndex)
+{
+    uint64_t generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWakeCondition.wait(lock, [&]() { return mStop || mGeneration != generation; });
+            if (mStop)
+                return;
+            generation = mGeneration;
+        }
+
+        runRanges(workerIndex);
+    }
+}
+
+void TaskScheduler::runRanges(uint workerIndex)
+{
+    Range range;
+    while (popRange(workerIndex, range))
+        runRange(workerIndex, range);
+}
+
+bool TaskScheduler::popRange(uint workerIndex, Range& range)
+{
+    {
+        Queue& queue = *mQueues[workerIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.ranges.empty())
+        {
+            range = queue.ranges.back();
+            queue.ranges.pop_back();
+            return true;
+        }
+    }
+
+    // Own queue is empty, steal oldest range of other worker.
+    const uint workerCount = getWorkerCount();
+    for (uint i = 1; i < workerCount; ++i)
+    {
+        Queue& queue = *mQueues[(workerIndex + i) % workerCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.ranges.empty())
+        {
+            range = queue.ranges.front();
+            queue.ranges.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TaskScheduler::runRange(uint workerIndex, const Range& range)
+{
+    Job& job = *range.pJob;
+
+    try
+    {
+        (*job.pFunc)(workerIndex, range.begin, range.end);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(job.errorMutex);
+        if (!job.pError)
+            job.pError = std::current_exception();
+    }
+
+    // Notify under lock, so that job is not destroyed between decrement and notify.
+    std::lock_guard<std::mutex> lock(mDoneMutex);
+    if (--job.remainingRangeCount == 0)
+        mDoneCondition.notify_all();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Falcor.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace Falcor;
+
+// Work stealing scheduler for data parallel loops of CPU backend.
+// Each worker has own queue of ranges. Workers pop from back of own queue, and steal from front of others,
+// so uneven ranges (e.g. paths of different length) are balanced without central queue.
+class TaskScheduler
+{
+public:
+    // Range function is called with (worker index, begin, end). Worker index is less than getWorkerCount().
+    using RangeFunc = std::function<void(uint, uint, uint)>;
+
+    // threadCount 0 uses hardware concurrency. Calling thread works as worker 0, so threadCount - 1 threads are started.
+    explicit TaskScheduler(uint threadCount = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    uint getWorkerCount() const { return (uint)mQueues.size(); }
+
+    // Split [0, count) into ranges of grainSize, and run them on all workers. Returns when every range is done.
+    // Exception thrown by func is rethrown here, after remaining ranges are done.
+    // Not reentrant, func must not call parallelFor.
+    void parallelFor(uint count, uint grainSize, const RangeFunc& func);
+
+private:
+    struct Job
+    {
+        const RangeFunc* pFunc = nullptr;
+        std::atomic<uint> remainingRangeCount{0};
+        std::mutex errorMutex;
+        std::exception_ptr pError;
+    };
+
+    struct Range
+    {
+        Job* pJob;
+        uint begin;
+        uint end;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(uint workerIndex);
+    void runRanges(uint workerIndex);
+    bool popRange(uint workerIndex, Range& range);
+    void runRange(uint workerIndex, const Range& range);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mThreads;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeCondition;
+    uint64_t mGeneration = 0;
+    bool mStop = false;
+
+    std::mutex mDoneMutex;
+    std::condition_variable mDoneCondition;
+};
@@ -0,0 +1,118 @@
+#include "SurfelSurfaceCache.h"
+#include "../SurfelGI/ResolutionScale.h"
+
+namespace
+{
+// Camera which linear depth is measured from, same as the one packed hit info is rendered with.
+// If not given, active camera of scene is used.
+const std::string kCameraIndex = "cameraIndex";
+
+const std::string kPackedHitInfoTextureName = "packedHitInfo";
+const std::string kSurfacePosWTextureName = "surfacePosW";
+const std::string kSurfaceDataTextureName = "surfaceData";
+} // namespace
+
+SurfelSurfaceCache::SurfelSurfaceCache(ref<Device> pDevice, const Properties& props) : RenderPass(pDevice)
+{
+    mpState = ComputeState::create(mpDevice);
+
+    if (auto cameraIndex = props.getOpt<uint>(kCameraIndex))
+    {
+        mCameraIndex = *cameraIndex;
+        mUseActiveCamera = false;
+    }
+}
+
+Properties SurfelSurfaceCache::getProperties() const
+{
+    Properties props;
+    if (!mUseActiveCamera)
+        props[kCameraIndex] = mCameraIndex;
+    return props;
+}
+
+RenderPassReflection SurfelSurfaceCache::reflect(const CompileData& compileData)
+{
+    RenderPassReflection reflector;
+
+    // Input
+    reflector.addInput(kPackedHitInfoTextureName, "packed hit info texture")
+        .format(ResourceFormat::RGBA32Uint)
+        .bindFlags(ResourceBindFlags::ShaderResource);
+
+    // Output
+    reflector.addOutput(kSurfacePosWTextureName, "world position and linear depth")
+        .format(ResourceFormat::RGBA32Float)
+        .bindFlags(ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+
+    reflector.addOutput(kSurfaceDataTextureName, "packed normal and albedo")
+        .format(ResourceFormat::RG32Uint)
+        .bindFlags(ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+
+    return reflector;
+}
+
+void SurfelSurfaceCache::execute(RenderContext* pRenderContext, const RenderData& renderData)
+{
+    if (!mpProgram)
+        return;
+
+    FALCOR_PROFILE(pRenderContext, "Surface Cache");
+
+    const auto& pPackedHitInfo = renderData.getTexture(kPackedHitInfoTextureName);
+    const uint2 resolution =
+        getRenderResolution(uint2(pPackedHitInfo->getWidth(), pPackedHitInfo->getHeight()), getResolutionScale(renderData));
+
+    auto var = mpVars->getRootVar();
+    mpScene->setRaytracingShaderData(pRenderContext, var);
+
+    var["CB"]["gResolution"] = resolution;
+    getCamera()->bindShaderData(var["CB"]["gCamera"]);
+
+    var["gPackedHitInfo"] = pPackedHitInfo;
+    var["gSurfacePosW"] = renderData.getTexture(kSurfacePosWTextureName);
+    var["gSurfaceData"] = renderData.getTexture(kSurfaceDataTextureName);
+
+    uint3 threadGroupSize = mpProgram->getReflector()->getThreadGroupSize();
+    uint3 groups = div_round_up(uint3(resolution, 1), threadGroupSize);
+    pRenderContext->dispatch(mpState.get(), mpVars.get(), groups);
+}
+
+void SurfelSurfaceCache::renderUI(Gui::Widgets& widget)
+{
+    if (!mpScene || mpScene->getCameras().size() <= 1)
+        return;
+
+    widget.checkbox("Use active camera", mUseActiveCamera);
+    if (!mUseActiveCamera)
+        widget.slider("Camera index", mCameraIndex, 0u, (uint)mpScene->getCameras().size() - 1);
+}
+
+const ref<Camera>& SurfelSurfaceCache::getCamera() const
+{
+    const auto& cameras = mpScene->getCameras();
+    if (mUseActiveCamera || cameras.empty())
+        return mpScene->getCamera();
+
+    return cameras[std::min<size_t>(mCameraIndex, cameras.size() - 1)];
+}
+
+void SurfelSurfaceCache::setScene(RenderContext* pRenderContext, const ref<Scene>& pScene)
+{
+    mpScene = pScene;
+    mpProgram = nullptr;
+    mpVars = nullptr;
+
+    if (mpScene)
+    {
+        ProgramDesc desc;
+        desc.addShaderModules(mpScene->getShaderModules());
+        desc.addShaderLibrary("RenderPasses/Surfel/SurfelSurfaceCache/SurfelSurfaceCache.cs.slang").csEntry("csMain");
+        desc.addTypeConformances(mpScene->getTypeConformances());
+
+        mpProgram = Program::create(mpDevice, desc, mpScene->getSceneDefines());
+        mpState->setProgram(mpProgram);
+
+        mpVars = ProgramVars::create(mpDevice, mpProgram.get());
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "Falcor.h"
+#include "RenderGraph/RenderPass.h"
+
+using namespace Falcor;
+
+// Decode packed hit info once per frame into compact surface of each pixel (see SurfaceCache.slang).
+// SurfelGI and SurfelGIRenderPass read it when connected, and fall back to packed hit info otherwise.
+class SurfelSurfaceCache : public RenderPass
+{
+public:
+    FALCOR_PLUGIN_CLASS(SurfelSurfaceCache, "SurfelSurfaceCache", "Compact per-pixel surface shared by surfel passes");
+
+    static ref<SurfelSurfaceCache> create(ref<Device> pDevice, const Properties& props)
+    {
+        return make_ref<SurfelSurfaceCache>(pDevice, props);
+    }
+
+    SurfelSurfaceCache(ref<Device> pDevice, const Properties& props);
+
+    virtual Properties getProperties() const override;
+    virtual RenderPassReflection reflect(const CompileData& compileData) override;
+    virtual void compile(RenderContext* pRenderContext, const CompileData& compileData) override {}
+    virtual void execute(RenderContext* pRenderContext, const RenderData& renderData) override;
+    virtual void renderUI(Gui::Widgets& widget) override;
+    virtual void setScene(RenderContext* pRenderContext, const ref<Scene>& pScene) override;
+    virtual bool onMouseEvent(const MouseEvent& mouseEvent) override { return false; }
+    virtual bool onKeyEvent(const KeyboardEvent& keyEvent) override { return false; }
+
+private:
+    const ref<Camera>& getCamera() const;
+
+    ref<Scene> mpScene;
+    ref<ComputeState> mpState;
+    ref<Program> mpProgram;
+    ref<ProgramVars> mpVars;
+
+    uint mCameraIndex = 0;
+    bool mUseActiveCamera = true;
+};
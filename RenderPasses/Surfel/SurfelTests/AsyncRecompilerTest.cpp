@@ -0,0 +1,166 @@
+#include "SurfelGI/AsyncRecompiler.h"
+#include <gtest/gtest.h>
+#include <deque>
+#include <stdexcept>
+
+namespace
+{
+
+using Recompiler = AsyncRecompiler<int>;
+
+// Stub compiler. Jobs are not run until test finishes them, so every state can be observed.
+struct StubCompiler
+{
+    struct PendingJob
+    {
+        Recompiler::Job job;
+        std::promise<int> promise;
+    };
+
+    std::deque<PendingJob> jobs;
+    int launchCount = 0;
+
+    Recompiler::Launcher getLauncher()
+    {
+        return [this](Recompiler::Job job)
+        {
+            launchCount++;
+            jobs.push_back({std::move(job), {}});
+            return jobs.back().promise.get_future();
+        };
+    }
+
+    // Run oldest launched job, as worker thread would.
+    void finishNext()
+    {
+        ASSERT_FALSE(jobs.empty());
+        PendingJob pending = std::move(jobs.front());
+        jobs.pop_front();
+        try
+        {
+            pending.promise.set_value(pending.job());
+        }
+        catch (...)
+        {
+            pending.promise.set_exception(std::current_exception());
+        }
+    }
+};
+
+Recompiler::Job makeJob(int value)
+{
+    return [value]() { return value; };
+}
+
+} // namespace
+
+TEST(AsyncRecompilerTest, SwapsResultOnce)
+{
+    StubCompiler compiler;
+    Recompiler recompiler(compiler.getLauncher());
+
+    EXPECT_EQ(recompiler.getState(), Recompiler::State::Idle);
+    EXPECT_FALSE(recompiler.poll());
+
+    recompiler.request(makeJob(1));
+    EXPECT_TRUE(recompiler.isBuilding());
+
+    // Current programs stay in use while job runs.
+    EXPECT_FALSE(recompiler.poll());
+    EXPECT_TRUE(recompiler.isBuilding());
+
+    compiler.finishNext();
+    EXPECT_EQ(recompiler.poll(), 1);
+    EXPECT_EQ(recompiler.getState(), Recompiler::State::Idle);
+    EXPECT_FALSE(recompiler.poll());
+}
+
+TEST(AsyncRecompilerTest, OnlyLatestRequestIsSwapped)
+{
+    StubCompiler compiler;
+    Recompiler recompiler(compiler.getLauncher());
+
+    recompiler.request(makeJob(1));
+    recompiler.request(makeJob(2));
+    recompiler.request(makeJob(3));
+
+    // Queued requests replace each other, and are not launched while one is in flight.
+    EXPECT_EQ(compiler.launchCount, 1);
+    EXPECT_TRUE(recompiler.hasPendingRequest());
+
+    compiler.finishNext();
+    EXPECT_FALSE(recompiler.poll());
+    EXPECT_EQ(compiler.launchCount, 2);
+    EXPECT_FALSE(recompiler.hasPendingRequest());
+
+    compiler.finishNext();
+    EXPECT_EQ(recompiler.poll(), 3);
+    EXPECT_EQ(recompiler.getState(), Recompiler::State::Idle);
+}
+
+TEST(AsyncRecompilerTest, FailureKeepsCurrentPrograms)
+{
+    StubCompiler compiler;
+    Recompiler recompiler(compiler.getLauncher());
+
+    recompiler.request([]() -> int { throw std::runtime_error("Compile error."); });
+    compiler.finishNext();
+
+    EXPECT_FALSE(recompiler.poll());
+    EXPECT_EQ(recompiler.getState(), Recompiler::State::Failed);
+    EXPECT_EQ(recompiler.getError(), "Compile error.");
+
+    // Next request clears error.
+    recompiler.request(makeJob(4));
+    EXPECT_TRUE(recompiler.getError().empty());
+    compiler.finishNext();
+    EXPECT_EQ(recompiler.poll(), 4);
+}
+
+TEST(AsyncRecompilerTest, FailedJobIsSupersededByQueuedOne)
+{
+    StubCompiler compiler;
+    Recompiler recompiler(compiler.getLauncher());
+
+    recompiler.request([]() -> int { throw std::runtime_error("Compile error."); });
+    recompiler.request(makeJob(5));
+
+    compiler.finishNext();
+    EXPECT_FALSE(recompiler.poll());
+    EXPECT_TRUE(recompiler.isBuilding());
+    EXPECT_TRUE(recompiler.getError().empty());
+
+    compiler.finishNext();
+    EXPECT_EQ(recompiler.poll(), 5);
+}
+
+TEST(AsyncRecompilerTest, CancelDropsQueuedRequest)
+{
+    StubCompiler compiler;
+    Recompiler recompiler(compiler.getLauncher());
+
+    recompiler.request(makeJob(1));
+    recompiler.request(makeJob(2));
+
+    // Cancel waits for job in flight, so finish it first.
+    compiler.finishNext();
+    recompiler.cancel();
+
+    EXPECT_EQ(recompiler.getState(), Recompiler::State::Idle);
+    EXPECT_FALSE(recompiler.hasPendingRequest());
+    EXPECT_FALSE(recompiler.poll());
+    EXPECT_EQ(compiler.launchCount, 1);
+}
+
+TEST(AsyncRecompilerTest, WaitReturnsLatestResult)
+{
+    // Default launcher runs jobs on worker thread.
+    Recompiler recompiler;
+
+    recompiler.request(makeJob(1));
+    recompiler.request(makeJob(2));
+
+    EXPECT_EQ(recompiler.wait(), 2);
+    EXPECT_EQ(recompiler.getState(), Recompiler::State::Idle);
+    EXPECT_FALSE(recompiler.wait());
+}
@@ -0,0 +1,170 @@
+#include "SurfelGI/ConvergenceMonitor.h"
+#include "SurfelGI/SurfelTypes.slang"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace
+{
+
+ConvergenceMonitor::Criteria createCriteria()
+{
+    ConvergenceMonitor::Criteria criteria;
+    criteria.varianceThreshold = 1e-3f;
+    criteria.minIterationCount = 4;
+    criteria.maxIterationCount = 16;
+    criteria.stableIterationCount = 2;
+    return criteria;
+}
+
+// Sum of encoded variances as integrate pass accumulates it: 32-bit wave sums added to low word,
+// and one carried into high word whenever low word wraps around.
+uint64_t accumulate(const std::vector<float>& variances, uint waveSize)
+{
+    uint low = 0;
+    uint high = 0;
+    for (size_t i = 0; i < variances.size(); i += waveSize)
+    {
+        uint waveVariance = 0;
+        for (size_t j = i; j < std::min(i + waveSize, variances.size()); ++j)
+            waveVariance += ConvergenceVariance::encode(variances[j]);
+
+        const uint prevLow = low;
+        low += waveVariance;
+        if (prevLow + waveVariance < prevLow)
+            high++;
+    }
+
+    return ((uint64_t)high << 32) | low;
+}
+
+} // namespace
+
+TEST(ConvergenceMonitor, ConvergesAfterStableIterations)
+{
+    ConvergenceMonitor monitor;
+    monitor.reset(createCriteria());
+
+    for (float variance : {1.f, 0.1f, 1e-2f, 5e-4f})
+        EXPECT_EQ(monitor.addSample(variance), ConvergenceMonitor::Status::Running);
+
+    EXPECT_EQ(monitor.addSample(5e-4f), ConvergenceMonitor::Status::Converged);
+    EXPECT_EQ(monitor.getIterationCount(), 5u);
+}
+
+TEST(ConvergenceMonitor, WaitsForMinIterationCount)
+{
+    ConvergenceMonitor monitor;
+    monitor.reset(createCriteria());
+
+    for (uint i = 0; i < 3; ++i)
+        EXPECT_EQ(monitor.addSample(0.f), ConvergenceMonitor::Status::Running);
+
+    EXPECT_EQ(monitor.addSample(0.f), ConvergenceMonitor::Status::Converged);
+}
+
+TEST(ConvergenceMonitor, SpikeRestartsStableCount)
+{
+    ConvergenceMonitor monitor;
+    monitor.reset(createCriteria());
+
+    for (float variance : {1.f, 1.f, 1.f, 1e-4f, 1.f, 1e-4f})
+        EXPECT_EQ(monitor.addSample(variance), ConvergenceMonitor::Status::Running);
+
+    EXPECT_EQ(monitor.addSample(1e-4f), ConvergenceMonitor::Status::Converged);
+}
+
+TEST(ConvergenceMonitor, StopsAtIterationCap)
+{
+    ConvergenceMonitor monitor;
+    monitor.reset(createCriteria());
+
+    for (uint i = 0; i < 15; ++i)
+        EXPECT_EQ(monitor.addSample(1.f), ConvergenceMonitor::Status::Running);
+
+    EXPECT_EQ(monitor.addSample(1.f), ConvergenceMonitor::Status::IterationCap);
+
+    // Later samples are only recorded.
+    EXPECT_EQ(monitor.addSample(0.f), ConvergenceMonitor::Status::IterationCap);
+    EXPECT_EQ(monitor.getHistory().size(), 17u);
+}
+
+TEST(ConvergenceMonitor, NaNIsNotConverged)
+{
+    ConvergenceMonitor monitor;
+    monitor.reset(createCriteria());
+
+    for (uint i = 0; i < 15; ++i)
+        EXPECT_EQ(monitor.addSample(std::nanf("")), ConvergenceMonitor::Status::Running);
+}
+
+// Mean of no surfel has no estimate, and must not pass for zero variance.
+TEST(ConvergenceMonitor, EmptyIsNotConverged)
+{
+    EXPECT_TRUE(std::isnan(ConvergenceMonitor::getMeanVariance(0, 0)));
+
+    ConvergenceMonitor monitor;
+    monitor.reset(createCriteria());
+
+    for (uint i = 0; i < 8; ++i)
+        EXPECT_EQ(monitor.addSample(ConvergenceMonitor::getMeanVariance(0, 0)), ConvergenceMonitor::Status::Running);
+
+    EXPECT_EQ(monitor.addEmptySample(), ConvergenceMonitor::Status::Empty);
+    EXPECT_EQ(monitor.addSample(0.f), ConvergenceMonitor::Status::Empty);
+
+    // Empty status is cleared at reset.
+    monitor.reset(createCriteria());
+    EXPECT_EQ(monitor.getStatus(), ConvergenceMonitor::Status::Running);
+}
+
+TEST(ConvergenceMonitor, ResetClampsCriteria)
+{
+    ConvergenceMonitor::Criteria criteria = createCriteria();
+    criteria.minIterationCount = 8;
+    criteria.maxIterationCount = 0;
+
+    ConvergenceMonitor monitor;
+    monitor.reset(criteria);
+
+    // Cap is at least one iteration, and minimum count does not exceed cap.
+    EXPECT_EQ(monitor.addSample(1.f), ConvergenceMonitor::Status::IterationCap);
+}
+
+// Fixed-point step must be much finer than threshold, and rounding must not move mean near threshold.
+TEST(ConvergenceMonitor, FixedPointMeanIsUnbiased)
+{
+    const float threshold = createCriteria().varianceThreshold;
+    EXPECT_LT(1.f / kConvergenceVarianceScale, threshold * 1e-2f);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(0.f, 2.f * threshold);
+
+    std::vector<float> variances(kTotalSurfelLimit);
+    double exactSum = 0.0;
+    for (float& v : variances)
+    {
+        v = dist(rng);
+        exactSum += v;
+    }
+
+    const float exactMean = (float)(exactSum / variances.size());
+    const float mean = ConvergenceMonitor::getMeanVariance(accumulate(variances, 32), (uint)variances.size());
+    EXPECT_NEAR(mean, exactMean, threshold * 1e-3f);
+
+    // Variance just under threshold stays under it.
+    EXPECT_LE(ConvergenceMonitor::getMeanVariance(ConvergenceVariance::encode(threshold * 0.99f), 1), threshold);
+}
+
+// Sum of all surfels at clamp exceeds 32 bits, and is kept by carry into high word.
+TEST(ConvergenceMonitor, FixedPointSumCarriesIntoHighWord)
+{
+    const std::vector<float> variances(kTotalSurfelLimit, 1e3f);
+
+    // One wave of clamped variance fits in 32 bits.
+    EXPECT_LE(64.0 * ConvergenceVariance::encode(1e3f), (double)UINT32_MAX);
+
+    const uint64_t sum = accumulate(variances, 64);
+    EXPECT_EQ(sum, (uint64_t)ConvergenceVariance::encode(kConvergenceVarianceClamp) * kTotalSurfelLimit);
+    EXPECT_FLOAT_EQ(ConvergenceMonitor::getMeanVariance(sum, kTotalSurfelLimit), kConvergenceVarianceClamp);
+
+    EXPECT_EQ(ConvergenceVariance::encode(-1.f), 0u);
+}
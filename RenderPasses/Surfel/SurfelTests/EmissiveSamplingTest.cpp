@@ -0,0 +1,242 @@
+#include "Falcor.h"
+#include "SurfelGI/SurfelMIS.slang"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace Falcor;
+
+// Ray tracing pass weights emissive light samples and BSDF sampled emission hits by SurfelMIS.
+// Pdfs of emissive sampler are checked here with host model of power sampler, which selects triangle by flux
+// and samples its area uniformly, giving solid angle pdf as Falcor's samplers do.
+namespace
+{
+
+const float kPi = 3.14159265358979f;
+const uint kSampleCount = 1000000;
+
+struct EmissiveTriangle
+{
+    float3 p0;
+    float3 p1;
+    float3 p2;
+    float Le;
+
+    float3 getNormal() const { return math::normalize(math::cross(p1 - p0, p2 - p0)); }
+    float getArea() const { return 0.5f * math::length(math::cross(p1 - p0, p2 - p0)); }
+
+    // Return distance to hit, or 0 if ray misses.
+    float intersect(const float3& origin, const float3& dir) const
+    {
+        const float3 e1 = p1 - p0;
+        const float3 e2 = p2 - p0;
+        const float3 p = math::cross(dir, e2);
+        const float det = math::dot(e1, p);
+        if (std::abs(det) < 1e-9f)
+            return 0.f;
+
+        const float3 s = origin - p0;
+        const float u = math::dot(s, p) / det;
+        const float3 q = math::cross(s, e1);
+        const float v = math::dot(dir, q) / det;
+        if (u < 0.f || v < 0.f || u + v > 1.f)
+            return 0.f;
+
+        const float t = math::dot(e2, q) / det;
+        return t > 0.f ? t : 0.f;
+    }
+};
+
+struct LightSample
+{
+    uint triangleIndex;
+    float3 dir;
+    float pdf;
+};
+
+// Host model of power based emissive sampler.
+struct PowerSampler
+{
+    std::vector<EmissiveTriangle> triangles;
+    std::vector<float> selectionPdf;
+
+    explicit PowerSampler(const std::vector<EmissiveTriangle>& tris) : triangles(tris)
+    {
+        float totalFlux = 0.f;
+        for (const auto& tri : triangles)
+            totalFlux += tri.Le * tri.getArea();
+        for (const auto& tri : triangles)
+            selectionPdf.push_back(tri.Le * tri.getArea() / totalFlux);
+    }
+
+    // Solid angle pdf of sampling point on triangle from posW.
+    float evalPdf(const float3& posW, uint triangleIndex, const float3& lightPosW) const
+    {
+        const EmissiveTriangle& tri = triangles[triangleIndex];
+        const float3 toLight = lightPosW - posW;
+        const float distSqr = math::dot(toLight, toLight);
+        const float cosLight = std::abs(math::dot(tri.getNormal(), toLight / std::sqrt(distSqr)));
+        return cosLight > 0.f ? selectionPdf[triangleIndex] * distSqr / (tri.getArea() * cosLight) : 0.f;
+    }
+
+    LightSample sample(const float3& posW, float u0, float u1, float u2) const
+    {
+        uint triangleIndex = 0;
+        for (float cdf = selectionPdf[0]; u0 >= cdf && triangleIndex + 1 < triangles.size(); cdf += selectionPdf[++triangleIndex])
+            ;
+
+        // Uniform point on triangle.
+        const float su = std::sqrt(u1);
+        const float b0 = 1.f - su;
+        const float b1 = u2 * su;
+        const EmissiveTriangle& tri = triangles[triangleIndex];
+        const float3 lightPosW = tri.p0 * b0 + tri.p1 * b1 + tri.p2 * (1.f - b0 - b1);
+
+        return {triangleIndex, math::normalize(lightPosW - posW), evalPdf(posW, triangleIndex, lightPosW)};
+    }
+
+    // Closest triangle hit by ray. Return false if none.
+    bool intersect(const float3& origin, const float3& dir, uint& triangleIndex, float3& hitPosW) const
+    {
+        float closest = FLT_MAX;
+        for (uint i = 0; i < triangles.size(); ++i)
+        {
+            const float t = triangles[i].intersect(origin, dir);
+            if (t > 0.f && t < closest)
+            {
+                closest = t;
+                triangleIndex = i;
+            }
+        }
+
+        hitPosW = origin + dir * closest;
+        return closest < FLT_MAX;
+    }
+};
+
+// Emitters above receiver at origin facing +z, which do not occlude each other.
+std::vector<EmissiveTriangle> createScene()
+{
+    return {
+        {float3(-1.f, -1.f, 1.f), float3(-1.f, 1.f, 1.f), float3(0.f, -1.f, 1.f), 4.f},
+        {float3(0.5f, -0.5f, 2.f), float3(2.f, 0.5f, 2.f), float3(2.f, -0.5f, 2.f), 10.f},
+        {float3(-0.5f, 1.5f, 0.5f), float3(0.5f, 1.5f, 0.5f), float3(0.f, 2.f, 1.5f), 1.f},
+    };
+}
+
+struct Sampler
+{
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> dist{0.f, 1.f};
+
+    float next() { return dist(rng); }
+};
+
+} // namespace
+
+TEST(EmissiveSampling, PowerHeuristicWeightsSumToOne)
+{
+    for (float p0 : {1e-4f, 0.1f, 1.f, 3.f, 1e3f})
+        for (float p1 : {0.f, 1e-4f, 0.5f, 1.f, 1e4f})
+            EXPECT_NEAR(SurfelMIS::evalPowerHeuristic(p0, p1) + SurfelMIS::evalPowerHeuristic(p1, p0), 1.f, 1e-5f);
+
+    EXPECT_EQ(SurfelMIS::evalPowerHeuristic(0.f, 1.f), 0.f);
+    EXPECT_EQ(SurfelMIS::evalPowerHeuristic(0.f, 0.f), 0.f);
+}
+
+TEST(EmissiveSampling, SelectionFollowsFlux)
+{
+    const PowerSampler sampler(createScene());
+    Sampler s;
+
+    std::vector<uint> counts(sampler.triangles.size(), 0);
+    for (uint i = 0; i < kSampleCount; ++i)
+        counts[sampler.sample(float3(0.f), s.next(), s.next(), s.next()).triangleIndex]++;
+
+    for (uint i = 0; i < counts.size(); ++i)
+        EXPECT_NEAR(counts[i] / float(kSampleCount), sampler.selectionPdf[i], 0.005f);
+}
+
+// Solid angle pdf integrates to one over directions toward emitters.
+TEST(EmissiveSampling, TrianglePdfIntegratesToOne)
+{
+    const PowerSampler sampler(createScene());
+    Sampler s;
+    const float3 posW(0.f, 0.f, 0.f);
+
+    double sum = 0.0;
+    for (uint i = 0; i < kSampleCount; ++i)
+    {
+        // Uniform direction on sphere.
+        const float z = 1.f - 2.f * s.next();
+        const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+        const float phi = 2.f * kPi * s.next();
+        const float3 dir(r * std::cos(phi), r * std::sin(phi), z);
+
+        uint triangleIndex;
+        float3 hitPosW;
+        if (sampler.intersect(posW, dir, triangleIndex, hitPosW))
+            sum += sampler.evalPdf(posW, triangleIndex, hitPosW) * 4.f * kPi;
+    }
+
+    EXPECT_NEAR(sum / kSampleCount, 1.0, 0.02);
+}
+
+// Light samples and cosine sampled BSDF hits combined by power heuristic, as evalEmissiveLight() and handleHit() do,
+// match irradiance estimated by uniform hemisphere sampling, which uses no emissive pdf.
+TEST(EmissiveSampling, MISEstimatorIsUnbiased)
+{
+    const PowerSampler sampler(createScene());
+    Sampler s;
+    const float3 posW(0.f, 0.f, 0.f);
+    const float albedo = 0.8f;
+
+    double reference = 0.0;
+    double mis = 0.0;
+    for (uint i = 0; i < kSampleCount; ++i)
+    {
+        // Uniform hemisphere, pdf 1 / (2 pi).
+        {
+            const float z = s.next();
+            const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+            const float phi = 2.f * kPi * s.next();
+            const float3 dir(r * std::cos(phi), r * std::sin(phi), z);
+
+            uint triangleIndex;
+            float3 hitPosW;
+            if (sampler.intersect(posW, dir, triangleIndex, hitPosW))
+                reference += albedo / kPi * sampler.triangles[triangleIndex].Le * z * 2.f * kPi;
+        }
+
+        // Emissive light sample.
+        {
+            const LightSample ls = sampler.sample(posW, s.next(), s.next(), s.next());
+            const float cosTheta = ls.dir.z;
+            if (cosTheta > 0.f && ls.pdf > 0.f)
+            {
+                const float bsdfPdf = cosTheta / kPi;
+                const float misWeight = SurfelMIS::evalPowerHeuristic(ls.pdf, bsdfPdf);
+                mis += albedo / kPi * sampler.triangles[ls.triangleIndex].Le * cosTheta * misWeight / ls.pdf;
+            }
+        }
+
+        // Cosine sampled BSDF direction, weight is albedo.
+        {
+            const float r = std::sqrt(s.next());
+            const float phi = 2.f * kPi * s.next();
+            const float3 dir(r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.f, 1.f - r * r)));
+
+            uint triangleIndex;
+            float3 hitPosW;
+            if (sampler.intersect(posW, dir, triangleIndex, hitPosW))
+            {
+                const float bsdfPdf = dir.z / kPi;
+                const float lightPdf = sampler.evalPdf(posW, triangleIndex, hitPosW);
+                mis += albedo * sampler.triangles[triangleIndex].Le * SurfelMIS::evalPowerHeuristic(bsdfPdf, lightPdf);
+            }
+        }
+    }
+
+    reference /= kSampleCount;
+    mis /= kSampleCount;
+    EXPECT_NEAR(mis, reference, reference * 0.02);
+}
@@ -0,0 +1,140 @@
+#include "SurfelGIRenderPass/LightCullingReference.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace LightCullingReference;
+
+namespace
+{
+
+const float kCutoff = 0.01f;
+
+// Surface of height field facing camera, so that tile bounds have some depth.
+struct Surface
+{
+    uint2 resolution;
+    std::vector<float3> posW;
+    std::vector<bool> isValid;
+
+    Surface(uint2 res, uint seed) : resolution(res), posW(res.x * res.y), isValid(res.x * res.y, true)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> height(0.f, 0.5f);
+
+        for (uint y = 0; y < res.y; ++y)
+            for (uint x = 0; x < res.x; ++x)
+                posW[y * res.x + x] = float3(x * 0.1f, y * 0.1f, height(rng));
+    }
+};
+
+std::vector<Light> createPointLights(uint count, float intensity, uint seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-2.f, 12.f);
+
+    std::vector<Light> lights(count);
+    for (Light& light : lights)
+        light = {float3(dist(rng), dist(rng), dist(rng) * 0.2f), intensity, true};
+    return lights;
+}
+
+bool contains(const TileLights& tile, uint lightIndex)
+{
+    return std::find(tile.lightIndices.begin(), tile.lightIndices.end(), lightIndex) != tile.lightIndices.end();
+}
+
+} // namespace
+
+TEST(LightCulling, InfluenceRadiusReachesCutoff)
+{
+    const float radius = LightCulling::getInfluenceRadius(4.f, kCutoff);
+    EXPECT_NEAR(4.f / (radius * radius), kCutoff, 1e-6f);
+    EXPECT_EQ(LightCulling::getInfluenceRadius(0.f, kCutoff), 0.f);
+}
+
+TEST(LightCulling, SphereBoxOverlap)
+{
+    const float3 boxMin(0.f, 0.f, 0.f);
+    const float3 boxMax(1.f, 1.f, 1.f);
+
+    EXPECT_TRUE(LightCulling::isSphereOverlapBox(float3(0.5f, 0.5f, 0.5f), 0.f, boxMin, boxMax));
+    EXPECT_TRUE(LightCulling::isSphereOverlapBox(float3(2.f, 0.5f, 0.5f), 1.f, boxMin, boxMax));
+    EXPECT_FALSE(LightCulling::isSphereOverlapBox(float3(2.f, 2.f, 0.5f), 1.f, boxMin, boxMax));
+}
+
+TEST(LightCulling, NonPointLightsAreKept)
+{
+    const Surface surface({32, 32}, 1);
+    const std::vector<Light> lights = {{float3(1000.f, 0.f, 0.f), 1.f, false}, {float3(1000.f, 0.f, 0.f), 1.f, true}};
+
+    for (const TileLights& tile : cullLights(surface.resolution, surface.posW, surface.isValid, lights, kCutoff))
+    {
+        EXPECT_EQ(tile.count, 1u);
+        EXPECT_TRUE(contains(tile, 0));
+    }
+}
+
+TEST(LightCulling, EmptyTileHasNoLights)
+{
+    Surface surface({32, 16}, 2);
+    for (uint y = 0; y < 16; ++y)
+        for (uint x = 0; x < 16; ++x)
+            surface.isValid[y * 32 + x] = false;
+
+    const std::vector<Light> lights = {{float3(0.f), 1.f, false}};
+    const std::vector<TileLights> tiles = cullLights(surface.resolution, surface.posW, surface.isValid, lights, kCutoff);
+
+    ASSERT_EQ(tiles.size(), 2u);
+    EXPECT_EQ(tiles[0].count, 0u);
+    EXPECT_EQ(tiles[1].count, 1u);
+}
+
+// Every light which lights any pixel of tile above cutoff must be in tile list.
+TEST(LightCulling, CullingIsConservative)
+{
+    // Resolution is not multiple of tile size, so partial tiles are covered too.
+    const Surface surface({100, 70}, 3);
+    const std::vector<Light> lights = createPointLights(256, 0.02f, 4);
+
+    const std::vector<TileLights> tiles = cullLights(surface.resolution, surface.posW, surface.isValid, lights, kCutoff);
+    const uint2 tileCount = getTileCount(surface.resolution);
+    ASSERT_EQ(tiles.size(), tileCount.x * tileCount.y);
+
+    uint culledCount = 0;
+    for (uint y = 0; y < surface.resolution.y; ++y)
+    {
+        for (uint x = 0; x < surface.resolution.x; ++x)
+        {
+            const TileLights& tile = tiles[(y / kLightTileSize) * tileCount.x + x / kLightTileSize];
+            ASSERT_FALSE(tile.isOverflowed());
+
+            const float3 p = surface.posW[y * surface.resolution.x + x];
+            for (uint lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+            {
+                const float3 toLight = lights[lightIndex].posW - p;
+                const bool isAffecting = lights[lightIndex].intensity / math::dot(toLight, toLight) >= kCutoff;
+
+                if (isAffecting)
+                    EXPECT_TRUE(contains(tile, lightIndex)) << "pixel (" << x << ", " << y << "), light " << lightIndex;
+                else if (!contains(tile, lightIndex))
+                    culledCount++;
+            }
+        }
+    }
+
+    // Lights are spread wider than influence radius, so most of them should be culled.
+    EXPECT_GT(culledCount, surface.resolution.x * surface.resolution.y * lights.size() / 2);
+}
+
+TEST(LightCulling, OverflowKeepsCount)
+{
+    const Surface surface({16, 16}, 5);
+    const std::vector<Light> lights = createPointLights(kMaxLightsPerTile + 10, 1e6f, 6);
+
+    const std::vector<TileLights> tiles = cullLights(surface.resolution, surface.posW, surface.isValid, lights, kCutoff);
+
+    ASSERT_EQ(tiles.size(), 1u);
+    EXPECT_EQ(tiles[0].count, kMaxLightsPerTile + 10);
+    EXPECT_EQ(tiles[0].lightIndices.size(), kMaxLightsPerTile);
+    EXPECT_TRUE(tiles[0].isOverflowed());
+}
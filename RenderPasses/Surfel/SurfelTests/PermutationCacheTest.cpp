@@ -0,0 +1,177 @@
+#include "SurfelGI/PermutationCache.h"
+#include <gtest/gtest.h>
+#include <fstream>
+
+namespace
+{
+
+// Temporary shader directory, removed at end of test.
+class SourceDirectory
+{
+public:
+    SourceDirectory()
+    {
+        mPath = std::filesystem::temp_directory_path() /
+                ("SurfelPermutationCacheTest_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+        std::filesystem::remove_all(mPath);
+        std::filesystem::create_directories(mPath);
+    }
+
+    ~SourceDirectory() { std::filesystem::remove_all(mPath); }
+
+    void write(const std::string& name, const std::string& contents) const
+    {
+        std::filesystem::create_directories((mPath / name).parent_path());
+        std::ofstream(mPath / name, std::ios::binary | std::ios::trunc) << contents;
+    }
+
+    uint64_t getKey() const { return PermutationKeyBuilder().addSourceDirectory(mPath).getKey(); }
+
+    const std::filesystem::path& getPath() const { return mPath; }
+
+private:
+    std::filesystem::path mPath;
+};
+
+uint64_t getKey(const DefineList& defines)
+{
+    return PermutationKeyBuilder().addDefines(defines).getKey();
+}
+
+} // namespace
+
+TEST(PermutationCacheTest, KeyChangesWithSource)
+{
+    SourceDirectory sources;
+    sources.write("SurfelTypes.slang", "static const uint kTotalSurfelLimit = 150000;");
+    sources.write("SurfelGI/SurfelRayTrace.rt.slang", "[shader(\"raygeneration\")] void rayGen() {}");
+
+    const uint64_t key = sources.getKey();
+    EXPECT_EQ(sources.getKey(), key);
+
+    sources.write("SurfelTypes.slang", "static const uint kTotalSurfelLimit = 150001;");
+    const uint64_t editedKey = sources.getKey();
+    EXPECT_NE(editedKey, key);
+
+    sources.write("SurfelGI/GroupScan.slang", "");
+    EXPECT_NE(sources.getKey(), editedKey);
+}
+
+TEST(PermutationCacheTest, KeyChangesWithFileName)
+{
+    // Same contents under other path is other source tree.
+    SourceDirectory sources;
+    sources.write("a.slang", "x");
+    const uint64_t key = sources.getKey();
+
+    std::filesystem::rename(sources.getPath() / "a.slang", sources.getPath() / "b.slang");
+    EXPECT_NE(sources.getKey(), key);
+}
+
+TEST(PermutationCacheTest, KeyChangesWithDefines)
+{
+    DefineList defines;
+    defines.add("CELL_DIM", "250");
+    defines.add("USE_SURFEL_DEPTH");
+    const uint64_t key = getKey(defines);
+
+    DefineList sameDefines;
+    sameDefines.add("USE_SURFEL_DEPTH");
+    sameDefines.add("CELL_DIM", "250");
+    EXPECT_EQ(getKey(sameDefines), key);
+
+    DefineList otherValue = defines;
+    otherValue.add("CELL_DIM", "100");
+    EXPECT_NE(getKey(otherValue), key);
+
+    DefineList addedDefine = defines;
+    addedDefine.add("DETERMINISTIC");
+    EXPECT_NE(getKey(addedDefine), key);
+
+    // Define name and value are hashed separately.
+    DefineList shiftedValue;
+    shiftedValue.add("CELL_DIM2", "50");
+    shiftedValue.add("USE_SURFEL_DEPTH");
+    EXPECT_NE(getKey(shiftedValue), key);
+}
+
+TEST(PermutationCacheTest, KeyChangesWithTypeConformances)
+{
+    TypeConformanceList conformances;
+    conformances.add("StandardMaterial", "IMaterial", 0);
+    const uint64_t key = PermutationKeyBuilder().addTypeConformances(conformances).getKey();
+
+    TypeConformanceList otherId;
+    otherId.add("StandardMaterial", "IMaterial", 1);
+    EXPECT_NE(PermutationKeyBuilder().addTypeConformances(otherId).getKey(), key);
+
+    conformances.add("HairMaterial", "IMaterial", 1);
+    EXPECT_NE(PermutationKeyBuilder().addTypeConformances(conformances).getKey(), key);
+}
+
+TEST(PermutationCacheTest, ValuesAreLengthPrefixed)
+{
+    EXPECT_NE(PermutationKeyBuilder().add("ab").add("c").getKey(), PermutationKeyBuilder().add("a").add("bc").getKey());
+}
+
+TEST(PermutationCacheTest, LeastRecentlyUsedIsDropped)
+{
+    PermutationCache cache;
+    cache.setMaxEntryCount(2);
+
+    cache.record(1, "{}");
+    cache.record(2, "{}");
+    cache.record(1, "{}");
+    cache.record(3, "{}");
+
+    EXPECT_TRUE(cache.contains(1));
+    EXPECT_FALSE(cache.contains(2));
+    EXPECT_TRUE(cache.contains(3));
+    EXPECT_EQ(cache.getEntries().size(), 2u);
+}
+
+TEST(PermutationCacheTest, SerializeRoundTrip)
+{
+    PermutationCache cache;
+    cache.record(0x0123456789abcdefull, "{\"cellDim\": 250, \"deterministic\": false}");
+    cache.record(42, "{}");
+
+    PermutationCache loaded;
+    EXPECT_TRUE(loaded.deserialize(cache.serialize()));
+    ASSERT_EQ(loaded.getEntries().size(), 2u);
+    EXPECT_EQ(loaded.serialize(), cache.serialize());
+
+    // Use counter continues after loaded entries, so new record is most recent.
+    loaded.setMaxEntryCount(2);
+    loaded.record(7, "{}");
+    EXPECT_TRUE(loaded.contains(7));
+    EXPECT_TRUE(loaded.contains(42));
+    EXPECT_FALSE(loaded.contains(0x0123456789abcdefull));
+}
+
+TEST(PermutationCacheTest, MalformedLinesAreSkipped)
+{
+    PermutationCache cache;
+    EXPECT_FALSE(cache.deserialize("00000000000000ff 1 {}\nnot-a-key 2 {}\n0000000000000010\n\n0000000000000011 3 {}\n"));
+
+    EXPECT_TRUE(cache.contains(0xff));
+    EXPECT_TRUE(cache.contains(0x11));
+    EXPECT_EQ(cache.getEntries().size(), 2u);
+}
+
+TEST(PermutationCacheTest, SaveAndLoad)
+{
+    SourceDirectory directory;
+    const auto path = directory.getPath() / "cache" / "SurfelGI.txt";
+
+    PermutationCache cache;
+    cache.record(5, "{\"cellUnit\": 0.05}");
+    ASSERT_TRUE(cache.save(path));
+
+    PermutationCache loaded;
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_TRUE(loaded.contains(5));
+    EXPECT_EQ(loaded.getEntries()[0].staticParams, "{\"cellUnit\": 0.05}");
+
+    EXPECT_FALSE(loaded.load(directory.getPath() / "missing.txt"));
+}
@@ -0,0 +1,96 @@
+#include "SurfelGI/RadianceFormat.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+
+namespace
+{
+
+float quantize(RadianceFormat format, float value, uint channel = 0)
+{
+    const float3 radiance = quantizeRadiance(format, float3(value));
+    return channel == 0 ? radiance.x : (channel == 1 ? radiance.y : radiance.z);
+}
+
+// Largest relative rounding error for given mantissa bits, half of spacing at bottom of binade.
+float getMaxRelativeError(int mantissaBits)
+{
+    return std::ldexp(1.f, -mantissaBits - 1);
+}
+
+} // namespace
+
+TEST(RadianceFormatTest, ResourceFormat)
+{
+    EXPECT_EQ(getResourceFormat(RadianceFormat::RGBA32Float), ResourceFormat::RGBA32Float);
+    EXPECT_EQ(getResourceFormat(RadianceFormat::RGBA16Float), ResourceFormat::RGBA16Float);
+    EXPECT_EQ(getResourceFormat(RadianceFormat::R11G11B10Float), ResourceFormat::R11G11B10Float);
+}
+
+TEST(RadianceFormatTest, FullPrecisionIsExact)
+{
+    for (float value : {-1.f, 1.f / 3.f, 1e-30f, 1e30f})
+        EXPECT_EQ(quantize(RadianceFormat::RGBA32Float, value), value);
+}
+
+TEST(RadianceFormatTest, RelativeErrorWithinMantissa)
+{
+    // Radiance from dim indirect to bright emitters, in normal range of every format.
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> logDist(std::log(1e-3f), std::log(6e4f));
+
+    for (uint i = 0; i < 10000; ++i)
+    {
+        const float value = std::exp(logDist(rng));
+        EXPECT_LE(std::abs(quantize(RadianceFormat::RGBA16Float, value) - value), value * getMaxRelativeError(10)) << value;
+        EXPECT_LE(std::abs(quantize(RadianceFormat::R11G11B10Float, value, 0) - value), value * getMaxRelativeError(6)) << value;
+        EXPECT_LE(std::abs(quantize(RadianceFormat::R11G11B10Float, value, 1) - value), value * getMaxRelativeError(6)) << value;
+        EXPECT_LE(std::abs(quantize(RadianceFormat::R11G11B10Float, value, 2) - value), value * getMaxRelativeError(5)) << value;
+    }
+}
+
+TEST(RadianceFormatTest, KnownValues)
+{
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, 1.f / 3.f), 0.333251953125f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 1.f / 3.f), 0.33203125f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 1.f / 3.f, 2), 0.3359375f);
+
+    // Integers are exact up to 2^(mantissa bits + 1).
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, 2048.f), 2048.f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 127.f), 127.f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 63.f, 2), 63.f);
+
+    // Ties round to even mantissa.
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, 2049.f), 2048.f);
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, 2051.f), 2052.f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 129.f), 128.f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 131.f), 132.f);
+}
+
+TEST(RadianceFormatTest, RangeLimits)
+{
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, 1e6f), 65504.f);
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, -1e6f), -65504.f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 1e6f), 65024.f);
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, 1e6f, 2), 64512.f);
+
+    // Value just below max does not round up past it.
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, 65519.f), 65504.f);
+
+    // Unsigned format has no negative value.
+    EXPECT_EQ(quantize(RadianceFormat::R11G11B10Float, -1.f), 0.f);
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, -0.5f), -0.5f);
+}
+
+TEST(RadianceFormatTest, DimRadianceKeepsAbsoluteError)
+{
+    // Below smallest normal, spacing stays 2^-24 for half and 2^-20 for 11 bit float, so dim radiance keeps absolute
+    // error instead of relative one.
+    for (float value : {1e-5f, 3e-6f, 1e-7f})
+    {
+        EXPECT_LE(std::abs(quantize(RadianceFormat::RGBA16Float, value) - value), std::ldexp(1.f, -25));
+        EXPECT_LE(std::abs(quantize(RadianceFormat::R11G11B10Float, value) - value), std::ldexp(1.f, -21));
+    }
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, std::ldexp(1.f, -24)), std::ldexp(1.f, -24));
+    EXPECT_EQ(quantize(RadianceFormat::RGBA16Float, std::ldexp(1.f, -26)), 0.f);
+}
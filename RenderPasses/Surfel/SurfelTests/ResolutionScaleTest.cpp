@@ -0,0 +1,145 @@
+#include "SurfelGI/ResolutionScale.h"
+#include "SurfelReference/SurfelReferenceEngine.h"
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+
+namespace
+{
+
+const uint2 kFrameDim = uint2(1920, 1080);
+
+SurfelView createView(float scale)
+{
+    SurfelView view = {};
+    view.position = float3(0.f, 1.f, 0.f);
+    view.fovy = 1.f;
+    view.frameDim = kFrameDim;
+    view.resolution = getRenderResolution(kFrameDim, scale);
+    return view;
+}
+
+std::vector<Surfel> createSurfels(uint count)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-4.f, 4.f);
+
+    std::vector<Surfel> surfels(count);
+    for (Surfel& surfel : surfels)
+    {
+        surfel = {};
+        surfel.position = float3(dist(rng), 0.f, dist(rng));
+        surfel.normal = float3(0.f, 1.f, 0.f);
+        surfel.radius = 0.05f;
+        surfel.msmeData = SurfelReference::makeMSMEData();
+    }
+    return surfels;
+}
+
+// Engine after few frames of same view at given scale.
+std::vector<Surfel> runEngine(float scale)
+{
+    SurfelReferenceEngine::Settings settings;
+    settings.staticParams.cellUnit = 0.05f;
+    settings.runtimeParams.fixedGridCenter = true;
+    settings.surfelLimit = 4096;
+    settings.threadCount = 1;
+
+    SurfelReferenceEngine engine(settings);
+    engine.spawn(createSurfels(2000));
+    for (uint frame = 0; frame < 3; ++frame)
+    {
+        for (uint surfelIndex : engine.getValidSurfelIndices())
+            engine.markSeen(surfelIndex);
+        engine.update({createView(scale)});
+    }
+    return engine.getSurfels();
+}
+
+// Vector comparison is per component, so compare as pair.
+std::pair<uint, uint> toPair(uint2 v)
+{
+    return {v.x, v.y};
+}
+
+uint getTileCount(uint2 resolution)
+{
+    return ((resolution.x + kTileSize.x - 1) / kTileSize.x) * ((resolution.y + kTileSize.y - 1) / kTileSize.y);
+}
+
+} // namespace
+
+TEST(ResolutionScaleTest, ClampScale)
+{
+    EXPECT_EQ(clampResolutionScale(0.5f), 0.5f);
+    EXPECT_EQ(clampResolutionScale(2.f), 1.f);
+    EXPECT_EQ(clampResolutionScale(0.f), kMinResolutionScale);
+    EXPECT_EQ(clampResolutionScale(-1.f), kMinResolutionScale);
+    EXPECT_EQ(clampResolutionScale(std::numeric_limits<float>::quiet_NaN()), 1.f);
+    EXPECT_EQ(clampResolutionScale(std::numeric_limits<float>::infinity()), 1.f);
+    EXPECT_EQ(clampResolutionScale(-std::numeric_limits<float>::infinity()), kMinResolutionScale);
+}
+
+TEST(ResolutionScaleTest, RenderResolution)
+{
+    EXPECT_EQ(toPair(getRenderResolution(kFrameDim, 1.f)), toPair(kFrameDim));
+    EXPECT_EQ(toPair(getRenderResolution(kFrameDim, 0.5f)), toPair(uint2(960, 540)));
+
+    // Rounded up, never empty, never larger than frame.
+    EXPECT_EQ(toPair(getRenderResolution(uint2(3, 3), 0.5f)), toPair(uint2(2, 2)));
+    EXPECT_EQ(toPair(getRenderResolution(uint2(1, 1), 0.25f)), toPair(uint2(1, 1)));
+    EXPECT_EQ(toPair(getRenderResolution(uint2(0, 0), 1.f)), toPair(uint2(1, 1)));
+
+    uint2 last = uint2(0, 0);
+    for (float scale = kMinResolutionScale; scale <= 1.f; scale += 0.01f)
+    {
+        const uint2 resolution = getRenderResolution(kFrameDim, scale);
+        EXPECT_LE(resolution.x, kFrameDim.x);
+        EXPECT_LE(resolution.y, kFrameDim.y);
+        EXPECT_GE(resolution.x, last.x);
+        EXPECT_GE(resolution.y, last.y);
+        last = resolution;
+    }
+}
+
+TEST(ResolutionScaleTest, SurfelRadiusIgnoresScale)
+{
+    // Radius is measured in full frame. Measured in render resolution, it would double at half scale.
+    for (float distance : {0.5f, 2.f, 10.f})
+    {
+        const float radius = SurfelReference::calcSurfelRadius(distance, 1.f, createView(1.f).frameDim, 4.f, 100.f);
+        EXPECT_EQ(SurfelReference::calcSurfelRadius(distance, 1.f, createView(0.5f).frameDim, 4.f, 100.f), radius);
+        EXPECT_NEAR(SurfelReference::calcSurfelRadius(distance, 1.f, createView(0.5f).resolution, 4.f, 100.f), radius * 2.f, radius * 0.01f);
+    }
+}
+
+TEST(ResolutionScaleTest, EngineUpdateIgnoresScale)
+{
+    // Radius, life and ray count of each surfel are same at any scale.
+    const std::vector<Surfel> reference = runEngine(1.f);
+    for (float scale : {0.75f, 0.5f, kMinResolutionScale})
+    {
+        const std::vector<Surfel> surfels = runEngine(scale);
+        ASSERT_EQ(surfels.size(), reference.size());
+        for (size_t i = 0; i < surfels.size(); ++i)
+        {
+            EXPECT_EQ(surfels[i].radius, reference[i].radius);
+            EXPECT_EQ(surfels[i].rayCount, reference[i].rayCount);
+        }
+    }
+}
+
+TEST(ResolutionScaleTest, SpawnDensityIgnoresScale)
+{
+    // Expected spawns over frame are tile count times chance. Scaled chance keeps them within tile rounding.
+    const float fullSpawnCount = (float)getTileCount(kFrameDim);
+    for (float scale = kMinResolutionScale; scale <= 1.f; scale += 0.05f)
+    {
+        const uint2 resolution = getRenderResolution(kFrameDim, scale);
+        const float spawnCount = (float)getTileCount(resolution) * getSpawnChanceScale(kFrameDim, resolution);
+        EXPECT_NEAR(spawnCount / fullSpawnCount, 1.f, 0.08f) << "scale " << scale;
+    }
+
+    EXPECT_EQ(getSpawnChanceScale(kFrameDim, kFrameDim), 1.f);
+    EXPECT_EQ(getSpawnChanceScale(kFrameDim, uint2(0, 0)), 1.f);
+}
@@ -0,0 +1,94 @@
+#include "SurfelReference/SurfelReferenceMath.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace SurfelReference;
+
+namespace
+{
+
+std::vector<float3> createNormals(uint count)
+{
+    std::mt19937 rng(0);
+    std::normal_distribution<float> dist;
+
+    // Axes and octant borders, where wrap and sign extension matter, then random directions.
+    std::vector<float3> normals = {
+        float3(1, 0, 0), float3(-1, 0, 0), float3(0, 1, 0), float3(0, -1, 0), float3(0, 0, 1), float3(0, 0, -1),
+        math::normalize(float3(1, 1, 0)), math::normalize(float3(-1, -1, 0)), math::normalize(float3(1, -1, -1e-4f)),
+        math::normalize(float3(-1, 1, -1)),
+    };
+    while (normals.size() < count)
+    {
+        const float3 v = float3(dist(rng), dist(rng), dist(rng));
+        if (math::length(v) > 1e-3f)
+            normals.push_back(math::normalize(v));
+    }
+    return normals;
+}
+
+} // namespace
+
+TEST(SurfaceCacheTest, NormalRoundTrip)
+{
+    // 16 bits per component leaves angle error well below 1e-3 rad.
+    for (const float3& normal : createNormals(10000))
+    {
+        const float3 decoded = unpackSurfaceNormal(packSurfaceNormal(normal));
+        EXPECT_NEAR(math::length(decoded), 1.f, 1e-5f);
+        EXPECT_GT(math::dot(decoded, normal), std::cos(1e-3f)) << normal.x << " " << normal.y << " " << normal.z;
+    }
+}
+
+TEST(SurfaceCacheTest, NormalBitLayout)
+{
+    // x in low half, y in high half, both two's complement snorm.
+    EXPECT_EQ(packSurfaceNormal(float3(0, 0, 1)), 0u);
+    EXPECT_EQ(packSurfaceNormal(float3(1, 0, 0)), 0x00007FFFu);
+    EXPECT_EQ(packSurfaceNormal(float3(-1, 0, 0)), 0x00008001u);
+    EXPECT_EQ(packSurfaceNormal(float3(0, 1, 0)), 0x7FFF0000u);
+    EXPECT_EQ(packSurfaceNormal(float3(0, -1, 0)), 0x80010000u);
+
+    // Negative low half must not leak sign into y.
+    const float3 decoded = unpackSurfaceNormal(0x00008001u);
+    EXPECT_NEAR(decoded.x, -1.f, 1e-6f);
+    EXPECT_NEAR(decoded.y, 0.f, 1e-6f);
+}
+
+TEST(SurfaceCacheTest, NormalIsStableUnderRepack)
+{
+    // Consumers may write decoded normal back, which must not drift.
+    for (const float3& normal : createNormals(1000))
+    {
+        const uint packed = packSurfaceNormal(normal);
+        EXPECT_EQ(packSurfaceNormal(unpackSurfaceNormal(packed)), packed);
+    }
+}
+
+TEST(SurfaceCacheTest, AlbedoQuantization)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    for (uint i = 0; i < 10000; ++i)
+    {
+        const float3 albedo = float3(dist(rng), dist(rng), dist(rng));
+        const uint packed = packSurfaceAlbedo(albedo);
+        const float3 decoded = unpackSurfaceAlbedo(packed);
+
+        EXPECT_EQ(packed >> 24, 0u);
+        for (uint c = 0; c < 3; ++c)
+            EXPECT_LE(std::abs(decoded[c] - albedo[c]), 0.5f / 255.f + 1e-6f);
+        EXPECT_EQ(packSurfaceAlbedo(decoded), packed);
+    }
+}
+
+TEST(SurfaceCacheTest, AlbedoBitLayoutAndClamp)
+{
+    EXPECT_EQ(packSurfaceAlbedo(float3(1.f, 0.f, 0.f)), 0x0000FFu);
+    EXPECT_EQ(packSurfaceAlbedo(float3(0.f, 1.f, 0.f)), 0x00FF00u);
+    EXPECT_EQ(packSurfaceAlbedo(float3(0.f, 0.f, 1.f)), 0xFF0000u);
+
+    // Out of range albedo from materials is clamped, not wrapped into next channel.
+    EXPECT_EQ(packSurfaceAlbedo(float3(2.f, -1.f, 1.5f)), 0xFF00FFu);
+}
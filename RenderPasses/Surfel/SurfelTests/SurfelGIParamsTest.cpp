@@ -0,0 +1,163 @@
+#include "SurfelGI/SurfelGIParams.h"
+#include <gtest/gtest.h>
+#include <limits>
+
+TEST(SurfelGIParamsTest, EmptyPropertiesKeepDefaults)
+{
+    SurfelGIRuntimeParams runtimeParams;
+    SurfelGIStaticParams staticParams;
+
+    EXPECT_TRUE(parseSurfelGIProperties(Properties(), runtimeParams, staticParams));
+    EXPECT_EQ(runtimeParams.maxRayCount, SurfelGIRuntimeParams().maxRayCount);
+    EXPECT_EQ(staticParams, SurfelGIStaticParams());
+}
+
+TEST(SurfelGIParamsTest, RoundTrip)
+{
+    SurfelGIRuntimeParams runtimeParams;
+    runtimeParams.chanceMultiply = 0.5f;
+    runtimeParams.placementThreshold = 3.f;
+    runtimeParams.removalThreshold = 7.f;
+    runtimeParams.overlayMode = Falcor::OverlayMode::RayCount;
+    runtimeParams.outputFormat = RadianceFormat::R11G11B10Float;
+    runtimeParams.minRayCount = 8u;
+    runtimeParams.maxRayCount = 128u;
+    runtimeParams.fixedGridCenter = true;
+    runtimeParams.gridCenter = float3(1.f, 2.f, 3.f);
+    runtimeParams.batchCriteria.minIterationCount = 3u;
+    runtimeParams.regionSpillPath = "regions.bin";
+
+    SurfelGIStaticParams staticParams;
+    staticParams.surfelTargetArea = 20000;
+    staticParams.cellUnit = 0.1f;
+    staticParams.cellDim = 100u;
+    staticParams.perCellSurfelLimit = 64u;
+    staticParams.useLightReservoir = true;
+    staticParams.emissiveSampler = EmissiveLightSamplerType::Uniform;
+    staticParams.deterministic = true;
+    ASSERT_TRUE(staticParams.validate());
+
+    SurfelGIRuntimeParams parsedRuntime;
+    SurfelGIStaticParams parsedStatic;
+    EXPECT_TRUE(parseSurfelGIProperties(getSurfelGIProperties(runtimeParams, staticParams), parsedRuntime, parsedStatic));
+
+    EXPECT_EQ(parsedStatic, staticParams);
+    EXPECT_EQ(parsedStatic.cellCount, 100u * 100u * 100u);
+    EXPECT_EQ(parsedRuntime.chanceMultiply, runtimeParams.chanceMultiply);
+    EXPECT_EQ(parsedRuntime.removalThreshold, runtimeParams.removalThreshold);
+    EXPECT_EQ(parsedRuntime.thresholdGap, 4.f);
+    EXPECT_EQ(parsedRuntime.overlayMode, runtimeParams.overlayMode);
+    EXPECT_EQ(parsedRuntime.outputFormat, runtimeParams.outputFormat);
+    EXPECT_EQ(parsedRuntime.minRayCount, runtimeParams.minRayCount);
+    EXPECT_EQ(parsedRuntime.maxRayCount, runtimeParams.maxRayCount);
+    EXPECT_TRUE(parsedRuntime.fixedGridCenter);
+    EXPECT_EQ(parsedRuntime.gridCenter.z, 3.f);
+    EXPECT_EQ(parsedRuntime.batchCriteria.minIterationCount, 3u);
+    EXPECT_EQ(parsedRuntime.regionSpillPath, runtimeParams.regionSpillPath);
+}
+
+TEST(SurfelGIParamsTest, UnknownKeyIsReportedAndOthersApplied)
+{
+    Properties props;
+    props["maxRayCount"] = 32u;
+    props["maxRayCnt"] = 16u;
+
+    SurfelGIRuntimeParams runtimeParams;
+    SurfelGIStaticParams staticParams;
+
+    EXPECT_FALSE(parseSurfelGIProperties(props, runtimeParams, staticParams));
+    EXPECT_EQ(runtimeParams.maxRayCount, 32u);
+}
+
+TEST(SurfelGIParamsTest, OutOfRangeIsClamped)
+{
+    Properties props;
+    props["maxRayCount"] = 1000u;
+    props["minRayCount"] = 512u;
+    props["cellDim"] = 10u;
+    props["chanceMultiply"] = std::numeric_limits<float>::quiet_NaN();
+
+    SurfelGIRuntimeParams runtimeParams;
+    SurfelGIStaticParams staticParams;
+
+    EXPECT_FALSE(parseSurfelGIProperties(props, runtimeParams, staticParams));
+    EXPECT_EQ(runtimeParams.maxRayCount, 256u);
+    EXPECT_EQ(runtimeParams.minRayCount, runtimeParams.maxRayCount);
+    EXPECT_EQ(runtimeParams.chanceMultiply, 0.f);
+    EXPECT_EQ(staticParams.cellDim, 25u);
+    EXPECT_EQ(staticParams.cellCount, 25u * 25u * 25u);
+}
+
+TEST(SurfelGIParamsTest, RemovalThresholdFollowsPlacement)
+{
+    SurfelGIRuntimeParams runtimeParams;
+    SurfelGIStaticParams staticParams;
+    const float gap = runtimeParams.thresholdGap;
+
+    Properties props;
+    props["placementThreshold"] = 5.f;
+    EXPECT_TRUE(parseSurfelGIProperties(props, runtimeParams, staticParams));
+    EXPECT_EQ(runtimeParams.removalThreshold, 5.f + gap);
+
+    // Removal threshold below placement threshold is raised to it.
+    props["removalThreshold"] = 1.f;
+    EXPECT_FALSE(parseSurfelGIProperties(props, runtimeParams, staticParams));
+    EXPECT_EQ(runtimeParams.removalThreshold, 5.f);
+    EXPECT_EQ(runtimeParams.thresholdGap, 0.f);
+}
+
+TEST(SurfelGIParamsTest, UnsupportedEmissiveSamplerFallsBackToPower)
+{
+    Properties props;
+    props["emissiveSampler"] = EmissiveLightSamplerType::LightBVH;
+
+    SurfelGIRuntimeParams runtimeParams;
+    SurfelGIStaticParams staticParams;
+
+    EXPECT_FALSE(parseSurfelGIProperties(props, runtimeParams, staticParams));
+    EXPECT_EQ(staticParams.emissiveSampler, EmissiveLightSamplerType::Power);
+}
+
+TEST(SurfelGIParamsTest, StaticPropertiesOnly)
+{
+    const Properties props = getSurfelGIStaticProperties(SurfelGIStaticParams());
+
+    EXPECT_TRUE(props.has("cellUnit"));
+    EXPECT_TRUE(props.has("deterministic"));
+    EXPECT_FALSE(props.has("maxRayCount"));
+    EXPECT_FALSE(props.has("outputFormat"));
+}
+
+TEST(SurfelGIParamsTest, SurfelResetOnlyOnCachedDataChange)
+{
+    const SurfelGIStaticParams prev;
+
+    // Surfels are in world space, so grid, search and sampling params keep them.
+    SurfelGIStaticParams params = prev;
+    params.cellUnit = 0.1f;
+    params.cellDim = 100u;
+    params.perCellSurfelLimit = 64u;
+    params.useRayGuiding = true;
+    params.useEmissiveSampling = true;
+    params.useInstrumentation = true;
+    EXPECT_FALSE(params.isSurfelResetRequired(prev));
+
+    params = prev;
+    params.useLightReservoir = true;
+    EXPECT_TRUE(params.isSurfelResetRequired(prev));
+
+    params = prev;
+    params.useLightVisibilityCache = true;
+    EXPECT_TRUE(params.isSurfelResetRequired(prev));
+
+    params = prev;
+    params.deterministic = true;
+    EXPECT_TRUE(params.isSurfelResetRequired(prev));
+
+    // Visibility cache is off in deterministic mode either way, so only deterministic toggle matters.
+    SurfelGIStaticParams deterministic = prev;
+    deterministic.deterministic = true;
+    params = deterministic;
+    params.useLightVisibilityCache = true;
+    EXPECT_FALSE(params.isSurfelResetRequired(deterministic));
+}
@@ -0,0 +1,145 @@
+#include "SurfelGI/SurfelHistograms.h"
+#include <gtest/gtest.h>
+#include <climits>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+// Binning of getHistogramBin in SurfelInstrumentation.slang.
+uint getDeviceBin(SurfelHistogramType type, uint value)
+{
+    if (SurfelHistograms::isLog2(type))
+    {
+        uint firstBitHigh = 0;
+        for (uint v = value; v > 1; v >>= 1)
+            firstBitHigh++;
+        return value == 0 ? 0 : std::min(firstBitHigh + 1, kHistogramBinCount - 1);
+    }
+
+    return std::min(value, kHistogramBinCount - 1);
+}
+
+std::vector<uint> createTestValues()
+{
+    std::vector<uint> values;
+    for (uint i = 0; i < 32; ++i)
+    {
+        values.push_back(1u << i);
+        values.push_back((1u << i) - 1);
+        values.push_back((1u << i) + 1);
+    }
+    values.push_back(UINT_MAX);
+    return values;
+}
+
+} // namespace
+
+TEST(SurfelHistogramsTest, HostBinMatchesDevice)
+{
+    for (uint i = 0; i < (uint)SurfelHistogramType::Count; ++i)
+    {
+        const SurfelHistogramType type = (SurfelHistogramType)i;
+        for (uint value : createTestValues())
+            EXPECT_EQ(SurfelHistograms::getBin(type, value), getDeviceBin(type, value)) << SurfelHistograms::getName(type) << " " << value;
+    }
+}
+
+TEST(SurfelHistogramsTest, Log2Bins)
+{
+    const SurfelHistogramType type = SurfelHistogramType::CellOccupancy;
+    EXPECT_EQ(SurfelHistograms::getBin(type, 0), 0u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, 1), 1u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, 2), 2u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, 3), 2u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, 4), 3u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, UINT_MAX), kHistogramBinCount - 1);
+
+    EXPECT_EQ(SurfelHistograms::getBinLabel(type, 0), "0");
+    EXPECT_EQ(SurfelHistograms::getBinLabel(type, 1), "1");
+    EXPECT_EQ(SurfelHistograms::getBinLabel(type, 3), "4-7");
+    EXPECT_EQ(SurfelHistograms::getBinLabel(type, kHistogramBinCount - 1), std::to_string(1u << (kHistogramBinCount - 2)) + "+");
+}
+
+TEST(SurfelHistogramsTest, LinearBins)
+{
+    const SurfelHistogramType type = SurfelHistogramType::RayStep;
+    EXPECT_EQ(SurfelHistograms::getBin(type, 0), 0u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, 5), 5u);
+    EXPECT_EQ(SurfelHistograms::getBin(type, 1000), kHistogramBinCount - 1);
+
+    EXPECT_EQ(SurfelHistograms::getBinLabel(type, 5), "5");
+    EXPECT_EQ(SurfelHistograms::getBinLabel(type, kHistogramBinCount - 1), std::to_string(kHistogramBinCount - 1) + "+");
+
+    EXPECT_EQ(SurfelHistograms::getBinLabel(SurfelHistogramType::FinalizeOutcome, (uint)FinalizeOutcome::SkippedDense), "SkippedDense");
+    EXPECT_EQ(SurfelHistograms::getBinLabel(SurfelHistogramType::FinalizeOutcome, (uint)FinalizeOutcome::Count), "Unknown");
+}
+
+TEST(SurfelHistogramsTest, BinRangeHoldsItsValues)
+{
+    // Ranges of consecutive bins tile value range, and every value falls in range of its bin.
+    for (uint i = 0; i < (uint)SurfelHistogramType::Count; ++i)
+    {
+        const SurfelHistogramType type = (SurfelHistogramType)i;
+        for (uint bin = 0; bin < kHistogramBinCount; ++bin)
+        {
+            const uint2 range = SurfelHistograms::getBinRange(type, bin);
+            EXPECT_LE(range.x, range.y);
+            EXPECT_EQ(SurfelHistograms::getBin(type, range.x), bin);
+            EXPECT_EQ(SurfelHistograms::getBin(type, range.y), bin);
+            if (bin > 0)
+                EXPECT_EQ(SurfelHistograms::getBinRange(type, bin - 1).y + 1, range.x);
+        }
+        EXPECT_EQ(SurfelHistograms::getBinRange(type, kHistogramBinCount - 1).y, UINT_MAX);
+    }
+}
+
+TEST(SurfelHistogramsTest, AccumulateDecodesBufferLayout)
+{
+    // Buffer holds bins of each histogram in type order.
+    std::vector<uint> buffer(kHistogramBufferCount, 0);
+    buffer[(uint)SurfelHistogramType::RayStep * kHistogramBinCount + 3] = 7;
+    buffer[(uint)SurfelHistogramType::FinalizeOutcome * kHistogramBinCount + (uint)FinalizeOutcome::Miss] = 2;
+    buffer[(uint)SurfelHistogramType::SurfelAge * kHistogramBinCount + kHistogramBinCount - 1] = 1;
+
+    SurfelHistograms histograms;
+    histograms.accumulate(buffer.data());
+    histograms.accumulate(buffer.data());
+
+    EXPECT_EQ(histograms.getFrameCount(), 2u);
+    EXPECT_EQ(histograms.getCount(SurfelHistogramType::RayStep, 3), 14u);
+    EXPECT_EQ(histograms.getCount(SurfelHistogramType::FinalizeOutcome, (uint)FinalizeOutcome::Miss), 4u);
+    EXPECT_EQ(histograms.getTotal(SurfelHistogramType::RayStep), 14u);
+    EXPECT_EQ(histograms.getTotal(SurfelHistogramType::CellOccupancy), 0u);
+
+    EXPECT_EQ(histograms.getUsedBinCount(SurfelHistogramType::RayStep), 4u);
+    EXPECT_EQ(histograms.getUsedBinCount(SurfelHistogramType::SurfelAge), kHistogramBinCount);
+    EXPECT_EQ(histograms.getUsedBinCount(SurfelHistogramType::CellOccupancy), 0u);
+
+    histograms.clear();
+    EXPECT_EQ(histograms.getFrameCount(), 0u);
+    EXPECT_EQ(histograms.getTotal(SurfelHistogramType::RayStep), 0u);
+}
+
+TEST(SurfelHistogramsTest, CsvHasNonEmptyBins)
+{
+    std::vector<uint> buffer(kHistogramBufferCount, 0);
+    buffer[(uint)SurfelHistogramType::CellOccupancy * kHistogramBinCount + 3] = 5;
+    buffer[(uint)SurfelHistogramType::FinalizeOutcome * kHistogramBinCount + (uint)FinalizeOutcome::Hit] = 9;
+
+    SurfelHistograms histograms;
+    histograms.accumulate(buffer.data());
+
+    EXPECT_EQ(histograms.toCsv(), "histogram,bin,label,count\nCellOccupancy,3,4-7,5\nFinalizeOutcome,0,Hit,9\n");
+
+    const auto path = std::filesystem::temp_directory_path() / "SurfelHistogramsTest.csv";
+    ASSERT_TRUE(histograms.save(path));
+
+    std::ifstream stream(path);
+    std::stringstream content;
+    content << stream.rdbuf();
+    stream.close();
+    EXPECT_EQ(content.str(), "# frames,1\n" + histograms.toCsv());
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,182 @@
+#include "Falcor.h"
+#include "SurfelGI/SurfelLightVisibility.slang"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Falcor;
+
+namespace
+{
+
+// Same compare-exchange loop as evalAnalyticLight in SurfelRayTrace.rt.slang.
+void updateAtomic(std::atomic<uint>& record, uint lightIndex, bool visible)
+{
+    uint word = record.load();
+    while (!record.compare_exchange_weak(word, LightVisibility::update(word, lightIndex, visible)))
+    {
+    }
+}
+
+} // namespace
+
+TEST(SurfelLightVisibilityTest, StableAfterTwoAgreeingResults)
+{
+    uint word = 0;
+    EXPECT_TRUE(LightVisibility::shouldTrace(word, 3, 0.99f, 0.1f));
+
+    word = LightVisibility::update(word, 3, true);
+    EXPECT_TRUE(LightVisibility::isVisible(word, 3));
+    EXPECT_TRUE(LightVisibility::shouldTrace(word, 3, 0.99f, 0.1f));
+
+    word = LightVisibility::update(word, 3, true);
+    EXPECT_EQ(LightVisibility::getBucketState(word, 3), kLightVisibilityValidBit | kLightVisibilityVisibleBit | kLightVisibilityStableBit);
+
+    // Stable bucket is traced again only with refresh probability.
+    EXPECT_FALSE(LightVisibility::shouldTrace(word, 3, 0.99f, 0.1f));
+    EXPECT_TRUE(LightVisibility::shouldTrace(word, 3, 0.05f, 0.1f));
+}
+
+TEST(SurfelLightVisibilityTest, FirstResultIsNotStable)
+{
+    // Invalid bucket reads as hidden, which must not count as agreement with first hidden result.
+    const uint word = LightVisibility::update(0u, 5, false);
+    EXPECT_EQ(LightVisibility::getBucketState(word, 5), kLightVisibilityValidBit);
+    EXPECT_FALSE(LightVisibility::isVisible(word, 5));
+}
+
+TEST(SurfelLightVisibilityTest, DisagreementClearsStable)
+{
+    // Penumbra alternates between results, and keeps tracing.
+    uint word = 0;
+    word = LightVisibility::update(word, 0, false);
+    word = LightVisibility::update(word, 0, false);
+    ASSERT_FALSE(LightVisibility::shouldTrace(word, 0, 1.f, 0.1f));
+
+    word = LightVisibility::update(word, 0, true);
+    EXPECT_EQ(LightVisibility::getBucketState(word, 0), kLightVisibilityValidBit | kLightVisibilityVisibleBit);
+    EXPECT_TRUE(LightVisibility::shouldTrace(word, 0, 1.f, 0.1f));
+
+    word = LightVisibility::update(word, 0, false);
+    EXPECT_TRUE(LightVisibility::shouldTrace(word, 0, 1.f, 0.1f));
+}
+
+TEST(SurfelLightVisibilityTest, BucketsAreIndependent)
+{
+    uint word = 0;
+    for (uint lightIndex = 0; lightIndex < kLightVisibilityBucketsPerWord; ++lightIndex)
+    {
+        word = LightVisibility::update(word, lightIndex, lightIndex % 2 == 0);
+        word = LightVisibility::update(word, lightIndex, lightIndex % 2 == 0);
+    }
+
+    for (uint lightIndex = 0; lightIndex < kLightVisibilityBucketsPerWord; ++lightIndex)
+    {
+        EXPECT_EQ(LightVisibility::isVisible(word, lightIndex), lightIndex % 2 == 0);
+        EXPECT_FALSE(LightVisibility::shouldTrace(word, lightIndex, 1.f, 0.1f));
+    }
+
+    // Disagreement on one bucket leaves others stable.
+    word = LightVisibility::update(word, 2, false);
+    for (uint lightIndex = 0; lightIndex < kLightVisibilityBucketsPerWord; ++lightIndex)
+        EXPECT_EQ(LightVisibility::shouldTrace(word, lightIndex, 1.f, 0.1f), lightIndex == 2);
+}
+
+TEST(SurfelLightVisibilityTest, LightsShareBucketsByIndex)
+{
+    // Light 1 and light 1 + bucket count land in same bucket of same word.
+    const uint other = 1 + kLightVisibilityBucketCount;
+    EXPECT_EQ(LightVisibility::getWordIndex(1), LightVisibility::getWordIndex(other));
+
+    uint word = 0;
+    word = LightVisibility::update(word, 1, true);
+    word = LightVisibility::update(word, 1, true);
+    EXPECT_FALSE(LightVisibility::shouldTrace(word, other, 1.f, 0.1f));
+
+    // Other light is hidden, which clears stable, so both keep tracing.
+    word = LightVisibility::update(word, other, false);
+    EXPECT_TRUE(LightVisibility::shouldTrace(word, 1, 1.f, 0.1f));
+
+    // Buckets of one word are consecutive, words cover all buckets.
+    EXPECT_EQ(LightVisibility::getWordIndex(kLightVisibilityBucketsPerWord - 1), 0u);
+    EXPECT_EQ(LightVisibility::getWordIndex(kLightVisibilityBucketsPerWord), 1u);
+    EXPECT_EQ(LightVisibility::getWordIndex(kLightVisibilityBucketCount - 1), kLightVisibilityWordCount - 1);
+}
+
+TEST(SurfelLightVisibilityTest, ConcurrentUpdatesKeepEveryBucket)
+{
+    // Rays of same surfel update buckets of same word from many threads. Each thread owns a bucket and writes
+    // constant result, so each bucket must end valid, stable and with its own visibility. Plain read-modify-write
+    // of the word would lose updates of other buckets.
+    for (uint iteration = 0; iteration < 20; ++iteration)
+    {
+        std::atomic<uint> record = 0;
+        std::vector<std::thread> threads;
+        for (uint lightIndex = 0; lightIndex < kLightVisibilityBucketsPerWord; ++lightIndex)
+        {
+            threads.emplace_back(
+                [&record, lightIndex]()
+                {
+                    for (uint i = 0; i < 1000; ++i)
+                        updateAtomic(record, lightIndex, lightIndex % 3 == 0);
+                }
+            );
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        const uint word = record.load();
+        for (uint lightIndex = 0; lightIndex < kLightVisibilityBucketsPerWord; ++lightIndex)
+        {
+            const uint expected = kLightVisibilityValidBit | kLightVisibilityStableBit | (lightIndex % 3 == 0 ? kLightVisibilityVisibleBit : 0u);
+            EXPECT_EQ(LightVisibility::getBucketState(word, lightIndex), expected);
+        }
+    }
+}
+
+TEST(SurfelLightVisibilityTest, ConcurrentResultsStayPaired)
+{
+    // Threads race on one bucket with alternating results. Low bits of the word, which hold other buckets, count
+    // successful exchanges instead, so that results can be replayed in the order they landed. Final bucket must
+    // equal the sequential replay. Racing writes of separate masks could store one ray's stable bit with the
+    // other ray's visible bit, which no replay produces.
+    const uint lightIndex = kLightVisibilityBucketsPerWord - 1;
+    const uint sequenceMask = 0x0FFFFFFFu;
+    const uint threadCount = 4;
+    const uint updateCount = 1000;
+
+    for (uint iteration = 0; iteration < 20; ++iteration)
+    {
+        std::atomic<uint> record = 0;
+        std::vector<uint8_t> results(threadCount * updateCount);
+        std::vector<std::thread> threads;
+        for (uint t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back(
+                [&, t]()
+                {
+                    for (uint i = 0; i < updateCount; ++i)
+                    {
+                        const bool visible = (t + i) % 2 == 0;
+                        uint word = record.load();
+                        while (!record.compare_exchange_weak(word, LightVisibility::update(word, lightIndex, visible) + 1))
+                        {
+                        }
+                        results[word & sequenceMask] = visible;
+                    }
+                }
+            );
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        uint replay = 0;
+        for (uint8_t visible : results)
+            replay = LightVisibility::update(replay, lightIndex, visible != 0);
+
+        const uint word = record.load();
+        EXPECT_EQ(word & sequenceMask, threadCount * updateCount);
+        EXPECT_EQ(LightVisibility::getBucketState(word, lightIndex), LightVisibility::getBucketState(replay, lightIndex));
+    }
+}
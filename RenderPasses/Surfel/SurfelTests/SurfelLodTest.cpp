@@ -0,0 +1,230 @@
+#include "SurfelReference/SurfelReferenceEngine.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace SurfelReference;
+
+namespace
+{
+
+const float kCellUnit = 0.1f;
+
+Surfel createSurfel(const float3& position, const float3& normal, float radius, const float3& mean)
+{
+    Surfel surfel = {};
+    surfel.position = position;
+    surfel.normal = normal;
+    surfel.radius = radius;
+    surfel.msmeData = makeMSMEData();
+    surfel.msmeData.mean = mean;
+    surfel.msmeData.shortMean = mean;
+    surfel.msmeData.variance = float3(0.04f);
+    surfel.radiance = mean;
+    return surfel;
+}
+
+SurfelView createView(const float3& position)
+{
+    SurfelView view = {};
+    view.position = position;
+    view.fovy = 1.f;
+    view.resolution = uint2(1920, 1080);
+    view.frameDim = view.resolution;
+    return view;
+}
+
+SurfelReferenceEngine::Settings createSettings()
+{
+    SurfelReferenceEngine::Settings settings;
+    settings.staticParams.cellUnit = kCellUnit;
+    settings.staticParams.cellDim = 400u;
+    settings.staticParams.useIrradianceSharing = false;
+    settings.runtimeParams.fixedGridCenter = true;
+    settings.surfelLimit = 4096;
+    settings.threadCount = 2;
+    settings.useLod = true;
+    return settings;
+}
+
+// Floor patch of surfels facing up around center.
+std::vector<Surfel> createPatch(const float3& center, uint count)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+
+    std::vector<Surfel> surfels;
+    for (uint i = 0; i < count; ++i)
+        surfels.push_back(createSurfel(center + float3(dist(rng), 0.f, dist(rng)), float3(0, 1, 0), 0.02f, float3(0.5f)));
+    return surfels;
+}
+
+void updateFrame(SurfelReferenceEngine& engine, const float3& viewPos)
+{
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+        engine.markSeen(surfelIndex);
+    engine.update({createView(viewPos)});
+}
+
+} // namespace
+
+TEST(SurfelLodTest, AdequateLevelGrowsWithDistance)
+{
+    SurfelLodParams params;
+    params.maxLevel = 3;
+    const float mergeDistance = params.mergeDistance * kCellUnit;
+    const float variance = 1.f;
+
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance * 0.99f, variance, kCellUnit), 0u);
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance, variance, kCellUnit), 1u);
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance * 2.f, variance, kCellUnit), 2u);
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance * 4.f, variance, kCellUnit), 3u);
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance * 100.f, variance, kCellUnit), 3u);
+}
+
+TEST(SurfelLodTest, ConvergedSurfelIsOneLevelCoarser)
+{
+    SurfelLodParams params;
+    const float mergeDistance = params.mergeDistance * kCellUnit;
+    const float converged = params.varianceThreshold * 0.5f;
+
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance, converged, kCellUnit), 2u);
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance * 4.f, converged, kCellUnit), params.maxLevel);
+
+    // Near surfel is never merged, however converged.
+    EXPECT_EQ(getAdequateLodLevel(params, mergeDistance * 0.5f, converged, kCellUnit), 0u);
+}
+
+TEST(SurfelLodTest, SplitHasHysteresis)
+{
+    // Engine divides distance by split ratio for split test, so parent made at merge distance stays
+    // until view is closer than split ratio of it.
+    SurfelLodParams params;
+    const float mergeDistance = params.mergeDistance * kCellUnit;
+
+    const float justInside = mergeDistance * 0.9f;
+    EXPECT_EQ(getAdequateLodLevel(params, justInside, 1.f, kCellUnit), 0u);
+    EXPECT_EQ(getAdequateLodLevel(params, justInside / params.splitRatio, 1.f, kCellUnit), 1u);
+
+    const float close = mergeDistance * params.splitRatio * 0.9f;
+    EXPECT_EQ(getAdequateLodLevel(params, close / params.splitRatio, 1.f, kCellUnit), 0u);
+}
+
+TEST(SurfelLodTest, ClusterKey)
+{
+    const float3 up = float3(0, 1, 0);
+    auto getKey = [](const float3& posW, const float3& normalW) { return getLodClusterKey(posW, normalW, float3(0.f), kCellUnit, 1); };
+
+    // Level 1 cluster spans 2 cells per axis.
+    EXPECT_EQ(getKey(float3(0.01f, 0, 0.01f), up), getKey(float3(0.19f, 0, 0.19f), up));
+    EXPECT_NE(getKey(float3(0.01f, 0, 0.01f), up), getKey(float3(0.21f, 0, 0.01f), up));
+
+    // Negative side is not folded onto positive one.
+    EXPECT_NE(getKey(float3(-0.05f, 0, 0), up), getKey(float3(0.05f, 0, 0), up));
+
+    // Opposite sides of thin wall are separate clusters.
+    EXPECT_NE(getKey(float3(0.05f, 0, 0), up), getKey(float3(0.05f, 0, 0), float3(0, -1, 0)));
+}
+
+TEST(SurfelLodTest, MergeIsAreaWeighted)
+{
+    const Surfel small = createSurfel(float3(0, 0, 0), float3(0, 1, 0), 0.01f, float3(1.f));
+    const Surfel large = createSurfel(float3(0.1f, 0, 0), float3(0, 1, 0), 0.03f, float3(0.f));
+    const Surfel parent = mergeSurfels({&small, &large});
+
+    // Weights 1 / 10 and 9 / 10.
+    EXPECT_NEAR(parent.position.x, 0.09f, 1e-6f);
+    EXPECT_NEAR(parent.msmeData.mean.x, 0.1f, 1e-6f);
+    EXPECT_NEAR(parent.radiance.x, 0.1f, 1e-6f);
+    EXPECT_NEAR(parent.normal.y, 1.f, 1e-6f);
+
+    // Disc of parent covers discs of children.
+    for (const Surfel* pChild : {&small, &large})
+        EXPECT_GE(parent.radius + 1e-6f, math::length(pChild->position - parent.position) + pChild->radius);
+
+    // Variance of weighted mean of independent estimates.
+    EXPECT_NEAR(parent.msmeData.variance.x, 0.04f * (0.01f + 0.81f), 1e-6f);
+}
+
+TEST(SurfelLodTest, MergeOfIdenticalChildrenKeepsRadiance)
+{
+    std::vector<Surfel> children;
+    for (uint i = 0; i < 8; ++i)
+        children.push_back(createSurfel(float3(0.01f * (float)i, 0, 0), float3(0, 1, 0), 0.02f, float3(0.3f, 0.6f, 0.9f)));
+
+    std::vector<const Surfel*> pChildren;
+    for (const Surfel& child : children)
+        pChildren.push_back(&child);
+
+    const Surfel parent = mergeSurfels(pChildren);
+    EXPECT_NEAR(parent.msmeData.mean.z, 0.9f, 1e-6f);
+
+    // Averaging 8 equal estimates divides variance by 8.
+    EXPECT_NEAR(parent.msmeData.variance.x, 0.04f / 8.f, 1e-6f);
+}
+
+TEST(SurfelLodTest, SplitKeepsChildDetail)
+{
+    Surfel child = createSurfel(float3(0.f), float3(0, 1, 0), 0.02f, float3(0.4f));
+    Surfel parent = createSurfel(float3(0.f), float3(0, 1, 0), 0.1f, float3(0.6f));
+
+    // Parent has learned +0.1 since merge at mean 0.5.
+    applyParentUpdate(parent, float3(0.5f), child);
+    EXPECT_NEAR(child.msmeData.mean.x, 0.5f, 1e-6f);
+    EXPECT_NEAR(child.radiance.x, 0.5f, 1e-6f);
+
+    // Radiance does not go negative when parent gets darker.
+    parent.msmeData.mean = float3(0.f);
+    applyParentUpdate(parent, float3(1.f), child);
+    EXPECT_EQ(child.msmeData.mean.x, 0.f);
+}
+
+TEST(SurfelLodTest, EngineMergesFarAndSplitsNear)
+{
+    const auto settings = createSettings();
+    SurfelReferenceEngine engine(settings);
+
+    // Patch beyond merge distance of level 1 from view.
+    const float3 patchCenter = float3(10.f, 0.f, 0.f);
+    const uint childCount = engine.spawn(createPatch(patchCenter, 400));
+
+    updateFrame(engine, float3(0.f, 1.f, 0.f));
+    const auto& stats = engine.getLodStats();
+    EXPECT_GT(stats.mergeCount, 0u);
+    EXPECT_GT(stats.mergedSurfelCount, 0u);
+
+    // Children held by parents are neither valid nor traced. Parents of level 1 may be held by level 2.
+    const uint validCount = (uint)engine.getValidSurfelIndices().size();
+    EXPECT_LT(validCount, childCount);
+    EXPECT_EQ(validCount + stats.mergedSurfelCount, childCount + stats.mergeCount);
+
+    uint maxLevel = 0;
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+        maxLevel = std::max(maxLevel, engine.getLodLevel(surfelIndex));
+    EXPECT_GE(maxLevel, 1u);
+
+    // View comes to patch, every parent splits back to its children.
+    updateFrame(engine, patchCenter + float3(0.f, 0.5f, 0.f));
+    updateFrame(engine, patchCenter + float3(0.f, 0.5f, 0.f));
+    EXPECT_EQ(engine.getLodStats().parentCount, 0u);
+    EXPECT_EQ(engine.getLodStats().mergedSurfelCount, 0u);
+    EXPECT_EQ((uint)engine.getValidSurfelIndices().size(), childCount);
+}
+
+TEST(SurfelLodTest, RecycledParentFreesChildren)
+{
+    const auto settings = createSettings();
+    SurfelReferenceEngine engine(settings);
+    engine.spawn(createPatch(float3(10.f, 0.f, 0.f), 400));
+    updateFrame(engine, float3(0.f, 1.f, 0.f));
+    ASSERT_GT(engine.getLodStats().parentCount, 0u);
+
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+        engine.markDestroy(surfelIndex);
+    engine.update({createView(float3(0.f, 1.f, 0.f))});
+
+    EXPECT_TRUE(engine.getValidSurfelIndices().empty());
+    EXPECT_EQ(engine.getLodStats().mergedSurfelCount, 0u);
+
+    // Every slot is free again.
+    EXPECT_EQ(engine.spawn(createPatch(float3(0.f), settings.surfelLimit)), settings.surfelLimit);
+}
@@ -0,0 +1,157 @@
+#include "SurfelReference/SurfelReferenceEngine.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace
+{
+
+const float kCellUnit = 0.1f;
+
+SurfelReferenceEngine::Settings createSettings()
+{
+    SurfelReferenceEngine::Settings settings;
+    settings.staticParams.cellUnit = kCellUnit;
+    settings.staticParams.cellDim = 100u;
+    settings.staticParams.useIrradianceSharing = true;
+    settings.runtimeParams.fixedGridCenter = true;
+    settings.surfelLimit = 16384;
+    settings.threadCount = 2;
+    return settings;
+}
+
+SurfelView createView()
+{
+    SurfelView view = {};
+    view.position = float3(0.f, 1.f, 0.f);
+    view.fovy = 1.f;
+    view.resolution = uint2(1920, 1080);
+    view.frameDim = view.resolution;
+    return view;
+}
+
+// Surfels on floor within extent, half of them facing down.
+std::vector<Surfel> createSurfels(uint count, float extent, uint seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-extent, extent);
+
+    std::vector<Surfel> surfels(count);
+    for (uint i = 0; i < count; ++i)
+    {
+        Surfel& surfel = surfels[i];
+        surfel = {};
+        surfel.position = float3(dist(rng), dist(rng) * 0.1f, dist(rng));
+        surfel.normal = float3(0.f, i % 2 ? 1.f : -1.f, 0.f);
+        surfel.radius = 0.01f;
+        surfel.msmeData = SurfelReference::makeMSMEData();
+    }
+    return surfels;
+}
+
+// Nearest surfels within affect radius and facing same side, over every surfel.
+std::vector<uint> findNeighborsBruteForce(const SurfelReferenceEngine& engine, uint surfelIndex)
+{
+    const float affectRadius = kCellUnit * std::sqrt(2.f);
+    const Surfel& surfel = engine.getSurfels()[surfelIndex];
+
+    std::vector<std::pair<float, uint>> candidates;
+    for (uint neiSurfelIndex : engine.getValidSurfelIndices())
+    {
+        const Surfel& neiSurfel = engine.getSurfels()[neiSurfelIndex];
+        const float3 bias = surfel.position - neiSurfel.position;
+        const float dist2 = math::dot(bias, bias);
+        if (dist2 < affectRadius * affectRadius && math::dot(neiSurfel.normal, surfel.normal) > 0)
+            candidates.push_back({dist2, neiSurfelIndex});
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<uint> neighbors;
+    for (size_t i = 0; i < std::min<size_t>(candidates.size(), kMaxSurfelNeighborCount); ++i)
+        neighbors.push_back(candidates[i].second);
+    return neighbors;
+}
+
+std::vector<uint> getNeighbors(const SurfelReferenceEngine& engine, uint surfelIndex)
+{
+    std::vector<uint> neighbors;
+    const uint* pNeighbors = &engine.getNeighborBuffer()[(size_t)surfelIndex * kMaxSurfelNeighborCount];
+    for (uint n = 0; n < kMaxSurfelNeighborCount && pNeighbors[n] != kInvalidSurfelIndex; ++n)
+        neighbors.push_back(pNeighbors[n]);
+    return neighbors;
+}
+
+} // namespace
+
+TEST(SurfelNeighborListTest, SparseMatchesBruteForce)
+{
+    // Few surfels per cell, so that every surfel of 27 cells is candidate.
+    SurfelReferenceEngine engine(createSettings());
+    engine.spawn(createSurfels(600, 1.f, 0));
+    engine.update({createView()});
+
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+    {
+        for (uint n = 0; n < 27; ++n)
+        {
+            const Surfel& surfel = engine.getSurfels()[surfelIndex];
+            const int3 cellPos = SurfelReference::getCellPos(surfel.position, engine.getGridCenter(), kCellUnit);
+            const int3 neighborPos = int3(cellPos.x + (int)(n % 3) - 1, cellPos.y + (int)(n / 3 % 3) - 1, cellPos.z + (int)(n / 9) - 1);
+            ASSERT_LE(engine.getCellInfo(SurfelReference::getFlattenCellIndex(neighborPos, 100u)).surfelCount, kMaxNeighborCandidateCount);
+        }
+
+        EXPECT_EQ(getNeighbors(engine, surfelIndex), findNeighborsBruteForce(engine, surfelIndex));
+    }
+}
+
+TEST(SurfelNeighborListTest, NeighborsCrossCellBoundary)
+{
+    SurfelReferenceEngine engine(createSettings());
+
+    // Two surfels on either side of cell boundary at x = 0.05.
+    std::vector<Surfel> surfels = createSurfels(2, 0.f, 0);
+    surfels[0].position = float3(0.045f, 0.f, 0.f);
+    surfels[1].position = float3(0.055f, 0.f, 0.f);
+    surfels[1].normal = surfels[0].normal;
+
+    engine.spawn(surfels);
+    engine.update({createView()});
+
+    const auto& validIndices = engine.getValidSurfelIndices();
+    ASSERT_EQ(validIndices.size(), 2u);
+    const std::vector<uint> neighbors = getNeighbors(engine, validIndices[0]);
+    EXPECT_NE(std::find(neighbors.begin(), neighbors.end(), validIndices[1]), neighbors.end());
+}
+
+TEST(SurfelNeighborListTest, DenseListIsBoundedAndSorted)
+{
+    // Thousands of surfels per cell. Candidates are sampled, so only bound and order are checked.
+    SurfelReferenceEngine engine(createSettings());
+    engine.spawn(createSurfels(8000, 0.1f, 1));
+    engine.update({createView()});
+
+    const float affectRadius = kCellUnit * std::sqrt(2.f);
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+    {
+        const Surfel& surfel = engine.getSurfels()[surfelIndex];
+        const std::vector<uint> neighbors = getNeighbors(engine, surfelIndex);
+        EXPECT_EQ(neighbors.size(), kMaxSurfelNeighborCount);
+
+        float lastDist2 = 0.f;
+        for (uint neiSurfelIndex : neighbors)
+        {
+            const Surfel& neiSurfel = engine.getSurfels()[neiSurfelIndex];
+            const float3 bias = surfel.position - neiSurfel.position;
+            const float dist2 = math::dot(bias, bias);
+
+            EXPECT_LT(dist2, affectRadius * affectRadius);
+            EXPECT_GT(math::dot(neiSurfel.normal, surfel.normal), 0.f);
+            EXPECT_GE(dist2, lastDist2);
+            lastDist2 = dist2;
+        }
+
+        // No duplicate.
+        std::vector<uint> sorted = neighbors;
+        std::sort(sorted.begin(), sorted.end());
+        EXPECT_EQ(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    }
+}
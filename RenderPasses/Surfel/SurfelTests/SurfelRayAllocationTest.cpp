@@ -0,0 +1,119 @@
+#include "SurfelReference/SurfelReferenceMath.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace SurfelReference;
+
+namespace
+{
+
+enum class Distribution
+{
+    Uniform,    ///< Any count between 0 and max.
+    Sparse,     ///< Most surfels request no ray, as sleeping ones at low min ray count.
+    HeavyTail,  ///< Few surfels take max count, as noisy ones do.
+    Constant,
+};
+
+std::vector<uint> createRequestedRayCounts(Distribution distribution, uint count, std::mt19937& rng)
+{
+    std::uniform_int_distribution<uint> countDist(0, 64);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+
+    std::vector<uint> requestedRayCounts(count);
+    for (uint& rayCount : requestedRayCounts)
+    {
+        switch (distribution)
+        {
+        case Distribution::Uniform:
+            rayCount = countDist(rng);
+            break;
+        case Distribution::Sparse:
+            rayCount = u(rng) < 0.9f ? 0 : countDist(rng);
+            break;
+        case Distribution::HeavyTail:
+            rayCount = u(rng) < 0.05f ? 256 : 1 + countDist(rng) / 16;
+            break;
+        case Distribution::Constant:
+            rayCount = 16;
+            break;
+        }
+    }
+    return requestedRayCounts;
+}
+
+// Every ray to trace has owner whose range holds it, and every allocated ray is traced.
+void checkAllocation(const std::vector<uint>& requestedRayCounts, uint rayBudget)
+{
+    std::vector<uint> rayOffsets, rayCounts;
+    const uint rayCount = allocateRays(requestedRayCounts, rayBudget, rayOffsets, rayCounts);
+
+    ASSERT_LE(rayCount, rayBudget);
+
+    uint allocatedRayCount = 0;
+    for (size_t i = 0; i < requestedRayCounts.size(); ++i)
+    {
+        EXPECT_TRUE(rayCounts[i] == 0 || rayCounts[i] == requestedRayCounts[i]);
+        if (rayCounts[i] > 0)
+            EXPECT_LE(rayOffsets[i] + rayCounts[i], rayBudget);
+        if (i > 0)
+            EXPECT_GE(rayOffsets[i], rayOffsets[i - 1]);
+        allocatedRayCount += rayCounts[i];
+    }
+    EXPECT_EQ(rayCount, allocatedRayCount);
+
+    for (uint rayIndex = 0; rayIndex < rayCount; ++rayIndex)
+    {
+        const uint owner = findRayOwner(rayOffsets, rayIndex);
+        ASSERT_GE(rayIndex, rayOffsets[owner]);
+        ASSERT_LT(rayIndex, rayOffsets[owner] + rayCounts[owner]) << "Ray " << rayIndex << " has owner without ray.";
+    }
+}
+
+} // namespace
+
+TEST(SurfelRayAllocationTest, RandomDistributions)
+{
+    std::mt19937 rng(0);
+
+    for (Distribution distribution : {Distribution::Uniform, Distribution::Sparse, Distribution::HeavyTail, Distribution::Constant})
+    {
+        for (uint iteration = 0; iteration < 20; ++iteration)
+        {
+            const uint surfelCount = std::uniform_int_distribution<uint>(1, 3000)(rng);
+            const auto requestedRayCounts = createRequestedRayCounts(distribution, surfelCount, rng);
+
+            // Budgets both above total and in the middle of it.
+            checkAllocation(requestedRayCounts, 1u << 30);
+            checkAllocation(requestedRayCounts, std::uniform_int_distribution<uint>(0, surfelCount * 32)(rng));
+        }
+    }
+}
+
+TEST(SurfelRayAllocationTest, OverflowingSurfelGetsNoRay)
+{
+    std::vector<uint> rayOffsets, rayCounts;
+
+    // Third surfel would end at 110 with budget 100. Last surfel fits, but comes after overflow at offset 110.
+    const uint rayCount = allocateRays({40, 50, 20, 0}, 100, rayOffsets, rayCounts);
+
+    EXPECT_EQ(rayCount, 90u);
+    EXPECT_EQ(rayCounts[2], 0u);
+    EXPECT_EQ(rayOffsets[2], 90u);
+    EXPECT_EQ(rayOffsets[3], 110u);
+
+    // Rays 90 to 99 would belong to third surfel, which has no ray.
+    EXPECT_EQ(findRayOwner(rayOffsets, 89), 1u);
+}
+
+TEST(SurfelRayAllocationTest, SurfelsWithoutRayAreSkipped)
+{
+    std::vector<uint> rayOffsets, rayCounts;
+    const uint rayCount = allocateRays({0, 0, 3, 0, 2, 0}, 100, rayOffsets, rayCounts);
+
+    EXPECT_EQ(rayCount, 5u);
+    EXPECT_EQ(findRayOwner(rayOffsets, 0), 2u);
+    EXPECT_EQ(findRayOwner(rayOffsets, 2), 2u);
+    EXPECT_EQ(findRayOwner(rayOffsets, 3), 4u);
+    EXPECT_EQ(findRayOwner(rayOffsets, 4), 4u);
+}
@@ -0,0 +1,274 @@
+#include "SurfelReference/SurfelReferenceEngine.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+namespace
+{
+
+SurfelReferenceEngine::Settings createSettings(uint threadCount)
+{
+    SurfelReferenceEngine::Settings settings;
+    settings.staticParams.cellUnit = 0.1f;
+    settings.staticParams.cellDim = 100u;
+    settings.staticParams.useIrradianceSharing = true;
+    settings.surfelLimit = 8192;
+    settings.rayBudget = 8192 * 16;
+    settings.threadCount = threadCount;
+    return settings;
+}
+
+SurfelView createView(const float3& position)
+{
+    SurfelView view = {};
+    view.position = position;
+    view.fovy = 1.f;
+    view.resolution = uint2(1920, 1080);
+    view.frameDim = view.resolution;
+    return view;
+}
+
+// Surfels on floor plane y = 0, as generation pass would spawn them.
+std::vector<Surfel> createFloorSurfels(uint count, uint seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-2.f, 2.f);
+
+    std::vector<Surfel> surfels(count);
+    for (Surfel& surfel : surfels)
+    {
+        surfel = {};
+        surfel.position = float3(dist(rng), 0.f, dist(rng));
+        surfel.normal = float3(0.f, 1.f, 0.f);
+        surfel.radius = 0.05f;
+        surfel.msmeData = SurfelReference::makeMSMEData();
+    }
+    return surfels;
+}
+
+// Rays of sky with given radiance, sampled uniformly over hemisphere.
+std::vector<SurfelRayResult> createRayResults(const SurfelReferenceEngine& engine, float3 radiance, uint seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    std::vector<SurfelRayResult> rayResults(engine.getRequestedRayCount());
+    for (uint rayIndex = 0; rayIndex < rayResults.size(); ++rayIndex)
+    {
+        const uint surfelIndex = engine.findRaySurfel(rayIndex);
+        const Surfel& surfel = engine.getSurfels()[surfelIndex];
+        const float3 dirLocal = SurfelReference::hemispherePointUniform(dist(rng), dist(rng));
+
+        SurfelRayResult& rayResult = rayResults[rayIndex];
+        rayResult.dirLocal = dirLocal;
+        rayResult.dirWorld = SurfelReference::getTangentSpace(surfel.normal).toWorld(dirLocal);
+        rayResult.pdf = 1.f / (2.f * (float)M_PI);
+        rayResult.firstRayLength = FLT_MAX;
+        rayResult.radiance = radiance * (0.5f + dist(rng));
+        rayResult.surfelIndex = surfelIndex;
+    }
+    return rayResults;
+}
+
+// Run frames with same input, and return surfels after the last one.
+std::vector<Surfel> runFrames(SurfelReferenceEngine& engine, uint frameCount)
+{
+    const std::vector<SurfelView> views = {createView(float3(0.f, 1.f, 0.f))};
+
+    engine.spawn(createFloorSurfels(4000, 1));
+    for (uint frame = 0; frame < frameCount; ++frame)
+    {
+        for (uint surfelIndex : engine.getValidSurfelIndices())
+            engine.markSeen(surfelIndex);
+
+        engine.update(views);
+        engine.integrate(createRayResults(engine, float3(1.f), frame));
+    }
+    return engine.getSurfels();
+}
+
+} // namespace
+
+TEST(SurfelReferenceEngineTest, SpawnPopsFreeSlotsFromEnd)
+{
+    SurfelReferenceEngine engine(createSettings(1));
+    const uint surfelLimit = createSettings(1).surfelLimit;
+
+    EXPECT_EQ(engine.spawn(createFloorSurfels(3, 0)), 3u);
+    const auto& validIndices = engine.getValidSurfelIndices();
+    ASSERT_EQ(validIndices.size(), 3u);
+    EXPECT_EQ(validIndices[0], surfelLimit - 1);
+    EXPECT_EQ(validIndices[2], surfelLimit - 3);
+
+    // Update compacts valid list into ascending index order.
+    engine.update({createView(float3(0.f, 1.f, 0.f))});
+    EXPECT_EQ(engine.getValidSurfelIndices()[0], surfelLimit - 3);
+    EXPECT_EQ(engine.getValidSurfelIndices()[2], surfelLimit - 1);
+}
+
+TEST(SurfelReferenceEngineTest, SpawnStopsAtLimit)
+{
+    SurfelReferenceEngine engine(createSettings(1));
+    const uint surfelLimit = createSettings(1).surfelLimit;
+
+    EXPECT_EQ(engine.spawn(createFloorSurfels(surfelLimit - 10, 0)), surfelLimit - 10);
+    EXPECT_EQ(engine.spawn(createFloorSurfels(100, 1)), 10u);
+    EXPECT_EQ(engine.spawn(createFloorSurfels(1, 2)), 0u);
+}
+
+TEST(SurfelReferenceEngineTest, RaysAreContiguous)
+{
+    SurfelReferenceEngine engine(createSettings(2));
+    engine.spawn(createFloorSurfels(3000, 0));
+    engine.update({createView(float3(0.f, 1.f, 0.f))});
+
+    uint rayOffset = 0;
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+    {
+        const Surfel& surfel = engine.getSurfels()[surfelIndex];
+        EXPECT_EQ(surfel.rayOffset, rayOffset);
+        EXPECT_GT(surfel.rayCount, 0u);
+
+        for (uint rayIndex = surfel.rayOffset; rayIndex < surfel.rayOffset + surfel.rayCount; ++rayIndex)
+            ASSERT_EQ(engine.findRaySurfel(rayIndex), surfelIndex);
+
+        rayOffset += surfel.rayCount;
+    }
+    EXPECT_EQ(engine.getRequestedRayCount(), rayOffset);
+}
+
+TEST(SurfelReferenceEngineTest, CellListsHoldIntersectingSurfels)
+{
+    const auto settings = createSettings(2);
+    SurfelReferenceEngine engine(settings);
+    engine.spawn(createFloorSurfels(2000, 0));
+    engine.update({createView(float3(0.f, 1.f, 0.f))});
+
+    const auto& staticParams = settings.staticParams;
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+    {
+        const Surfel& surfel = engine.getSurfels()[surfelIndex];
+        const int3 cellPos = SurfelReference::getCellPos(surfel.position, engine.getGridCenter(), staticParams.cellUnit);
+        const CellInfo cellInfo = engine.getCellInfo(SurfelReference::getFlattenCellIndex(cellPos, staticParams.cellDim));
+
+        const auto begin = engine.getCellToSurfelBuffer().begin() + cellInfo.cellToSurfelBufferOffset;
+        const auto end = begin + cellInfo.surfelCount;
+        EXPECT_TRUE(std::is_sorted(begin, end));
+        EXPECT_TRUE(std::binary_search(begin, end, surfelIndex));
+    }
+}
+
+TEST(SurfelReferenceEngineTest, DestroyedSurfelIsFreed)
+{
+    SurfelReferenceEngine engine(createSettings(1));
+    engine.spawn(createFloorSurfels(10, 0));
+    engine.update({createView(float3(0.f, 1.f, 0.f))});
+
+    const uint destroyedIndex = engine.getValidSurfelIndices()[4];
+    engine.markDestroy(destroyedIndex);
+    engine.update({createView(float3(0.f, 1.f, 0.f))});
+
+    const auto& validIndices = engine.getValidSurfelIndices();
+    EXPECT_EQ(validIndices.size(), 9u);
+    EXPECT_EQ(std::find(validIndices.begin(), validIndices.end(), destroyedIndex), validIndices.end());
+}
+
+TEST(SurfelReferenceEngineTest, SameResultOnAnyThreadCount)
+{
+    SurfelReferenceEngine serialEngine(createSettings(1));
+    SurfelReferenceEngine parallelEngine(createSettings(4));
+
+    TaskScheduler scheduler(3);
+    auto schedulerSettings = createSettings(0);
+    schedulerSettings.pScheduler = &scheduler;
+    SurfelReferenceEngine schedulerEngine(schedulerSettings);
+
+    const auto serialSurfels = runFrames(serialEngine, 8);
+    const auto parallelSurfels = runFrames(parallelEngine, 8);
+    const auto schedulerSurfels = runFrames(schedulerEngine, 8);
+
+    for (uint surfelIndex : serialEngine.getValidSurfelIndices())
+    {
+        for (const auto* pSurfels : {&parallelSurfels, &schedulerSurfels})
+        {
+            const Surfel& a = serialSurfels[surfelIndex];
+            const Surfel& b = (*pSurfels)[surfelIndex];
+            ASSERT_EQ(a.radiance.x, b.radiance.x);
+            ASSERT_EQ(a.radiance.y, b.radiance.y);
+            ASSERT_EQ(a.radiance.z, b.radiance.z);
+            ASSERT_EQ(a.msmeData.variance.x, b.msmeData.variance.x);
+            ASSERT_EQ(a.radius, b.radius);
+            ASSERT_EQ(a.rayOffset, b.rayOffset);
+        }
+    }
+}
+
+TEST(SurfelReferenceEngineTest, IntegrateConverges)
+{
+    SurfelReferenceEngine engine(createSettings(2));
+    const std::vector<SurfelView> views = {createView(float3(0.f, 1.f, 0.f))};
+    engine.spawn(createFloorSurfels(1000, 0));
+
+    float firstVariance = 0.f;
+    float lastVariance = 0.f;
+    for (uint frame = 0; frame < 200; ++frame)
+    {
+        for (uint surfelIndex : engine.getValidSurfelIndices())
+            engine.markSeen(surfelIndex);
+
+        engine.update(views);
+        lastVariance = engine.integrate(createRayResults(engine, float3(1.f), frame));
+        if (frame == 10)
+            firstVariance = lastVariance;
+    }
+
+    EXPECT_LT(lastVariance, firstVariance);
+
+    // Uniform sky of radiance 1 gives irradiance pi, integrated as 1 / 16 of it.
+    for (uint surfelIndex : engine.getValidSurfelIndices())
+        EXPECT_NEAR(engine.getSurfels()[surfelIndex].radiance.y, 1.f / 16.f, 0.02f);
+}
+
+TEST(SurfelReferenceEngineTest, SchedulerCoversEveryIndexOnce)
+{
+    TaskScheduler scheduler(4);
+    std::vector<std::atomic<uint>> visits(10000);
+
+    scheduler.parallelFor(
+        (uint)visits.size(),
+        7,
+        [&](uint workerIndex, uint begin, uint end)
+        {
+            EXPECT_LT(workerIndex, scheduler.getWorkerCount());
+            for (uint i = begin; i < end; ++i)
+                visits[i]++;
+        }
+    );
+
+    for (const auto& visit : visits)
+        ASSERT_EQ(visit.load(), 1u);
+}
+
+TEST(SurfelReferenceEngineTest, SchedulerRethrows)
+{
+    TaskScheduler scheduler(4);
+    std::atomic<uint> rangeCount = 0;
+
+    EXPECT_THROW(
+        scheduler.parallelFor(
+            100,
+            1,
+            [&](uint, uint begin, uint)
+            {
+                rangeCount++;
+                if (begin == 50)
+                    throw std::runtime_error("Range failed.");
+            }
+        ),
+        std::runtime_error
+    );
+
+    // Remaining ranges are still run, and scheduler is usable again.
+    EXPECT_EQ(rangeCount.load(), 100u);
+    scheduler.parallelFor(10, 1, [](uint, uint, uint) {});
+}
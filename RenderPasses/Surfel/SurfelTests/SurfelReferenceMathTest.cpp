@@ -0,0 +1,183 @@
+#include "SurfelReference/SurfelReferenceMath.h"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace SurfelReference;
+
+TEST(SurfelReferenceMathTest, CellPosRoundsHalfToEven)
+{
+    // HLSL round() keeps surfel at cell boundary in even cell. std::round would move 0.5 to 1.
+    const int3 cellPos = getCellPos(float3(0.5f, 1.5f, -2.5f), float3(0.f), 1.f);
+    EXPECT_EQ(cellPos.x, 0);
+    EXPECT_EQ(cellPos.y, 2);
+    EXPECT_EQ(cellPos.z, -2);
+
+    const int3 offsetPos = getCellPos(float3(10.26f, 9.74f, 10.f), float3(10.f), 0.5f);
+    EXPECT_EQ(offsetPos.x, 1);
+    EXPECT_EQ(offsetPos.y, -1);
+    EXPECT_EQ(offsetPos.z, 0);
+}
+
+TEST(SurfelReferenceMathTest, FlattenCellIndex)
+{
+    const uint cellDim = 250;
+
+    EXPECT_EQ(getFlattenCellIndex(int3(0, 0, 0), cellDim), 125u * cellDim * cellDim + 125u * cellDim + 125u);
+    EXPECT_EQ(getFlattenCellIndex(int3(-125, -125, -125), cellDim), 0u);
+    EXPECT_EQ(getFlattenCellIndex(int3(1, 0, 0), cellDim) - getFlattenCellIndex(int3(0, 0, 0), cellDim), 1u);
+    EXPECT_EQ(getFlattenCellIndex(int3(0, 0, 1), cellDim) - getFlattenCellIndex(int3(0, 0, 0), cellDim), cellDim * cellDim);
+
+    // Out of range cell wraps around as unsigned on GPU, it is not clamped.
+    EXPECT_EQ(getFlattenCellIndex(int3(-126, -125, -125), cellDim), 0xffffffffu);
+}
+
+TEST(SurfelReferenceMathTest, CellValidRange)
+{
+    const uint cellDim = 250;
+
+    EXPECT_TRUE(isCellValid(int3(124, -124, 0), cellDim));
+    EXPECT_FALSE(isCellValid(int3(125, 0, 0), cellDim));
+    EXPECT_FALSE(isCellValid(int3(0, -125, 0), cellDim));
+
+    // Odd dimension rounds half down, so only center cell of dimension 3 is valid.
+    EXPECT_TRUE(isCellValid(int3(0, 0, 0), 3));
+    EXPECT_FALSE(isCellValid(int3(0, 0, 1), 3));
+}
+
+TEST(SurfelReferenceMathTest, SurfelIntersectCell)
+{
+    const float cellUnit = 1.f;
+    const uint cellDim = 250;
+    const float3 gridCenter = float3(0.f);
+    const float3 surfelPos = float3(0.f);
+
+    // Face of neighbor cell is at 0.5, strictly closer than radius intersects.
+    EXPECT_TRUE(isSurfelIntersectCell(surfelPos, 0.51f, int3(1, 0, 0), gridCenter, cellUnit, cellDim));
+    EXPECT_FALSE(isSurfelIntersectCell(surfelPos, 0.5f, int3(1, 0, 0), gridCenter, cellUnit, cellDim));
+
+    // Corner of diagonal neighbor is at sqrt(3) / 2.
+    EXPECT_FALSE(isSurfelIntersectCell(surfelPos, 0.86f, int3(1, 1, 1), gridCenter, cellUnit, cellDim));
+    EXPECT_TRUE(isSurfelIntersectCell(surfelPos, 0.87f, int3(1, 1, 1), gridCenter, cellUnit, cellDim));
+
+    // Own cell always intersects, invalid cell never does.
+    EXPECT_TRUE(isSurfelIntersectCell(surfelPos, 1e-3f, int3(0, 0, 0), gridCenter, cellUnit, cellDim));
+    EXPECT_FALSE(isSurfelIntersectCell(float3(124.4f, 0.f, 0.f), 2.f, int3(125, 0, 0), gridCenter, cellUnit, cellDim));
+}
+
+TEST(SurfelReferenceMathTest, SurfelRadius)
+{
+    const float fovy = 1.f;
+    const uint2 resolution = uint2(1920, 1080);
+    const float cellUnit = 0.5f;
+
+    // Radius grows linearly with distance, until it is clamped to two cells.
+    const float radius1 = calcSurfelRadius(1.f, fovy, resolution, 40000.f, cellUnit);
+    const float radius2 = calcSurfelRadius(2.f, fovy, resolution, 40000.f, cellUnit);
+    EXPECT_NEAR(radius2, 2.f * radius1, 1e-6f);
+    EXPECT_EQ(calcSurfelRadius(1000.f, fovy, resolution, 40000.f, cellUnit), cellUnit * 2);
+
+    // Larger side of resolution is used.
+    EXPECT_EQ(calcRadiusApprox(40000.f, 1.f, fovy, uint2(1080, 1920)), calcRadiusApprox(40000.f, 1.f, fovy, resolution));
+}
+
+TEST(SurfelReferenceMathTest, OctEncodeRoundTrip)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        float3 dir = float3(dist(rng), dist(rng), std::abs(dist(rng)) + 1e-3f);
+        dir = math::normalize(dir);
+
+        const float2 uv = octEncode(dir * 3.f);
+        EXPECT_LE(std::abs(uv.x), 1.f + 1e-6f);
+        EXPECT_LE(std::abs(uv.y), 1.f + 1e-6f);
+
+        const float3 decoded = octDecode(uv);
+        EXPECT_NEAR(decoded.x, dir.x, 1e-5f);
+        EXPECT_NEAR(decoded.y, dir.y, 1e-5f);
+        EXPECT_NEAR(decoded.z, dir.z, 1e-5f);
+    }
+}
+
+TEST(SurfelReferenceMathTest, TangentSpaceIsOrthonormal)
+{
+    for (const float3& normal : {float3(0, 0, 1), float3(1, 0, 0), math::normalize(float3(1, 2, -3))})
+    {
+        const TangentSpace space = getTangentSpace(normal);
+        EXPECT_NEAR(math::dot(space.tangent, space.binormal), 0.f, 1e-6f);
+        EXPECT_NEAR(math::dot(space.tangent, normal), 0.f, 1e-6f);
+        EXPECT_NEAR(math::dot(space.binormal, normal), 0.f, 1e-6f);
+
+        // Local z is normal.
+        const float3 dirW = space.toWorld(float3(0, 0, 1));
+        EXPECT_NEAR(math::dot(dirW, normal), 1.f, 1e-6f);
+    }
+}
+
+TEST(SurfelReferenceMathTest, RandomSequence)
+{
+    RNG a, b, c;
+    a.init(uint2(3, 5), 7);
+    b.init(uint2(3, 5), 7);
+    c.init(uint2(3, 5), 8);
+
+    bool differs = false;
+    for (int i = 0; i < 256; ++i)
+    {
+        const float u = a.nextFloat();
+        EXPECT_EQ(u, b.nextFloat());
+        EXPECT_GE(u, 0.f);
+        EXPECT_LT(u, 1.f);
+        differs |= u != c.nextFloat();
+    }
+    EXPECT_TRUE(differs);
+
+    // 23 mantissa bits, so nextUint never reaches nmax.
+    for (int i = 0; i < 256; ++i)
+        EXPECT_LT(a.nextUint(10), 10u);
+}
+
+TEST(SurfelReferenceMathTest, Contribution)
+{
+    EXPECT_EQ(calcContribution(1.f, 0.f, 1.f), 1.f);
+    EXPECT_EQ(calcContribution(1.f, 1.f, 1.f), 0.f);
+    EXPECT_EQ(calcContribution(1.f, 2.f, 1.f), 0.f);
+    EXPECT_EQ(calcContribution(-0.5f, 0.f, 1.f), 0.f);
+
+    float last = 1.f;
+    for (float dist = 0.1f; dist < 1.f; dist += 0.1f)
+    {
+        const float contribution = calcContribution(1.f, dist, 1.f);
+        EXPECT_LT(contribution, last);
+        last = contribution;
+    }
+}
+
+TEST(SurfelReferenceMathTest, MSMEConvergesToConstant)
+{
+    MSMEData data = makeMSMEData();
+    const float3 y = float3(0.5f, 1.f, 2.f);
+
+    float3 mean = float3(0.f);
+    for (int i = 0; i < 2000; ++i)
+        mean = MSME(y, data);
+
+    EXPECT_NEAR(mean.x, y.x, 1e-3f);
+    EXPECT_NEAR(mean.y, y.y, 1e-3f);
+    EXPECT_NEAR(mean.z, y.z, 1e-3f);
+    EXPECT_LT(luminance(data.variance), 1e-6f);
+}
+
+TEST(SurfelReferenceMathTest, MSMESuppressesFirefly)
+{
+    MSMEData data = makeMSMEData();
+    for (int i = 0; i < 500; ++i)
+        MSME(float3(1.f), data);
+
+    // Sample far above short mean plus deviation is clamped before blending.
+    const float3 mean = MSME(float3(1e6f), data);
+    EXPECT_LT(mean.x, 2.f);
+    EXPECT_LT(data.shortMean.x, 2.f);
+}
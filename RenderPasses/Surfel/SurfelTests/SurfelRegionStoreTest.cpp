@@ -0,0 +1,234 @@
+#include "SurfelGI/SurfelRegionStore.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+const float kRegionSize = 10.f;
+const uint64_t kRecordSize = sizeof(SurfelRegionRecord);
+
+SurfelRegionRecord createRecord(const float3& position, uint id)
+{
+    SurfelRegionRecord record = {};
+    record.surfel.position = position;
+    record.surfel.normal = float3(0.f, 1.f, 0.f);
+    record.surfel.radiance = float3((float)id);
+    record.hitInfo = {id, id + 1, id + 2, id + 3};
+    return record;
+}
+
+// Records of region centered at given region position.
+std::vector<SurfelRegionRecord> createRegion(const int3& region, uint count, uint firstId)
+{
+    std::vector<SurfelRegionRecord> records;
+    const float3 center = (float3(region) + float3(0.5f)) * kRegionSize;
+    for (uint i = 0; i < count; ++i)
+        records.push_back(createRecord(center + float3(0.1f * (float)i, 0.f, 0.f), firstId + i));
+    return records;
+}
+
+void store(SurfelRegionStore& store, const std::vector<SurfelRegionRecord>& records)
+{
+    store.store(records.data(), records.size());
+}
+
+// Take single region back.
+std::vector<SurfelRegionRecord> take(SurfelRegionStore& store, const int3& region)
+{
+    std::vector<SurfelRegionRecord> records;
+    const float3 center = (float3(region) + float3(0.5f)) * kRegionSize;
+    store.take(center, center, records);
+    return records;
+}
+
+bool isSameRecords(const std::vector<SurfelRegionRecord>& a, const std::vector<SurfelRegionRecord>& b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * kRecordSize) == 0);
+}
+
+std::filesystem::path getSpillPath()
+{
+    return std::filesystem::temp_directory_path() /
+           ("SurfelRegionStoreTest_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".bin");
+}
+
+} // namespace
+
+TEST(SurfelRegionStoreTest, SerializeRoundTrip)
+{
+    const auto records = createRegion(int3(1, 2, 3), 5, 0);
+    const std::vector<uint8_t> data = SurfelRegionStore::serialize(records);
+
+    // Deserialized records are appended.
+    std::vector<SurfelRegionRecord> loaded = createRegion(int3(0, 0, 0), 2, 100);
+    ASSERT_TRUE(SurfelRegionStore::deserialize(data.data(), data.size(), loaded));
+    ASSERT_EQ(loaded.size(), 7u);
+    EXPECT_TRUE(isSameRecords(std::vector<SurfelRegionRecord>(loaded.begin() + 2, loaded.end()), records));
+
+    std::vector<SurfelRegionRecord> empty;
+    const std::vector<uint8_t> emptyData = SurfelRegionStore::serialize(empty);
+    EXPECT_TRUE(SurfelRegionStore::deserialize(emptyData.data(), emptyData.size(), empty));
+    EXPECT_TRUE(empty.empty());
+}
+
+TEST(SurfelRegionStoreTest, DeserializeRejectsBadData)
+{
+    const std::vector<uint8_t> data = SurfelRegionStore::serialize(createRegion(int3(0, 0, 0), 3, 0));
+    std::vector<SurfelRegionRecord> records;
+
+    EXPECT_FALSE(SurfelRegionStore::deserialize(data.data(), data.size() - 1, records));
+    EXPECT_FALSE(SurfelRegionStore::deserialize(data.data(), 8, records));
+
+    // Written with other record layout.
+    std::vector<uint8_t> otherLayout = data;
+    otherLayout[8]++;
+    EXPECT_FALSE(SurfelRegionStore::deserialize(otherLayout.data(), otherLayout.size(), records));
+
+    std::vector<uint8_t> otherMagic = data;
+    otherMagic[0]++;
+    EXPECT_FALSE(SurfelRegionStore::deserialize(otherMagic.data(), otherMagic.size(), records));
+
+    EXPECT_TRUE(records.empty());
+}
+
+TEST(SurfelRegionStoreTest, RegionOfPosition)
+{
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 1ull << 30, {});
+
+    const int3 region = regionStore.getRegion(float3(-0.1f, 9.9f, 10.f));
+    EXPECT_EQ(region.x, -1);
+    EXPECT_EQ(region.y, 0);
+    EXPECT_EQ(region.z, 1);
+}
+
+TEST(SurfelRegionStoreTest, TakeReturnsRegionsInBox)
+{
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 1ull << 30, {});
+
+    const auto a = createRegion(int3(1, 0, 0), 3, 0);
+    const auto b = createRegion(int3(-1, 0, 0), 2, 10);
+    const auto c = createRegion(int3(5, 0, 0), 4, 20);
+    store(regionStore, a);
+    store(regionStore, c);
+    store(regionStore, b);
+    EXPECT_EQ(regionStore.getStats().residentSize, 9 * kRecordSize);
+
+    // Box spans regions -1 to 1. Records come in region order, not store order.
+    std::vector<SurfelRegionRecord> records;
+    EXPECT_EQ(regionStore.take(float3(-5.f, 1.f, 1.f), float3(15.f, 1.f, 1.f), records), 2u);
+
+    std::vector<SurfelRegionRecord> expected = b;
+    expected.insert(expected.end(), a.begin(), a.end());
+    EXPECT_TRUE(isSameRecords(records, expected));
+
+    // Taken regions are removed.
+    EXPECT_TRUE(take(regionStore, int3(1, 0, 0)).empty());
+    EXPECT_EQ(regionStore.getStats().residentRegionCount, 1u);
+    EXPECT_EQ(regionStore.getStats().residentSize, 4 * kRecordSize);
+    EXPECT_TRUE(isSameRecords(take(regionStore, int3(5, 0, 0)), c));
+}
+
+TEST(SurfelRegionStoreTest, StoreAppendsToRegion)
+{
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 1ull << 30, {});
+
+    auto records = createRegion(int3(0, 0, 0), 2, 0);
+    const auto more = createRegion(int3(0, 0, 0), 3, 10);
+    store(regionStore, records);
+    store(regionStore, more);
+
+    records.insert(records.end(), more.begin(), more.end());
+    EXPECT_TRUE(isSameRecords(take(regionStore, int3(0, 0, 0)), records));
+}
+
+TEST(SurfelRegionStoreTest, LeastRecentlyUsedIsDropped)
+{
+    // Budget of two regions of 4 records, and no spill file.
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 8 * kRecordSize, {});
+
+    store(regionStore, createRegion(int3(0, 0, 0), 4, 0));
+    store(regionStore, createRegion(int3(1, 0, 0), 3, 10));
+
+    // Region 0 is used again within budget, so region 1 is least recently used when region 2 comes.
+    store(regionStore, createRegion(int3(0, 0, 0), 1, 20));
+    EXPECT_EQ(regionStore.getStats().residentSize, 8 * kRecordSize);
+    EXPECT_EQ(regionStore.getStats().droppedRecordCount, 0u);
+
+    store(regionStore, createRegion(int3(2, 0, 0), 2, 30));
+    EXPECT_EQ(regionStore.getStats().residentSize, 7 * kRecordSize);
+    EXPECT_EQ(regionStore.getStats().residentRegionCount, 2u);
+    EXPECT_EQ(regionStore.getStats().droppedRecordCount, 3u);
+
+    EXPECT_EQ(take(regionStore, int3(0, 0, 0)).size(), 5u);
+    EXPECT_TRUE(take(regionStore, int3(1, 0, 0)).empty());
+    EXPECT_EQ(take(regionStore, int3(2, 0, 0)).size(), 2u);
+}
+
+TEST(SurfelRegionStoreTest, EvictedRegionIsSpilledAndRestored)
+{
+    const auto spillPath = getSpillPath();
+
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 4 * kRecordSize, spillPath);
+
+    const auto a = createRegion(int3(0, 0, 0), 4, 0);
+    const auto b = createRegion(int3(0, 1, 0), 4, 10);
+    store(regionStore, a);
+    store(regionStore, b);
+
+    EXPECT_EQ(regionStore.getStats().spilledRegionCount, 1u);
+    EXPECT_EQ(regionStore.getStats().droppedRecordCount, 0u);
+    EXPECT_GT(regionStore.getStats().spillFileSize, 4 * kRecordSize);
+    EXPECT_TRUE(std::filesystem::exists(spillPath));
+
+    // Spilled region comes back intact. Resident one is spilled in turn only when store goes over budget.
+    EXPECT_TRUE(isSameRecords(take(regionStore, int3(0, 0, 0)), a));
+    EXPECT_EQ(regionStore.getStats().spilledRegionCount, 0u);
+    EXPECT_TRUE(isSameRecords(take(regionStore, int3(0, 1, 0)), b));
+
+    // Spill file is removed with regions.
+    regionStore.clear();
+    EXPECT_FALSE(std::filesystem::exists(spillPath));
+}
+
+TEST(SurfelRegionStoreTest, AppendToSpilledRegion)
+{
+    const auto spillPath = getSpillPath();
+
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 4 * kRecordSize, spillPath);
+
+    auto a = createRegion(int3(0, 0, 0), 3, 0);
+    store(regionStore, a);
+    store(regionStore, createRegion(int3(1, 0, 0), 4, 10));
+    ASSERT_EQ(regionStore.getStats().spilledRegionCount, 1u);
+
+    // Spilled region is read back to append, and the other one is spilled instead.
+    const auto more = createRegion(int3(0, 0, 0), 1, 20);
+    store(regionStore, more);
+    a.insert(a.end(), more.begin(), more.end());
+
+    EXPECT_TRUE(isSameRecords(take(regionStore, int3(0, 0, 0)), a));
+    EXPECT_EQ(take(regionStore, int3(1, 0, 0)).size(), 4u);
+
+    regionStore.clear();
+}
+
+TEST(SurfelRegionStoreTest, RegionSizeChangeClears)
+{
+    SurfelRegionStore regionStore;
+    regionStore.configure(kRegionSize, 1ull << 30, {});
+    store(regionStore, createRegion(int3(0, 0, 0), 2, 0));
+
+    // Budget change keeps regions, region size change drops them.
+    regionStore.configure(kRegionSize, 1ull << 29, {});
+    EXPECT_EQ(regionStore.getStats().residentSize, 2 * kRecordSize);
+
+    regionStore.configure(kRegionSize * 2.f, 1ull << 29, {});
+    EXPECT_EQ(regionStore.getStats().residentSize, 0u);
+    EXPECT_EQ(regionStore.getStats().residentRegionCount, 0u);
+}
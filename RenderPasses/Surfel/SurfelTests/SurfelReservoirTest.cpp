@@ -0,0 +1,231 @@
+#include "Falcor.h"
+#include "SurfelGI/SurfelReservoir.slang"
+#include <gtest/gtest.h>
+#include <array>
+#include <random>
+
+using namespace Falcor;
+
+namespace
+{
+
+const uint kTrialCount = 200000;
+
+// Target pdf roughly follows integrand, as unshadowed light contribution follows shadowed one.
+const std::array<float, 6> kIntegrand = {0.5f, 2.f, 0.1f, 4.f, 1.f, 0.25f};
+const std::array<float, 6> kTargetPdf = {1.f, 1.5f, 0.3f, 3.f, 2.f, 0.2f};
+
+// Ray hit reusing reservoir of surfel sees other lights than surfel.
+// Surfel target pdf is zero for lights 1 and 4 that hit sees, and nonzero for light 2 that hit does not see.
+const std::array<float, 6> kHitIntegrand = {0.5f, 2.f, 0.f, 4.f, 1.f, 0.25f};
+const std::array<float, 6> kHitTargetPdf = {1.f, 1.5f, 0.f, 3.f, 2.f, 0.2f};
+const std::array<float, 6> kSurfelTargetPdf = {2.f, 0.f, 1.f, 0.5f, 0.f, 3.f};
+
+float getIntegral(const std::array<float, 6>& integrand = kIntegrand)
+{
+    float sum = 0.f;
+    for (float f : integrand)
+        sum += f;
+    return sum;
+}
+
+struct Sampler
+{
+    std::mt19937 rng{1234};
+    std::uniform_real_distribution<float> dist{0.f, 1.f};
+
+    float next() { return dist(rng); }
+    uint nextLight() { return std::min(uint(next() * kIntegrand.size()), uint(kIntegrand.size() - 1)); }
+};
+
+// Stream uniform candidates as resampling pass does.
+SurfelReservoir streamCandidates(Sampler& sampler, uint candidateCount, const std::array<float, 6>& targetPdf = kTargetPdf)
+{
+    const float lightCount = float(kIntegrand.size());
+
+    SurfelReservoir reservoir = {};
+    for (uint i = 0; i < candidateCount; ++i)
+    {
+        const uint lightIndex = sampler.nextLight();
+        reservoir.update(lightIndex, targetPdf[lightIndex] * lightCount, sampler.next());
+    }
+    reservoir.finalize(targetPdf[reservoir.lightIndex]);
+
+    return reservoir;
+}
+
+// Resample fresh uniform candidate at hit with reservoir of surfel, as ray trace pass does.
+SurfelReservoir reuseAtHit(Sampler& sampler, SurfelReservoir surfelReservoir, float maxM)
+{
+    const float lightCount = float(kIntegrand.size());
+    surfelReservoir.clampHistory(maxM);
+
+    SurfelReservoir reservoir = {};
+    float selectedTargetPdf = 0.f;
+
+    const uint lightIndex = sampler.nextLight();
+    const float targetPdf = kHitTargetPdf[lightIndex];
+    if (targetPdf > 0.f)
+    {
+        const float misWeight =
+            SurfelReservoirMIS::evalBalanceHeuristic(1.f, targetPdf, surfelReservoir.M, kSurfelTargetPdf[lightIndex]);
+        if (reservoir.update(lightIndex, misWeight * targetPdf * lightCount, sampler.next()))
+            selectedTargetPdf = targetPdf;
+    }
+
+    if (surfelReservoir.M > 0.f)
+    {
+        const float reusedTargetPdf = kHitTargetPdf[surfelReservoir.lightIndex];
+        if (reusedTargetPdf > 0.f)
+        {
+            const float misWeight = SurfelReservoirMIS::evalBalanceHeuristic(
+                surfelReservoir.M, kSurfelTargetPdf[surfelReservoir.lightIndex], 1.f, reusedTargetPdf
+            );
+            if (reservoir.mergeWithMIS(surfelReservoir, reusedTargetPdf, misWeight, sampler.next()))
+                selectedTargetPdf = reusedTargetPdf;
+        }
+    }
+
+    reservoir.finalizeWithMIS(selectedTargetPdf);
+
+    return reservoir;
+}
+
+float estimate(const SurfelReservoir& reservoir)
+{
+    return kIntegrand[reservoir.lightIndex] * reservoir.W;
+}
+
+} // namespace
+
+TEST(SurfelReservoir, EmptyReservoirHasNoContribution)
+{
+    SurfelReservoir reservoir = {};
+    reservoir.finalize(1.f);
+    EXPECT_EQ(reservoir.W, 0.f);
+
+    // Empty reservoir has no weight, so it is never selected by merge.
+    SurfelReservoir other = {};
+    EXPECT_FALSE(reservoir.merge(other, 1.f, 0.f));
+    EXPECT_EQ(reservoir.M, 0.f);
+}
+
+TEST(SurfelReservoir, ZeroWeightCandidateIsNeverSelected)
+{
+    SurfelReservoir reservoir = {};
+    EXPECT_TRUE(reservoir.update(3, 1.f, 0.99f));
+    EXPECT_FALSE(reservoir.update(5, 0.f, 0.f));
+    EXPECT_EQ(reservoir.lightIndex, 3u);
+    EXPECT_EQ(reservoir.M, 2.f);
+}
+
+TEST(SurfelReservoir, StreamingIsUnbiased)
+{
+    Sampler sampler;
+
+    for (uint candidateCount : {1u, 4u, 16u})
+    {
+        double sum = 0.0;
+        for (uint i = 0; i < kTrialCount; ++i)
+            sum += estimate(streamCandidates(sampler, candidateCount));
+
+        EXPECT_NEAR(sum / kTrialCount, getIntegral(), getIntegral() * 0.01f) << "candidateCount = " << candidateCount;
+    }
+}
+
+TEST(SurfelReservoir, MergeIsUnbiased)
+{
+    Sampler sampler;
+
+    double sum = 0.0;
+    for (uint i = 0; i < kTrialCount; ++i)
+    {
+        // Fresh candidates merged with reused reservoir of longer history, as temporal reuse does.
+        const SurfelReservoir fresh = streamCandidates(sampler, 2);
+        const SurfelReservoir reused = streamCandidates(sampler, 8);
+
+        SurfelReservoir reservoir = {};
+        reservoir.merge(fresh, kTargetPdf[fresh.lightIndex], sampler.next());
+        reservoir.merge(reused, kTargetPdf[reused.lightIndex], sampler.next());
+        reservoir.finalize(kTargetPdf[reservoir.lightIndex]);
+
+        EXPECT_EQ(reservoir.M, 10.f);
+        sum += estimate(reservoir);
+    }
+
+    EXPECT_NEAR(sum / kTrialCount, getIntegral(), getIntegral() * 0.01f);
+}
+
+TEST(SurfelReservoir, ClampedHistoryIsUnbiased)
+{
+    Sampler sampler;
+
+    double sum = 0.0;
+    for (uint i = 0; i < kTrialCount; ++i)
+    {
+        const SurfelReservoir fresh = streamCandidates(sampler, 1);
+        SurfelReservoir reused = streamCandidates(sampler, 32);
+        reused.clampHistory(4.f);
+        EXPECT_EQ(reused.M, 4.f);
+
+        SurfelReservoir reservoir = {};
+        reservoir.merge(fresh, kTargetPdf[fresh.lightIndex], sampler.next());
+        reservoir.merge(reused, kTargetPdf[reused.lightIndex], sampler.next());
+        reservoir.finalize(kTargetPdf[reservoir.lightIndex]);
+
+        sum += estimate(reservoir);
+    }
+
+    EXPECT_NEAR(sum / kTrialCount, getIntegral(), getIntegral() * 0.01f);
+}
+
+TEST(SurfelReservoir, BalanceHeuristicSumsToOne)
+{
+    EXPECT_FLOAT_EQ(
+        SurfelReservoirMIS::evalBalanceHeuristic(1.f, 2.f, 8.f, 0.5f) + SurfelReservoirMIS::evalBalanceHeuristic(8.f, 0.5f, 1.f, 2.f),
+        1.f
+    );
+
+    // Sample outside support of other domain keeps full weight there.
+    EXPECT_EQ(SurfelReservoirMIS::evalBalanceHeuristic(1.f, 2.f, 8.f, 0.f), 1.f);
+    EXPECT_EQ(SurfelReservoirMIS::evalBalanceHeuristic(8.f, 0.f, 1.f, 2.f), 0.f);
+    EXPECT_EQ(SurfelReservoirMIS::evalBalanceHeuristic(0.f, 0.f, 0.f, 0.f), 0.f);
+}
+
+TEST(SurfelReservoir, ReuseAtHitWithDifferentSupportIsUnbiased)
+{
+    Sampler sampler;
+    const float integral = getIntegral(kHitIntegrand);
+
+    // Long surfel history is clamped, otherwise it would dominate fresh candidate.
+    for (uint surfelCandidateCount : {1u, 8u, 64u})
+    {
+        double sum = 0.0;
+        for (uint i = 0; i < kTrialCount; ++i)
+        {
+            const SurfelReservoir surfelReservoir = streamCandidates(sampler, surfelCandidateCount, kSurfelTargetPdf);
+            const SurfelReservoir reservoir = reuseAtHit(sampler, surfelReservoir, 20.f);
+            sum += kHitIntegrand[reservoir.lightIndex] * reservoir.W;
+        }
+
+        EXPECT_NEAR(sum / kTrialCount, integral, integral * 0.01f) << "surfelCandidateCount = " << surfelCandidateCount;
+    }
+}
+
+TEST(SurfelReservoir, LightOnlyReachableFromHitKeepsContribution)
+{
+    Sampler sampler;
+
+    // Light 1 has zero target pdf at surfel, so only fresh candidate can pick it, and its weight must not shrink
+    // with history length of surfel reservoir.
+    double sum = 0.0;
+    for (uint i = 0; i < kTrialCount; ++i)
+    {
+        const SurfelReservoir surfelReservoir = streamCandidates(sampler, 64, kSurfelTargetPdf);
+        const SurfelReservoir reservoir = reuseAtHit(sampler, surfelReservoir, 20.f);
+        if (reservoir.lightIndex == 1)
+            sum += kHitIntegrand[1] * reservoir.W;
+    }
+
+    EXPECT_NEAR(sum / kTrialCount, kHitIntegrand[1], kHitIntegrand[1] * 0.02f);
+}
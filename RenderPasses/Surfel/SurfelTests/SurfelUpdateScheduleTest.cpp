@@ -0,0 +1,144 @@
+#include "Falcor.h"
+#include "SurfelGI/SurfelUpdateSchedule.slang"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Falcor;
+
+namespace
+{
+
+const uint kOldAge = kScheduleWarmupFrameCount + 100;
+
+SurfelUpdateSchedule createSchedule(uint interval)
+{
+    SurfelUpdateSchedule schedule = {};
+    schedule.interval = interval;
+    schedule.varianceThreshold = 0.1f;
+    return schedule;
+}
+
+// Converged off-screen surfel, which is deferred.
+bool shouldUpdateDeferred(SurfelUpdateSchedule& schedule, uint surfelIndex, uint frameIndex)
+{
+    return schedule.shouldUpdate(surfelIndex, frameIndex, kOldAge, false, false, 0.f);
+}
+
+} // namespace
+
+TEST(SurfelUpdateScheduleTest, NotDeferrableIsAlwaysUpdated)
+{
+    SurfelUpdateSchedule schedule = createSchedule(8);
+
+    for (uint frameIndex = 0; frameIndex < 32; ++frameIndex)
+    {
+        // Young, visible or inconsistent surfel.
+        EXPECT_TRUE(schedule.shouldUpdate(3, frameIndex, kScheduleWarmupFrameCount - 1, false, false, 0.f));
+        EXPECT_TRUE(schedule.shouldUpdate(3, frameIndex, kOldAge, true, true, 0.f));
+        EXPECT_TRUE(schedule.shouldUpdate(3, frameIndex, kOldAge, false, false, 0.2f));
+    }
+}
+
+TEST(SurfelUpdateScheduleTest, Deferrable)
+{
+    SurfelUpdateSchedule schedule = createSchedule(8);
+
+    EXPECT_FALSE(schedule.isDeferrable(kScheduleWarmupFrameCount - 1, false, true, 0.f));
+    EXPECT_TRUE(schedule.isDeferrable(kScheduleWarmupFrameCount, false, false, 0.1f));
+    EXPECT_FALSE(schedule.isDeferrable(kOldAge, true, false, 0.f));
+    EXPECT_FALSE(schedule.isDeferrable(kOldAge, false, false, 0.11f));
+
+    // Sleeping surfel gets no ray to lower its variance, so it is deferred however noisy.
+    EXPECT_TRUE(schedule.isDeferrable(kOldAge, false, true, 10.f));
+}
+
+TEST(SurfelUpdateScheduleTest, IntervalOneUpdatesEverySurfel)
+{
+    for (uint interval : {0u, 1u})
+    {
+        SurfelUpdateSchedule schedule = createSchedule(interval);
+        for (uint surfelIndex = 0; surfelIndex < 100; ++surfelIndex)
+            EXPECT_TRUE(shouldUpdateDeferred(schedule, surfelIndex, surfelIndex * 7));
+    }
+}
+
+TEST(SurfelUpdateScheduleTest, DeferredUpdatedOncePerInterval)
+{
+    // Any window of interval consecutive frames updates deferred surfel exactly once, from any start frame.
+    for (uint interval : {2u, 3u, 8u, 16u})
+    {
+        SurfelUpdateSchedule schedule = createSchedule(interval);
+        for (uint surfelIndex = 0; surfelIndex < 64; ++surfelIndex)
+        {
+            for (uint start = 1000; start < 1000 + 2 * interval; ++start)
+            {
+                uint count = 0;
+                for (uint frameIndex = start; frameIndex < start + interval; ++frameIndex)
+                    count += shouldUpdateDeferred(schedule, surfelIndex, frameIndex) ? 1 : 0;
+                EXPECT_EQ(count, 1u) << "interval " << interval << " surfel " << surfelIndex << " start " << start;
+            }
+        }
+    }
+}
+
+TEST(SurfelUpdateScheduleTest, NoStarvationWhenStateChanges)
+{
+    // Surfels go in and out of view and converge or diverge at random. Gap between updates never exceeds interval.
+    const uint interval = 8;
+    const uint surfelCount = 512;
+    SurfelUpdateSchedule schedule = createSchedule(interval);
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+
+    std::vector<uint> lastUpdateFrame(surfelCount, 0);
+    for (uint frameIndex = 1; frameIndex < 2000; ++frameIndex)
+    {
+        for (uint surfelIndex = 0; surfelIndex < surfelCount; ++surfelIndex)
+        {
+            const bool isVisible = u(rng) < 0.1f;
+            const bool isSleeping = u(rng) < 0.2f;
+            const float scaledVariance = u(rng) < 0.1f ? 1.f : 0.f;
+            if (schedule.shouldUpdate(surfelIndex, frameIndex, kOldAge, isVisible, isSleeping, scaledVariance))
+                lastUpdateFrame[surfelIndex] = frameIndex;
+
+            ASSERT_LT(frameIndex - lastUpdateFrame[surfelIndex], interval) << "surfel " << surfelIndex;
+        }
+    }
+}
+
+TEST(SurfelUpdateScheduleTest, LoadIsEvenAcrossFrames)
+{
+    const uint interval = 8;
+    SurfelUpdateSchedule schedule = createSchedule(interval);
+
+    // Contiguous slots split exactly.
+    const uint surfelCount = 1003;
+    for (uint frameIndex = 0; frameIndex < interval; ++frameIndex)
+    {
+        uint count = 0;
+        for (uint surfelIndex = 0; surfelIndex < surfelCount; ++surfelIndex)
+            count += shouldUpdateDeferred(schedule, surfelIndex, frameIndex) ? 1 : 0;
+        EXPECT_GE(count, surfelCount / interval);
+        EXPECT_LE(count, (surfelCount + interval - 1) / interval);
+    }
+
+    // Valid surfels hold random slots after recycling. Share of each frame stays near 1 / interval.
+    std::mt19937 rng(1);
+    std::vector<uint> slots(150000);
+    for (uint i = 0; i < slots.size(); ++i)
+        slots[i] = i;
+    std::shuffle(slots.begin(), slots.end(), rng);
+    slots.resize(40000);
+
+    const float expected = (float)slots.size() / interval;
+    for (uint frameIndex = 0; frameIndex < interval; ++frameIndex)
+    {
+        uint count = 0;
+        for (uint surfelIndex : slots)
+            count += shouldUpdateDeferred(schedule, surfelIndex, frameIndex) ? 1 : 0;
+        EXPECT_NEAR((float)count, expected, expected * 0.05f);
+    }
+}
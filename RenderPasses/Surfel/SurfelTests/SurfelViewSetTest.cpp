@@ -0,0 +1,82 @@
+#include "SurfelGI/SurfelViewSet.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+// Number of frames within one period at which view spawns surfels.
+uint getScheduledFrameCount(const SurfelViewSet& viewSet, uint viewIndex, uint firstFrame, uint frameCount)
+{
+    uint count = 0;
+    for (uint frameIndex = firstFrame; frameIndex < firstFrame + frameCount; ++frameIndex)
+        count += viewSet.isScheduled(viewIndex, frameIndex) ? 1 : 0;
+    return count;
+}
+
+} // namespace
+
+TEST(SurfelViewSet, PrimaryViewIsAlwaysScheduled)
+{
+    SurfelViewSet viewSet;
+    viewSet.setEnabled(0, false);
+    viewSet.setUpdatePeriod(0, 4);
+
+    EXPECT_TRUE(viewSet.getView(0).enabled);
+    EXPECT_EQ(viewSet.getEnabledViewCount(), 1u);
+    for (uint frameIndex = 0; frameIndex < 16; ++frameIndex)
+        EXPECT_EQ(viewSet.getScheduledViews(frameIndex), std::vector<uint>{0});
+}
+
+TEST(SurfelViewSet, DisabledViewIsNeverScheduled)
+{
+    SurfelViewSet viewSet;
+    viewSet.setEnabled(1, true);
+    viewSet.setEnabled(1, false);
+
+    EXPECT_EQ(getScheduledFrameCount(viewSet, 1, 0, 16), 0u);
+}
+
+TEST(SurfelViewSet, AuxiliaryViewSpawnsOncePerPeriod)
+{
+    SurfelViewSet viewSet;
+    viewSet.setEnabled(1, true);
+
+    for (uint period : {1u, 2u, 3u, 7u, 16u})
+    {
+        viewSet.setUpdatePeriod(1, period);
+        for (uint firstFrame : {0u, 5u, 1000u})
+            EXPECT_EQ(getScheduledFrameCount(viewSet, 1, firstFrame, period), 1u) << "period = " << period;
+    }
+
+    // Period is at least one frame.
+    viewSet.setUpdatePeriod(1, 0);
+    EXPECT_EQ(viewSet.getView(1).updatePeriod, 1u);
+}
+
+// Views of same period spawn at different frames, so that at most one of them spawns per frame.
+TEST(SurfelViewSet, ViewsOfSamePeriodAreSpread)
+{
+    const uint auxViewCount = kMaxViewCount - 1;
+    const uint period = auxViewCount;
+
+    SurfelViewSet viewSet;
+    for (uint i = 1; i <= auxViewCount; ++i)
+    {
+        viewSet.setEnabled(i, true);
+        viewSet.setUpdatePeriod(i, period);
+    }
+
+    for (uint frameIndex = 0; frameIndex < period * 4; ++frameIndex)
+    {
+        const std::vector<uint> views = viewSet.getScheduledViews(frameIndex);
+        ASSERT_EQ(views.size(), 2u) << "frame " << frameIndex;
+        EXPECT_EQ(views[0], 0u);
+    }
+
+    // Removing one view keeps the others spread.
+    viewSet.setEnabled(1, false);
+    for (uint frameIndex = 0; frameIndex < period; ++frameIndex)
+        EXPECT_LE(viewSet.getScheduledViews(frameIndex).size(), 2u);
+    for (uint i = 2; i <= auxViewCount; ++i)
+        EXPECT_EQ(getScheduledFrameCount(viewSet, i, 0, period), 1u);
+}
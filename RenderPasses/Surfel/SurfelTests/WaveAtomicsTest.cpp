@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+// CPU emulation of WaveAtomics.slang. Lanes of wave run in lock step, and inactive lanes (divergent branch)
+// take no part in wave intrinsics. Waves run on threads, so that they race on the counter as on GPU.
+namespace
+{
+
+struct Wave
+{
+    std::vector<uint32_t> values;
+    std::vector<bool> active;
+
+    uint32_t getFirstLane() const { return (uint32_t)(std::find(active.begin(), active.end(), true) - active.begin()); }
+
+    // WavePrefixSum over active lanes.
+    std::vector<uint32_t> prefixSum() const
+    {
+        std::vector<uint32_t> prefix(values.size(), 0);
+        uint32_t sum = 0;
+        for (size_t lane = 0; lane < values.size(); ++lane)
+        {
+            if (!active[lane])
+                continue;
+            prefix[lane] = sum;
+            sum += values[lane];
+        }
+        return prefix;
+    }
+
+    // WaveActiveSum.
+    uint32_t activeSum() const
+    {
+        uint32_t sum = 0;
+        for (size_t lane = 0; lane < values.size(); ++lane)
+            sum += active[lane] ? values[lane] : 0;
+        return sum;
+    }
+};
+
+// Same steps as waveInterlockedAdd. Result of inactive lane is undefined, and left 0.
+std::vector<uint32_t> waveInterlockedAdd(std::atomic<uint32_t>& counter, const Wave& wave)
+{
+    std::vector<uint32_t> results(wave.values.size(), 0);
+    if (wave.getFirstLane() == wave.values.size())
+        return results;
+
+    const std::vector<uint32_t> wavePrefix = wave.prefixSum();
+    const uint32_t waveTotal = wave.activeSum();
+
+    // Only first active lane issues atomic, others read its result.
+    const uint32_t waveOffset = counter.fetch_add(waveTotal);
+
+    for (size_t lane = 0; lane < wave.values.size(); ++lane)
+        results[lane] = wave.active[lane] ? waveOffset + wavePrefix[lane] : 0;
+    return results;
+}
+
+// Same steps as waveInterlockedSub.
+std::vector<int32_t> waveInterlockedSub(std::atomic<int32_t>& counter, const Wave& wave)
+{
+    std::vector<int32_t> results(wave.values.size(), 0);
+    if (wave.getFirstLane() == wave.values.size())
+        return results;
+
+    const std::vector<uint32_t> wavePrefix = wave.prefixSum();
+    const int32_t waveTotal = (int32_t)wave.activeSum();
+
+    const int32_t waveOffset = counter.fetch_sub(waveTotal);
+
+    for (size_t lane = 0; lane < wave.values.size(); ++lane)
+        results[lane] = wave.active[lane] ? waveOffset - (int32_t)wavePrefix[lane] : 0;
+    return results;
+}
+
+std::vector<Wave> createWaves(uint32_t waveCount, uint32_t waveSize, uint32_t maxValue, float activeRatio, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> valueDist(0, maxValue);
+    std::bernoulli_distribution activeDist(activeRatio);
+
+    std::vector<Wave> waves(waveCount);
+    for (Wave& wave : waves)
+    {
+        wave.values.resize(waveSize);
+        wave.active.resize(waveSize);
+        for (uint32_t lane = 0; lane < waveSize; ++lane)
+        {
+            wave.values[lane] = valueDist(rng);
+            wave.active[lane] = activeDist(rng);
+        }
+    }
+    return waves;
+}
+
+// Run waves on threads, each thread taking every threadCount-th wave.
+template<typename Func>
+void runWaves(size_t waveCount, const Func& func)
+{
+    const uint32_t threadCount = 8;
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (size_t i = t; i < waveCount; i += threadCount)
+                    func(i);
+            }
+        );
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+struct Range
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+} // namespace
+
+class WaveAtomicsTest : public ::testing::TestWithParam<uint32_t>
+{};
+
+TEST_P(WaveAtomicsTest, AddGivesDisjointRanges)
+{
+    const uint32_t waveSize = GetParam();
+    const std::vector<Wave> waves = createWaves(2000, waveSize, 64, 0.7f, waveSize);
+
+    std::atomic<uint32_t> counter = 0;
+    std::vector<std::vector<uint32_t>> results(waves.size());
+    runWaves(waves.size(), [&](size_t i) { results[i] = waveInterlockedAdd(counter, waves[i]); });
+
+    // Total is same as one atomic per lane.
+    uint32_t total = 0;
+    std::vector<Range> ranges;
+    for (size_t i = 0; i < waves.size(); ++i)
+    {
+        const Wave& wave = waves[i];
+        uint32_t laneEnd = UINT32_MAX;
+        for (uint32_t lane = 0; lane < waveSize; ++lane)
+        {
+            if (!wave.active[lane])
+                continue;
+
+            total += wave.values[lane];
+
+            // Contiguous in lane order within wave.
+            if (laneEnd != UINT32_MAX)
+                EXPECT_EQ(results[i][lane], laneEnd);
+            laneEnd = results[i][lane] + wave.values[lane];
+
+            if (wave.values[lane] > 0)
+                ranges.push_back({results[i][lane], laneEnd});
+        }
+    }
+    EXPECT_EQ(counter.load(), total);
+
+    // Ranges are disjoint and cover [0, total) without gap.
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+    uint32_t expectedBegin = 0;
+    for (const Range& range : ranges)
+    {
+        ASSERT_EQ(range.begin, expectedBegin);
+        expectedBegin = range.end;
+    }
+    EXPECT_EQ(expectedBegin, total);
+}
+
+TEST_P(WaveAtomicsTest, SubGivesDisjointRanges)
+{
+    // Free surfel count is popped by generation, lane gets slots (result - value, result].
+    const uint32_t waveSize = GetParam();
+    const std::vector<Wave> waves = createWaves(2000, waveSize, 1, 0.3f, waveSize + 1);
+
+    const int32_t initialCount = 10000;
+    std::atomic<int32_t> counter = initialCount;
+    std::vector<std::vector<int32_t>> results(waves.size());
+    runWaves(waves.size(), [&](size_t i) { results[i] = waveInterlockedSub(counter, waves[i]); });
+
+    int32_t total = 0;
+    std::vector<int32_t> slots;
+    for (size_t i = 0; i < waves.size(); ++i)
+    {
+        for (uint32_t lane = 0; lane < waveSize; ++lane)
+        {
+            if (!waves[i].active[lane])
+                continue;
+
+            total += (int32_t)waves[i].values[lane];
+            for (uint32_t j = 0; j < waves[i].values[lane]; ++j)
+                slots.push_back(results[i][lane] - 1 - (int32_t)j);
+        }
+    }
+    EXPECT_EQ(counter.load(), initialCount - total);
+
+    // Slots popped from top of list are distinct, and exactly the popped ones.
+    std::sort(slots.begin(), slots.end());
+    ASSERT_EQ((int32_t)slots.size(), total);
+    for (size_t i = 0; i < slots.size(); ++i)
+        ASSERT_EQ(slots[i], initialCount - total + (int32_t)i);
+}
+
+TEST_P(WaveAtomicsTest, InactiveWaveIssuesNoAtomic)
+{
+    const uint32_t waveSize = GetParam();
+    Wave wave;
+    wave.values.assign(waveSize, 5);
+    wave.active.assign(waveSize, false);
+
+    std::atomic<uint32_t> counter = 7;
+    waveInterlockedAdd(counter, wave);
+    EXPECT_EQ(counter.load(), 7u);
+}
+
+TEST_P(WaveAtomicsTest, SingleLaneMatchesInterlockedAdd)
+{
+    // Lane alone in divergent branch gets same value as its own InterlockedAdd.
+    const uint32_t waveSize = GetParam();
+    Wave wave;
+    wave.values.assign(waveSize, 3);
+    wave.active.assign(waveSize, false);
+    wave.active[waveSize - 1] = true;
+
+    std::atomic<uint32_t> counter = 11;
+    const auto results = waveInterlockedAdd(counter, wave);
+    EXPECT_EQ(results[waveSize - 1], 11u);
+    EXPECT_EQ(counter.load(), 14u);
+}
+
+INSTANTIATE_TEST_SUITE_P(WaveSizes, WaveAtomicsTest, ::testing::Values(4u, 32u, 64u));
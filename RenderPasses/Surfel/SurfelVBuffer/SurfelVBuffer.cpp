@@ -1,4 +1,11 @@
 #include "SurfelVBuffer.h"
+#include "../SurfelGI/ResolutionScale.h"
+
+namespace
+{
+// Camera used for rendering. If not given, active camera of scene is used.
+const std::string kCameraIndex = "cameraIndex";
+} // namespace
 
 SurfelVBuffer::SurfelVBuffer(ref<Device> pDevice, const Properties& props) : RenderPass(pDevice)
 {
@@ -11,6 +18,20 @@ SurfelVBuffer::SurfelVBuffer(ref<Device> pDevice, const Properties& props) : Ren
         FALCOR_THROW("requires rasterizer ordered views (ROVs) support.");
 
     mpSampleGenerator = SampleGenerator::create(mpDevice, SAMPLE_GENERATOR_UNIFORM);
+
+    if (auto cameraIndex = props.getOpt<uint>(kCameraIndex))
+    {
+        mCameraIndex = *cameraIndex;
+        mUseActiveCamera = false;
+    }
+}
+
+Properties SurfelVBuffer::getProperties() const
+{
+    Properties props;
+    if (!mUseActiveCamera)
+        props[kCameraIndex] = mCameraIndex;
+    return props;
 }
 
 RenderPassReflection SurfelVBuffer::reflect(const CompileData& compileData)
@@ -36,14 +57,42 @@ void SurfelVBuffer::execute(RenderContext* pRenderContext, const RenderData& ren
     if (!mpScene)
         return;
 
+    // Camera other than active one is not updated by scene, so keep its aspect ratio here.
+    const auto& pCamera = getCamera();
+    if (pCamera != mpScene->getCamera())
+        pCamera->setAspectRatio((float)mFrameDim.x / (float)mFrameDim.y);
+
+    // Camera keeps aspect ratio of full frame, so that sub-rectangle sees same view with fewer pixels.
+    const uint2 renderResolution = getRenderResolution(mFrameDim, getResolutionScale(renderData));
+
     auto var = mRtPass.pVars->getRootVar();
 
-    var["CB"]["gResolution"] = mFrameDim;
+    var["CB"]["gResolution"] = renderResolution;
+    pCamera->bindShaderData(var["CB"]["gCamera"]);
 
     var["gPackedHitInfo"] = renderData.getTexture("packedHitInfo");
     var["gDepth"] = renderData.getTexture("depth");
 
-    mpScene->raytrace(pRenderContext, mRtPass.pProgram.get(), mRtPass.pVars, uint3(mFrameDim, 1));
+    mpScene->raytrace(pRenderContext, mRtPass.pProgram.get(), mRtPass.pVars, uint3(renderResolution, 1));
+}
+
+void SurfelVBuffer::renderUI(Gui::Widgets& widget)
+{
+    if (!mpScene || mpScene->getCameras().size() <= 1)
+        return;
+
+    widget.checkbox("Use active camera", mUseActiveCamera);
+    if (!mUseActiveCamera)
+        widget.slider("Camera index", mCameraIndex, 0u, (uint)mpScene->getCameras().size() - 1);
+}
+
+const ref<Camera>& SurfelVBuffer::getCamera() const
+{
+    const auto& cameras = mpScene->getCameras();
+    if (mUseActiveCamera || cameras.empty())
+        return mpScene->getCamera();
+
+    return cameras[std::min<size_t>(mCameraIndex, cameras.size() - 1)];
 }
 
 void SurfelVBuffer::setScene(RenderContext* pRenderContext, const ref<Scene>& pScene)
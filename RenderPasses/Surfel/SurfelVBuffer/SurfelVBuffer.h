@@ -17,20 +17,24 @@ public:
 
     SurfelVBuffer(ref<Device> pDevice, const Properties& props);
 
-    virtual Properties getProperties() const override { return {}; }
+    virtual Properties getProperties() const override;
     virtual RenderPassReflection reflect(const CompileData& compileData) override;
     virtual void compile(RenderContext* pRenderContext, const CompileData& compileData) override {}
     virtual void execute(RenderContext* pRenderContext, const RenderData& renderData) override;
-    virtual void renderUI(Gui::Widgets& widget) override {}
+    virtual void renderUI(Gui::Widgets& widget) override;
     virtual void setScene(RenderContext* pRenderContext, const ref<Scene>& pScene) override;
     virtual bool onMouseEvent(const MouseEvent& mouseEvent) override { return false; }
     virtual bool onKeyEvent(const KeyboardEvent& keyEvent) override { return false; }
 
 private:
+    const ref<Camera>& getCamera() const;
+
     ref<Scene> mpScene;
     ref<SampleGenerator> mpSampleGenerator;
 
     uint2 mFrameDim;
+    uint mCameraIndex = 0;
+    bool mUseActiveCamera = true;
 
     struct
     {
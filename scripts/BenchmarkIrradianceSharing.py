@@ -0,0 +1,85 @@
+from pathlib import WindowsPath, PosixPath, Path
+from falcor import *
+import json
+import os
+
+# GPU time of irradiance sharing as cells get denser.
+# Run with scene loaded, e.g. `Mogwai --script BenchmarkIrradianceSharing.py --scene Sponza.pyscene`.
+#   SURFELGI_CELL_UNITS  : Comma separated cell units. Larger cell holds more surfels. (default: 0.05,0.1,0.2,0.4)
+#   SURFELGI_TARGET_AREA : Surfel target area. Smaller area spawns more surfels per cell. (default: 10000)
+#   SURFELGI_WARMUP      : Frames rendered before measure, so that surfel count is settled. (default: 256)
+#   SURFELGI_FRAMES      : Frames measured for each cell unit. (default: 64)
+#   SURFELGI_OUTPUT      : Output directory. (default: benchmark)
+# Results are written to <output>/sharing.json and <output>/sharing.csv.
+
+kPassName = 'SurfelGI'
+kEvents = {
+    'buildNeighborsMs': 'Update Pass (Build Surfel Neighbors Pass)',
+    'integrateMs': 'Surfel Integrate Pass',
+}
+
+def render_graph_BenchmarkIrradianceSharing(props):
+    g = RenderGraph('BenchmarkIrradianceSharing')
+    g.create_pass('SurfelGI', 'SurfelGI', props)
+    g.create_pass('SurfelVBuffer', 'SurfelVBuffer', {})
+    g.add_edge('SurfelVBuffer.packedHitInfo', 'SurfelGI.packedHitInfo')
+    g.mark_output(f'{kPassName}.output')
+    return g
+
+def event_time(capture, event_name):
+    # Mean GPU time of event, wherever it is nested in SurfelGI.
+    total = 0.0
+    for name, event in capture['events'].items():
+        if f'/{kPassName}/' in name and name.endswith(f'/{event_name}/gpu_time'):
+            total += event['stats']['mean']
+    return total
+
+def measure(cell_unit, target_area, warmup_frames, measure_frames):
+    # Updating static params resets surfels, so that every run starts from empty cache.
+    props = {'cellUnit': cell_unit, 'surfelTargetArea': target_area, 'useIrradianceSharing': True, 'deterministic': True}
+    m.activeGraph.update_pass(kPassName, props)
+    m.clock.time = 0
+
+    for _ in range(warmup_frames):
+        m.renderFrame()
+
+    m.profiler.enabled = True
+    m.profiler.start_capture()
+    for _ in range(measure_frames):
+        m.renderFrame()
+    capture = m.profiler.end_capture()
+    m.profiler.enabled = False
+
+    return {key: event_time(capture, name) for key, name in kEvents.items()}
+
+def main():
+    cell_units = [float(c) for c in os.environ.get('SURFELGI_CELL_UNITS', '0.05,0.1,0.2,0.4').split(',')]
+    target_area = float(os.environ.get('SURFELGI_TARGET_AREA', 10000))
+    warmup_frames = int(os.environ.get('SURFELGI_WARMUP', 256))
+    measure_frames = int(os.environ.get('SURFELGI_FRAMES', 64))
+
+    output_dir = Path(os.environ.get('SURFELGI_OUTPUT', 'benchmark'))
+    output_dir.mkdir(parents=True, exist_ok=True)
+
+    m.addGraph(render_graph_BenchmarkIrradianceSharing({}))
+    m.clock.pause()
+
+    results = []
+    for cell_unit in cell_units:
+        result = {'cellUnit': cell_unit, 'surfelTargetArea': target_area}
+        result.update(measure(cell_unit, target_area, warmup_frames, measure_frames))
+        result['totalMs'] = result['buildNeighborsMs'] + result['integrateMs']
+        results.append(result)
+
+        print(f'cell unit {cell_unit}: build {result["buildNeighborsMs"]:.3f} ms, integrate {result["integrateMs"]:.3f} ms')
+
+    (output_dir / 'sharing.json').write_text(json.dumps(results, indent=2))
+
+    with open(output_dir / 'sharing.csv', 'w') as f:
+        keys = ['cellUnit', 'surfelTargetArea', 'buildNeighborsMs', 'integrateMs', 'totalMs']
+        f.write(','.join(keys) + '\n')
+        for r in results:
+            f.write(','.join(str(r[k]) for k in keys) + '\n')
+
+main()
+exit()
@@ -0,0 +1,113 @@
+from pathlib import WindowsPath, PosixPath, Path
+from falcor import *
+import json
+import os
+import random
+
+# GPU time of SurfelGIRenderPass direct lighting by light count, for each direct lighting mode.
+# Point lights are added to base scene at random positions in box, so that light count is only variable.
+# Run without scene, e.g. `Mogwai --script BenchmarkLightCount.py`.
+#   SURFELGI_SCENE        : Base scene. (required)
+#   SURFELGI_LIGHT_COUNTS : Comma separated light counts. (default: 16,64,256,1024)
+#   SURFELGI_LIGHT_BOUNDS : Box of light positions, 'minX,minY,minZ,maxX,maxY,maxZ'. (default: -10,0,-10,10,10,10)
+#   SURFELGI_LIGHT_POWER  : Intensity of each light. (default: 1)
+#   SURFELGI_MODES        : Comma separated direct lighting modes. (default: all)
+#   SURFELGI_WARMUP       : Frames rendered before measure. (default: 64)
+#   SURFELGI_FRAMES       : Frames measured for each configuration. (default: 64)
+#   SURFELGI_OUTPUT       : Output directory. (default: benchmark)
+# Results are written to <output>/lightcount.json and <output>/lightcount.csv.
+
+kPassName = 'SurfelGIRenderPass'
+kModes = ['Exhaustive', 'Tiled', 'Stochastic']
+kEvents = {
+    'cullingMs': 'Light Culling Pass',
+    'gatherMs': 'Final Gather',
+}
+
+def render_graph_BenchmarkLightCount(props):
+    g = RenderGraph('BenchmarkLightCount')
+    g.create_pass('SurfelGI', 'SurfelGI', {})
+    g.create_pass('SurfelGBuffer', 'SurfelGBuffer', {})
+    g.create_pass(kPassName, 'SurfelGIRenderPass', props)
+    g.add_edge('SurfelGBuffer.packedHitInfo', 'SurfelGI.packedHitInfo')
+    g.add_edge('SurfelGBuffer.packedHitInfo', f'{kPassName}.packedHitInfo')
+    g.add_edge('SurfelGI.output', f'{kPassName}.indirectLighting')
+    g.mark_output(f'{kPassName}.output')
+    return g
+
+def write_scene(path, base_scene, light_count, bounds, power):
+    # Same seed for every count, so that smaller light set is prefix of larger one.
+    rng = random.Random(0)
+    lines = [f'sceneBuilder.importScene(r"{base_scene}")']
+    for i in range(light_count):
+        p = [rng.uniform(bounds[a], bounds[a + 3]) for a in range(3)]
+        lines.append(f'light = PointLight("BenchmarkLight{i}")')
+        lines.append(f'light.position = float3({p[0]}, {p[1]}, {p[2]})')
+        lines.append(f'light.intensity = float3({power}, {power}, {power})')
+        lines.append('sceneBuilder.addLight(light)')
+    path.write_text('\n'.join(lines) + '\n')
+
+def event_time(capture, event_name):
+    # Mean GPU time of event in render pass. Zero if event did not run.
+    total = 0.0
+    for name, event in capture['events'].items():
+        if f'/{kPassName}/' in name and name.endswith(f'/{event_name}/gpu_time'):
+            total += event['stats']['mean']
+    return total
+
+def measure(mode, warmup_frames, measure_frames):
+    m.activeGraph.update_pass(kPassName, {'directLightingMode': mode})
+    m.clock.time = 0
+
+    for _ in range(warmup_frames):
+        m.renderFrame()
+
+    m.profiler.enabled = True
+    m.profiler.start_capture()
+    for _ in range(measure_frames):
+        m.renderFrame()
+    capture = m.profiler.end_capture()
+    m.profiler.enabled = False
+
+    return {key: event_time(capture, name) for key, name in kEvents.items()}
+
+def main():
+    base_scene = os.environ['SURFELGI_SCENE']
+    light_counts = [int(c) for c in os.environ.get('SURFELGI_LIGHT_COUNTS', '16,64,256,1024').split(',')]
+    bounds = [float(b) for b in os.environ.get('SURFELGI_LIGHT_BOUNDS', '-10,0,-10,10,10,10').split(',')]
+    power = float(os.environ.get('SURFELGI_LIGHT_POWER', 1))
+    modes = os.environ.get('SURFELGI_MODES', ','.join(kModes)).split(',')
+    warmup_frames = int(os.environ.get('SURFELGI_WARMUP', 64))
+    measure_frames = int(os.environ.get('SURFELGI_FRAMES', 64))
+
+    output_dir = Path(os.environ.get('SURFELGI_OUTPUT', 'benchmark'))
+    output_dir.mkdir(parents=True, exist_ok=True)
+
+    m.addGraph(render_graph_BenchmarkLightCount({}))
+    m.clock.pause()
+
+    results = []
+    for light_count in light_counts:
+        # Graph is kept, loading scene sets it to every pass.
+        scene_path = output_dir / f'lightcount_{light_count}.pyscene'
+        write_scene(scene_path, Path(base_scene).resolve(), light_count, bounds, power)
+        m.loadScene(str(scene_path))
+
+        for mode in modes:
+            result = {'lightCount': light_count, 'mode': mode}
+            result.update(measure(mode, warmup_frames, measure_frames))
+            result['totalMs'] = result['cullingMs'] + result['gatherMs']
+            results.append(result)
+
+            print(f'{light_count} lights, {mode}: culling {result["cullingMs"]:.3f} ms, gather {result["gatherMs"]:.3f} ms')
+
+    (output_dir / 'lightcount.json').write_text(json.dumps(results, indent=2))
+
+    with open(output_dir / 'lightcount.csv', 'w') as f:
+        keys = ['lightCount', 'mode', 'cullingMs', 'gatherMs', 'totalMs']
+        f.write(','.join(keys) + '\n')
+        for r in results:
+            f.write(','.join(str(r[k]) for k in keys) + '\n')
+
+main()
+exit()
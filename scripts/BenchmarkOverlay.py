@@ -0,0 +1,84 @@
+from pathlib import WindowsPath, PosixPath, Path
+from falcor import *
+import json
+import os
+
+# GPU time of per-pixel passes with each overlay mode.
+# IndirectLighting is the production path, other modes add overlay pass on top of it.
+# Run with scene loaded, e.g. `Mogwai --script BenchmarkOverlay.py --scene Sponza.pyscene`.
+#   SURFELGI_OVERLAY_MODES : Comma separated overlay modes. (default: all)
+#   SURFELGI_WARMUP        : Frames rendered before measure, so that surfel count is settled. (default: 256)
+#   SURFELGI_FRAMES        : Frames measured for each mode. (default: 64)
+#   SURFELGI_OUTPUT        : Output directory. (default: benchmark)
+# Results are written to <output>/overlay.json and <output>/overlay.csv.
+
+kPassName = 'SurfelGI'
+kOverlayModes = ['IndirectLighting', 'Variance', 'RayCount', 'RefCount', 'Life', 'Coverage']
+kEvents = {
+    'generationMs': 'Surfel Generation Pass',
+    'overlayMs': 'Surfel Overlay Pass',
+}
+
+def render_graph_BenchmarkOverlay(props):
+    g = RenderGraph('BenchmarkOverlay')
+    g.create_pass('SurfelGI', 'SurfelGI', props)
+    g.create_pass('SurfelVBuffer', 'SurfelVBuffer', {})
+    g.add_edge('SurfelVBuffer.packedHitInfo', 'SurfelGI.packedHitInfo')
+    g.mark_output(f'{kPassName}.output')
+    return g
+
+def event_time(capture, event_name):
+    # Mean GPU time of event, wherever it is nested in SurfelGI. Zero if event did not run.
+    total = 0.0
+    for name, event in capture['events'].items():
+        if f'/{kPassName}/' in name and name.endswith(f'/{event_name}/gpu_time'):
+            total += event['stats']['mean']
+    return total
+
+def measure(overlay_mode, warmup_frames, measure_frames):
+    # Updating params resets surfels, so that every run starts from empty cache.
+    m.activeGraph.update_pass(kPassName, {'overlayMode': overlay_mode, 'deterministic': True})
+    m.clock.time = 0
+
+    for _ in range(warmup_frames):
+        m.renderFrame()
+
+    m.profiler.enabled = True
+    m.profiler.start_capture()
+    for _ in range(measure_frames):
+        m.renderFrame()
+    capture = m.profiler.end_capture()
+    m.profiler.enabled = False
+
+    return {key: event_time(capture, name) for key, name in kEvents.items()}
+
+def main():
+    overlay_modes = os.environ.get('SURFELGI_OVERLAY_MODES', ','.join(kOverlayModes)).split(',')
+    warmup_frames = int(os.environ.get('SURFELGI_WARMUP', 256))
+    measure_frames = int(os.environ.get('SURFELGI_FRAMES', 64))
+
+    output_dir = Path(os.environ.get('SURFELGI_OUTPUT', 'benchmark'))
+    output_dir.mkdir(parents=True, exist_ok=True)
+
+    m.addGraph(render_graph_BenchmarkOverlay({}))
+    m.clock.pause()
+
+    results = []
+    for overlay_mode in overlay_modes:
+        result = {'overlayMode': overlay_mode}
+        result.update(measure(overlay_mode, warmup_frames, measure_frames))
+        result['totalMs'] = result['generationMs'] + result['overlayMs']
+        results.append(result)
+
+        print(f'{overlay_mode}: generation {result["generationMs"]:.3f} ms, overlay {result["overlayMs"]:.3f} ms')
+
+    (output_dir / 'overlay.json').write_text(json.dumps(results, indent=2))
+
+    with open(output_dir / 'overlay.csv', 'w') as f:
+        keys = ['overlayMode', 'generationMs', 'overlayMs', 'totalMs']
+        f.write(','.join(keys) + '\n')
+        for r in results:
+            f.write(','.join(str(r[k]) for k in keys) + '\n')
+
+main()
+exit()
@@ -0,0 +1,83 @@
+from pathlib import WindowsPath, PosixPath, Path
+from falcor import *
+import json
+import os
+import time
+
+# Throughput of SurfelGICPU by worker thread count.
+# Run with scene loaded, e.g. `Mogwai --script BenchmarkSurfelGICPU.py --scene Sponza.pyscene`.
+#   SURFELGICPU_THREADS : Comma separated thread counts. (default: 1, 2, 4, ... up to core count)
+#   SURFELGICPU_WARMUP  : Frames rendered before measure, so that surfel count is settled. (default: 64)
+#   SURFELGICPU_FRAMES  : Frames measured for each thread count. (default: 16)
+#   SURFELGICPU_OUTPUT  : Output directory. (default: benchmark)
+# Results are written to <output>/results.json and <output>/results.csv.
+# Surfels are reset with each thread count, so that every run measures same frames.
+
+kPassName = 'SurfelGICPU'
+
+def render_graph_BenchmarkSurfelGICPU(props):
+    g = RenderGraph('BenchmarkSurfelGICPU')
+    g.create_pass(kPassName, 'SurfelGICPU', props)
+    g.mark_output(f'{kPassName}.output')
+    return g
+
+def default_thread_counts():
+    core_count = os.cpu_count() or 1
+    counts = []
+    count = 1
+    while count < core_count:
+        counts.append(count)
+        count *= 2
+    counts.append(core_count)
+    return counts
+
+def measure(thread_count, warmup_frames, measure_frames):
+    # Updating properties recreates engine, which also clears surfels.
+    m.activeGraph.update_pass(kPassName, {'threadCount': thread_count, 'deterministic': True})
+    m.clock.time = 0
+
+    for _ in range(warmup_frames):
+        m.renderFrame()
+
+    start = time.perf_counter()
+    for _ in range(measure_frames):
+        m.renderFrame()
+    elapsed = time.perf_counter() - start
+
+    return elapsed * 1000.0 / measure_frames
+
+def main():
+    threads = os.environ.get('SURFELGICPU_THREADS')
+    thread_counts = [int(t) for t in threads.split(',')] if threads else default_thread_counts()
+    warmup_frames = int(os.environ.get('SURFELGICPU_WARMUP', 64))
+    measure_frames = int(os.environ.get('SURFELGICPU_FRAMES', 16))
+
+    output_dir = Path(os.environ.get('SURFELGICPU_OUTPUT', 'benchmark'))
+    output_dir.mkdir(parents=True, exist_ok=True)
+
+    m.addGraph(render_graph_BenchmarkSurfelGICPU({}))
+    m.clock.pause()
+
+    results = []
+    for thread_count in thread_counts:
+        frame_time = measure(thread_count, warmup_frames, measure_frames)
+        result = {'threadCount': thread_count, 'frameTimeMs': frame_time, 'framesPerSecond': 1000.0 / frame_time}
+        results.append(result)
+
+    # Speedup and efficiency are relative to first thread count.
+    base = results[0]
+    for r in results:
+        r['speedup'] = base['frameTimeMs'] / r['frameTimeMs']
+        r['efficiency'] = r['speedup'] * base['threadCount'] / r['threadCount']
+        print(f'{r["threadCount"]} threads: {r["frameTimeMs"]:.2f} ms, speedup {r["speedup"]:.2f}, efficiency {r["efficiency"]:.2f}')
+
+    (output_dir / 'results.json').write_text(json.dumps(results, indent=2))
+
+    with open(output_dir / 'results.csv', 'w') as f:
+        keys = ['threadCount', 'frameTimeMs', 'framesPerSecond', 'speedup', 'efficiency']
+        f.write(','.join(keys) + '\n')
+        for r in results:
+            f.write(','.join(str(r[k]) for k in keys) + '\n')
+
+main()
+exit()
@@ -0,0 +1,42 @@
+from pathlib import WindowsPath, PosixPath
+from falcor import *
+import os
+
+# Capture frames of SurfelGI in deterministic mode, for SurfelGIRegression.py.
+# Run with scene loaded, e.g. `Mogwai --script CaptureSurfelGI.py --scene Sponza.pyscene`.
+#   SURFELGI_CAPTURE_DIR    : Output directory. (default: captures)
+#   SURFELGI_CAPTURE_FRAMES : Comma separated frame indices to capture. (default: 64,256)
+#   SURFELGI_CAPTURE_NAME   : Base name of captured files. (default: surfelgi)
+
+def render_graph_SurfelGIRegression():
+    g = RenderGraph('SurfelGIRegression')
+    g.create_pass('SurfelGI', 'SurfelGI', {'deterministic': True})
+    g.create_pass('SurfelVBuffer', 'SurfelVBuffer', {})
+    g.create_pass('SurfelGIRenderPass', 'SurfelGIRenderPass', {})
+    g.add_edge('SurfelVBuffer.packedHitInfo', 'SurfelGI.packedHitInfo')
+    g.add_edge('SurfelVBuffer.packedHitInfo', 'SurfelGIRenderPass.packedHitInfo')
+    g.add_edge('SurfelGI.output', 'SurfelGIRenderPass.indirectLighting')
+    g.mark_output('SurfelGI.output')
+    g.mark_output('SurfelGIRenderPass.output')
+    return g
+
+outputDir = os.environ.get('SURFELGI_CAPTURE_DIR', 'captures')
+frames = [int(f) for f in os.environ.get('SURFELGI_CAPTURE_FRAMES', '64,256').split(',')]
+baseName = os.environ.get('SURFELGI_CAPTURE_NAME', 'surfelgi')
+
+graph = render_graph_SurfelGIRegression()
+m.addGraph(graph)
+
+# Animation and time must not change between runs.
+m.clock.pause()
+m.clock.time = 0
+
+m.frameCapture.outputDir = outputDir
+
+for frame in range(max(frames) + 1):
+    m.renderFrame()
+    if frame in frames:
+        m.frameCapture.baseFilename = f'{baseName}_{frame}'
+        m.frameCapture.capture()
+
+exit()
@@ -0,0 +1,208 @@
+"""
+Compare frames captured from SurfelGI on CPU.
+
+Reads PFM and EXR images, computes error statistics against a reference,
+and checks them against tolerances.
+
+    python CompareFrames.py reference.exr test.exr --rmse 1e-3 --max-abs 0.05
+    python CompareFrames.py test.pfm --stats
+"""
+
+import argparse
+import json
+import math
+import sys
+from pathlib import Path
+
+import numpy as np
+
+
+def read_pfm(path):
+    with open(path, 'rb') as f:
+        header = f.readline().decode('ascii').strip()
+        if header not in ('PF', 'Pf'):
+            raise ValueError(f'{path}: not a PFM file.')
+        channels = 3 if header == 'PF' else 1
+
+        width, height = map(int, f.readline().decode('ascii').split())
+        scale = float(f.readline().decode('ascii').strip())
+        endian = '<' if scale < 0 else '>'
+
+        data = np.fromfile(f, dtype=endian + 'f4', count=width * height * channels)
+
+    # Rows are stored bottom to top.
+    return np.flipud(data.reshape(height, width, channels)).astype(np.float32)
+
+
+def write_pfm(path, image):
+    image = np.asarray(image, dtype=np.float32)
+    if image.ndim == 2:
+        image = image[:, :, None]
+    if image.shape[2] not in (1, 3):
+        image = image[:, :, :3]
+
+    height, width, channels = image.shape
+    with open(path, 'wb') as f:
+        f.write(('PF\n' if channels == 3 else 'Pf\n').encode('ascii'))
+        f.write(f'{width} {height}\n-1.0\n'.encode('ascii'))
+        np.flipud(image).astype('<f4').tofile(f)
+
+
+def read_exr(path):
+    try:
+        import OpenEXR
+        import Imath
+    except ImportError:
+        OpenEXR = None
+
+    if OpenEXR is not None:
+        exr = OpenEXR.InputFile(str(path))
+        window = exr.header()['dataWindow']
+        width = window.max.x - window.min.x + 1
+        height = window.max.y - window.min.y + 1
+        names = [c for c in 'RGBA' if c in exr.header()['channels']]
+        pixel_type = Imath.PixelType(Imath.PixelType.FLOAT)
+        planes = [np.frombuffer(exr.channel(c, pixel_type), dtype=np.float32).reshape(height, width) for c in names]
+        return np.stack(planes, axis=-1)
+
+    try:
+        import imageio.v3 as iio
+    except ImportError:
+        raise RuntimeError('Reading EXR needs either OpenEXR or imageio package.')
+
+    return np.asarray(iio.imread(path), dtype=np.float32)
+
+
+def read_image(path):
+    path = Path(path)
+    suffix = path.suffix.lower()
+    if suffix == '.pfm':
+        image = read_pfm(path)
+    elif suffix == '.exr':
+        image = read_exr(path)
+    else:
+        raise ValueError(f'{path}: only PFM and EXR are supported.')
+
+    if image.ndim == 2:
+        image = image[:, :, None]
+
+    # Alpha of SurfelGI output is coverage, not part of lighting.
+    return image[:, :, :3]
+
+
+def image_stats(image):
+    finite = np.isfinite(image)
+    values = image[finite]
+    luminance = 0.2126 * image[:, :, 0] + 0.7152 * image[:, :, 1] + 0.0722 * image[:, :, 2] if image.shape[2] >= 3 else image[:, :, 0]
+
+    return {
+        'width': int(image.shape[1]),
+        'height': int(image.shape[0]),
+        'mean': float(values.mean()) if values.size else 0.0,
+        'min': float(values.min()) if values.size else 0.0,
+        'max': float(values.max()) if values.size else 0.0,
+        'meanLuminance': float(np.nanmean(np.where(np.isfinite(luminance), luminance, np.nan))) if values.size else 0.0,
+        'nonFinite': int((~finite).sum()),
+    }
+
+
+def compare_images(reference, test, pixel_threshold=1e-2):
+    if reference.shape != test.shape:
+        raise ValueError(f'Image size mismatch: {reference.shape} != {test.shape}.')
+
+    # Non-finite values are always treated as error.
+    finite = np.isfinite(reference) & np.isfinite(test)
+    diff = np.where(finite, np.abs(reference - test), np.inf)
+    finite_diff = diff[finite]
+
+    mse = float(np.mean(finite_diff ** 2)) if finite_diff.size else 0.0
+    peak = float(np.max(np.abs(reference[np.isfinite(reference)]))) if np.isfinite(reference).any() else 1.0
+
+    # Relative error is robust for HDR values.
+    relative = finite_diff / (np.abs(reference[finite]) + 1e-2)
+
+    pixel_error = np.max(diff, axis=-1)
+
+    return {
+        'rmse': math.sqrt(mse),
+        'maxAbs': float(finite_diff.max()) if finite_diff.size else 0.0,
+        'meanAbs': float(finite_diff.mean()) if finite_diff.size else 0.0,
+        'meanRelative': float(relative.mean()) if relative.size else 0.0,
+        'psnr': float('inf') if mse == 0.0 else 10.0 * math.log10(max(peak, 1e-8) ** 2 / mse),
+        'pixelFailRatio': float(np.mean(pixel_error > pixel_threshold)),
+        'nonFinite': int((~finite).sum()),
+    }
+
+
+# Metric name -> (tolerance key, True if larger value is worse).
+TOLERANCES = {
+    'rmse': ('rmse', True),
+    'maxAbs': ('maxAbs', True),
+    'meanRelative': ('meanRelative', True),
+    'pixelFailRatio': ('pixelFailRatio', True),
+    'psnr': ('minPsnr', False),
+    'nonFinite': ('nonFinite', True),
+}
+
+
+def check_tolerances(metrics, tolerances):
+    """Return list of failed metric descriptions. Metrics without tolerance are not checked."""
+    failures = []
+    for metric, (key, larger_is_worse) in TOLERANCES.items():
+        if key not in tolerances:
+            continue
+
+        limit = tolerances[key]
+        value = metrics[metric]
+        failed = value > limit if larger_is_worse else value < limit
+        if failed:
+            failures.append(f'{metric} {value:.6g} (limit {limit:.6g})')
+
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare SurfelGI frames on CPU.')
+    parser.add_argument('images', nargs='+', help='Reference and test image, or single image with --stats.')
+    parser.add_argument('--stats', action='store_true', help='Print statistics of single image.')
+    parser.add_argument('--rmse', type=float)
+    parser.add_argument('--max-abs', type=float)
+    parser.add_argument('--mean-relative', type=float)
+    parser.add_argument('--pixel-fail-ratio', type=float)
+    parser.add_argument('--min-psnr', type=float)
+    parser.add_argument('--pixel-threshold', type=float, default=1e-2, help='Per pixel error counted as failure.')
+    parser.add_argument('--diff', help='Write absolute difference image as PFM.')
+    args = parser.parse_args()
+
+    if args.stats:
+        for path in args.images:
+            print(path, json.dumps(image_stats(read_image(path)), indent=2))
+        return 0
+
+    if len(args.images) != 2:
+        parser.error('Need reference and test image.')
+
+    reference = read_image(args.images[0])
+    test = read_image(args.images[1])
+    metrics = compare_images(reference, test, args.pixel_threshold)
+    print(json.dumps(metrics, indent=2))
+
+    if args.diff:
+        write_pfm(args.diff, np.abs(reference - test))
+
+    tolerances = {
+        'rmse': args.rmse,
+        'maxAbs': args.max_abs,
+        'meanRelative': args.mean_relative,
+        'pixelFailRatio': args.pixel_fail_ratio,
+        'minPsnr': args.min_psnr,
+    }
+    failures = check_tolerances(metrics, {k: v for k, v in tolerances.items() if v is not None})
+    for failure in failures:
+        print('FAIL:', failure)
+
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,55 @@
+from pathlib import WindowsPath, PosixPath, Path
+from falcor import *
+import json
+import os
+
+# Compile common SurfelGI permutations once, so that shader cache of device has their binaries.
+# Run at install time with the scene to be used, e.g. `Mogwai --script PrewarmSurfelGI.py --scene Sponza.pyscene`.
+#   SURFELGI_PERMUTATIONS      : JSON file of static param sets to compile. (default: list below)
+#   SURFELGI_PERMUTATION_CACHE : SurfelGIPermutations.txt recorded by SurfelGI. Its permutations are compiled too.
+
+kDefaultPermutations = [
+    {},
+    {'useLightReservoir': True},
+    {'useRayGuiding': True},
+    {'deterministic': True},
+]
+
+def load_permutations():
+    permutations = list(kDefaultPermutations)
+
+    if 'SURFELGI_PERMUTATIONS' in os.environ:
+        permutations = json.loads(Path(os.environ['SURFELGI_PERMUTATIONS']).read_text())
+
+    # Each line is "<key> <last use> <static params as JSON>".
+    if 'SURFELGI_PERMUTATION_CACHE' in os.environ:
+        for line in Path(os.environ['SURFELGI_PERMUTATION_CACHE']).read_text().splitlines():
+            fields = line.split(' ', 2)
+            if len(fields) == 3:
+                permutations.append(json.loads(fields[2]))
+
+    return permutations
+
+def render_graph_PrewarmSurfelGI():
+    g = RenderGraph('PrewarmSurfelGI')
+    g.create_pass('SurfelGI', 'SurfelGI', {})
+    g.create_pass('SurfelVBuffer', 'SurfelVBuffer', {})
+    g.add_edge('SurfelVBuffer.packedHitInfo', 'SurfelGI.packedHitInfo')
+    g.mark_output('SurfelGI.output')
+    return g
+
+m.addGraph(render_graph_PrewarmSurfelGI())
+
+# Properties not given in a set are reset to default, so that sets do not leak into each other.
+defaults = m.activeGraph.get_pass('SurfelGI').properties
+
+for index, permutation in enumerate(load_permutations()):
+    props = dict(defaults)
+    props.update(permutation)
+
+    # Static params change makes SurfelGI compile the permutation before returning.
+    m.activeGraph.update_pass('SurfelGI', props)
+    m.renderFrame()
+    print(f'[{index}] compiled {permutation}')
+
+exit()
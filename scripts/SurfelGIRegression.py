@@ -0,0 +1,93 @@
+"""
+Image regression check for SurfelGI.
+
+Compares captured frames with reference frames listed in a manifest, on CPU.
+Capture frames with CaptureSurfelGI.py in Mogwai, with deterministic mode enabled.
+
+    python SurfelGIRegression.py manifest.json --test-dir captures
+
+Manifest:
+    {
+        "referenceDir": "references",
+        "defaultTolerances": { "rmse": 1e-4, "pixelFailRatio": 0.0 },
+        "frames": [
+            { "name": "sponza_64", "reference": "sponza_64.exr", "test": "sponza_64.exr" },
+            { "name": "sponza_256", "reference": "sponza_256.exr", "tolerances": { "rmse": 1e-3 } }
+        ]
+    }
+"""
+
+import argparse
+import json
+import sys
+from pathlib import Path
+
+from CompareFrames import check_tolerances, compare_images, read_image, write_pfm
+
+
+def run(manifest_path, test_dir, diff_dir=None):
+    manifest_path = Path(manifest_path)
+    manifest = json.loads(manifest_path.read_text())
+
+    reference_dir = manifest_path.parent / manifest.get('referenceDir', '.')
+    default_tolerances = manifest.get('defaultTolerances', {})
+
+    results = []
+    for frame in manifest['frames']:
+        name = frame['name']
+        reference_path = reference_dir / frame['reference']
+        test_path = Path(test_dir) / frame.get('test', frame['reference'])
+
+        tolerances = dict(default_tolerances)
+        tolerances.update(frame.get('tolerances', {}))
+
+        if not test_path.exists():
+            results.append((name, None, [f'missing {test_path}']))
+            continue
+
+        reference = read_image(reference_path)
+        test = read_image(test_path)
+        if reference.shape != test.shape:
+            results.append((name, None, [f'size mismatch {reference.shape} != {test.shape}']))
+            continue
+
+        metrics = compare_images(reference, test, tolerances.get('pixelThreshold', 1e-2))
+        failures = check_tolerances(metrics, tolerances)
+        results.append((name, metrics, failures))
+
+        if diff_dir and failures:
+            Path(diff_dir).mkdir(parents=True, exist_ok=True)
+            write_pfm(Path(diff_dir) / f'{name}_diff.pfm', abs(reference - test))
+
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Check SurfelGI frames against references.')
+    parser.add_argument('manifest', help='Manifest JSON listing reference frames and tolerances.')
+    parser.add_argument('--test-dir', required=True, help='Directory of captured frames.')
+    parser.add_argument('--diff-dir', help='Write difference images of failed frames here.')
+    parser.add_argument('--report', help='Write results as JSON.')
+    args = parser.parse_args()
+
+    results = run(args.manifest, args.test_dir, args.diff_dir)
+
+    failed = 0
+    for name, metrics, failures in results:
+        status = 'FAIL' if failures else 'PASS'
+        summary = f"rmse {metrics['rmse']:.3e}, maxAbs {metrics['maxAbs']:.3e}, psnr {metrics['psnr']:.2f}" if metrics else ''
+        print(f'[{status}] {name} {summary}')
+        for failure in failures:
+            print(f'    {failure}')
+        failed += 1 if failures else 0
+
+    if args.report:
+        report = [{'name': n, 'metrics': m, 'failures': f} for n, m, f in results]
+        Path(args.report).write_text(json.dumps(report, indent=2))
+
+    print(f'{len(results) - failed} / {len(results)} passed.')
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
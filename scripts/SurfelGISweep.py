@@ -0,0 +1,121 @@
+from pathlib import WindowsPath, PosixPath, Path
+from falcor import *
+import itertools
+import json
+import os
+import sys
+
+# Parameter sweep of SurfelGI. Records GPU time against error to reference for each configuration.
+# Run with scene loaded, e.g. `Mogwai --script SurfelGISweep.py --scene Sponza.pyscene`.
+#   SURFELGI_SWEEP : Sweep description JSON. (default: SurfelGISweep.json next to this script)
+#
+# Sweep description:
+#   {
+#       "outputDir": "sweep",
+#       "warmupFrames": 256,
+#       "measureFrames": 64,
+#       "base": { "deterministic": true },
+#       "reference": { "properties": { "maxRayCount": 256, "minRayCount": 64 }, "warmupFrames": 2048 },
+#       "grid": {
+#           "cellUnit": [0.025, 0.05, 0.1],
+#           "perCellSurfelLimit": [64, 256, 1024],
+#           "maxRayCount": [32, 64],
+#           "surfelTargetArea": [20000, 40000, 80000]
+#       }
+#   }
+# Keys of "base", "reference" and "grid" are SurfelGI properties.
+# Results are written to <outputDir>/results.json and <outputDir>/results.csv.
+
+sys.path.append(str(Path(__file__).parent))
+from CompareFrames import compare_images, read_image
+
+kPassName = 'SurfelGI'
+kOutputName = 'SurfelGI.output'
+
+def render_graph_SurfelGISweep(props):
+    g = RenderGraph('SurfelGISweep')
+    g.create_pass('SurfelGI', 'SurfelGI', props)
+    g.create_pass('SurfelVBuffer', 'SurfelVBuffer', {})
+    g.add_edge('SurfelVBuffer.packedHitInfo', 'SurfelGI.packedHitInfo')
+    g.mark_output(kOutputName)
+    return g
+
+def gpu_time(capture):
+    # Sum of mean GPU time of all SurfelGI events at top level of pass.
+    total = 0.0
+    for name, event in capture['events'].items():
+        if name.endswith(f'/{kPassName}/gpu_time'):
+            total += event['stats']['mean']
+    return total
+
+def render(props, warmup_frames, measure_frames, capture_name):
+    graph = m.activeGraph
+    graph.update_pass(kPassName, props)
+
+    for _ in range(warmup_frames):
+        m.renderFrame()
+
+    m.profiler.enabled = True
+    m.profiler.start_capture()
+    for _ in range(measure_frames):
+        m.renderFrame()
+    capture = m.profiler.end_capture()
+    m.profiler.enabled = False
+
+    m.frameCapture.baseFilename = capture_name
+    m.frameCapture.capture()
+
+    images = sorted(Path(m.frameCapture.outputDir).glob(f'{capture_name}*{kOutputName}*'))
+    if not images:
+        raise RuntimeError(f'Captured image of {capture_name} not found.')
+
+    return gpu_time(capture), images[-1]
+
+def main():
+    sweep_path = Path(os.environ.get('SURFELGI_SWEEP', Path(__file__).parent / 'SurfelGISweep.json'))
+    sweep = json.loads(sweep_path.read_text())
+
+    output_dir = Path(sweep.get('outputDir', 'sweep'))
+    output_dir.mkdir(parents=True, exist_ok=True)
+
+    warmup_frames = sweep.get('warmupFrames', 256)
+    measure_frames = sweep.get('measureFrames', 64)
+    base = sweep.get('base', {})
+
+    m.addGraph(render_graph_SurfelGISweep(base))
+    m.clock.pause()
+    m.clock.time = 0
+    m.frameCapture.outputDir = str(output_dir)
+
+    reference = sweep.get('reference', {})
+    reference_props = dict(base, **reference.get('properties', {}))
+    _, reference_path = render(reference_props, reference.get('warmupFrames', warmup_frames * 8), 1, 'reference')
+    reference_image = read_image(reference_path)
+
+    grid = sweep.get('grid', {})
+    keys = list(grid.keys())
+
+    results = []
+    for index, values in enumerate(itertools.product(*[grid[k] for k in keys])):
+        config = dict(zip(keys, values))
+        props = dict(base, **config)
+
+        time, image_path = render(props, warmup_frames, measure_frames, f'config{index}')
+        metrics = compare_images(reference_image, read_image(image_path))
+
+        result = {'index': index, 'config': config, 'gpuTimeMs': time, 'image': str(image_path)}
+        result.update(metrics)
+        results.append(result)
+
+        print(f'[{index}] {config}: {time:.3f} ms, rmse {metrics["rmse"]:.3e}, psnr {metrics["psnr"]:.2f}')
+
+    (output_dir / 'results.json').write_text(json.dumps(results, indent=2))
+
+    with open(output_dir / 'results.csv', 'w') as f:
+        f.write(','.join(['index'] + keys + ['gpuTimeMs', 'rmse', 'psnr', 'meanRelative']) + '\n')
+        for r in results:
+            row = [r['index']] + [r['config'][k] for k in keys] + [r['gpuTimeMs'], r['rmse'], r['psnr'], r['meanRelative']]
+            f.write(','.join(str(v) for v in row) + '\n')
+
+main()
+exit()